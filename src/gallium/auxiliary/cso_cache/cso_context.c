@@ -87,6 +87,13 @@ struct cso_context {
     */
    int max_sampler_seen;
 
+   /* Whether cso_single_sampler changed any sampler since the last
+    * cso_single_sampler_done, and the number of samplers last bound per
+    * stage, so that unchanged samplers aren't sent to the driver again.
+    */
+   boolean sampler_changed;
+   int nr_bound_samplers[PIPE_SHADER_TYPES];
+
    struct pipe_vertex_buffer aux_vertex_buffer_current;
    struct pipe_vertex_buffer aux_vertex_buffer_saved;
    unsigned aux_vertex_buffer_index;
@@ -1243,7 +1250,10 @@ cso_single_sampler(struct cso_context *ctx, enum pipe_shader_type shader_stage,
       }
 
       ctx->samplers[shader_stage].cso_samplers[idx] = cso;
-      ctx->samplers[shader_stage].samplers[idx] = cso->data;
+      if (ctx->samplers[shader_stage].samplers[idx] != cso->data) {
+         ctx->samplers[shader_stage].samplers[idx] = cso->data;
+         ctx->sampler_changed = TRUE;
+      }
       ctx->max_sampler_seen = MAX2(ctx->max_sampler_seen, (int)idx);
    }
 }
@@ -1261,10 +1271,18 @@ cso_single_sampler_done(struct cso_context *ctx,
    if (ctx->max_sampler_seen == -1)
       return;
 
-   ctx->pipe->bind_sampler_states(ctx->pipe, shader_stage, 0,
-                                  ctx->max_sampler_seen + 1,
-                                  info->samplers);
+   /* Drivers take the number of samplers as the new count of bound
+    * samplers, so always bind all of them, starting from 0.
+    */
+   if (ctx->sampler_changed ||
+       ctx->nr_bound_samplers[shader_stage] != ctx->max_sampler_seen + 1) {
+      ctx->pipe->bind_sampler_states(ctx->pipe, shader_stage, 0,
+                                     ctx->max_sampler_seen + 1,
+                                     info->samplers);
+      ctx->nr_bound_samplers[shader_stage] = ctx->max_sampler_seen + 1;
+   }
    ctx->max_sampler_seen = -1;
+   ctx->sampler_changed = FALSE;
 }
 
 
@@ -1313,6 +1331,7 @@ cso_restore_fragment_samplers(struct cso_context *ctx)
          break;
       }
    }
+   ctx->sampler_changed = TRUE;
 
    cso_single_sampler_done(ctx, PIPE_SHADER_FRAGMENT);
 }
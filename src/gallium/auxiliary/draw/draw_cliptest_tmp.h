@@ -96,32 +96,9 @@ static boolean TAG(do_cliptest)( struct pt_post_vs *pvs,
             out->clip_pos[i] = position[i];
          }
 
-         /* Be careful with NaNs. Comparisons must be true for them. */
          /* Do the hardwired planes first:
           */
-         if (flags & DO_CLIP_XY_GUARD_BAND) {
-            if (!(-0.50 * position[0] + position[3] >= 0)) mask |= (1<<0);
-            if (!( 0.50 * position[0] + position[3] >= 0)) mask |= (1<<1);
-            if (!(-0.50 * position[1] + position[3] >= 0)) mask |= (1<<2);
-            if (!( 0.50 * position[1] + position[3] >= 0)) mask |= (1<<3);
-         }
-         else if (flags & DO_CLIP_XY) {
-            if (!(-position[0] + position[3] >= 0)) mask |= (1<<0);
-            if (!( position[0] + position[3] >= 0)) mask |= (1<<1);
-            if (!(-position[1] + position[3] >= 0)) mask |= (1<<2);
-            if (!( position[1] + position[3] >= 0)) mask |= (1<<3);
-         }
-
-         /* Clip Z planes according to full cube, half cube or none.
-          */
-         if (flags & DO_CLIP_FULL_Z) {
-            if (!( position[2] + position[3] >= 0)) mask |= (1<<4);
-            if (!(-position[2] + position[3] >= 0)) mask |= (1<<5);
-         }
-         else if (flags & DO_CLIP_HALF_Z) {
-            if (!( position[2]               >= 0)) mask |= (1<<4);
-            if (!(-position[2] + position[3] >= 0)) mask |= (1<<5);
-         }
+         mask = compute_fixed_clipmask(position, flags);
 
          if (flags & DO_CLIP_USER) {
             unsigned ucp_mask = ucp_enable;
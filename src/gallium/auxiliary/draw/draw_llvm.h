@@ -44,6 +44,16 @@ struct draw_llvm;
 struct llvm_vertex_shader;
 struct llvm_geometry_shader;
 
+/**
+ * Number of vertices the vertex shader processes at once.  This stays at
+ * most 8 on AVX-512 CPUs, as only llvmpipe's fragment shaders are 16 wide.
+ */
+static inline unsigned
+draw_llvm_vector_length(void)
+{
+   return MIN2(lp_native_vector_width, 256) / 32;
+}
+
 struct draw_jit_texture
 {
    uint32_t width;
@@ -55,6 +65,8 @@ struct draw_jit_texture
    uint32_t row_stride[PIPE_MAX_TEXTURE_LEVELS];
    uint32_t img_stride[PIPE_MAX_TEXTURE_LEVELS];
    uint32_t mip_offsets[PIPE_MAX_TEXTURE_LEVELS];
+   uint32_t num_samples;
+   uint32_t sample_stride;
 };
 
 
@@ -89,6 +101,8 @@ enum {
    DRAW_JIT_TEXTURE_ROW_STRIDE,
    DRAW_JIT_TEXTURE_IMG_STRIDE,
    DRAW_JIT_TEXTURE_MIP_OFFSETS,
+   DRAW_JIT_TEXTURE_NUM_SAMPLES,
+   DRAW_JIT_TEXTURE_SAMPLE_STRIDE,
    DRAW_JIT_TEXTURE_NUM_FIELDS  /* number of fields above */
 };
 
@@ -517,6 +531,7 @@ draw_llvm_set_mapped_texture(struct draw_context *draw,
                              unsigned sview_idx,
                              uint32_t width, uint32_t height, uint32_t depth,
                              uint32_t first_level, uint32_t last_level,
+                             uint32_t num_samples, uint32_t sample_stride,
                              const void *base_ptr,
                              uint32_t row_stride[PIPE_MAX_TEXTURE_LEVELS],
                              uint32_t img_stride[PIPE_MAX_TEXTURE_LEVELS],
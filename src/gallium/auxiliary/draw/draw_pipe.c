@@ -167,6 +167,85 @@ static void do_triangle( struct draw_context *draw,
 }
 
 
+/**
+ * Run a list of independent triangles through a pipeline whose first stage
+ * is the clipper.
+ *
+ * The trivial accept/reject decisions are made for the whole run here, so
+ * that only triangles which actually straddle a clip plane are handed to the
+ * clip stage; trivially rejected ones are dropped and trivially accepted ones
+ * go straight to the stage following the clipper.
+ *
+ * \param elts  element list, or NULL for linear vertices
+ */
+static void pipe_run_clipped_tris( struct draw_context *draw,
+                                   struct draw_stage *clip,
+                                   char *verts,
+                                   unsigned stride,
+                                   const ushort *elts,
+                                   unsigned count,
+                                   unsigned max_index )
+{
+   struct draw_stage *next = clip->next;
+   struct prim_header prim;
+   unsigned i;
+
+   prim.flags = DRAW_PIPE_RESET_STIPPLE | DRAW_PIPE_EDGE_FLAG_ALL;
+   prim.pad = 0;
+
+   for (i = 0; i + 2 < count; i += 3) {
+      struct vertex_header *v0, *v1, *v2;
+      unsigned ormask;
+
+      if (elts) {
+         v0 = (struct vertex_header *)(verts + stride * MIN2(elts[i], max_index));
+         v1 = (struct vertex_header *)(verts + stride * MIN2(elts[i + 1], max_index));
+         v2 = (struct vertex_header *)(verts + stride * MIN2(elts[i + 2], max_index));
+      }
+      else {
+         v0 = (struct vertex_header *)(verts + stride * i);
+         v1 = (struct vertex_header *)(verts + stride * (i + 1));
+         v2 = (struct vertex_header *)(verts + stride * (i + 2));
+      }
+
+      /* all vertices outside the same plane: trivially rejected */
+      if (v0->clipmask & v1->clipmask & v2->clipmask)
+         continue;
+
+      ormask = v0->clipmask | v1->clipmask | v2->clipmask;
+
+      prim.v[0] = v0;
+      prim.v[1] = v1;
+      prim.v[2] = v2;
+
+      if (ormask == 0)
+         next->tri( next, &prim );
+      else
+         clip->tri( clip, &prim );
+   }
+}
+
+
+/**
+ * Check whether a primitive run can use pipe_run_clipped_tris().
+ * Returns the clip stage if so, otherwise NULL.
+ */
+static struct draw_stage *pipe_batched_clipper( struct draw_context *draw,
+                                                unsigned prim )
+{
+   struct draw_stage *first;
+
+   if (prim != PIPE_PRIM_TRIANGLES)
+      return NULL;
+
+   first = draw_pipeline_first_stage( draw );
+   if (first != draw->pipeline.clip)
+      return NULL;
+
+   return first;
+}
+
+
 /*
  * Set up macros for draw_pt_decompose.h template code.
  * This code uses vertex indexes / elements.
@@ -227,6 +306,7 @@ void draw_pipeline_run( struct draw_context *draw,
                         const struct draw_vertex_info *vert_info,
                         const struct draw_prim_info *prim_info)
 {
+   struct draw_stage *clip = pipe_batched_clipper(draw, prim_info->prim);
    unsigned i, start;
 
    draw->pipeline.verts = (char *)vert_info->verts;
@@ -258,6 +338,16 @@ void draw_pipeline_run( struct draw_context *draw,
       }
 #endif
 
+      if (clip) {
+         pipe_run_clipped_tris(draw, clip,
+                               (char *)vert_info->verts,
+                               vert_info->stride,
+                               prim_info->elts + start,
+                               count,
+                               vert_info->count - 1);
+         continue;
+      }
+
       pipe_run_elts(draw,
                     prim_info->prim,
                     prim_info->flags,
@@ -314,6 +404,7 @@ void draw_pipeline_run_linear( struct draw_context *draw,
                                const struct draw_vertex_info *vert_info,
                                const struct draw_prim_info *prim_info)
 {
+   struct draw_stage *clip = pipe_batched_clipper(draw, prim_info->prim);
    unsigned i, start;
 
    for (start = i = 0;
@@ -330,6 +421,12 @@ void draw_pipeline_run_linear( struct draw_context *draw,
 
       assert(count <= vert_info->count);
 
+      if (clip) {
+         pipe_run_clipped_tris(draw, clip, verts, vert_info->stride,
+                               NULL, count, count - 1);
+         continue;
+      }
+
       pipe_run_linear(draw,
                       prim_info->prim,
                       prim_info->flags,
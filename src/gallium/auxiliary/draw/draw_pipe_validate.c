@@ -278,6 +278,18 @@ static struct draw_stage *validate_pipeline( struct draw_stage *stage )
    return draw->pipeline.first;
 }
 
+/**
+ * Return the first stage of the pipeline, building the pipeline first if
+ * state changed since it was last validated.
+ */
+struct draw_stage *draw_pipeline_first_stage( struct draw_context *draw )
+{
+   if (draw->pipeline.first == draw->pipeline.validate)
+      return validate_pipeline( draw->pipeline.validate );
+
+   return draw->pipeline.first;
+}
+
 static void validate_tri( struct draw_stage *stage, 
 			  struct prim_header *header )
 {
@@ -28,6 +28,7 @@
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/u_prim.h"
+#include "util/u_sse.h"
 #include "pipe/p_context.h"
 #include "draw/draw_context.h"
 #include "draw/draw_private.h"
@@ -71,6 +72,70 @@ dot4(const float *a, const float *b)
            a[3]*b[3]);
 }
 
+/**
+ * Compute the clip mask bits of the fixed x/y and z planes.
+ *
+ * Be careful with NaNs: a distance which is NaN must be reported as
+ * outside, hence the "not greater or equal" comparisons.
+ */
+static inline unsigned
+compute_fixed_clipmask(const float *position, unsigned flags)
+{
+   unsigned mask = 0;
+#if defined(PIPE_ARCH_SSE)
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 pos = _mm_loadu_ps(position);
+   const __m128 w = _mm_shuffle_ps(pos, pos, _MM_SHUFFLE(3, 3, 3, 3));
+
+   if (flags & (DO_CLIP_XY | DO_CLIP_XY_GUARD_BAND)) {
+      const float k = (flags & DO_CLIP_XY_GUARD_BAND) ? 0.5f : 1.0f;
+      /* (w - k*x, w + k*x, w - k*y, w + k*y) */
+      const __m128 xxyy = _mm_shuffle_ps(pos, pos, _MM_SHUFFLE(1, 1, 0, 0));
+      const __m128 dist = _mm_add_ps(_mm_mul_ps(xxyy,
+                                                _mm_setr_ps(-k, k, -k, k)),
+                                     w);
+      mask |= _mm_movemask_ps(_mm_cmpnge_ps(dist, zero));
+   }
+
+   if (flags & (DO_CLIP_FULL_Z | DO_CLIP_HALF_Z)) {
+      /* (z + w, w - z) for the full cube, (z, w - z) for the half cube */
+      const __m128 zz = _mm_shuffle_ps(pos, pos, _MM_SHUFFLE(2, 2, 2, 2));
+      const __m128 wz = (flags & DO_CLIP_FULL_Z) ? w :
+         _mm_and_ps(w, _mm_castsi128_ps(_mm_setr_epi32(0, ~0, 0, 0)));
+      const __m128 dist = _mm_add_ps(_mm_mul_ps(zz,
+                                                _mm_setr_ps(1.0f, -1.0f,
+                                                            0.0f, 0.0f)),
+                                     wz);
+      mask |= (_mm_movemask_ps(_mm_cmpnge_ps(dist, zero)) & 0x3) << 4;
+   }
+#else
+   if (flags & DO_CLIP_XY_GUARD_BAND) {
+      if (!(-0.50 * position[0] + position[3] >= 0)) mask |= (1<<0);
+      if (!( 0.50 * position[0] + position[3] >= 0)) mask |= (1<<1);
+      if (!(-0.50 * position[1] + position[3] >= 0)) mask |= (1<<2);
+      if (!( 0.50 * position[1] + position[3] >= 0)) mask |= (1<<3);
+   }
+   else if (flags & DO_CLIP_XY) {
+      if (!(-position[0] + position[3] >= 0)) mask |= (1<<0);
+      if (!( position[0] + position[3] >= 0)) mask |= (1<<1);
+      if (!(-position[1] + position[3] >= 0)) mask |= (1<<2);
+      if (!( position[1] + position[3] >= 0)) mask |= (1<<3);
+   }
+
+   /* Clip Z planes according to full cube, half cube or none.
+    */
+   if (flags & DO_CLIP_FULL_Z) {
+      if (!( position[2] + position[3] >= 0)) mask |= (1<<4);
+      if (!(-position[2] + position[3] >= 0)) mask |= (1<<5);
+   }
+   else if (flags & DO_CLIP_HALF_Z) {
+      if (!( position[2]               >= 0)) mask |= (1<<4);
+      if (!(-position[2] + position[3] >= 0)) mask |= (1<<5);
+   }
+#endif
+   return mask;
+}
+
 #define FLAGS (0)
 #define TAG(x) x##_none
 #include "draw_cliptest_tmp.h"
@@ -23,6 +23,9 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <inttypes.h>
+
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 
@@ -31,11 +34,23 @@
 #include "draw/draw_pt.h"
 
 #define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+
+/*
+ * The post-transform vertex cache is set-associative: a fetch index is
+ * hashed to one of CACHE_SETS sets, each holding up to CACHE_WAYS entries
+ * which are replaced in FIFO order.  This avoids the systematic conflicts a
+ * direct-mapped cache keyed by "index % size" has on grid-like meshes, where
+ * vertices shared between rows are a power-of-two stride apart.
+ */
+#define CACHE_SET_BITS 7
+#define CACHE_SETS     (1 << CACHE_SET_BITS)
+#define CACHE_WAYS     4
 
 /* The largest possible index within an index buffer */
 #define MAX_ELT_IDX 0xffffffff
 
+DEBUG_GET_ONCE_BOOL_OPTION(draw_vsplit_stats, "DRAW_VSPLIT_STATS", FALSE)
+
 struct vsplit_frontend {
    struct draw_pt_front_end base;
    struct draw_context *draw;
@@ -54,21 +69,29 @@ struct vsplit_frontend {
 
    struct {
       /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      ushort draws[MAP_SIZE];
-      boolean has_max_fetch;
+      unsigned fetches[CACHE_SETS][CACHE_WAYS];
+      ushort draws[CACHE_SETS][CACHE_WAYS];
+      /* number of insertions into each set since the last clear */
+      ushort fill[CACHE_SETS];
 
       ushort num_fetch_elts;
       ushort num_draw_elts;
    } cache;
+
+   /* post-transform cache statistics, see DRAW_VSPLIT_STATS */
+   struct {
+      boolean enabled;
+      uint64_t hits;
+      uint64_t misses;
+   } stats;
 };
 
 
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
-   vsplit->cache.has_max_fetch = FALSE;
+   /* only the fill counts need resetting; stale ways are never looked at */
+   memset(vsplit->cache.fill, 0, sizeof(vsplit->cache.fill));
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
 }
@@ -76,34 +99,58 @@ vsplit_clear_cache(struct vsplit_frontend *vsplit)
 static void
 vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 {
+   if (vsplit->stats.enabled) {
+      vsplit->stats.misses += vsplit->cache.num_fetch_elts;
+      vsplit->stats.hits += vsplit->cache.num_draw_elts -
+                            vsplit->cache.num_fetch_elts;
+   }
+
    vsplit->middle->run(vsplit->middle,
          vsplit->fetch_elts, vsplit->cache.num_fetch_elts,
          vsplit->draw_elts, vsplit->cache.num_draw_elts, flags);
 }
 
+/**
+ * Map a fetch element to a cache set.  Fibonacci hashing spreads both
+ * sequential and power-of-two strided indices evenly over the sets.
+ */
+static inline unsigned
+vsplit_cache_set(unsigned fetch)
+{
+   return (fetch * 0x9e3779b1u) >> (32 - CACHE_SET_BITS);
+}
+
 /**
  * Add a fetch element and add it to the draw elements.
  */
 static inline void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch)
 {
-   unsigned hash;
+   const unsigned set = vsplit_cache_set(fetch);
+   const unsigned fill = vsplit->cache.fill[set];
+   const unsigned valid = MIN2(fill, CACHE_WAYS);
+   unsigned *fetches = vsplit->cache.fetches[set];
+   ushort *draws = vsplit->cache.draws[set];
+   unsigned way;
+
+   for (way = 0; way < valid; way++) {
+      if (fetches[way] == fetch) {
+         vsplit->draw_elts[vsplit->cache.num_draw_elts++] = draws[way];
+         return;
+      }
+   }
 
-   hash = fetch % MAP_SIZE;
+   /* miss: replace the oldest entry of the set */
+   way = fill % CACHE_WAYS;
+   fetches[way] = fetch;
+   draws[way] = vsplit->cache.num_fetch_elts;
+   vsplit->cache.fill[set] = fill + 1;
 
-   /* If the value isn't in the cache or it's an overflow due to the
-    * element bias */
-   if (vsplit->cache.fetches[hash] != fetch) {
-      /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
+   /* add fetch */
+   assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
+   vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
 
-      /* add fetch */
-      assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
-      vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
-   }
-
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = draws[way];
 }
 
 /**
@@ -131,12 +178,6 @@ vsplit_add_cache_ubyte(struct vsplit_frontend *vsplit, const ubyte *elts,
 {
    struct draw_context *draw = vsplit->draw;
    VSPLIT_CREATE_IDX(elts, start, fetch, elt_bias);
-   /* unlike the uint case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = fetch % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -146,12 +187,6 @@ vsplit_add_cache_ushort(struct vsplit_frontend *vsplit, const ushort *elts,
 {
    struct draw_context *draw = vsplit->draw;
    VSPLIT_CREATE_IDX(elts, start, fetch, elt_bias);
-   /* unlike the uint case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = fetch % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -166,13 +201,6 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
 {
    struct draw_context *draw = vsplit->draw;
    VSPLIT_CREATE_IDX(elts, start, fetch, elt_bias);
-   /* Take care for DRAW_MAX_FETCH_IDX (since cache is initialized to -1). */
-   if (elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = fetch % MAP_SIZE;
-      /* force update - any value will do except DRAW_MAX_FETCH_IDX */
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -244,6 +272,17 @@ static void vsplit_flush(struct draw_pt_front_end *frontend, unsigned flags)
 
 static void vsplit_destroy(struct draw_pt_front_end *frontend)
 {
+   struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;
+
+   if (vsplit->stats.enabled) {
+      uint64_t total = vsplit->stats.hits + vsplit->stats.misses;
+
+      debug_printf("draw: vsplit cache: %" PRIu64 " vertices, "
+                   "%" PRIu64 " hits, %" PRIu64 " misses (%.1f%% hit rate)\n",
+                   total, vsplit->stats.hits, vsplit->stats.misses,
+                   total ? 100.0 * vsplit->stats.hits / total : 0.0);
+   }
+
    FREE(frontend);
 }
 
@@ -261,6 +300,7 @@ struct draw_pt_front_end *draw_pt_vsplit(struct draw_context *draw)
    vsplit->base.flush   = vsplit_flush;
    vsplit->base.destroy = vsplit_destroy;
    vsplit->draw = draw;
+   vsplit->stats.enabled = debug_get_option_draw_vsplit_stats();
 
    for (i = 0; i < SEGMENT_SIZE; i++)
       vsplit->identity_draw_elts[i] = i;
@@ -420,6 +420,8 @@ lp_build_init(void)
       util_cpu_caps.has_avx2 = 0;
       util_cpu_caps.has_f16c = 0;
       util_cpu_caps.has_fma = 0;
+      util_cpu_caps.has_avx512f = 0;
+      util_cpu_caps.has_avx512dq = 0;
    }
 #endif
 
@@ -429,9 +431,18 @@ lp_build_init(void)
     *
     * See also:
     * - http://www.anandtech.com/show/4955/the-bulldozer-review-amd-fx8150-tested/2
+    *
+    * AVX-512 requires LLVM 4.0, as older versions don't pick up the host CPU
+    * features and we explicitly disable AVX-512 for them (see
+    * lp_build_create_jit_compiler_for_module).
     */
-   if (util_cpu_caps.has_avx &&
+   if (HAVE_LLVM >= 0x0400 &&
+       util_cpu_caps.has_avx512f &&
+       util_cpu_caps.has_avx512dq &&
        util_cpu_caps.has_intel) {
+      lp_native_vector_width = 512;
+   } else if (util_cpu_caps.has_avx &&
+              util_cpu_caps.has_intel) {
       lp_native_vector_width = 256;
    } else {
       /* Leave it at 128, even when no SIMD extensions are available.
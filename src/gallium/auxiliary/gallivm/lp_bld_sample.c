@@ -2077,3 +2077,66 @@ lp_build_sample_offset(struct lp_build_context *bld,
 
    *out_offset = offset;
 }
+
+
+/**
+ * Compute the offset of a pixel in an image stored in 4x4 pixel tiles.
+ *
+ * The tiles of a row of tiles are stored consecutively, so with y_stride
+ * being the stride of a single row of pixels the offset of pixel x, y is
+ *
+ *    (y & ~3) * y_stride + ((x & ~3) * 4 + (y & 3) * 4 + (x & 3)) * bpp
+ *
+ * Only formats with 1x1 pixel blocks can be tiled.
+ */
+void
+lp_build_sample_tiled_offset(struct lp_build_context *bld,
+                             const struct util_format_description *format_desc,
+                             LLVMValueRef x,
+                             LLVMValueRef y,
+                             LLVMValueRef z,
+                             LLVMValueRef y_stride,
+                             LLVMValueRef z_stride,
+                             LLVMValueRef *out_offset,
+                             LLVMValueRef *out_i,
+                             LLVMValueRef *out_j)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+   LLVMValueRef x_stride, mask_lo, mask_hi, index;
+   LLVMValueRef offset;
+
+   assert(format_desc->block.width == 1);
+   assert(format_desc->block.height == 1);
+
+   x_stride = lp_build_const_vec(bld->gallivm, bld->type,
+                                 format_desc->block.bits/8);
+   mask_lo = lp_build_const_int_vec(bld->gallivm, bld->type, 3);
+   mask_hi = lp_build_const_int_vec(bld->gallivm, bld->type, ~3);
+
+   /* pixel index within the row of tiles */
+   index = LLVMBuildAnd(builder, x, mask_hi, "");
+   if (y && y_stride) {
+      index = LLVMBuildOr(builder, index,
+                          LLVMBuildAnd(builder, y, mask_lo, ""), "");
+   }
+   index = LLVMBuildShl(builder, index,
+                        lp_build_const_int_vec(bld->gallivm, bld->type, 2), "");
+   index = LLVMBuildOr(builder, index,
+                       LLVMBuildAnd(builder, x, mask_lo, ""), "");
+   offset = lp_build_mul(bld, index, x_stride);
+
+   if (y && y_stride) {
+      LLVMValueRef y_offset;
+      y_offset = lp_build_mul(bld, LLVMBuildAnd(builder, y, mask_hi, ""),
+                              y_stride);
+      offset = lp_build_add(bld, offset, y_offset);
+   }
+
+   if (z && z_stride) {
+      offset = lp_build_add(bld, offset, lp_build_mul(bld, z, z_stride));
+   }
+
+   *out_offset = offset;
+   *out_i = bld->zero;
+   *out_j = bld->zero;
+}
@@ -95,6 +95,7 @@ enum lp_sampler_op_type {
 #define LP_SAMPLER_LOD_CONTROL_MASK   (3 << 4)
 #define LP_SAMPLER_LOD_PROPERTY_SHIFT       6
 #define LP_SAMPLER_LOD_PROPERTY_MASK  (3 << 6)
+#define LP_SAMPLER_FETCH_MS           (1 << 8)
 
 struct lp_sampler_params
 {
@@ -108,6 +109,7 @@ struct lp_sampler_params
    const LLVMValueRef *offsets;
    LLVMValueRef lod;
    const struct lp_derivatives *derivs;
+   LLVMValueRef ms_index;     /**< sample index, for LP_SAMPLER_FETCH_MS */
    LLVMValueRef *texel;
 };
 
@@ -143,6 +145,7 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+   unsigned tiled:1;         /**< image stored in 4x4 pixel tiles */
 };
 
 
@@ -254,6 +257,20 @@ struct lp_sampler_dynamic_state
                   LLVMValueRef context_ptr,
                   unsigned texture_unit);
 
+   /** Obtain the number of samples (returns int32) */
+   LLVMValueRef
+   (*num_samples)(const struct lp_sampler_dynamic_state *state,
+                  struct gallivm_state *gallivm,
+                  LLVMValueRef context_ptr,
+                  unsigned texture_unit);
+
+   /** Obtain the byte offset between samples (returns int32) */
+   LLVMValueRef
+   (*sample_stride)(const struct lp_sampler_dynamic_state *state,
+                    struct gallivm_state *gallivm,
+                    LLVMValueRef context_ptr,
+                    unsigned texture_unit);
+
    /* These are callbacks for sampler state */
 
    /** Obtain texture min lod (returns float) */
@@ -603,6 +620,19 @@ lp_build_sample_offset(struct lp_build_context *bld,
                        LLVMValueRef *out_j);
 
 
+void
+lp_build_sample_tiled_offset(struct lp_build_context *bld,
+                             const struct util_format_description *format_desc,
+                             LLVMValueRef x,
+                             LLVMValueRef y,
+                             LLVMValueRef z,
+                             LLVMValueRef y_stride,
+                             LLVMValueRef z_stride,
+                             LLVMValueRef *out_offset,
+                             LLVMValueRef *out_i,
+                             LLVMValueRef *out_j);
+
+
 void
 lp_build_sample_soa(const struct lp_static_texture_state *static_texture_state,
                     const struct lp_static_sampler_state *static_sampler_state,
@@ -137,10 +137,18 @@ lp_build_sample_texel_soa(struct lp_build_sample_context *bld,
    }
 
    /* convert x,y,z coords to linear offset from start of texture, in bytes */
-   lp_build_sample_offset(&bld->int_coord_bld,
-                          bld->format_desc,
-                          x, y, z, y_stride, z_stride,
-                          &offset, &i, &j);
+   if (bld->static_texture_state->tiled) {
+      lp_build_sample_tiled_offset(&bld->int_coord_bld,
+                                   bld->format_desc,
+                                   x, y, z, y_stride, z_stride,
+                                   &offset, &i, &j);
+   }
+   else {
+      lp_build_sample_offset(&bld->int_coord_bld,
+                             bld->format_desc,
+                             x, y, z, y_stride, z_stride,
+                             &offset, &i, &j);
+   }
    if (mipoffsets) {
       offset = lp_build_add(&bld->int_coord_bld, offset, mipoffsets);
    }
@@ -2581,6 +2589,7 @@ lp_build_fetch_texel(struct lp_build_sample_context *bld,
                      const LLVMValueRef *coords,
                      LLVMValueRef explicit_lod,
                      const LLVMValueRef *offsets,
+                     LLVMValueRef ms_index,
                      LLVMValueRef *colors_out)
 {
    struct lp_build_context *perquadi_bld = &bld->lodi_bld;
@@ -2667,16 +2676,60 @@ lp_build_fetch_texel(struct lp_build_sample_context *bld,
       }
    }
 
-   lp_build_sample_offset(int_coord_bld,
-                          bld->format_desc,
-                          x, y, z, row_stride_vec, img_stride_vec,
-                          &offset, &i, &j);
+   if (bld->static_texture_state->tiled) {
+      lp_build_sample_tiled_offset(int_coord_bld,
+                                   bld->format_desc,
+                                   x, y, z, row_stride_vec, img_stride_vec,
+                                   &offset, &i, &j);
+   }
+   else {
+      lp_build_sample_offset(int_coord_bld,
+                             bld->format_desc,
+                             x, y, z, row_stride_vec, img_stride_vec,
+                             &offset, &i, &j);
+   }
 
    if (bld->static_texture_state->target != PIPE_BUFFER) {
       offset = lp_build_add(int_coord_bld, offset,
                             lp_build_get_mip_offsets(bld, ilevel));
    }
 
+   if (ms_index) {
+      /*
+       * Each sample is a complete image, sample_stride bytes after the
+       * previous one.  Without the callbacks there's only one sample.
+       */
+      LLVMValueRef num_samples, sample_stride;
+
+      if (bld->dynamic_state->num_samples) {
+         num_samples = bld->dynamic_state->num_samples(bld->dynamic_state,
+                                                       bld->gallivm,
+                                                       bld->context_ptr,
+                                                       texture_unit);
+         sample_stride = bld->dynamic_state->sample_stride(bld->dynamic_state,
+                                                           bld->gallivm,
+                                                           bld->context_ptr,
+                                                           texture_unit);
+      }
+      else {
+         num_samples = lp_build_const_int32(bld->gallivm, 1);
+         sample_stride = lp_build_const_int32(bld->gallivm, 0);
+      }
+      num_samples = lp_build_broadcast_scalar(int_coord_bld, num_samples);
+      sample_stride = lp_build_broadcast_scalar(int_coord_bld, sample_stride);
+
+      out1 = lp_build_cmp(int_coord_bld, PIPE_FUNC_LESS, ms_index,
+                          int_coord_bld->zero);
+      out_of_bounds = lp_build_or(int_coord_bld, out_of_bounds, out1);
+      out1 = lp_build_cmp(int_coord_bld, PIPE_FUNC_GEQUAL, ms_index,
+                          num_samples);
+      out_of_bounds = lp_build_or(int_coord_bld, out_of_bounds, out1);
+
+      offset = lp_build_add(int_coord_bld, offset,
+                            lp_build_mul(int_coord_bld, ms_index,
+                                         sample_stride));
+   }
+
    offset = lp_build_andnot(int_coord_bld, offset, out_of_bounds);
 
    lp_build_fetch_rgba_soa(bld->gallivm,
@@ -2727,6 +2780,7 @@ lp_build_sample_nop(struct gallivm_state *gallivm,
  * \param type  vector float type to use for coords, etc.
  * \param sample_key
  * \param derivs  partial derivatives of (s,t,r,q) with respect to x and y
+ * \param ms_index  sample index, for LP_SAMPLER_FETCH_MS
  */
 static void
 lp_build_sample_soa_code(struct gallivm_state *gallivm,
@@ -2743,6 +2797,7 @@ lp_build_sample_soa_code(struct gallivm_state *gallivm,
                          const LLVMValueRef *offsets,
                          const struct lp_derivatives *derivs, /* optional */
                          LLVMValueRef lod, /* optional */
+                         LLVMValueRef ms_index, /* optional */
                          LLVMValueRef texel_out[4])
 {
    unsigned target = static_texture_state->target;
@@ -3090,7 +3145,7 @@ lp_build_sample_soa_code(struct gallivm_state *gallivm,
 
    else if (op_type == LP_SAMPLER_OP_FETCH) {
       lp_build_fetch_texel(&bld, texture_index, newcoords,
-                           lod, offsets,
+                           lod, offsets, ms_index,
                            texel_out);
    }
 
@@ -3122,6 +3177,10 @@ lp_build_sample_soa_code(struct gallivm_state *gallivm,
          /* theoretically possible with AoS filtering but not implemented (complex!) */
          use_aos = 0;
       }
+      if (static_texture_state->tiled) {
+         /* AoS addressing only knows linear layouts */
+         use_aos = 0;
+      }
 
       if ((gallivm_debug & GALLIVM_DEBUG_PERF) &&
           !use_aos && util_format_fits_8unorm(bld.format_desc)) {
@@ -3410,6 +3469,7 @@ lp_build_sample_gen_func(struct gallivm_state *gallivm,
    LLVMValueRef coords[5];
    LLVMValueRef offsets[3] = { NULL };
    LLVMValueRef lod = NULL;
+   LLVMValueRef ms_index = NULL;
    LLVMValueRef context_ptr;
    LLVMValueRef thread_data_ptr = NULL;
    LLVMValueRef texel_out[4];
@@ -3468,6 +3528,9 @@ lp_build_sample_gen_func(struct gallivm_state *gallivm,
       }
       deriv_ptr = &derivs;
    }
+   if (sample_key & LP_SAMPLER_FETCH_MS) {
+      ms_index = LLVMGetParam(function, num_param++);
+   }
 
    assert(num_args == num_param);
 
@@ -3494,6 +3557,7 @@ lp_build_sample_gen_func(struct gallivm_state *gallivm,
                             offsets,
                             deriv_ptr,
                             lod,
+                            ms_index,
                             texel_out);
 
    LLVMBuildAggregateRet(gallivm->builder, texel_out, 4);
@@ -3609,6 +3673,9 @@ lp_build_sample_soa_func(struct gallivm_state *gallivm,
             assert(LLVMTypeOf(derivs->ddy[0]) == LLVMTypeOf(derivs->ddy[i]));
          }
       }
+      if (sample_key & LP_SAMPLER_FETCH_MS) {
+         arg_types[num_param++] = LLVMTypeOf(params->ms_index);
+      }
 
       val_type[0] = val_type[1] = val_type[2] = val_type[3] =
          lp_build_vec_type(gallivm, params->type);
@@ -3667,6 +3734,9 @@ lp_build_sample_soa_func(struct gallivm_state *gallivm,
          args[num_args++] = derivs->ddy[i];
       }
    }
+   if (sample_key & LP_SAMPLER_FETCH_MS) {
+      args[num_args++] = params->ms_index;
+   }
 
    assert(num_args <= LP_MAX_TEX_FUNC_ARGS);
 
@@ -3752,6 +3822,7 @@ lp_build_sample_soa(const struct lp_static_texture_state *static_texture_state,
                                params->offsets,
                                params->derivs,
                                params->lod,
+                               params->ms_index,
                                params->texel);
    }
 }
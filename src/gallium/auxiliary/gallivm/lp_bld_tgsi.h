@@ -170,6 +170,35 @@ struct lp_bld_tgsi_system_values {
    LLVMValueRef prim_id;
    LLVMValueRef basevertex;
    LLVMValueRef invocation_id;
+   LLVMValueRef thread_id[3];   /**< vectors, compute shaders only */
+   LLVMValueRef block_id[3];    /**< scalars, compute shaders only */
+   LLVMValueRef grid_size[3];
+   LLVMValueRef block_size[3];
+};
+
+
+/**
+ * Memory and barriers of compute shaders.
+ *
+ * A compute shader function runs one vector of invocations of a work
+ * group.  Barriers are implemented by returning from the function: the
+ * function returns the (non-zero) index of the barrier it stopped at, or
+ * zero once the invocations have finished, and is called again with that
+ * index as resume_index once all the other invocations of the group got
+ * to the barrier too.  The temporaries of a shader with barriers live in
+ * temps_ptr so that they survive these returns.  Barriers must be in
+ * uniform control flow, and not inside a switch or a subroutine;
+ * unsupported_barrier is set if one isn't.
+ */
+struct lp_build_tgsi_cs_iface
+{
+   LLVMValueRef ssbo_ptr;        /**< array of i32 pointers to shader buffers */
+   LLVMValueRef ssbo_sizes_ptr;  /**< array of i32 buffer sizes, in bytes */
+   LLVMValueRef shared_ptr;      /**< i8 pointer to the group's shared memory */
+   LLVMValueRef shared_size;     /**< i32 size of the shared memory, in bytes */
+   LLVMValueRef temps_ptr;       /**< storage for the temporaries, or NULL */
+   LLVMValueRef resume_index;    /**< i32 barrier to resume at, or NULL */
+   boolean *unsupported_barrier; /**< out: a barrier couldn't be resumed */
 };
 
 
@@ -230,7 +259,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface);
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface);
 
 
 void
@@ -398,6 +428,11 @@ struct lp_build_tgsi_context
      */
    void (*emit_prologue)(struct lp_build_tgsi_context*);
 
+   /** Optional, called after the declarations and immediates, right before
+    * the first instruction.
+    */
+   void (*emit_prologue_post_decl)(struct lp_build_tgsi_context*);
+
    /** This function allows the user to insert some instructions at the end of
      * the program.  This callback is intended to be used for emitting
      * instructions to handle the export for the output registers, but it can
@@ -438,6 +473,7 @@ struct lp_build_tgsi_soa_context
    struct lp_build_context elem_bld;
 
    const struct lp_build_tgsi_gs_iface *gs_iface;
+   const struct lp_build_tgsi_cs_iface *cs_iface;
    LLVMValueRef emitted_prims_vec_ptr;
    LLVMValueRef total_emitted_vertices_vec_ptr;
    LLVMValueRef emitted_vertices_vec_ptr;
@@ -447,6 +483,8 @@ struct lp_build_tgsi_soa_context
    LLVMValueRef const_sizes_ptr;
    LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
    LLVMValueRef consts_sizes[LP_MAX_TGSI_CONST_BUFFERS];
+   LLVMValueRef ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   LLVMValueRef ssbo_sizes[LP_MAX_TGSI_SHADER_BUFFERS];
    const LLVMValueRef (*inputs)[TGSI_NUM_CHANNELS];
    LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS];
    LLVMValueRef context_ptr;
@@ -494,6 +532,10 @@ struct lp_build_tgsi_soa_context
 
    uint num_immediates;
    boolean use_immediates_array;
+
+   /** compute shaders: switch to the code after each barrier */
+   LLVMValueRef resume_switch;
+   unsigned num_barriers;
 };
 
 void
@@ -819,6 +819,104 @@ static void lp_exec_mask_endsub(struct lp_exec_mask *mask, int *pc)
    lp_exec_mask_update(mask);
 }
 
+/*
+ * Whether the code following a barrier at the current position can be
+ * entered directly when resuming a compute shader.
+ *
+ * Code inside a loop ahead of the barrier is then reached through the back
+ * edge without passing through the code ahead of the loop, so the masks
+ * live at the loop entries must not be values computed there.
+ */
+static boolean
+lp_exec_mask_barrier_resumable(struct lp_exec_mask *mask)
+{
+   struct function_ctx *ctx = func_ctx(mask);
+   int i;
+
+   if (mask->function_stack_size > 1 || mask_has_switch(mask))
+      return FALSE;
+
+   if (ctx->loop_stack_size == 0)
+      return TRUE;
+
+   if (ctx->loop_stack_size > LP_MAX_TGSI_NESTING ||
+       ctx->cond_stack_size > 0 ||
+       !LLVMIsConstant(mask->ret_mask))
+      return FALSE;
+
+   for (i = 0; i < ctx->loop_stack_size; i++) {
+      if (!LLVMIsConstant(ctx->loop_stack[i].cont_mask))
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+static LLVMValueRef
+barrier_merge_value(struct lp_exec_mask *mask,
+                    LLVMValueRef value,
+                    LLVMBasicBlockRef skip_block,
+                    LLVMBasicBlockRef resume_block)
+{
+   LLVMBuilderRef builder = mask->bld->gallivm->builder;
+   LLVMValueRef ones = LLVMConstAllOnes(mask->int_vec_type);
+   LLVMValueRef phi;
+
+   if (!value || value == ones)
+      return value;
+
+   phi = LLVMBuildPhi(builder, mask->int_vec_type, "");
+   LLVMAddIncoming(phi, &value, &skip_block, 1);
+   LLVMAddIncoming(phi, &ones, &resume_block, 1);
+   return phi;
+}
+
+/*
+ * Merge the masks at the code following a barrier.
+ *
+ * Barriers are in uniform control flow, so all the invocations are active
+ * when resuming, while skip_block is the path of vectors which had no
+ * active invocation when reaching the barrier.  Must be called with the
+ * builder at the beginning of the merge block.
+ */
+static void
+lp_exec_mask_barrier_merge(struct lp_exec_mask *mask,
+                           LLVMBasicBlockRef skip_block,
+                           LLVMBasicBlockRef resume_block)
+{
+   int i, j;
+
+   mask->ret_mask = barrier_merge_value(mask, mask->ret_mask,
+                                        skip_block, resume_block);
+   mask->cond_mask = barrier_merge_value(mask, mask->cond_mask,
+                                         skip_block, resume_block);
+   mask->cont_mask = barrier_merge_value(mask, mask->cont_mask,
+                                         skip_block, resume_block);
+   mask->break_mask = barrier_merge_value(mask, mask->break_mask,
+                                          skip_block, resume_block);
+
+   for (i = 0; i < mask->function_stack_size; i++) {
+      struct function_ctx *ctx = &mask->function_stack[i];
+
+      ctx->ret_mask = barrier_merge_value(mask, ctx->ret_mask,
+                                          skip_block, resume_block);
+      for (j = 0; j < MIN2(ctx->cond_stack_size, LP_MAX_TGSI_NESTING); j++) {
+         ctx->cond_stack[j] = barrier_merge_value(mask, ctx->cond_stack[j],
+                                                  skip_block, resume_block);
+      }
+      for (j = 0; j < MIN2(ctx->loop_stack_size, LP_MAX_TGSI_NESTING); j++) {
+         ctx->loop_stack[j].cont_mask =
+            barrier_merge_value(mask, ctx->loop_stack[j].cont_mask,
+                                skip_block, resume_block);
+         ctx->loop_stack[j].break_mask =
+            barrier_merge_value(mask, ctx->loop_stack[j].break_mask,
+                                skip_block, resume_block);
+      }
+   }
+
+   lp_exec_mask_update(mask);
+}
+
 
 static LLVMValueRef
 get_file_ptr(struct lp_build_tgsi_soa_context *bld,
@@ -1647,6 +1745,36 @@ emit_fetch_system_value(
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
+   case TGSI_SEMANTIC_THREAD_ID:
+      res = swizzle < 3 ? bld->system_values.thread_id[swizzle] :
+                          bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_ID:
+      res = swizzle < 3 ?
+            lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                      bld->system_values.block_id[swizzle]) :
+            bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_GRID_SIZE:
+      res = swizzle < 3 ?
+            lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                      bld->system_values.grid_size[swizzle]) :
+            bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_SIZE:
+      res = swizzle < 3 ?
+            lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                      bld->system_values.block_size[swizzle]) :
+            bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
    default:
       assert(!"unexpected semantic in emit_fetch_system_value");
       res = bld_base->base.zero;
@@ -2479,10 +2607,17 @@ emit_fetch_texels( struct lp_build_tgsi_soa_context *bld,
       explicit_lod = lp_build_emit_fetch(&bld->bld_base, inst, 0, 3);
       lod_property = lp_build_lod_property(&bld->bld_base, inst, 0);
    }
-   /*
-    * XXX: for real msaa support, the w component (or src2.x for sample_i_ms)
-    * would be the sample index.
-    */
+   /* the w component (or src2.x for sample_i_ms) is the sample index */
+   if (target == TGSI_TEXTURE_2D_MSAA ||
+       target == TGSI_TEXTURE_2D_ARRAY_MSAA) {
+      sample_key |= LP_SAMPLER_FETCH_MS;
+      if (inst->Instruction.Opcode == TGSI_OPCODE_SAMPLE_I_MS) {
+         params.ms_index = lp_build_emit_fetch(&bld->bld_base, inst, 2, 0);
+      }
+      else {
+         params.ms_index = lp_build_emit_fetch(&bld->bld_base, inst, 0, 3);
+      }
+   }
 
    for (i = 0; i < dims; i++) {
       coords[i] = lp_build_emit_fetch(&bld->bld_base, inst, 0, i);
@@ -2904,6 +3039,18 @@ lp_emit_declaration_soa(
    }
       break;
 
+   case TGSI_FILE_BUFFER:
+      assert(bld->cs_iface);
+      assert(last < LP_MAX_TGSI_SHADER_BUFFERS);
+      for (idx = first; idx <= last; ++idx) {
+         LLVMValueRef index = lp_build_const_int32(gallivm, idx);
+         bld->ssbos[idx] =
+            lp_build_array_get(gallivm, bld->cs_iface->ssbo_ptr, index);
+         bld->ssbo_sizes[idx] =
+            lp_build_array_get(gallivm, bld->cs_iface->ssbo_sizes_ptr, index);
+      }
+      break;
+
    default:
       /* don't need to declare other vars */
       break;
@@ -3455,6 +3602,385 @@ end_primitive(
    }
 }
 
+/*
+ * Return the i32 pointer to and the size in bytes of the shader buffer or
+ * shared memory referenced by a memory instruction.
+ */
+static void
+get_memory_ptr(struct lp_build_tgsi_soa_context *bld,
+               unsigned file,
+               unsigned index,
+               LLVMValueRef *ptr,
+               LLVMValueRef *size)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+
+   assert(bld->cs_iface);
+
+   if (file == TGSI_FILE_BUFFER) {
+      assert(index < LP_MAX_TGSI_SHADER_BUFFERS);
+      *ptr = bld->ssbos[index];
+      *size = bld->ssbo_sizes[index];
+   }
+   else {
+      /* TGSI_FILE_MEMORY, only shared memory is supported */
+      assert(file == TGSI_FILE_MEMORY);
+      *ptr = LLVMBuildBitCast(builder, bld->cs_iface->shared_ptr,
+                              LLVMPointerType(LLVMInt32TypeInContext(gallivm->context), 0),
+                              "");
+      *size = bld->cs_iface->shared_size;
+   }
+}
+
+/*
+ * Return the dword index vector of a memory access and the mask of the
+ * active invocations accessing it within bounds.
+ */
+static LLVMValueRef
+get_memory_index(struct lp_build_tgsi_context *bld_base,
+                 LLVMValueRef offset,
+                 LLVMValueRef size,
+                 unsigned chan,
+                 LLVMValueRef *mask)
+{
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMValueRef index, num_dwords;
+
+   index = lp_build_shr_imm(uint_bld, offset, 2);
+   if (chan) {
+      index = lp_build_add(uint_bld, index,
+                           lp_build_const_int_vec(gallivm, uint_bld->type, chan));
+   }
+   num_dwords = lp_build_broadcast_scalar(uint_bld,
+                   LLVMBuildLShr(gallivm->builder, size,
+                                 lp_build_const_int32(gallivm, 2), ""));
+
+   *mask = LLVMBuildAnd(gallivm->builder, mask_vec(bld_base),
+                        lp_build_cmp(uint_bld, PIPE_FUNC_LESS, index, num_dwords),
+                        "");
+   return index;
+}
+
+static LLVMValueRef
+fetch_uint(struct lp_build_tgsi_context *bld_base,
+           const struct tgsi_full_instruction *inst,
+           unsigned src_op,
+           unsigned chan)
+{
+   return LLVMBuildBitCast(bld_base->base.gallivm->builder,
+                           lp_build_emit_fetch(bld_base, inst, src_op, chan),
+                           bld_base->uint_bld.vec_type, "");
+}
+
+/*
+ * Out of bounds loads return zero, out of bounds stores and atomics are
+ * dropped.
+ */
+static void
+load_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   LLVMValueRef base_ptr, size, offset;
+   unsigned chan;
+
+   get_memory_ptr(bld, inst->Src[0].Register.File,
+                  inst->Src[0].Register.Index, &base_ptr, &size);
+   base_ptr = LLVMBuildBitCast(builder, base_ptr,
+                               LLVMPointerType(LLVMFloatTypeInContext(gallivm->context), 0),
+                               "");
+   offset = fetch_uint(bld_base, inst, 1, TGSI_CHAN_X);
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      LLVMValueRef index, mask;
+
+      index = get_memory_index(bld_base, offset, size, chan, &mask);
+      emit_data->output[chan] =
+         build_gather(bld_base, base_ptr, index,
+                      LLVMBuildNot(builder, mask, ""), NULL);
+   }
+}
+
+static void
+store_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   LLVMValueRef base_ptr, size, offset;
+   unsigned chan, i;
+
+   get_memory_ptr(bld, inst->Dst[0].Register.File,
+                  inst->Dst[0].Register.Index, &base_ptr, &size);
+   offset = fetch_uint(bld_base, inst, 0, TGSI_CHAN_X);
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      LLVMValueRef value = fetch_uint(bld_base, inst, 1, chan);
+      LLVMValueRef index, mask;
+
+      index = get_memory_index(bld_base, offset, size, chan, &mask);
+
+      /*
+       * Other invocations may access the neighbouring dwords concurrently,
+       * so this can't be a masked read-modify-write like emit_mask_scatter.
+       */
+      for (i = 0; i < bld_base->base.type.length; i++) {
+         LLVMValueRef ii = lp_build_const_int32(gallivm, i);
+         LLVMValueRef cond, scalar_ptr, scalar_index;
+         struct lp_build_if_state ifthen;
+
+         cond = LLVMBuildICmp(builder, LLVMIntNE,
+                              LLVMBuildExtractElement(builder, mask, ii, ""),
+                              lp_build_const_int32(gallivm, 0), "");
+         lp_build_if(&ifthen, gallivm, cond);
+         scalar_index = LLVMBuildExtractElement(builder, index, ii, "");
+         scalar_ptr = LLVMBuildGEP(builder, base_ptr, &scalar_index, 1, "");
+         LLVMBuildStore(builder,
+                        LLVMBuildExtractElement(builder, value, ii, ""),
+                        scalar_ptr);
+         lp_build_endif(&ifthen);
+      }
+   }
+}
+
+static void
+atomic_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   unsigned opcode = inst->Instruction.Opcode;
+   LLVMValueRef base_ptr, size, offset, data, data2 = NULL;
+   LLVMValueRef index, mask, result_ptr, result;
+   LLVMAtomicRMWBinOp op = LLVMAtomicRMWBinOpAdd;
+   unsigned chan, i;
+
+   switch (opcode) {
+   case TGSI_OPCODE_ATOMUADD:
+      op = LLVMAtomicRMWBinOpAdd;
+      break;
+   case TGSI_OPCODE_ATOMXCHG:
+      op = LLVMAtomicRMWBinOpXchg;
+      break;
+   case TGSI_OPCODE_ATOMAND:
+      op = LLVMAtomicRMWBinOpAnd;
+      break;
+   case TGSI_OPCODE_ATOMOR:
+      op = LLVMAtomicRMWBinOpOr;
+      break;
+   case TGSI_OPCODE_ATOMXOR:
+      op = LLVMAtomicRMWBinOpXor;
+      break;
+   case TGSI_OPCODE_ATOMUMIN:
+      op = LLVMAtomicRMWBinOpUMin;
+      break;
+   case TGSI_OPCODE_ATOMUMAX:
+      op = LLVMAtomicRMWBinOpUMax;
+      break;
+   case TGSI_OPCODE_ATOMIMIN:
+      op = LLVMAtomicRMWBinOpMin;
+      break;
+   case TGSI_OPCODE_ATOMIMAX:
+      op = LLVMAtomicRMWBinOpMax;
+      break;
+   case TGSI_OPCODE_ATOMCAS:
+      break;
+   default:
+      assert(0);
+      break;
+   }
+
+   get_memory_ptr(bld, inst->Src[0].Register.File,
+                  inst->Src[0].Register.Index, &base_ptr, &size);
+   offset = fetch_uint(bld_base, inst, 1, TGSI_CHAN_X);
+   data = fetch_uint(bld_base, inst, 2, TGSI_CHAN_X);
+   if (opcode == TGSI_OPCODE_ATOMCAS)
+      data2 = fetch_uint(bld_base, inst, 3, TGSI_CHAN_X);
+
+   index = get_memory_index(bld_base, offset, size, 0, &mask);
+
+   result_ptr = lp_build_alloca(gallivm, uint_bld->vec_type, "atomic_result");
+   LLVMBuildStore(builder, uint_bld->zero, result_ptr);
+
+   for (i = 0; i < uint_bld->type.length; i++) {
+      LLVMValueRef ii = lp_build_const_int32(gallivm, i);
+      LLVMValueRef cond, scalar_ptr, scalar_index, scalar_data, scalar;
+      struct lp_build_if_state ifthen;
+
+      cond = LLVMBuildICmp(builder, LLVMIntNE,
+                           LLVMBuildExtractElement(builder, mask, ii, ""),
+                           lp_build_const_int32(gallivm, 0), "");
+      lp_build_if(&ifthen, gallivm, cond);
+      scalar_index = LLVMBuildExtractElement(builder, index, ii, "");
+      scalar_ptr = LLVMBuildGEP(builder, base_ptr, &scalar_index, 1, "");
+      scalar_data = LLVMBuildExtractElement(builder, data, ii, "");
+
+      if (opcode == TGSI_OPCODE_ATOMCAS) {
+#if HAVE_LLVM >= 0x0309
+         LLVMValueRef scalar_new = LLVMBuildExtractElement(builder, data2, ii, "");
+         scalar = LLVMBuildAtomicCmpXchg(builder, scalar_ptr,
+                                         scalar_data, scalar_new,
+                                         LLVMAtomicOrderingSequentiallyConsistent,
+                                         LLVMAtomicOrderingSequentiallyConsistent,
+                                         FALSE);
+         scalar = LLVMBuildExtractValue(builder, scalar, 0, "");
+#else
+         /* not advertised without compute support, see PIPE_CAP_COMPUTE */
+         (void) data2;
+         assert(0);
+         scalar = lp_build_const_int32(gallivm, 0);
+#endif
+      }
+      else {
+         scalar = LLVMBuildAtomicRMW(builder, op, scalar_ptr, scalar_data,
+                                     LLVMAtomicOrderingSequentiallyConsistent,
+                                     FALSE);
+      }
+
+      result = LLVMBuildLoad(builder, result_ptr, "");
+      result = LLVMBuildInsertElement(builder, result, scalar, ii, "");
+      LLVMBuildStore(builder, result, result_ptr);
+      lp_build_endif(&ifthen);
+   }
+
+   result = LLVMBuildLoad(builder, result_ptr, "");
+   result = LLVMBuildBitCast(builder, result, bld_base->base.vec_type, "");
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      emit_data->output[chan] = result;
+   }
+}
+
+static void
+resq_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   LLVMValueRef base_ptr, size;
+   unsigned chan;
+
+   get_memory_ptr(bld, inst->Src[0].Register.File,
+                  inst->Src[0].Register.Index, &base_ptr, &size);
+   size = lp_build_broadcast_scalar(&bld_base->uint_bld, size);
+   size = LLVMBuildBitCast(bld_base->base.gallivm->builder, size,
+                           bld_base->base.vec_type, "");
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      emit_data->output[chan] = size;
+   }
+}
+
+static void
+membar_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   /*
+    * Nothing to do: the atomics are sequentially consistent, and the
+    * invocations of a work group only observe each other at barriers,
+    * which return to the caller.
+    */
+}
+
+/*
+ * Barriers return the barrier index to the caller, which calls the
+ * function again with it as the resume index once all the invocations of
+ * the work group reached the barrier.
+ */
+static void
+barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_exec_mask *exec_mask = &bld->exec_mask;
+   struct function_ctx *ctx = func_ctx(exec_mask);
+   LLVMBasicBlockRef skip_block, barrier_block, resume_block, merge_block;
+   LLVMValueRef index;
+
+   if (!bld->resume_switch)
+      return;
+
+   /* the shader can't be run, the caller must fail it */
+   if (!lp_exec_mask_barrier_resumable(exec_mask)) {
+      if (bld->cs_iface->unsupported_barrier)
+         *bld->cs_iface->unsupported_barrier = TRUE;
+      return;
+   }
+
+   index = lp_build_const_int32(gallivm, ++bld->num_barriers);
+
+   if (!exec_mask->has_mask) {
+      LLVMBuildRet(builder, index);
+      resume_block = lp_build_insert_new_block(gallivm, "barrier_resume");
+      LLVMAddCase(bld->resume_switch, index, resume_block);
+      LLVMPositionBuilderAtEnd(builder, resume_block);
+      return;
+   }
+
+   /*
+    * Vectors without active invocations (e.g. in the untaken side of an
+    * if) don't stop at the barrier.
+    */
+   skip_block = LLVMGetInsertBlock(builder);
+   barrier_block = lp_build_insert_new_block(gallivm, "barrier");
+   resume_block = lp_build_insert_new_block(gallivm, "barrier_resume");
+   merge_block = lp_build_insert_new_block(gallivm, "barrier_merge");
+
+   {
+      LLVMTypeRef reg_type =
+         LLVMIntTypeInContext(gallivm->context,
+                              bld_base->base.type.width *
+                              bld_base->base.type.length);
+      LLVMValueRef any =
+         LLVMBuildICmp(builder, LLVMIntNE,
+                       LLVMBuildBitCast(builder, exec_mask->exec_mask,
+                                        reg_type, ""),
+                       LLVMConstNull(reg_type), "");
+      LLVMBuildCondBr(builder, any, barrier_block, merge_block);
+   }
+
+   LLVMPositionBuilderAtEnd(builder, barrier_block);
+   LLVMBuildRet(builder, index);
+
+   /*
+    * The break masks are stored at the end of each iteration, but the
+    * loop limiter has to be reinitialized.
+    */
+   LLVMPositionBuilderAtEnd(builder, resume_block);
+   LLVMAddCase(bld->resume_switch, index, resume_block);
+   if (ctx->loop_stack_size) {
+      LLVMBuildStore(builder,
+                     lp_build_const_int32(gallivm, LP_MAX_TGSI_LOOP_ITERATIONS),
+                     ctx->loop_limiter);
+   }
+   LLVMBuildBr(builder, merge_block);
+
+   LLVMPositionBuilderAtEnd(builder, merge_block);
+   lp_exec_mask_barrier_merge(exec_mask, skip_block, resume_block);
+}
+
 static void
 cal_emit(
    const struct lp_build_tgsi_action * action,
@@ -3644,7 +4170,13 @@ static void emit_prologue(struct lp_build_tgsi_context * bld_base)
    struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
    struct gallivm_state * gallivm = bld_base->base.gallivm;
 
-   if (bld->indirect_files & (1 << TGSI_FILE_TEMPORARY)) {
+   if (bld->cs_iface && bld->cs_iface->temps_ptr) {
+      /* the temporaries must survive barriers */
+      bld->temps_array =
+         LLVMBuildBitCast(gallivm->builder, bld->cs_iface->temps_ptr,
+                          LLVMPointerType(bld_base->base.vec_type, 0), "");
+   }
+   else if (bld->indirect_files & (1 << TGSI_FILE_TEMPORARY)) {
       LLVMValueRef array_size =
          lp_build_const_int32(gallivm,
                          bld_base->info->file_max[TGSI_FILE_TEMPORARY] * 4 + 4);
@@ -3730,6 +4262,25 @@ static void emit_prologue(struct lp_build_tgsi_context * bld_base)
    }
 }
 
+static void emit_prologue_post_decl(struct lp_build_tgsi_context * bld_base)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state * gallivm = bld_base->base.gallivm;
+
+   /*
+    * The resume switch goes after the declarations, as these load the
+    * buffer pointers and store the immediates.
+    */
+   if (bld->cs_iface && bld->cs_iface->resume_index) {
+      LLVMBasicBlockRef start = lp_build_insert_new_block(gallivm, "start");
+
+      bld->resume_switch =
+         LLVMBuildSwitch(gallivm->builder, bld->cs_iface->resume_index, start,
+                         bld_base->info->opcode_count[TGSI_OPCODE_BARRIER]);
+      LLVMPositionBuilderAtEnd(gallivm->builder, start);
+   }
+}
+
 static void emit_epilogue(struct lp_build_tgsi_context * bld_base)
 {
    struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
@@ -3782,7 +4333,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface)
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface)
 {
    struct lp_build_tgsi_soa_context bld;
 
@@ -3862,6 +4414,7 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
    bld.bld_base.emit_immediate = lp_emit_immediate_soa;
 
    bld.bld_base.emit_prologue = emit_prologue;
+   bld.bld_base.emit_prologue_post_decl = emit_prologue_post_decl;
    bld.bld_base.emit_epilogue = emit_epilogue;
 
    /* Set opcode actions */
@@ -3938,6 +4491,30 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                                 max_output_vertices);
    }
 
+   if (cs_iface) {
+      bld.cs_iface = cs_iface;
+      /* temporaries live in memory provided by the caller */
+      if (cs_iface->temps_ptr)
+         bld.indirect_files |= (1 << TGSI_FILE_TEMPORARY);
+      bld.bld_base.op_actions[TGSI_OPCODE_LOAD].emit = load_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_STORE].emit = store_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUADD].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXCHG].emit = atomic_emit;
+#if HAVE_LLVM >= 0x0309
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMCAS].emit = atomic_emit;
+#endif
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMAND].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_RESQ].emit = resq_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_MEMBAR].emit = membar_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = barrier_emit;
+   }
+
    lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
 
    bld.system_values = *system_values;
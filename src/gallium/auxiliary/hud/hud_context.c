@@ -1226,6 +1226,9 @@ hud_parse_env_var(struct hud_context *hud, struct pipe_screen *screen,
       else if (strcmp(name, "API-thread-num-syncs") == 0) {
          hud_thread_counter_install(pane, name, HUD_COUNTER_SYNCS);
       }
+      else if (strcmp(name, "API-thread-num-sync-calls") == 0) {
+         hud_thread_counter_install(pane, name, HUD_COUNTER_SYNC_CALLS);
+      }
       else if (strcmp(name, "main-thread-busy") == 0) {
          hud_thread_busy_install(pane, name, true);
       }
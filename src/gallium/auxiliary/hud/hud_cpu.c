@@ -252,8 +252,8 @@ query_api_thread_busy_status(struct hud_graph *gr, struct pipe_context *pipe)
          } else {
             struct util_queue_monitoring *mon = gr->pane->hud->monitored_queue;
 
-            if (mon && mon->queue)
-               thread_now = util_queue_get_thread_time_nano(mon->queue, 0);
+            if (mon && mon->thread)
+               thread_now = u_thread_get_time_nano(*mon->thread);
             else
                thread_now = 0;
          }
@@ -318,7 +318,7 @@ static unsigned get_counter(struct hud_graph *gr, enum hud_counter counter)
 {
    struct util_queue_monitoring *mon = gr->pane->hud->monitored_queue;
 
-   if (!mon || !mon->queue)
+   if (!mon || !mon->thread)
       return 0;
 
    switch (counter) {
@@ -328,6 +328,8 @@ static unsigned get_counter(struct hud_graph *gr, enum hud_counter counter)
       return mon->num_direct_items;
    case HUD_COUNTER_SYNCS:
       return mon->num_syncs;
+   case HUD_COUNTER_SYNC_CALLS:
+      return mon->num_sync_calls;
    default:
       assert(0);
       return 0;
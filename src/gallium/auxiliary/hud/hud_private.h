@@ -37,6 +37,7 @@ enum hud_counter {
    HUD_COUNTER_OFFLOADED,
    HUD_COUNTER_DIRECT,
    HUD_COUNTER_SYNCS,
+   HUD_COUNTER_SYNC_CALLS,
 };
 
 struct hud_context {
@@ -32,8 +32,13 @@
 
 #include "pipe/p_config.h"
 #include "pipe/p_state.h"
+#include "util/u_debug.h"
 #include "translate.h"
 
+#if HAVE_LLVM
+DEBUG_GET_ONCE_BOOL_OPTION(translate_llvm, "TRANSLATE_LLVM", TRUE)
+#endif
+
 struct translate *translate_create( const struct translate_key *key )
 {
    struct translate *translate = NULL;
@@ -42,10 +47,21 @@ struct translate *translate_create( const struct translate_key *key )
    translate = translate_sse2_create( key );
    if (translate)
       return translate;
-#else
-   (void)translate;
 #endif
 
+   /* Building a JIT module per key is much more expensive than the SSE
+    * backend, so only use it for keys that one doesn't handle.
+    */
+#if HAVE_LLVM
+   if (debug_get_option_translate_llvm()) {
+      translate = translate_llvm_create( key );
+      if (translate)
+         return translate;
+   }
+#endif
+
+   (void)translate;
+
    return translate_generic_create( key );
 }
 
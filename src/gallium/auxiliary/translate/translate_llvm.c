@@ -0,0 +1,549 @@
+/**************************************************************************
+ *
+ * Copyright 2017 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Translate module backend generating native code through gallivm.
+ *
+ * One function is generated per run_* entry point.  Vertex fetch and
+ * conversion reuse the lp_bld_format AoS fetch code, so any input format
+ * gallivm can fetch gets a native path on every architecture LLVM supports.
+ * Output formats are restricted to 32-bit float and integer channels (plus
+ * straight copies); other keys make translate_llvm_create() return NULL so
+ * that the caller falls back to another backend.
+ */
+
+#include <stddef.h>
+
+#include "util/u_debug.h"
+#include "util/u_memory.h"
+#include "util/u_format.h"
+#include "pipe/p_state.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_format.h"
+#include "translate.h"
+
+
+/** Per vertex buffer state, read by the generated code */
+struct translate_llvm_buffer {
+   const uint8_t *base_ptr;
+   unsigned stride;
+   unsigned max_index;
+};
+
+
+struct translate_llvm {
+   struct translate translate;
+
+   struct translate_llvm_buffer buffer[PIPE_MAX_ATTRIBS];
+
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+};
+
+
+/** How the vertex index of the i-th vertex is obtained */
+enum translate_llvm_index {
+   INDEX_LINEAR,
+   INDEX_ELTS8,
+   INDEX_ELTS16,
+   INDEX_ELTS32
+};
+
+
+static struct translate_llvm *
+translate_llvm(struct translate *translate)
+{
+   return (struct translate_llvm *)translate;
+}
+
+
+/**
+ * Load a scalar of the given type at a byte offset from an i8 pointer.
+ */
+static LLVMValueRef
+load_field(struct gallivm_state *gallivm, LLVMValueRef base,
+           unsigned offset, LLVMTypeRef type)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef index = lp_build_const_int32(gallivm, offset);
+   LLVMValueRef ptr;
+
+   ptr = LLVMBuildGEP(builder, base, &index, 1, "");
+   ptr = LLVMBuildBitCast(builder, ptr, LLVMPointerType(type, 0), "");
+   return LLVMBuildLoad(builder, ptr, "");
+}
+
+
+/**
+ * Return a typed pointer to byte offset of an i8 pointer.
+ */
+static LLVMValueRef
+byte_ptr(struct gallivm_state *gallivm, LLVMValueRef base,
+         LLVMValueRef offset, LLVMTypeRef type)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef ptr = LLVMBuildGEP(builder, base, &offset, 1, "");
+
+   return LLVMBuildBitCast(builder, ptr, LLVMPointerType(type, 0), "");
+}
+
+
+/**
+ * Is the format made only of 32-bit float channels in RGBA order?
+ */
+static boolean
+is_float32_output(const struct util_format_description *desc)
+{
+   unsigned i;
+
+   for (i = 0; i < desc->nr_channels; i++) {
+      if (desc->channel[i].type != UTIL_FORMAT_TYPE_FLOAT ||
+          desc->channel[i].size != 32 ||
+          desc->swizzle[i] != i)
+         return FALSE;
+   }
+   return desc->nr_channels > 0;
+}
+
+
+/**
+ * Is the format made only of 32-bit pure integer channels in RGBA order?
+ */
+static boolean
+is_int32_output(const struct util_format_description *desc)
+{
+   unsigned i;
+
+   for (i = 0; i < desc->nr_channels; i++) {
+      if (!desc->channel[i].pure_integer ||
+          desc->channel[i].size != 32 ||
+          desc->swizzle[i] != i)
+         return FALSE;
+   }
+   return desc->nr_channels > 0;
+}
+
+
+/**
+ * Element whose input and output formats are identical and byte sized,
+ * so it can simply be copied.
+ */
+static boolean
+is_copy_element(const struct translate_element *elem)
+{
+   const struct util_format_description *desc =
+      util_format_description(elem->input_format);
+
+   return elem->input_format == elem->output_format &&
+          desc->block.width == 1 &&
+          desc->block.height == 1 &&
+          !(desc->block.bits & 7);
+}
+
+
+static boolean
+is_supported_element(const struct translate_element *elem)
+{
+   const struct util_format_description *in_desc, *out_desc;
+   unsigned i;
+
+   out_desc = util_format_description(elem->output_format);
+   if (!out_desc)
+      return FALSE;
+
+   if (elem->type == TRANSLATE_ELEMENT_INSTANCE_ID) {
+      return elem->output_format == PIPE_FORMAT_R32_USCALED ||
+             elem->output_format == PIPE_FORMAT_R32_SSCALED ||
+             elem->output_format == PIPE_FORMAT_R32_FLOAT;
+   }
+
+   in_desc = util_format_description(elem->input_format);
+   if (!in_desc)
+      return FALSE;
+
+   if (elem->input_buffer >= PIPE_MAX_ATTRIBS)
+      return FALSE;
+
+   if (is_copy_element(elem))
+      return TRUE;
+
+   if (in_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       in_desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB ||
+       in_desc->block.width != 1 || in_desc->block.height != 1)
+      return FALSE;
+
+   if (!util_format_is_pure_integer(elem->input_format))
+      return is_float32_output(out_desc) &&
+             (in_desc->is_array || in_desc->fetch_rgba_float);
+
+   /*
+    * Pure integers go through the array fetch path only, and like in
+    * translate_generic must neither change sign nor lose precision.
+    */
+   if (!in_desc->is_array || !is_int32_output(out_desc))
+      return FALSE;
+
+   for (i = 0; i < MIN2(in_desc->nr_channels, out_desc->nr_channels); i++) {
+      if (in_desc->channel[i].type != out_desc->channel[i].type)
+         return FALSE;
+   }
+   return TRUE;
+}
+
+
+/**
+ * Fetch an attribute as a 4 x 32-bit vector (floats, or integer bits for
+ * pure integer formats).
+ */
+static LLVMValueRef
+fetch_element(struct gallivm_state *gallivm,
+              const struct util_format_description *desc,
+              LLVMValueRef src_ptr)
+{
+   LLVMValueRef zero = lp_build_const_int32(gallivm, 0);
+
+   if (desc->is_array)
+      return lp_build_fetch_rgba_aos_array(gallivm, desc,
+                                           lp_float32_vec4_type(),
+                                           src_ptr, zero);
+
+   return lp_build_fetch_rgba_aos(gallivm, desc, lp_float32_vec4_type(),
+                                  FALSE, src_ptr, zero, zero, zero, NULL);
+}
+
+
+/**
+ * Emit the code translating one vertex.
+ */
+static void
+emit_vertex(struct translate_llvm *tl,
+            LLVMValueRef translate_ptr,
+            LLVMValueRef elt,
+            LLVMValueRef start_instance,
+            LLVMValueRef instance_id,
+            LLVMValueRef vertex_ptr)
+{
+   struct gallivm_state *gallivm = tl->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMContextRef context = gallivm->context;
+   LLVMTypeRef i8ptr_t = LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+   LLVMTypeRef i32_t = LLVMInt32TypeInContext(context);
+   LLVMTypeRef i64_t = LLVMInt64TypeInContext(context);
+   LLVMTypeRef f32_t = LLVMFloatTypeInContext(context);
+   const struct translate_key *key = &tl->translate.key;
+   unsigned i;
+
+   for (i = 0; i < key->nr_elements; i++) {
+      const struct translate_element *elem = &key->element[i];
+      const struct util_format_description *out_desc =
+         util_format_description(elem->output_format);
+      LLVMValueRef dst_offset = lp_build_const_int32(gallivm,
+                                                     elem->output_offset);
+      const unsigned buf_offset =
+         offsetof(struct translate_llvm, buffer) +
+         elem->input_buffer * sizeof(struct translate_llvm_buffer);
+      const struct util_format_description *in_desc;
+      LLVMValueRef base, stride, index, offset, src_ptr, value;
+      unsigned chan;
+
+      if (elem->type == TRANSLATE_ELEMENT_INSTANCE_ID) {
+         if (elem->output_format == PIPE_FORMAT_R32_FLOAT) {
+            value = LLVMBuildUIToFP(builder, instance_id, f32_t, "");
+            LLVMBuildStore(builder, value,
+                           byte_ptr(gallivm, vertex_ptr, dst_offset, f32_t));
+         }
+         else {
+            LLVMBuildStore(builder, instance_id,
+                           byte_ptr(gallivm, vertex_ptr, dst_offset, i32_t));
+         }
+         continue;
+      }
+
+      in_desc = util_format_description(elem->input_format);
+
+      base = load_field(gallivm, translate_ptr,
+                        buf_offset +
+                        offsetof(struct translate_llvm_buffer, base_ptr),
+                        i8ptr_t);
+      stride = load_field(gallivm, translate_ptr,
+                          buf_offset +
+                          offsetof(struct translate_llvm_buffer, stride),
+                          i32_t);
+
+      if (elem->instance_divisor) {
+         index = LLVMBuildUDiv(builder, instance_id,
+                               lp_build_const_int32(gallivm,
+                                                    elem->instance_divisor),
+                               "");
+         index = LLVMBuildAdd(builder, start_instance, index, "");
+      }
+      else {
+         /* clamp to avoid going out of bounds */
+         LLVMValueRef max_index =
+            load_field(gallivm, translate_ptr,
+                       buf_offset +
+                       offsetof(struct translate_llvm_buffer, max_index),
+                       i32_t);
+         LLVMValueRef in_range = LLVMBuildICmp(builder, LLVMIntULT,
+                                               elt, max_index, "");
+         index = LLVMBuildSelect(builder, in_range, elt, max_index, "");
+      }
+
+      /* (ptrdiff_t)stride * index + input_offset */
+      offset = LLVMBuildMul(builder,
+                            LLVMBuildZExt(builder, stride, i64_t, ""),
+                            LLVMBuildZExt(builder, index, i64_t, ""), "");
+      offset = LLVMBuildAdd(builder, offset,
+                            LLVMConstInt(i64_t, elem->input_offset, 0), "");
+      src_ptr = LLVMBuildGEP(builder, base, &offset, 1, "");
+
+      if (is_copy_element(elem)) {
+         LLVMTypeRef copy_t = LLVMIntTypeInContext(context,
+                                                   in_desc->block.bits);
+         LLVMValueRef src = LLVMBuildBitCast(builder, src_ptr,
+                                             LLVMPointerType(copy_t, 0), "");
+         LLVMValueRef store;
+
+         value = LLVMBuildLoad(builder, src, "");
+         LLVMSetAlignment(value, 1);
+         store = LLVMBuildStore(builder, value,
+                                byte_ptr(gallivm, vertex_ptr, dst_offset,
+                                         copy_t));
+         LLVMSetAlignment(store, 1);
+         continue;
+      }
+
+      value = fetch_element(gallivm, in_desc, src_ptr);
+      if (util_format_is_pure_integer(elem->input_format))
+         value = LLVMBuildBitCast(builder, value,
+                                  LLVMVectorType(i32_t, 4), "");
+
+      for (chan = 0; chan < out_desc->nr_channels; chan++) {
+         LLVMValueRef chan_index = lp_build_const_int32(gallivm, chan);
+         LLVMValueRef chan_offset =
+            lp_build_const_int32(gallivm, elem->output_offset + chan * 4);
+         LLVMValueRef v = LLVMBuildExtractElement(builder, value,
+                                                  chan_index, "");
+
+         LLVMBuildStore(builder, v,
+                        byte_ptr(gallivm, vertex_ptr, chan_offset,
+                                 LLVMTypeOf(v)));
+      }
+   }
+}
+
+
+/**
+ * Build one of the run_* entry points.
+ */
+static LLVMValueRef
+build_run_function(struct translate_llvm *tl,
+                   enum translate_llvm_index index_kind)
+{
+   static const char *names[] = {
+      "translate_run",
+      "translate_run_elts8",
+      "translate_run_elts16",
+      "translate_run_elts32"
+   };
+   struct gallivm_state *gallivm = tl->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMContextRef context = gallivm->context;
+   LLVMTypeRef i8ptr_t = LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+   LLVMTypeRef i32_t = LLVMInt32TypeInContext(context);
+   LLVMTypeRef elt_t = NULL;
+   LLVMTypeRef args[6];
+   LLVMValueRef func, translate_ptr, elts, count, start_instance;
+   LLVMValueRef instance_id, output_ptr;
+   LLVMBasicBlockRef block;
+   struct lp_build_for_loop_state loop;
+
+   switch (index_kind) {
+   case INDEX_ELTS8:
+      elt_t = LLVMInt8TypeInContext(context);
+      break;
+   case INDEX_ELTS16:
+      elt_t = LLVMInt16TypeInContext(context);
+      break;
+   case INDEX_ELTS32:
+      elt_t = i32_t;
+      break;
+   case INDEX_LINEAR:
+      break;
+   }
+
+   args[0] = i8ptr_t;
+   args[1] = elt_t ? LLVMPointerType(elt_t, 0) : i32_t;
+   args[2] = i32_t;  /* count */
+   args[3] = i32_t;  /* start_instance */
+   args[4] = i32_t;  /* instance_id */
+   args[5] = i8ptr_t;
+
+   func = LLVMAddFunction(gallivm->module, names[index_kind],
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, ARRAY_SIZE(args), 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   translate_ptr = LLVMGetParam(func, 0);
+   elts = LLVMGetParam(func, 1);
+   count = LLVMGetParam(func, 2);
+   start_instance = LLVMGetParam(func, 3);
+   instance_id = LLVMGetParam(func, 4);
+   output_ptr = LLVMGetParam(func, 5);
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   lp_build_for_loop_begin(&loop, gallivm, lp_build_const_int32(gallivm, 0),
+                           LLVMIntULT, count,
+                           lp_build_const_int32(gallivm, 1));
+   {
+      LLVMValueRef elt, vertex_offset, vertex_ptr;
+
+      if (elt_t) {
+         LLVMValueRef elt_ptr = LLVMBuildGEP(builder, elts,
+                                             &loop.counter, 1, "");
+         elt = LLVMBuildLoad(builder, elt_ptr, "");
+         if (elt_t != i32_t)
+            elt = LLVMBuildZExt(builder, elt, i32_t, "");
+      }
+      else {
+         elt = LLVMBuildAdd(builder, elts, loop.counter, "");
+      }
+
+      vertex_offset = LLVMBuildMul(builder, loop.counter,
+                                   lp_build_const_int32(gallivm,
+                                                        tl->translate.key.output_stride),
+                                   "");
+      vertex_ptr = LLVMBuildGEP(builder, output_ptr, &vertex_offset, 1, "");
+
+      emit_vertex(tl, translate_ptr, elt, start_instance, instance_id,
+                  vertex_ptr);
+   }
+   lp_build_for_loop_end(&loop);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+static void
+llvm_set_buffer(struct translate *translate,
+                unsigned buf,
+                const void *ptr,
+                unsigned stride,
+                unsigned max_index)
+{
+   struct translate_llvm *tl = translate_llvm(translate);
+
+   if (buf < PIPE_MAX_ATTRIBS) {
+      tl->buffer[buf].base_ptr = (const uint8_t *)ptr;
+      tl->buffer[buf].stride = stride;
+      tl->buffer[buf].max_index = max_index;
+   }
+}
+
+
+static void
+llvm_release(struct translate *translate)
+{
+   struct translate_llvm *tl = translate_llvm(translate);
+
+   if (tl->gallivm)
+      gallivm_destroy(tl->gallivm);
+   if (tl->context)
+      LLVMContextDispose(tl->context);
+
+   FREE(tl);
+}
+
+
+struct translate *
+translate_llvm_create(const struct translate_key *key)
+{
+   struct translate_llvm *tl;
+   LLVMValueRef funcs[4];
+   unsigned i;
+
+   assert(key->nr_elements <= TRANSLATE_MAX_ATTRIBS);
+
+   for (i = 0; i < key->nr_elements; i++) {
+      if (!is_supported_element(&key->element[i]))
+         return NULL;
+   }
+
+   tl = CALLOC_STRUCT(translate_llvm);
+   if (!tl)
+      return NULL;
+
+   tl->translate.key = *key;
+   tl->translate.release = llvm_release;
+   tl->translate.set_buffer = llvm_set_buffer;
+
+   tl->context = LLVMContextCreate();
+   if (!tl->context)
+      goto fail;
+
+   tl->gallivm = gallivm_create("translate", tl->context);
+   if (!tl->gallivm)
+      goto fail;
+
+   funcs[INDEX_LINEAR] = build_run_function(tl, INDEX_LINEAR);
+   funcs[INDEX_ELTS8] = build_run_function(tl, INDEX_ELTS8);
+   funcs[INDEX_ELTS16] = build_run_function(tl, INDEX_ELTS16);
+   funcs[INDEX_ELTS32] = build_run_function(tl, INDEX_ELTS32);
+
+   gallivm_compile_module(tl->gallivm);
+
+   tl->translate.run =
+      (run_func) gallivm_jit_function(tl->gallivm, funcs[INDEX_LINEAR]);
+   tl->translate.run_elts8 =
+      (run_elts8_func) gallivm_jit_function(tl->gallivm, funcs[INDEX_ELTS8]);
+   tl->translate.run_elts16 =
+      (run_elts16_func) gallivm_jit_function(tl->gallivm, funcs[INDEX_ELTS16]);
+   tl->translate.run_elts =
+      (run_elts_func) gallivm_jit_function(tl->gallivm, funcs[INDEX_ELTS32]);
+
+   gallivm_free_ir(tl->gallivm);
+
+   if (!tl->translate.run || !tl->translate.run_elts8 ||
+       !tl->translate.run_elts16 || !tl->translate.run_elts)
+      goto fail;
+
+   return &tl->translate;
+
+fail:
+   llvm_release(&tl->translate);
+   return NULL;
+}
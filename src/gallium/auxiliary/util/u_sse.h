@@ -245,6 +245,24 @@ static inline __m128i mm_mullo_epi32(const __m128i a, const __m128i b)
 }
 
 
+/* Provide SSE2 implementations of _mm_min_epi32() / _mm_max_epi32()
+ * (which are SSE4.1 only).
+ */
+static inline __m128i
+mm_min_epi32(const __m128i a, const __m128i b)
+{
+   __m128i gt = _mm_cmpgt_epi32(a, b);
+   return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+
+static inline __m128i
+mm_max_epi32(const __m128i a, const __m128i b)
+{
+   __m128i gt = _mm_cmpgt_epi32(a, b);
+   return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+
 static inline void
 transpose4_epi32(const __m128i * restrict a,
                  const __m128i * restrict b,
@@ -29,6 +29,7 @@
 #include "util/u_format.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
+#include "util/u_prim.h"
 #include "util/u_upload_mgr.h"
 
 /* 0 = disabled, 1 = assertions, 2 = printfs */
@@ -52,6 +53,9 @@
 
 #define TC_SENTINEL 0x5ca1ab1e
 
+DEBUG_GET_ONCE_BOOL_OPTION(tc_merge_draws, "GALLIUM_THREAD_MERGE_DRAWS", false)
+DEBUG_GET_ONCE_BOOL_OPTION(tc_stats, "GALLIUM_THREAD_STATS", false)
+
 enum tc_call_id {
 #define CALL(name) TC_CALL_##name,
 #include "u_threaded_context_calls.h"
@@ -109,6 +113,8 @@ tc_batch_flush(struct threaded_context *tc)
    tc_batch_check(next);
    tc_debug_check(tc);
    p_atomic_add(&tc->num_offloaded_slots, next->num_total_call_slots);
+   p_atomic_inc(&tc->num_batches);
+   tc->last_draw = NULL;
 
    if (next->token) {
       next->token->tc = NULL;
@@ -139,6 +145,19 @@ tc_add_sized_call(struct threaded_context *tc, enum tc_call_id id,
       tc_batch_flush(tc);
       next = &tc->batch_slots[tc->next];
       tc_assert(next->num_total_call_slots == 0);
+   } else if (next->num_total_call_slots >= TC_MIN_CALLS_PER_BATCH &&
+              id != TC_CALL_flush && !next->token &&
+              util_queue_fence_is_signalled(&tc->batch_slots[tc->last].fence)) {
+      /* The driver thread is idle, so give it work now instead of filling
+       * the batch up completely.  This only submits calls that have been
+       * fully recorded.  It must not happen once tc_flush() has attached
+       * a fence token to the batch, because the token would be detached
+       * from the batch that ends up executing the flush.
+       */
+      p_atomic_inc(&tc->num_early_flushes);
+      tc_batch_flush(tc);
+      next = &tc->batch_slots[tc->next];
+      tc_assert(next->num_total_call_slots == 0);
    }
 
    tc_assert(util_queue_fence_is_signalled(&next->fence));
@@ -179,6 +198,43 @@ tc_is_sync(struct threaded_context *tc)
           !next->num_total_call_slots;
 }
 
+static void
+tc_record_sync(struct threaded_context *tc, const char *func)
+{
+   unsigned i;
+
+   /* "func" is always __func__, so comparing pointers is sufficient. */
+   for (i = 0; i < tc->num_sync_sites; i++) {
+      if (tc->sync_sites[i].func == func) {
+         tc->sync_sites[i].count++;
+         return;
+      }
+   }
+
+   if (i < TC_MAX_SYNC_SITES) {
+      tc->sync_sites[i].func = func;
+      tc->sync_sites[i].count = 1;
+      tc->num_sync_sites++;
+   }
+}
+
+static void
+tc_print_stats(struct threaded_context *tc)
+{
+   debug_printf("threaded context %p:\n", (void*)tc);
+   debug_printf("   batches: %u (%u flushed early)\n", tc->num_batches,
+                tc->num_early_flushes);
+   debug_printf("   offloaded call slots: %u\n", tc->num_offloaded_slots);
+   debug_printf("   direct call slots: %u\n", tc->num_direct_slots);
+   debug_printf("   merged draws: %u\n", tc->num_merged_draws);
+   debug_printf("   syncs: %u\n", tc->num_syncs);
+
+   for (unsigned i = 0; i < tc->num_sync_sites; i++) {
+      debug_printf("      %s: %u\n", tc->sync_sites[i].func,
+                   tc->sync_sites[i].count);
+   }
+}
+
 static void
 _tc_sync(struct threaded_context *tc, MAYBE_UNUSED const char *info, MAYBE_UNUSED const char *func)
 {
@@ -204,6 +260,7 @@ _tc_sync(struct threaded_context *tc, MAYBE_UNUSED const char *info, MAYBE_UNUSE
    /* .. and execute unflushed calls directly. */
    if (next->num_total_call_slots) {
       p_atomic_add(&tc->num_direct_slots, next->num_total_call_slots);
+      tc->last_draw = NULL;
       tc_batch_execute(next, 0);
       synced = true;
    }
@@ -211,6 +268,9 @@ _tc_sync(struct threaded_context *tc, MAYBE_UNUSED const char *info, MAYBE_UNUSE
    if (synced) {
       p_atomic_inc(&tc->num_syncs);
 
+      if (unlikely(tc->print_stats))
+         tc_record_sync(tc, func);
+
       if (tc_strcmp(func, "tc_destroy") != 0) {
          tc_printf("sync %s %s\n", func, info);
 	  }
@@ -2008,6 +2068,68 @@ tc_add_draw_vbo(struct pipe_context *_pipe, bool indirect)
                                        sizeof(struct pipe_draw_info));
 }
 
+static bool
+tc_is_mergeable_draw(const struct pipe_draw_info *info)
+{
+   /* Only list primitives can be concatenated without changing the set of
+    * generated primitives.
+    */
+   return (info->mode == PIPE_PRIM_POINTS ||
+           info->mode == PIPE_PRIM_LINES ||
+           info->mode == PIPE_PRIM_TRIANGLES) &&
+          !info->indirect &&
+          !info->count_from_stream_output &&
+          !info->primitive_restart;
+}
+
+/* Try to extend the previous draw in the current batch by "info", which must
+ * start at "start" in "index_buffer" (if indexed). This is only possible if
+ * there were no other calls in between, i.e. no state changes.
+ */
+static bool
+tc_try_merge_draw(struct threaded_context *tc,
+                  const struct pipe_draw_info *info,
+                  struct pipe_resource *index_buffer, unsigned start)
+{
+   struct tc_batch *next = &tc->batch_slots[tc->next];
+   struct tc_call *last = tc->last_draw;
+
+   if (!last ||
+       last + last->num_call_slots != &next->call[next->num_total_call_slots])
+      return false;
+
+   struct pipe_draw_info *prev = (struct pipe_draw_info*)&last->payload;
+
+   if (prev->mode != info->mode ||
+       prev->index_size != info->index_size ||
+       prev->start + prev->count != start ||
+       prev->count % u_vertices_per_prim(prev->mode) != 0 ||
+       info->count % u_vertices_per_prim(info->mode) != 0 ||
+       prev->start_instance != info->start_instance ||
+       prev->instance_count != info->instance_count ||
+       prev->drawid != info->drawid)
+      return false;
+
+   if (info->index_size) {
+      if (prev->index.resource != index_buffer ||
+          prev->index_bias != info->index_bias)
+         return false;
+
+      prev->min_index = MIN2(prev->min_index, info->min_index);
+      prev->max_index = MAX2(prev->max_index, info->max_index);
+   }
+
+   prev->count += info->count;
+   p_atomic_inc(&tc->num_merged_draws);
+   return true;
+}
+
+static struct tc_call *
+tc_call_from_payload(void *payload)
+{
+   return (struct tc_call*)((char*)payload - offsetof(struct tc_call, payload));
+}
+
 static void
 tc_draw_vbo(struct pipe_context *_pipe, const struct pipe_draw_info *info)
 {
@@ -2015,6 +2137,7 @@ tc_draw_vbo(struct pipe_context *_pipe, const struct pipe_draw_info *info)
    struct pipe_draw_indirect_info *indirect = info->indirect;
    unsigned index_size = info->index_size;
    bool has_user_indices = info->has_user_indices;
+   bool mergeable = tc->merge_draws && tc_is_mergeable_draw(info);
 
    if (index_size && has_user_indices) {
       unsigned size = info->count * index_size;
@@ -2032,6 +2155,12 @@ tc_draw_vbo(struct pipe_context *_pipe, const struct pipe_draw_info *info)
       if (unlikely(!buffer))
          return;
 
+      if (mergeable &&
+          tc_try_merge_draw(tc, info, buffer, offset / index_size)) {
+         pipe_resource_reference(&buffer, NULL);
+         return;
+      }
+
       struct tc_full_draw_info *p = tc_add_draw_vbo(_pipe, false);
       p->draw.count_from_stream_output = NULL;
       pipe_so_target_reference(&p->draw.count_from_stream_output,
@@ -2040,8 +2169,13 @@ tc_draw_vbo(struct pipe_context *_pipe, const struct pipe_draw_info *info)
       p->draw.has_user_indices = false;
       p->draw.index.resource = buffer;
       p->draw.start = offset / index_size;
+      tc->last_draw = mergeable ? tc_call_from_payload(p) : NULL;
    } else {
       /* Non-indexed call or indexed with a real index buffer. */
+      if (mergeable &&
+          tc_try_merge_draw(tc, info, info->index.resource, info->start))
+         return;
+
       struct tc_full_draw_info *p = tc_add_draw_vbo(_pipe, indirect != NULL);
       p->draw.count_from_stream_output = NULL;
       pipe_so_target_reference(&p->draw.count_from_stream_output,
@@ -2059,6 +2193,7 @@ tc_draw_vbo(struct pipe_context *_pipe, const struct pipe_draw_info *info)
          memcpy(&p->indirect, indirect, sizeof(*indirect));
          p->draw.indirect = &p->indirect;
       }
+      tc->last_draw = mergeable ? tc_call_from_payload(p) : NULL;
    }
 }
 
@@ -2453,6 +2588,9 @@ tc_destroy(struct pipe_context *_pipe)
 
    tc_sync(tc);
 
+   if (unlikely(tc->print_stats))
+      tc_print_stats(tc);
+
    if (util_queue_is_initialized(&tc->queue)) {
       util_queue_destroy(&tc->queue);
 
@@ -2528,6 +2666,8 @@ threaded_context_create(struct pipe_context *pipe,
    tc->create_fence = create_fence;
    tc->map_buffer_alignment =
       pipe->screen->get_param(pipe->screen, PIPE_CAP_MIN_MAP_BUFFER_ALIGNMENT);
+   tc->merge_draws = debug_get_option_tc_merge_draws();
+   tc->print_stats = debug_get_option_tc_stats();
    tc->base.priv = pipe; /* priv points to the wrapped driver context */
    tc->base.screen = pipe->screen;
    tc->base.destroy = tc_destroy;
@@ -2542,6 +2682,15 @@ threaded_context_create(struct pipe_context *pipe,
    if (!tc->base.stream_uploader || !tc->base.const_uploader)
       goto fail;
 
+   /* Deferred flushes are cheap when the driver can create fences for
+    * them, and all uploads are done before the calls using them are added.
+    */
+   if (create_fence) {
+      u_upload_enable_recycling(tc->base.stream_uploader);
+      if (tc->base.const_uploader != tc->base.stream_uploader)
+         u_upload_enable_recycling(tc->base.const_uploader);
+   }
+
    /* The queue size is the number of batches "waiting". Batches are removed
     * from the queue before being executed, so keep one tc_batch slot for that
     * execution. Also, keep one unused slot for an unflushed batch.
@@ -222,6 +222,16 @@ struct tc_unflushed_batch_token;
  */
 #define TC_CALLS_PER_BATCH    192
 
+/* The number of call slots after which a batch is flushed early if the driver
+ * thread is idle. Batches only grow to TC_CALLS_PER_BATCH while the driver
+ * thread is busy, so that an idle driver thread doesn't have to wait for
+ * a full batch and a busy one gets fewer, larger batches.
+ */
+#define TC_MIN_CALLS_PER_BATCH 48
+
+/* The maximum number of distinct call sites recorded by the sync statistics. */
+#define TC_MAX_SYNC_SITES     32
+
 /* Threshold for when to use the queue or sync. */
 #define TC_MAX_STRING_MARKER_BYTES  512
 
@@ -346,6 +356,11 @@ struct tc_batch {
    struct tc_call call[TC_CALLS_PER_BATCH];
 };
 
+struct tc_sync_site {
+   const char *func;
+   unsigned count;
+};
+
 struct threaded_context {
    struct pipe_context base;
    struct pipe_context *pipe;
@@ -360,6 +375,25 @@ struct threaded_context {
    unsigned num_offloaded_slots;
    unsigned num_direct_slots;
    unsigned num_syncs;
+   unsigned num_batches;
+   unsigned num_early_flushes;
+   unsigned num_merged_draws;
+
+   /* Whether consecutive draws of the same list primitive type with
+    * contiguous ranges can be merged into one. This changes the values of
+    * gl_PrimitiveID seen by shaders, so it's only done on request.
+    */
+   bool merge_draws;
+
+   /* The last draw_vbo call that can be extended by the next draw, or NULL.
+    * It's only valid if it's also the last call in the current batch.
+    */
+   struct tc_call *last_draw;
+
+   /* Per call site sync counts, printed on destruction (GALLIUM_THREAD_STATS). */
+   bool print_stats;
+   unsigned num_sync_sites;
+   struct tc_sync_site sync_sites[TC_MAX_SYNC_SITES];
 
    struct util_queue queue;
    struct util_queue_fence *fence;
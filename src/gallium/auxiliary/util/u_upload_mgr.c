@@ -34,10 +34,15 @@
 #include "pipe/p_context.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/u_atomic.h"
 
 #include "u_upload_mgr.h"
 
 
+/* Number of filled upload buffers kept around for reuse. */
+#define U_UPLOAD_MAX_RETIRED 4
+
+
 struct u_upload_mgr {
    struct pipe_context *pipe;
 
@@ -53,6 +58,21 @@ struct u_upload_mgr {
    uint8_t *map;    /* Pointer to the mapped upload buffer. */
    unsigned offset; /* Aligned offset to the upload buffer, pointing
                      * at the first unused byte. */
+
+   /* Filled default-sized buffers, oldest first, if recycling is enabled.
+    * They are recycled once nothing but the upload manager references them
+    * and the fence of their last use has signalled, which avoids creating
+    * (and faulting in) a new buffer every time the current one wraps.
+    */
+   boolean recycle;
+   struct {
+      struct pipe_resource *buffer;
+      /* Taken once the upload manager holds the only reference, NULL
+       * before that.
+       */
+      struct pipe_fence_handle *fence;
+   } retired[U_UPLOAD_MAX_RETIRED];
+   unsigned num_retired;
 };
 
 
@@ -89,6 +109,12 @@ u_upload_create(struct pipe_context *pipe, unsigned default_size,
    return upload;
 }
 
+void
+u_upload_enable_recycling(struct u_upload_mgr *upload)
+{
+   upload->recycle = TRUE;
+}
+
 struct u_upload_mgr *
 u_upload_create_default(struct pipe_context *pipe)
 {
@@ -143,29 +169,143 @@ u_upload_release_buffer(struct u_upload_mgr *upload)
 }
 
 
+static void
+u_upload_release_retired(struct u_upload_mgr *upload, unsigned i)
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+
+   pipe_resource_reference(&upload->retired[i].buffer, NULL);
+   screen->fence_reference(screen, &upload->retired[i].fence, NULL);
+}
+
+
 void
 u_upload_destroy(struct u_upload_mgr *upload)
 {
+   unsigned i;
+
    u_upload_release_buffer(upload);
+
+   for (i = 0; i < upload->num_retired; i++)
+      u_upload_release_retired(upload, i);
+
    FREE(upload);
 }
 
 
+/**
+ * Unmap the current buffer and keep it for reuse if recycling is enabled
+ * and it has the default size, otherwise just release it.
+ */
+static void
+u_upload_retire_buffer(struct u_upload_mgr *upload, unsigned default_size)
+{
+   struct pipe_resource *buffer = upload->buffer;
+
+   if (!upload->recycle || !buffer || buffer->width0 != default_size) {
+      u_upload_release_buffer(upload);
+      return;
+   }
+
+   upload_unmap_internal(upload, TRUE);
+
+   if (upload->num_retired == U_UPLOAD_MAX_RETIRED) {
+      u_upload_release_retired(upload, 0);
+      memmove(&upload->retired[0], &upload->retired[1],
+              (U_UPLOAD_MAX_RETIRED - 1) * sizeof(upload->retired[0]));
+      upload->num_retired--;
+   }
+
+   /* transfer the reference */
+   upload->retired[upload->num_retired].buffer = buffer;
+   upload->retired[upload->num_retired].fence = NULL;
+   upload->num_retired++;
+   upload->buffer = NULL;
+}
+
+
+/**
+ * Try to make an idle retired buffer the current upload buffer.
+ *
+ * Once the upload manager holds the only reference to a buffer, no new
+ * command can use it, so a fence taken from then on covers its last use.
+ * The buffer is reused when that fence has signalled, and mapped
+ * unsynchronized like a new one.
+ */
+static boolean
+u_upload_recycle_buffer(struct u_upload_mgr *upload)
+{
+   struct pipe_context *pipe = upload->pipe;
+   struct pipe_screen *screen = pipe->screen;
+   struct pipe_fence_handle *fence = NULL;
+   boolean flushed = FALSE;
+   boolean found = FALSE;
+   unsigned i;
+
+   for (i = 0; i < upload->num_retired; i++) {
+      struct pipe_resource *buffer = upload->retired[i].buffer;
+
+      if (p_atomic_read(&buffer->reference.count) != 1)
+         continue;
+
+      if (!upload->retired[i].fence) {
+         /* One deferred flush fences all buffers that became idle. */
+         if (!flushed) {
+            pipe->flush(pipe, &fence, PIPE_FLUSH_DEFERRED | PIPE_FLUSH_ASYNC);
+            flushed = TRUE;
+         }
+         screen->fence_reference(screen, &upload->retired[i].fence, fence);
+         continue;
+      }
+
+      if (!screen->fence_finish(screen, NULL, upload->retired[i].fence, 0))
+         continue;
+
+      upload->map = pipe_buffer_map_range(pipe, buffer,
+                                          0, buffer->width0,
+                                          upload->map_flags,
+                                          &upload->transfer);
+      if (!upload->map) {
+         upload->transfer = NULL;
+         continue;
+      }
+
+      /* transfer the reference */
+      upload->buffer = buffer;
+      screen->fence_reference(screen, &upload->retired[i].fence, NULL);
+      memmove(&upload->retired[i], &upload->retired[i + 1],
+              (upload->num_retired - i - 1) * sizeof(upload->retired[0]));
+      upload->num_retired--;
+
+      upload->offset = 0;
+      found = TRUE;
+      break;
+   }
+
+   screen->fence_reference(screen, &fence, NULL);
+   return found;
+}
+
+
 static void
 u_upload_alloc_buffer(struct u_upload_mgr *upload, unsigned min_size)
 {
    struct pipe_screen *screen = upload->pipe->screen;
    struct pipe_resource buffer;
+   unsigned default_size = align(upload->default_size, 4096);
    unsigned size;
 
-   /* Release the old buffer, if present:
+   /* Retire the old buffer, if present:
     */
-   u_upload_release_buffer(upload);
+   u_upload_retire_buffer(upload, default_size);
 
-   /* Allocate a new one:
+   /* Reuse a previous one if possible, otherwise allocate a new one:
     */
    size = align(MAX2(upload->default_size, min_size), 4096);
 
+   if (size == default_size && u_upload_recycle_buffer(upload))
+      return;
+
    memset(&buffer, 0, sizeof buffer);
    buffer.target = PIPE_BUFFER;
    buffer.format = PIPE_FORMAT_R8_UNORM; /* want TYPELESS or similar */
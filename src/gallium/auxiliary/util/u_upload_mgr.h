@@ -69,6 +69,17 @@ u_upload_create_default(struct pipe_context *pipe);
 struct u_upload_mgr *
 u_upload_clone(struct pipe_context *pipe, struct u_upload_mgr *upload);
 
+/**
+ * Let the uploader reuse its filled buffers once the GPU is done with them
+ * instead of always allocating new ones.
+ *
+ * This issues deferred flushes on the uploader's context from within
+ * u_upload_alloc, so only enable it where that is safe, e.g. for the
+ * uploaders of u_threaded_context.
+ */
+void
+u_upload_enable_recycling(struct u_upload_mgr *upload);
+
 /**
  * Destroy the upload manager.
  */
@@ -432,6 +432,7 @@ i915_prepare_vertex_sampling(struct i915_context *i915)
                                  i,
                                  tex->width0, tex->height0, tex->depth0,
                                  view->u.tex.first_level, tex->last_level,
+                                 1, 0,
                                  addr,
                                  row_stride, img_stride, mip_offsets);
       } else
@@ -446,6 +446,20 @@ lp_build_occlusion_count(struct gallivm_state *gallivm,
                                        LLVMInt32TypeInContext(context), bits);
       count = LLVMBuildZExt(builder, count, LLVMIntTypeInContext(context, 64), "");
    }
+   else if(type.length == 16) {
+      /*
+       * Let llvm turn the sign bits into a 16bit mask, which is a single
+       * instruction with AVX-512 and a couple of movmsk/shifts otherwise.
+       */
+      LLVMTypeRef i16t = LLVMInt16TypeInContext(context);
+      LLVMValueRef bits = LLVMBuildICmp(builder, LLVMIntSLT, maskvalue,
+                                        lp_build_const_int_vec(gallivm,
+                                                               lp_int_type(type), 0),
+                                        "");
+      bits = LLVMBuildBitCast(builder, bits, i16t, "");
+      count = lp_build_intrinsic_unary(builder, "llvm.ctpop.i16", i16t, bits);
+      count = LLVMBuildZExt(builder, count, LLVMIntTypeInContext(context, 64), "");
+   }
    else if(util_cpu_caps.has_avx && type.length == 8) {
       const char *movmskintr = "llvm.x86.avx.movmsk.ps.256";
       const char *popcntintr = "llvm.ctpop.i32";
@@ -511,6 +525,141 @@ lp_build_occlusion_count(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Return the position (in a row-major 4x4 block) of element i of a 16-wide
+ * fragment vector, which holds the four quads of the block one after another.
+ */
+static unsigned
+quad_to_linear_4x4(unsigned i)
+{
+   unsigned quad = i / 4;
+   unsigned x = (quad & 1) * 2 + (i & 1);
+   unsigned y = (quad & 2) + ((i & 2) >> 1);
+
+   return y * 4 + x;
+}
+
+
+/**
+ * Inverse of quad_to_linear_4x4.
+ */
+static unsigned
+linear_to_quad_4x4(unsigned p)
+{
+   unsigned x = p % 4;
+   unsigned y = p / 4;
+
+   return ((y / 2) * 2 + x / 2) * 4 + (y % 2) * 2 + x % 2;
+}
+
+
+/**
+ * Load a full 4x4 block of depth/stencil values (for 16-wide fragment
+ * vectors), in quad order.
+ */
+static LLVMValueRef
+load_zs_4x4(struct gallivm_state *gallivm,
+            struct lp_type zs_type,
+            boolean is_1d,
+            LLVMValueRef depth_ptr,
+            LLVMValueRef depth_stride)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type row_type = zs_type;
+   LLVMTypeRef row_ptr_type;
+   LLVMValueRef rows[4];
+   LLVMValueRef shuffles[16];
+   LLVMValueRef zs;
+   unsigned i;
+
+   assert(zs_type.length == 16);
+   row_type.length = 4;
+   row_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, row_type), 0);
+
+   for (i = 0; i < 4; i++) {
+      if (is_1d && i > 0) {
+         rows[i] = lp_build_undef(gallivm, row_type);
+      }
+      else {
+         LLVMValueRef offset = LLVMBuildMul(builder,
+                                            lp_build_const_int32(gallivm, i),
+                                            depth_stride, "");
+         LLVMValueRef ptr = LLVMBuildGEP(builder, depth_ptr, &offset, 1, "");
+         ptr = LLVMBuildBitCast(builder, ptr, row_ptr_type, "");
+         rows[i] = LLVMBuildLoad(builder, ptr, "");
+      }
+   }
+
+   zs = lp_build_concat(gallivm, rows, row_type, 4);
+
+   for (i = 0; i < 16; i++) {
+      shuffles[i] = lp_build_const_int32(gallivm, quad_to_linear_4x4(i));
+   }
+
+   return LLVMBuildShuffleVector(builder, zs, zs,
+                                 LLVMConstVector(shuffles, 16), "");
+}
+
+
+/**
+ * Store a full 4x4 block of depth/stencil values given in quad order.
+ * For combined depth/stencil formats wider than 32 bits z and s are
+ * interleaved here.
+ */
+static void
+store_zs_4x4(struct gallivm_state *gallivm,
+             struct lp_type zs_type,
+             boolean is_1d,
+             LLVMValueRef depth_ptr,
+             LLVMValueRef depth_stride,
+             LLVMValueRef z_value,
+             LLVMValueRef s_value)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type row_type = zs_type;
+   LLVMTypeRef row_vec_type;
+   LLVMValueRef shuffles[32];
+   LLVMValueRef zs;
+   unsigned num_elems = zs_type.width > 32 ? 32 : 16;
+   unsigned row_elems = num_elems / 4;
+   unsigned i;
+
+   assert(zs_type.length == 16);
+   row_type.length = 4;
+   row_vec_type = lp_build_vec_type(gallivm, row_type);
+
+   if (zs_type.width > 32) {
+      for (i = 0; i < 16; i++) {
+         shuffles[i*2] = lp_build_const_int32(gallivm, linear_to_quad_4x4(i));
+         shuffles[i*2+1] = lp_build_const_int32(gallivm, linear_to_quad_4x4(i) + 16);
+      }
+      zs = LLVMBuildShuffleVector(builder, z_value, s_value,
+                                  LLVMConstVector(shuffles, 32), "");
+   }
+   else {
+      for (i = 0; i < 16; i++) {
+         shuffles[i] = lp_build_const_int32(gallivm, linear_to_quad_4x4(i));
+      }
+      zs = LLVMBuildShuffleVector(builder, z_value, z_value,
+                                  LLVMConstVector(shuffles, 16), "");
+   }
+
+   for (i = 0; i < (is_1d ? 1 : 4); i++) {
+      LLVMValueRef offset = LLVMBuildMul(builder,
+                                         lp_build_const_int32(gallivm, i),
+                                         depth_stride, "");
+      LLVMValueRef ptr = LLVMBuildGEP(builder, depth_ptr, &offset, 1, "");
+      LLVMValueRef row = lp_build_extract_range(gallivm, zs, i * row_elems,
+                                                row_elems);
+
+      row = LLVMBuildBitCast(builder, row, row_vec_type, "");
+      ptr = LLVMBuildBitCast(builder, ptr,
+                             LLVMPointerType(row_vec_type, 0), "");
+      LLVMBuildStore(builder, row, ptr);
+   }
+}
+
+
 /**
  * Load depth/stencil values.
  * The stored values are linear, swizzle them.
@@ -548,55 +697,60 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
    zs_load_type.length = zs_load_type.length / 2;
    load_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, zs_load_type), 0);
 
-   if (z_src_type.length == 4) {
-      unsigned i;
-      LLVMValueRef looplsb = LLVMBuildAnd(builder, loop_counter,
-                                          lp_build_const_int32(gallivm, 1), "");
-      LLVMValueRef loopmsb = LLVMBuildAnd(builder, loop_counter,
-                                          lp_build_const_int32(gallivm, 2), "");
-      LLVMValueRef offset2 = LLVMBuildMul(builder, loopmsb,
-                                          depth_stride, "");
-      depth_offset1 = LLVMBuildMul(builder, looplsb,
-                                   lp_build_const_int32(gallivm, depth_bytes * 2), "");
-      depth_offset1 = LLVMBuildAdd(builder, depth_offset1, offset2, "");
-
-      /* just concatenate the loaded 2x2 values into 4-wide vector */
-      for (i = 0; i < 4; i++) {
-         shuffles[i] = lp_build_const_int32(gallivm, i);
-      }
+   if (z_src_type.length == 16) {
+      *z_fb = load_zs_4x4(gallivm, zs_type, is_1d, depth_ptr, depth_stride);
    }
    else {
-      unsigned i;
-      LLVMValueRef loopx2 = LLVMBuildShl(builder, loop_counter,
-                                         lp_build_const_int32(gallivm, 1), "");
-      assert(z_src_type.length == 8);
-      depth_offset1 = LLVMBuildMul(builder, loopx2, depth_stride, "");
-      /*
-       * We load 2x4 values, and need to swizzle them (order
-       * 0,1,4,5,2,3,6,7) - not so hot with avx unfortunately.
-       */
-      for (i = 0; i < 8; i++) {
-         shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2);
+      if (z_src_type.length == 4) {
+         unsigned i;
+         LLVMValueRef looplsb = LLVMBuildAnd(builder, loop_counter,
+                                             lp_build_const_int32(gallivm, 1), "");
+         LLVMValueRef loopmsb = LLVMBuildAnd(builder, loop_counter,
+                                             lp_build_const_int32(gallivm, 2), "");
+         LLVMValueRef offset2 = LLVMBuildMul(builder, loopmsb,
+                                             depth_stride, "");
+         depth_offset1 = LLVMBuildMul(builder, looplsb,
+                                      lp_build_const_int32(gallivm, depth_bytes * 2), "");
+         depth_offset1 = LLVMBuildAdd(builder, depth_offset1, offset2, "");
+
+         /* just concatenate the loaded 2x2 values into 4-wide vector */
+         for (i = 0; i < 4; i++) {
+            shuffles[i] = lp_build_const_int32(gallivm, i);
+         }
+      }
+      else {
+         unsigned i;
+         LLVMValueRef loopx2 = LLVMBuildShl(builder, loop_counter,
+                                            lp_build_const_int32(gallivm, 1), "");
+         assert(z_src_type.length == 8);
+         depth_offset1 = LLVMBuildMul(builder, loopx2, depth_stride, "");
+         /*
+          * We load 2x4 values, and need to swizzle them (order
+          * 0,1,4,5,2,3,6,7) - not so hot with avx unfortunately.
+          */
+         for (i = 0; i < 8; i++) {
+            shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2);
+         }
       }
-   }
 
-   depth_offset2 = LLVMBuildAdd(builder, depth_offset1, depth_stride, "");
+      depth_offset2 = LLVMBuildAdd(builder, depth_offset1, depth_stride, "");
 
-   /* Load current z/stencil values from z/stencil buffer */
-   zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset1, 1, "");
-   zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
-   zs_dst1 = LLVMBuildLoad(builder, zs_dst_ptr, "");
-   if (is_1d) {
-      zs_dst2 = lp_build_undef(gallivm, zs_load_type);
-   }
-   else {
-      zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset2, 1, "");
+      /* Load current z/stencil values from z/stencil buffer */
+      zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset1, 1, "");
       zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
-      zs_dst2 = LLVMBuildLoad(builder, zs_dst_ptr, "");
-   }
+      zs_dst1 = LLVMBuildLoad(builder, zs_dst_ptr, "");
+      if (is_1d) {
+         zs_dst2 = lp_build_undef(gallivm, zs_load_type);
+      }
+      else {
+         zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset2, 1, "");
+         zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
+         zs_dst2 = LLVMBuildLoad(builder, zs_dst_ptr, "");
+      }
 
-   *z_fb = LLVMBuildShuffleVector(builder, zs_dst1, zs_dst2,
-                                  LLVMConstVector(shuffles, zs_type.length), "");
+      *z_fb = LLVMBuildShuffleVector(builder, zs_dst1, zs_dst2,
+                                     LLVMConstVector(shuffles, zs_type.length), "");
+   }
    *s_fb = *z_fb;
 
    if (format_desc->block.bits < z_src_type.width) {
@@ -691,6 +845,31 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
 
    lp_build_context_init(&z_bld, gallivm, z_type);
 
+   if (format_desc->block.bits > 32) {
+      s_value = LLVMBuildBitCast(builder, s_value, z_bld.vec_type, "");
+   }
+
+   if (mask) {
+      mask_value = lp_build_mask_value(mask);
+      z_value = lp_build_select(&z_bld, mask_value, z_value, z_fb);
+      if (format_desc->block.bits > 32) {
+         s_fb = LLVMBuildBitCast(builder, s_fb, z_bld.vec_type, "");
+         s_value = lp_build_select(&z_bld, mask_value, s_value, s_fb);
+      }
+   }
+
+   if (zs_type.width < z_src_type.width) {
+      /* Truncate ZS values (e.g., when writing to Z16_UNORM) */
+      z_value = LLVMBuildTrunc(builder, z_value,
+                               lp_build_int_vec_type(gallivm, zs_type), "");
+   }
+
+   if (z_src_type.length == 16) {
+      store_zs_4x4(gallivm, zs_type, is_1d, depth_ptr, depth_stride,
+                   z_value, s_value);
+      return;
+   }
+
    /*
     * This is far from ideal, at least for late depth write we should do this
     * outside the fs loop to avoid all the swizzle stuff.
@@ -728,25 +907,6 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
    zs_dst_ptr2 = LLVMBuildGEP(builder, depth_ptr, &depth_offset2, 1, "");
    zs_dst_ptr2 = LLVMBuildBitCast(builder, zs_dst_ptr2, load_ptr_type, "");
 
-   if (format_desc->block.bits > 32) {
-      s_value = LLVMBuildBitCast(builder, s_value, z_bld.vec_type, "");
-   }
-
-   if (mask) {
-      mask_value = lp_build_mask_value(mask);
-      z_value = lp_build_select(&z_bld, mask_value, z_value, z_fb);
-      if (format_desc->block.bits > 32) {
-         s_fb = LLVMBuildBitCast(builder, s_fb, z_bld.vec_type, "");
-         s_value = lp_build_select(&z_bld, mask_value, s_value, s_fb);
-      }
-   }
-
-   if (zs_type.width < z_src_type.width) {
-      /* Truncate ZS values (e.g., when writing to Z16_UNORM) */
-      z_value = LLVMBuildTrunc(builder, z_value,
-                               lp_build_int_vec_type(gallivm, zs_type), "");
-   }
-
    if (format_desc->block.bits <= 32) {
       if (z_src_type.length == 4) {
          zs_dst1 = lp_build_extract_range(gallivm, z_value, 0, 2);
@@ -0,0 +1,1077 @@
+/**************************************************************************
+ *
+ * Copyright 2017 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Direct blit, copy and clear paths.
+ *
+ * util_blitter draws a quad through setup, binning and a fragment shader
+ * even for plain copies and simple scaled blits, and the u_surface
+ * fallbacks for copies and clears are single threaded.  The common cases
+ * are instead done here directly on the mapped resources, split into
+ * bands of rows which are run on the rasterizer threads.
+ */
+
+#include <stdlib.h>
+
+#include "util/u_box.h"
+#include "util/u_format.h"
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_pack_color.h"
+#include "util/u_sse.h"
+#include "util/u_surface.h"
+#include "lp_blit.h"
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_rast.h"
+#include "lp_screen.h"
+#include "lp_texture.h"
+
+#if defined(PIPE_ARCH_SSE)
+#include <emmintrin.h>
+#endif
+
+
+/** Rows of blocks per job */
+#define LP_BLIT_BAND_ROWS 32
+
+/** Smaller operations are done on the calling thread */
+#define LP_BLIT_MIN_THREADED_BYTES (64 * 1024)
+
+
+enum lp_blit_op {
+   LP_BLIT_OP_COPY,     /**< same format, no scaling */
+   LP_BLIT_OP_NEAREST,  /**< same format, nearest scaling or flip */
+   LP_BLIT_OP_CONVERT,  /**< format conversion, nearest or linear scaling */
+   LP_BLIT_OP_FILL,     /**< constant color */
+   LP_BLIT_OP_RESOLVE   /**< average of the samples, no scaling */
+};
+
+
+struct lp_blit_job {
+   enum lp_blit_op op;
+
+   uint8_t *dst;
+   unsigned dst_stride;
+   unsigned dst_layer_stride;
+   enum pipe_format dst_format;
+
+   const uint8_t *src;
+   unsigned src_stride;
+   unsigned src_layer_stride;
+   enum pipe_format src_format;
+   unsigned src_width;           /**< size of the mapped source region */
+   unsigned src_height;
+   unsigned src_sample_stride;   /**< for resolves */
+   unsigned nr_samples;
+
+   unsigned width;               /**< destination size, in blocks */
+   unsigned height;
+   unsigned block_size;          /**< bytes per block */
+
+   unsigned rows_per_band;
+   unsigned bands_per_layer;
+
+   /**
+    * Source coordinates for scaled blits, relative to the mapped region.
+    * Destination pixel i maps to source position (i + 0.5) * scale + offset.
+    */
+   float scale_y, offset_y;
+   const unsigned *src_x0;       /**< nearest, or left linear sample */
+   const unsigned *src_x1;       /**< right linear sample */
+   const float *weight_x;
+   boolean linear;
+
+   union util_color color;
+   uint64_t keep_mask;           /**< fill: destination bits to preserve */
+};
+
+
+static inline unsigned
+nearest_coord(float scale, float offset, unsigned i, unsigned size)
+{
+   int s = util_ifloor((i + 0.5f) * scale + offset);
+   return CLAMP(s, 0, (int)size - 1);
+}
+
+
+static void
+blit_rows_nearest(const struct lp_blit_job *blit,
+                  uint8_t *dst, const uint8_t *src,
+                  unsigned y0, unsigned y1)
+{
+   const unsigned bs = blit->block_size;
+   unsigned x, y;
+
+   for (y = y0; y < y1; y++) {
+      const uint8_t *src_row = src + blit->src_stride *
+         nearest_coord(blit->scale_y, blit->offset_y, y, blit->src_height);
+      uint8_t *dst_row = dst + y * blit->dst_stride;
+
+      switch (bs) {
+      case 4:
+         for (x = 0; x < blit->width; x++)
+            ((uint32_t *)dst_row)[x] =
+               ((const uint32_t *)src_row)[blit->src_x0[x]];
+         break;
+      case 2:
+         for (x = 0; x < blit->width; x++)
+            ((uint16_t *)dst_row)[x] =
+               ((const uint16_t *)src_row)[blit->src_x0[x]];
+         break;
+      default:
+         for (x = 0; x < blit->width; x++)
+            memcpy(dst_row + x * bs, src_row + blit->src_x0[x] * bs, bs);
+         break;
+      }
+   }
+}
+
+
+static void
+blit_rows_convert(const struct lp_blit_job *blit,
+                  uint8_t *dst, const uint8_t *src,
+                  unsigned y0, unsigned y1)
+{
+   const struct util_format_description *src_desc =
+      util_format_description(blit->src_format);
+   const struct util_format_description *dst_desc =
+      util_format_description(blit->dst_format);
+   float *row[2], *out;
+   int row_y[2] = { -1, -1 };
+   unsigned x, y, c;
+
+   row[0] = MALLOC((2 * blit->src_width + blit->width) * 4 * sizeof(float));
+   if (!row[0])
+      return;
+   row[1] = row[0] + blit->src_width * 4;
+   out = row[1] + blit->src_width * 4;
+
+   for (y = y0; y < y1; y++) {
+      if (!blit->linear) {
+         int sy = nearest_coord(blit->scale_y, blit->offset_y, y,
+                                blit->src_height);
+         if (row_y[0] != sy) {
+            src_desc->unpack_rgba_float(row[0], 0,
+                                        src + sy * blit->src_stride, 0,
+                                        blit->src_width, 1);
+            row_y[0] = sy;
+         }
+         for (x = 0; x < blit->width; x++)
+            memcpy(&out[x * 4], &row[0][blit->src_x0[x] * 4],
+                   4 * sizeof(float));
+      }
+      else {
+         float fy = (y + 0.5f) * blit->scale_y + blit->offset_y - 0.5f;
+         int iy = util_ifloor(fy);
+         float wy = fy - iy;
+         int sy[2];
+         unsigned i;
+
+         sy[0] = CLAMP(iy, 0, (int)blit->src_height - 1);
+         sy[1] = CLAMP(iy + 1, 0, (int)blit->src_height - 1);
+
+         /* Keep the previously unpacked rows when possible. */
+         if (row_y[0] == sy[1] || row_y[1] == sy[0]) {
+            float *tmp = row[0];
+            int tmp_y = row_y[0];
+            row[0] = row[1];
+            row[1] = tmp;
+            row_y[0] = row_y[1];
+            row_y[1] = tmp_y;
+         }
+         for (i = 0; i < 2; i++) {
+            if (row_y[i] != sy[i]) {
+               src_desc->unpack_rgba_float(row[i], 0,
+                                           src + sy[i] * blit->src_stride, 0,
+                                           blit->src_width, 1);
+               row_y[i] = sy[i];
+            }
+         }
+
+         for (x = 0; x < blit->width; x++) {
+            const float *a = &row[0][blit->src_x0[x] * 4];
+            const float *b = &row[0][blit->src_x1[x] * 4];
+            const float *d = &row[1][blit->src_x0[x] * 4];
+            const float *e = &row[1][blit->src_x1[x] * 4];
+            float wx = blit->weight_x[x];
+
+            for (c = 0; c < 4; c++) {
+               float top = a[c] + (b[c] - a[c]) * wx;
+               float bottom = d[c] + (e[c] - d[c]) * wx;
+               out[x * 4 + c] = top + (bottom - top) * wy;
+            }
+         }
+      }
+
+      dst_desc->pack_rgba_float(dst + y * blit->dst_stride, 0,
+                                out, 0, blit->width, 1);
+   }
+
+   FREE(row[0]);
+}
+
+
+/**
+ * Average four samples of 8-bit unorm data, rounding to nearest.
+ * Sample i of byte j is at src[i * sample_stride + j].
+ */
+void
+llvmpipe_resolve_row_unorm8(uint8_t *dst, const uint8_t *src,
+                            unsigned sample_stride, unsigned bytes)
+{
+   const uint8_t *src1 = src + sample_stride;
+   const uint8_t *src2 = src1 + sample_stride;
+   const uint8_t *src3 = src2 + sample_stride;
+   unsigned i = 0;
+
+#if defined(PIPE_ARCH_SSE)
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i two = _mm_set1_epi16(2);
+
+   for (; i + 16 <= bytes; i += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+      __m128i b = _mm_loadu_si128((const __m128i *)(src1 + i));
+      __m128i c = _mm_loadu_si128((const __m128i *)(src2 + i));
+      __m128i d = _mm_loadu_si128((const __m128i *)(src3 + i));
+      __m128i lo, hi;
+
+      lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                       _mm_unpacklo_epi8(b, zero)),
+                         _mm_add_epi16(_mm_unpacklo_epi8(c, zero),
+                                       _mm_unpacklo_epi8(d, zero)));
+      hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                       _mm_unpackhi_epi8(b, zero)),
+                         _mm_add_epi16(_mm_unpackhi_epi8(c, zero),
+                                       _mm_unpackhi_epi8(d, zero)));
+      lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+      hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+   }
+#endif
+
+   for (; i < bytes; i++)
+      dst[i] = (src[i] + src1[i] + src2[i] + src3[i] + 2) >> 2;
+}
+
+
+static boolean
+is_unorm8(const struct util_format_description *desc)
+{
+   unsigned i;
+
+   if (desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB)
+      return FALSE;
+
+   for (i = 0; i < desc->nr_channels; i++) {
+      if (desc->channel[i].type != UTIL_FORMAT_TYPE_UNSIGNED ||
+          !desc->channel[i].normalized ||
+          desc->channel[i].size != 8)
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+static void
+blit_rows_resolve(const struct lp_blit_job *blit,
+                  uint8_t *dst, const uint8_t *src,
+                  unsigned y0, unsigned y1)
+{
+   const struct util_format_description *src_desc =
+      util_format_description(blit->src_format);
+   const struct util_format_description *dst_desc =
+      util_format_description(blit->dst_format);
+   const float scale = 1.0f / blit->nr_samples;
+   float *sum, *tmp;
+   unsigned x, y, s;
+
+   if (blit->src_format == blit->dst_format &&
+       blit->nr_samples == 4 &&
+       is_unorm8(src_desc)) {
+      for (y = y0; y < y1; y++)
+         llvmpipe_resolve_row_unorm8(dst + y * blit->dst_stride,
+                                     src + y * blit->src_stride,
+                                     blit->src_sample_stride,
+                                     blit->width * blit->block_size);
+      return;
+   }
+
+   sum = MALLOC(2 * blit->width * 4 * sizeof(float));
+   if (!sum)
+      return;
+   tmp = sum + blit->width * 4;
+
+   for (y = y0; y < y1; y++) {
+      const uint8_t *src_row = src + y * blit->src_stride;
+
+      src_desc->unpack_rgba_float(sum, 0, src_row, 0, blit->width, 1);
+      for (s = 1; s < blit->nr_samples; s++) {
+         src_desc->unpack_rgba_float(tmp, 0,
+                                     src_row + s * blit->src_sample_stride, 0,
+                                     blit->width, 1);
+         for (x = 0; x < blit->width * 4; x++)
+            sum[x] += tmp[x];
+      }
+      for (x = 0; x < blit->width * 4; x++)
+         sum[x] *= scale;
+
+      dst_desc->pack_rgba_float(dst + y * blit->dst_stride, 0,
+                                sum, 0, blit->width, 1);
+   }
+
+   FREE(sum);
+}
+
+
+/**
+ * Fill rows of a combined depth/stencil format, keeping the destination
+ * bits in keep_mask.
+ */
+static void
+blit_rows_fill_masked(const struct lp_blit_job *blit, uint8_t *dst,
+                      unsigned y0, unsigned y1)
+{
+   unsigned x, y;
+
+   for (y = y0; y < y1; y++) {
+      if (blit->block_size == 8) {
+         uint64_t *row = (uint64_t *)(dst + y * blit->dst_stride);
+         uint64_t value;
+
+         memcpy(&value, blit->color.ui, sizeof value);
+         value &= ~blit->keep_mask;
+         for (x = 0; x < blit->width; x++)
+            row[x] = (row[x] & blit->keep_mask) | value;
+      }
+      else {
+         uint32_t *row = (uint32_t *)(dst + y * blit->dst_stride);
+         uint32_t keep = (uint32_t)blit->keep_mask;
+         uint32_t value = blit->color.ui[0] & ~keep;
+
+         assert(blit->block_size == 4);
+         for (x = 0; x < blit->width; x++)
+            row[x] = (row[x] & keep) | value;
+      }
+   }
+}
+
+
+/**
+ * Run one band of rows of one layer.
+ */
+static void
+blit_job(void *data, unsigned job)
+{
+   const struct lp_blit_job *blit = (const struct lp_blit_job *)data;
+   unsigned layer = job / blit->bands_per_layer;
+   unsigned y0 = (job % blit->bands_per_layer) * blit->rows_per_band;
+   unsigned y1 = MIN2(y0 + blit->rows_per_band, blit->height);
+   uint8_t *dst = blit->dst + layer * blit->dst_layer_stride;
+   const uint8_t *src = blit->src;
+   unsigned y;
+
+   if (src)
+      src += layer * blit->src_layer_stride;
+
+   switch (blit->op) {
+   case LP_BLIT_OP_COPY:
+      for (y = y0; y < y1; y++)
+         memcpy(dst + y * blit->dst_stride,
+                src + y * blit->src_stride,
+                blit->width * blit->block_size);
+      break;
+   case LP_BLIT_OP_NEAREST:
+      blit_rows_nearest(blit, dst, src, y0, y1);
+      break;
+   case LP_BLIT_OP_CONVERT:
+      blit_rows_convert(blit, dst, src, y0, y1);
+      break;
+   case LP_BLIT_OP_FILL:
+      if (blit->keep_mask) {
+         blit_rows_fill_masked(blit, dst, y0, y1);
+      }
+      else {
+         union util_color uc = blit->color;
+         util_fill_rect(dst, blit->dst_format, blit->dst_stride,
+                        0, y0, blit->width, y1 - y0, &uc);
+      }
+      break;
+   case LP_BLIT_OP_RESOLVE:
+      blit_rows_resolve(blit, dst, src, y0, y1);
+      break;
+   }
+}
+
+
+/**
+ * Split the job in bands and run it, threaded if it is large enough.
+ */
+static void
+run_blit_job(struct llvmpipe_context *lp,
+             struct lp_blit_job *blit,
+             unsigned depth)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   uint64_t bytes = (uint64_t)blit->width * blit->height *
+                    blit->block_size * depth;
+   unsigned i;
+
+   if (bytes < LP_BLIT_MIN_THREADED_BYTES || screen->num_threads == 0) {
+      blit->rows_per_band = blit->height;
+      blit->bands_per_layer = 1;
+      for (i = 0; i < depth; i++)
+         blit_job(blit, i);
+      return;
+   }
+
+   blit->rows_per_band = LP_BLIT_BAND_ROWS;
+   blit->bands_per_layer = DIV_ROUND_UP(blit->height, blit->rows_per_band);
+
+   mtx_lock(&screen->rast_mutex);
+   lp_rast_run_jobs(screen->rast, blit_job, blit,
+                    blit->bands_per_layer * depth);
+   mtx_unlock(&screen->rast_mutex);
+}
+
+
+/**
+ * Try to do a blit directly.
+ * Handles color blits without scissor or blending between single sampled
+ * uncompressed formats, with or without scaling and format conversion.
+ * \return FALSE if the blit must go through util_blitter instead.
+ */
+boolean
+llvmpipe_direct_blit(struct llvmpipe_context *lp,
+                     const struct pipe_blit_info *info)
+{
+   struct pipe_context *pipe = &lp->pipe;
+   struct pipe_resource *src = info->src.resource;
+   struct pipe_resource *dst = info->dst.resource;
+   const struct pipe_box *sbox = &info->src.box;
+   const struct pipe_box *dbox = &info->dst.box;
+   const struct util_format_description *src_desc;
+   const struct util_format_description *dst_desc;
+   struct pipe_transfer *src_trans, *dst_trans;
+   struct pipe_box src_map_box;
+   struct lp_blit_job blit;
+   boolean same_format, scaled, integer;
+   unsigned *src_x0 = NULL;
+   float scale_x, offset_x;
+   int sx0, sx1, sy0, sy1;
+   unsigned x;
+
+   if (LP_PERF & PERF_NO_BLIT)
+      return FALSE;
+
+   if (info->scissor_enable ||
+       info->alpha_blend ||
+       (info->mask & PIPE_MASK_RGBA) != PIPE_MASK_RGBA ||
+       (info->mask & PIPE_MASK_ZS))
+      return FALSE;
+
+   if (src->target == PIPE_BUFFER || dst->target == PIPE_BUFFER ||
+       src->nr_samples > 1 || dst->nr_samples > 1)
+      return FALSE;
+
+   /* possibly overlapping */
+   if (src == dst && info->src.level == info->dst.level)
+      return FALSE;
+
+   if (dbox->width <= 0 || dbox->height <= 0 || dbox->depth <= 0 ||
+       sbox->width == 0 || sbox->height == 0 || sbox->depth != dbox->depth)
+      return FALSE;
+
+   src_desc = util_format_description(info->src.format);
+   dst_desc = util_format_description(info->dst.format);
+   if (!src_desc || !dst_desc ||
+       src_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       dst_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       util_format_is_depth_or_stencil(info->src.format) ||
+       util_format_is_depth_or_stencil(info->dst.format) ||
+       util_format_get_blocksize(info->src.format) !=
+       util_format_get_blocksize(src->format) ||
+       util_format_get_blocksize(info->dst.format) !=
+       util_format_get_blocksize(dst->format))
+      return FALSE;
+
+   same_format = info->src.format == info->dst.format;
+   integer = util_format_is_pure_integer(info->src.format) ||
+             util_format_is_pure_integer(info->dst.format);
+   scaled = sbox->width != dbox->width || sbox->height != dbox->height;
+
+   if (!same_format &&
+       (integer ||
+        !src_desc->unpack_rgba_float ||
+        !dst_desc->pack_rgba_float))
+      return FALSE;
+
+   memset(&blit, 0, sizeof blit);
+   blit.linear = info->filter == PIPE_TEX_FILTER_LINEAR && !integer &&
+                 (abs(sbox->width) != dbox->width ||
+                  abs(sbox->height) != dbox->height);
+
+   if (blit.linear && same_format &&
+       (!src_desc->unpack_rgba_float || !dst_desc->pack_rgba_float))
+      return FALSE;
+
+   /* Source region (boxes are flipped when width or height is negative),
+    * plus a border for linear filtering, clamped to the level.
+    */
+   sx0 = MIN2(sbox->x, sbox->x + sbox->width);
+   sx1 = MAX2(sbox->x, sbox->x + sbox->width);
+   sy0 = MIN2(sbox->y, sbox->y + sbox->height);
+   sy1 = MAX2(sbox->y, sbox->y + sbox->height);
+   if (blit.linear) {
+      sx0--;
+      sy0--;
+      sx1++;
+      sy1++;
+   }
+   sx0 = MAX2(sx0, 0);
+   sy0 = MAX2(sy0, 0);
+   sx1 = MIN2(sx1, (int)u_minify(src->width0, info->src.level));
+   sy1 = MIN2(sy1, (int)u_minify(src->height0, info->src.level));
+   if (sx1 <= sx0 || sy1 <= sy0)
+      return FALSE;
+
+   blit.src_format = info->src.format;
+   blit.dst_format = info->dst.format;
+   blit.src_width = sx1 - sx0;
+   blit.src_height = sy1 - sy0;
+   blit.width = dbox->width;
+   blit.height = dbox->height;
+   blit.block_size = util_format_get_blocksize(info->dst.format);
+
+   scale_x = (float)sbox->width / dbox->width;
+   offset_x = (float)(sbox->x - sx0);
+   blit.scale_y = (float)sbox->height / dbox->height;
+   blit.offset_y = (float)(sbox->y - sy0);
+
+   if (!same_format || blit.linear)
+      blit.op = LP_BLIT_OP_CONVERT;
+   else if (scaled ||
+            sbox->x != sx0 || sbox->y != sy0 ||
+            blit.src_width != blit.width || blit.src_height != blit.height)
+      blit.op = LP_BLIT_OP_NEAREST; /* scaled, flipped or clamped */
+   else
+      blit.op = LP_BLIT_OP_COPY;
+
+   if (blit.op != LP_BLIT_OP_COPY) {
+      float *weight_x;
+
+      src_x0 = MALLOC(dbox->width * (2 * sizeof(unsigned) + sizeof(float)));
+      if (!src_x0)
+         return FALSE;
+
+      blit.src_x0 = src_x0;
+      blit.src_x1 = src_x0 + dbox->width;
+      blit.weight_x = weight_x = (float *)(src_x0 + 2 * dbox->width);
+
+      for (x = 0; x < (unsigned)dbox->width; x++) {
+         if (blit.linear) {
+            float fx = (x + 0.5f) * scale_x + offset_x - 0.5f;
+            int ix = util_ifloor(fx);
+            src_x0[x] = CLAMP(ix, 0, (int)blit.src_width - 1);
+            src_x0[dbox->width + x] = CLAMP(ix + 1, 0, (int)blit.src_width - 1);
+            weight_x[x] = fx - ix;
+         }
+         else {
+            src_x0[x] = nearest_coord(scale_x, offset_x, x, blit.src_width);
+         }
+      }
+   }
+
+   u_box_3d(sx0, sy0, sbox->z, sx1 - sx0, sy1 - sy0, sbox->depth,
+            &src_map_box);
+
+   blit.src = pipe->transfer_map(pipe, src, info->src.level,
+                                 PIPE_TRANSFER_READ,
+                                 &src_map_box, &src_trans);
+   if (!blit.src) {
+      FREE(src_x0);
+      return FALSE;
+   }
+
+   blit.dst = pipe->transfer_map(pipe, dst, info->dst.level,
+                                 PIPE_TRANSFER_WRITE,
+                                 dbox, &dst_trans);
+   if (!blit.dst) {
+      pipe->transfer_unmap(pipe, src_trans);
+      FREE(src_x0);
+      return FALSE;
+   }
+
+   blit.src_stride = src_trans->stride;
+   blit.src_layer_stride = src_trans->layer_stride;
+   blit.dst_stride = dst_trans->stride;
+   blit.dst_layer_stride = dst_trans->layer_stride;
+
+   run_blit_job(lp, &blit, dbox->depth);
+
+   pipe->transfer_unmap(pipe, dst_trans);
+   pipe->transfer_unmap(pipe, src_trans);
+   FREE(src_x0);
+
+   return TRUE;
+}
+
+
+/**
+ * Try to do a texture copy directly, for large enough copies between
+ * formats of the same block size.
+ */
+boolean
+llvmpipe_direct_copy_region(struct llvmpipe_context *lp,
+                            struct pipe_resource *dst, unsigned dst_level,
+                            unsigned dstx, unsigned dsty, unsigned dstz,
+                            struct pipe_resource *src, unsigned src_level,
+                            const struct pipe_box *src_box)
+{
+   struct pipe_context *pipe = &lp->pipe;
+   struct pipe_transfer *src_trans, *dst_trans;
+   struct pipe_box dst_box;
+   struct lp_blit_job blit;
+   enum pipe_format format = src->format;
+   unsigned nr_samples = MAX2(src->nr_samples, 1);
+   unsigned depth = src_box->depth;
+
+   if (LP_PERF & PERF_NO_BLIT)
+      return FALSE;
+
+   if (src->target == PIPE_BUFFER || dst->target == PIPE_BUFFER ||
+       nr_samples != MAX2(dst->nr_samples, 1))
+      return FALSE;
+
+   /* The sample planes of multisampled resources are copied as layers. */
+   if (nr_samples > 1) {
+      if (src_box->depth != 1)
+         return FALSE;
+      depth = nr_samples;
+   }
+
+   if (src == dst && src_level == dst_level)
+      return FALSE;
+
+   if (util_format_get_blocksize(format) !=
+       util_format_get_blocksize(dst->format) ||
+       util_format_get_blockwidth(format) !=
+       util_format_get_blockwidth(dst->format) ||
+       util_format_get_blockheight(format) !=
+       util_format_get_blockheight(dst->format))
+      return FALSE;
+
+   if (src_box->width <= 0 || src_box->height <= 0 || src_box->depth <= 0)
+      return FALSE;
+
+   memset(&blit, 0, sizeof blit);
+   blit.op = LP_BLIT_OP_COPY;
+   blit.block_size = util_format_get_blocksize(format);
+   blit.width = util_format_get_nblocksx(format, src_box->width);
+   blit.height = util_format_get_nblocksy(format, src_box->height);
+
+   /* Small copies are just as well done by util_resource_copy_region,
+    * which only knows about the first sample though.
+    */
+   if (nr_samples == 1 &&
+       (uint64_t)blit.width * blit.height * blit.block_size *
+       src_box->depth < LP_BLIT_MIN_THREADED_BYTES)
+      return FALSE;
+
+   u_box_3d(dstx, dsty, dstz,
+            src_box->width, src_box->height, src_box->depth, &dst_box);
+
+   blit.src = pipe->transfer_map(pipe, src, src_level,
+                                 PIPE_TRANSFER_READ,
+                                 src_box, &src_trans);
+   if (!blit.src)
+      return FALSE;
+
+   blit.dst = pipe->transfer_map(pipe, dst, dst_level,
+                                 PIPE_TRANSFER_WRITE |
+                                 PIPE_TRANSFER_DISCARD_RANGE,
+                                 &dst_box, &dst_trans);
+   if (!blit.dst) {
+      pipe->transfer_unmap(pipe, src_trans);
+      return FALSE;
+   }
+
+   blit.src_stride = src_trans->stride;
+   blit.src_layer_stride = src_trans->layer_stride;
+   blit.dst_stride = dst_trans->stride;
+   blit.dst_layer_stride = dst_trans->layer_stride;
+   if (nr_samples > 1) {
+      blit.src_layer_stride = llvmpipe_resource(src)->sample_stride;
+      blit.dst_layer_stride = llvmpipe_resource(dst)->sample_stride;
+   }
+
+   run_blit_job(lp, &blit, depth);
+
+   pipe->transfer_unmap(pipe, dst_trans);
+   pipe->transfer_unmap(pipe, src_trans);
+
+   return TRUE;
+}
+
+
+/**
+ * Try to clear a color surface directly, for large enough clears.
+ */
+boolean
+llvmpipe_direct_clear_color(struct llvmpipe_context *lp,
+                            struct pipe_surface *dst,
+                            const union pipe_color_union *color,
+                            unsigned dstx, unsigned dsty,
+                            unsigned width, unsigned height)
+{
+   struct pipe_context *pipe = &lp->pipe;
+   const struct util_format_description *desc;
+   struct pipe_transfer *dst_trans;
+   struct lp_blit_job blit;
+   unsigned depth, nr_samples;
+
+   if (LP_PERF & PERF_NO_BLIT)
+      return FALSE;
+
+   if (!dst->texture || dst->texture->target == PIPE_BUFFER ||
+       !width || !height)
+      return FALSE;
+
+   desc = util_format_description(dst->format);
+   if (!desc || desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       util_format_is_depth_or_stencil(dst->format))
+      return FALSE;
+
+   depth = dst->u.tex.last_layer - dst->u.tex.first_layer + 1;
+   nr_samples = MAX2(dst->texture->nr_samples, 1);
+   if (nr_samples > 1 && depth != 1)
+      return FALSE;
+
+   memset(&blit, 0, sizeof blit);
+   blit.op = LP_BLIT_OP_FILL;
+   blit.dst_format = dst->format;
+   blit.block_size = util_format_get_blocksize(dst->format);
+   blit.width = width;
+   blit.height = height;
+
+   /* util_clear_render_target only clears the first sample */
+   if (nr_samples == 1 &&
+       (uint64_t)width * height * blit.block_size * depth <
+       LP_BLIT_MIN_THREADED_BYTES)
+      return FALSE;
+
+   if (util_format_is_pure_sint(dst->format)) {
+      util_format_write_4i(dst->format, color->i, 0, &blit.color,
+                           0, 0, 0, 1, 1);
+   }
+   else if (util_format_is_pure_uint(dst->format)) {
+      util_format_write_4ui(dst->format, color->ui, 0, &blit.color,
+                            0, 0, 0, 1, 1);
+   }
+   else {
+      util_pack_color(color->f, dst->format, &blit.color);
+   }
+
+   blit.dst = pipe_transfer_map_3d(pipe, dst->texture, dst->u.tex.level,
+                                   PIPE_TRANSFER_WRITE,
+                                   dstx, dsty, dst->u.tex.first_layer,
+                                   width, height, depth, &dst_trans);
+   if (!blit.dst)
+      return FALSE;
+
+   blit.dst_stride = dst_trans->stride;
+   blit.dst_layer_stride = dst_trans->layer_stride;
+   if (nr_samples > 1) {
+      blit.dst_layer_stride = llvmpipe_resource(dst->texture)->sample_stride;
+      depth = nr_samples;
+   }
+
+   run_blit_job(lp, &blit, depth);
+
+   pipe->transfer_unmap(pipe, dst_trans);
+
+   return TRUE;
+}
+
+
+/**
+ * Try to clear a depth/stencil surface directly, for large enough clears.
+ * Multisampled surfaces always take this path so every sample is cleared.
+ */
+boolean
+llvmpipe_direct_clear_depth_stencil(struct llvmpipe_context *lp,
+                                    struct pipe_surface *dst,
+                                    unsigned clear_flags,
+                                    double depth, unsigned stencil,
+                                    unsigned dstx, unsigned dsty,
+                                    unsigned width, unsigned height)
+{
+   struct pipe_context *pipe = &lp->pipe;
+   struct pipe_transfer *dst_trans;
+   struct lp_blit_job blit;
+   unsigned layers, nr_samples;
+   unsigned usage = PIPE_TRANSFER_WRITE;
+   uint64_t zstencil;
+
+   if (LP_PERF & PERF_NO_BLIT)
+      return FALSE;
+
+   if (!dst->texture || dst->texture->target == PIPE_BUFFER ||
+       !width || !height || !(clear_flags & PIPE_CLEAR_DEPTHSTENCIL))
+      return FALSE;
+
+   layers = dst->u.tex.last_layer - dst->u.tex.first_layer + 1;
+   nr_samples = MAX2(dst->texture->nr_samples, 1);
+   if (nr_samples > 1 && layers != 1)
+      return FALSE;
+
+   memset(&blit, 0, sizeof blit);
+   blit.op = LP_BLIT_OP_FILL;
+   blit.dst_format = dst->format;
+   blit.block_size = util_format_get_blocksize(dst->format);
+   blit.width = width;
+   blit.height = height;
+
+   /* util_clear_depth_stencil only clears the first sample */
+   if (nr_samples == 1 &&
+       (uint64_t)width * height * blit.block_size * layers <
+       LP_BLIT_MIN_THREADED_BYTES)
+      return FALSE;
+
+   zstencil = util_pack64_z_stencil(dst->format, depth, stencil);
+   switch (blit.block_size) {
+   case 1:
+      blit.color.ub = (uint8_t)zstencil;
+      break;
+   case 2:
+      blit.color.us = (uint16_t)zstencil;
+      break;
+   case 4:
+      blit.color.ui[0] = (uint32_t)zstencil;
+      break;
+   case 8:
+      memcpy(blit.color.ui, &zstencil, sizeof zstencil);
+      break;
+   default:
+      return FALSE;
+   }
+
+   /* Clearing only one of the depth and stencil components */
+   if ((clear_flags & PIPE_CLEAR_DEPTHSTENCIL) != PIPE_CLEAR_DEPTHSTENCIL &&
+       util_format_is_depth_and_stencil(dst->format)) {
+      uint64_t stencil_mask;
+
+      switch (dst->format) {
+      case PIPE_FORMAT_Z24_UNORM_S8_UINT:
+         stencil_mask = 0xff000000;
+         break;
+      case PIPE_FORMAT_S8_UINT_Z24_UNORM:
+         stencil_mask = 0x000000ff;
+         break;
+      case PIPE_FORMAT_Z32_FLOAT_S8X24_UINT:
+         stencil_mask = 0x000000ff00000000ull;
+         break;
+      default:
+         return FALSE;
+      }
+
+      if (clear_flags & PIPE_CLEAR_DEPTH)
+         blit.keep_mask = stencil_mask;
+      else
+         blit.keep_mask = ~stencil_mask &
+                          (blit.block_size == 8 ? ~0ull : 0xffffffffull);
+      usage = PIPE_TRANSFER_READ_WRITE;
+   }
+
+   blit.dst = pipe_transfer_map_3d(pipe, dst->texture, dst->u.tex.level,
+                                   usage,
+                                   dstx, dsty, dst->u.tex.first_layer,
+                                   width, height, layers, &dst_trans);
+   if (!blit.dst)
+      return FALSE;
+
+   blit.dst_stride = dst_trans->stride;
+   blit.dst_layer_stride = dst_trans->layer_stride;
+   if (nr_samples > 1) {
+      blit.dst_layer_stride = llvmpipe_resource(dst->texture)->sample_stride;
+      layers = nr_samples;
+   }
+
+   run_blit_job(lp, &blit, layers);
+
+   pipe->transfer_unmap(pipe, dst_trans);
+
+   return TRUE;
+}
+
+
+/**
+ * Blit from a multisampled resource: copy the samples to a multisampled
+ * destination, or average them into a single sampled one.  Integer and
+ * depth/stencil formats take the first sample instead of averaging.
+ * Scaling, flips, scissor and blending aren't supported for these, and
+ * are left to util_blitter.
+ * \return FALSE if the blit couldn't be done.
+ */
+boolean
+llvmpipe_direct_resolve(struct llvmpipe_context *lp,
+                        const struct pipe_blit_info *info)
+{
+   struct pipe_context *pipe = &lp->pipe;
+   struct pipe_resource *src = info->src.resource;
+   struct pipe_resource *dst = info->dst.resource;
+   const struct pipe_box *sbox = &info->src.box;
+   const struct pipe_box *dbox = &info->dst.box;
+   const struct util_format_description *src_desc;
+   const struct util_format_description *dst_desc;
+   struct pipe_transfer *src_trans, *dst_trans;
+   struct lp_blit_job blit;
+   unsigned nr_samples = src->nr_samples;
+   unsigned *src_x0 = NULL;
+   unsigned depth = 1;
+   boolean same_format, integer, zs;
+   unsigned x;
+
+   assert(nr_samples > 1);
+
+   if (info->scissor_enable || info->alpha_blend)
+      return FALSE;
+
+   if (src->target == PIPE_BUFFER || dst->target == PIPE_BUFFER ||
+       (dst->nr_samples > 1 && dst->nr_samples != nr_samples))
+      return FALSE;
+
+   if (src == dst && info->src.level == info->dst.level)
+      return FALSE;
+
+   if (dbox->width <= 0 || dbox->height <= 0 || dbox->depth != 1 ||
+       sbox->width != dbox->width || sbox->height != dbox->height ||
+       sbox->depth != 1)
+      return FALSE;
+
+   src_desc = util_format_description(info->src.format);
+   dst_desc = util_format_description(info->dst.format);
+   if (!src_desc || !dst_desc ||
+       src_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       dst_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       util_format_get_blocksize(info->src.format) !=
+       util_format_get_blocksize(src->format) ||
+       util_format_get_blocksize(info->dst.format) !=
+       util_format_get_blocksize(dst->format))
+      return FALSE;
+
+   same_format = info->src.format == info->dst.format;
+   zs = util_format_is_depth_or_stencil(info->src.format);
+   integer = util_format_is_pure_integer(info->src.format) ||
+             util_format_is_pure_integer(info->dst.format);
+
+   if (zs) {
+      /* only whole depth/stencil copies */
+      if (!same_format ||
+          (info->mask & PIPE_MASK_ZS) != util_format_get_mask(info->src.format))
+         return FALSE;
+   }
+   else {
+      if ((info->mask & PIPE_MASK_RGBA) != PIPE_MASK_RGBA ||
+          util_format_is_depth_or_stencil(info->dst.format))
+         return FALSE;
+      if (!same_format &&
+          (integer ||
+           !src_desc->unpack_rgba_float ||
+           !dst_desc->pack_rgba_float))
+         return FALSE;
+   }
+
+   memset(&blit, 0, sizeof blit);
+   blit.src_format = info->src.format;
+   blit.dst_format = info->dst.format;
+   blit.src_width = dbox->width;
+   blit.src_height = dbox->height;
+   blit.width = dbox->width;
+   blit.height = dbox->height;
+   blit.block_size = util_format_get_blocksize(info->dst.format);
+   blit.scale_y = 1.0f;
+   blit.nr_samples = nr_samples;
+
+   if (dst->nr_samples <= 1 && !zs && !integer) {
+      if (!src_desc->unpack_rgba_float || !dst_desc->pack_rgba_float)
+         return FALSE;
+      blit.op = LP_BLIT_OP_RESOLVE;
+   }
+   else {
+      blit.op = same_format ? LP_BLIT_OP_COPY : LP_BLIT_OP_CONVERT;
+      if (dst->nr_samples > 1)
+         depth = nr_samples;
+   }
+
+   if (blit.op == LP_BLIT_OP_CONVERT) {
+      src_x0 = MALLOC(dbox->width * sizeof(unsigned));
+      if (!src_x0)
+         return FALSE;
+      for (x = 0; x < (unsigned)dbox->width; x++)
+         src_x0[x] = x;
+      blit.src_x0 = src_x0;
+   }
+
+   blit.src = pipe->transfer_map(pipe, src, info->src.level,
+                                 PIPE_TRANSFER_READ,
+                                 sbox, &src_trans);
+   if (!blit.src) {
+      FREE(src_x0);
+      return FALSE;
+   }
+
+   blit.dst = pipe->transfer_map(pipe, dst, info->dst.level,
+                                 PIPE_TRANSFER_WRITE,
+                                 dbox, &dst_trans);
+   if (!blit.dst) {
+      pipe->transfer_unmap(pipe, src_trans);
+      FREE(src_x0);
+      return FALSE;
+   }
+
+   blit.src_stride = src_trans->stride;
+   blit.src_sample_stride = llvmpipe_resource(src)->sample_stride;
+   blit.dst_stride = dst_trans->stride;
+   if (depth > 1) {
+      blit.src_layer_stride = blit.src_sample_stride;
+      blit.dst_layer_stride = llvmpipe_resource(dst)->sample_stride;
+   }
+
+   run_blit_job(lp, &blit, depth);
+
+   pipe->transfer_unmap(pipe, dst_trans);
+   pipe->transfer_unmap(pipe, src_trans);
+   FREE(src_x0);
+
+   return TRUE;
+}
@@ -0,0 +1,76 @@
+/**************************************************************************
+ *
+ * Copyright 2017 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#ifndef LP_BLIT_H
+#define LP_BLIT_H
+
+#include "pipe/p_compiler.h"
+
+struct llvmpipe_context;
+struct pipe_blit_info;
+struct pipe_box;
+struct pipe_resource;
+struct pipe_surface;
+union pipe_color_union;
+
+
+boolean
+llvmpipe_direct_blit(struct llvmpipe_context *lp,
+                     const struct pipe_blit_info *info);
+
+boolean
+llvmpipe_direct_copy_region(struct llvmpipe_context *lp,
+                            struct pipe_resource *dst, unsigned dst_level,
+                            unsigned dstx, unsigned dsty, unsigned dstz,
+                            struct pipe_resource *src, unsigned src_level,
+                            const struct pipe_box *src_box);
+
+boolean
+llvmpipe_direct_clear_color(struct llvmpipe_context *lp,
+                            struct pipe_surface *dst,
+                            const union pipe_color_union *color,
+                            unsigned dstx, unsigned dsty,
+                            unsigned width, unsigned height);
+
+boolean
+llvmpipe_direct_clear_depth_stencil(struct llvmpipe_context *lp,
+                                    struct pipe_surface *dst,
+                                    unsigned clear_flags,
+                                    double depth, unsigned stencil,
+                                    unsigned dstx, unsigned dsty,
+                                    unsigned width, unsigned height);
+
+boolean
+llvmpipe_direct_resolve(struct llvmpipe_context *lp,
+                        const struct pipe_blit_info *info);
+
+void
+llvmpipe_resolve_row_unorm8(uint8_t *dst, const uint8_t *src,
+                            unsigned sample_stride, unsigned bytes);
+
+
+#endif /* LP_BLIT_H */
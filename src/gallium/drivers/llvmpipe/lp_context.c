@@ -43,8 +43,10 @@
 #include "lp_flush.h"
 #include "lp_perf.h"
 #include "lp_state.h"
+#include "lp_state_cs.h"
 #include "lp_surface.h"
 #include "lp_query.h"
+#include "lp_rast.h"
 #include "lp_setup.h"
 
 /* This is only safe if there's just one concurrent context */
@@ -95,6 +97,12 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
       }
    }
 
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->ssbos); i++) {
+      for (j = 0; j < ARRAY_SIZE(llvmpipe->ssbos[i]); j++) {
+         pipe_resource_reference(&llvmpipe->ssbos[i][j].buffer, NULL);
+      }
+   }
+
    for (i = 0; i < llvmpipe->num_vertex_buffers; i++) {
       pipe_vertex_buffer_unreference(&llvmpipe->vertex_buffer[i]);
    }
@@ -131,6 +139,27 @@ llvmpipe_render_condition(struct pipe_context *pipe,
    llvmpipe->render_cond_cond = condition;
 }
 
+
+/**
+ * Sample positions in [0,1] pixel units, matching the rasterizer's
+ * lp_sample_pos_4x table.
+ */
+static void
+llvmpipe_get_sample_position(struct pipe_context *pipe,
+                             unsigned sample_count,
+                             unsigned sample_index,
+                             float *out_value)
+{
+   if (sample_count == LP_MAX_SAMPLES && sample_index < LP_MAX_SAMPLES) {
+      out_value[0] = lp_sample_pos_4x[sample_index][0] / 8.0f + 0.5f;
+      out_value[1] = lp_sample_pos_4x[sample_index][1] / 8.0f + 0.5f;
+   }
+   else {
+      out_value[0] = 0.5f;
+      out_value[1] = 0.5f;
+   }
+}
+
 struct pipe_context *
 llvmpipe_create_context(struct pipe_screen *screen, void *priv,
                         unsigned flags)
@@ -160,6 +189,7 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    llvmpipe->pipe.flush = do_flush;
 
    llvmpipe->pipe.render_condition = llvmpipe_render_condition;
+   llvmpipe->pipe.get_sample_position = llvmpipe_get_sample_position;
 
    llvmpipe_init_blend_funcs(llvmpipe);
    llvmpipe_init_clip_funcs(llvmpipe);
@@ -171,6 +201,7 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    llvmpipe_init_fs_funcs(llvmpipe);
    llvmpipe_init_vs_funcs(llvmpipe);
    llvmpipe_init_gs_funcs(llvmpipe);
+   llvmpipe_init_compute_funcs(llvmpipe);
    llvmpipe_init_rasterizer_funcs(llvmpipe);
    llvmpipe_init_context_resource_funcs( &llvmpipe->pipe );
    llvmpipe_init_surface_functions(llvmpipe);
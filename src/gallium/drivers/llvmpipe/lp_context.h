@@ -48,6 +48,7 @@ struct draw_context;
 struct draw_stage;
 struct draw_vertex_shader;
 struct lp_fragment_shader;
+struct lp_compute_shader;
 struct lp_blend_state;
 struct lp_setup_context;
 struct lp_setup_variant;
@@ -67,6 +68,7 @@ struct llvmpipe_context {
    const struct lp_geometry_shader *gs;
    const struct lp_velems_state *velems;
    const struct lp_so_state *so;
+   struct lp_compute_shader *cs;
 
    /** Other rendering state */
    unsigned sample_mask;
@@ -74,6 +76,7 @@ struct llvmpipe_context {
    struct pipe_stencil_ref stencil_ref;
    struct pipe_clip_state clip;
    struct pipe_constant_buffer constants[PIPE_SHADER_TYPES][LP_MAX_TGSI_CONST_BUFFERS];
+   struct pipe_shader_buffer ssbos[PIPE_SHADER_TYPES][LP_MAX_TGSI_SHADER_BUFFERS];
    struct pipe_framebuffer_state framebuffer;
    struct pipe_poly_stipple poly_stipple;
    struct pipe_scissor_state scissors[PIPE_MAX_VIEWPORTS];
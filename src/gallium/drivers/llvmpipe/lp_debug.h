@@ -59,6 +59,9 @@ st_print_current(void);
 #define PERF_NO_BLEND       0x20  	/* disable blending */
 #define PERF_NO_DEPTH       0x40  	/* disable depth buffering entirely */
 #define PERF_NO_ALPHATEST   0x80  	/* disable alpha testing */
+#define PERF_NO_HIZ         0x100 	/* disable hierarchical z culling */
+#define PERF_NO_BLIT        0x200 	/* disable direct blit, copy and clear paths */
+#define PERF_NO_FASTCLEAR   0x400 	/* disable deferred color clears */
 
 
 extern int LP_PERF;
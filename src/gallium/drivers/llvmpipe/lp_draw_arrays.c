@@ -56,7 +56,7 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    struct llvmpipe_context *lp = llvmpipe_context(pipe);
    struct draw_context *draw = lp->draw;
    const void *mapped_indices = NULL;
-   unsigned i;
+   unsigned i, sh;
 
    if (!llvmpipe_check_render_cond(lp))
       return;
@@ -66,6 +66,15 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
       return;
    }
 
+   /* Sampled textures must not have clears pending */
+   for (sh = 0; sh < ARRAY_SIZE(lp->sampler_views); sh++) {
+      for (i = 0; i < lp->num_sampler_views[sh]; i++) {
+         struct pipe_sampler_view *view = lp->sampler_views[sh][i];
+         if (view && llvmpipe_resource(view->texture)->clear_pending)
+            llvmpipe_resource_resolve_clears(view->texture, FALSE);
+      }
+   }
+
    if (lp->dirty)
       llvmpipe_update_derived( lp );
 
@@ -39,6 +39,7 @@
 #include "gallivm/lp_bld_format.h"
 #include "lp_context.h"
 #include "lp_jit.h"
+#include "lp_state_cs.h"
 
 
 static void
@@ -82,6 +83,8 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
       elem_types[LP_JIT_TEXTURE_IMG_STRIDE] =
       elem_types[LP_JIT_TEXTURE_MIP_OFFSETS] =
          LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TEXTURE_LEVELS);
+      elem_types[LP_JIT_TEXTURE_NUM_SAMPLES] =
+      elem_types[LP_JIT_TEXTURE_SAMPLE_STRIDE] = LLVMInt32TypeInContext(lc);
 
       texture_type = LLVMStructTypeInContext(lc, elem_types,
                                              ARRAY_SIZE(elem_types), 0);
@@ -113,6 +116,12 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
       LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, mip_offsets,
                              gallivm->target, texture_type,
                              LP_JIT_TEXTURE_MIP_OFFSETS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, num_samples,
+                             gallivm->target, texture_type,
+                             LP_JIT_TEXTURE_NUM_SAMPLES);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, sample_stride,
+                             gallivm->target, texture_type,
+                             LP_JIT_TEXTURE_SAMPLE_STRIDE);
       LP_CHECK_STRUCT_SIZE(struct lp_jit_texture,
                            gallivm->target, texture_type);
    }
@@ -253,3 +262,45 @@ lp_jit_init_types(struct lp_fragment_shader_variant *lp)
    if (!lp->jit_context_ptr_type)
       lp_jit_create_types(lp);
 }
+
+
+void
+lp_jit_init_cs_types(struct lp_compute_shader_variant *lp)
+{
+   struct gallivm_state *gallivm = lp->gallivm;
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef elem_types[LP_JIT_CS_CTX_COUNT];
+   LLVMTypeRef context_type;
+
+   if (lp->jit_context_ptr_type)
+      return;
+
+   elem_types[LP_JIT_CS_CTX_CONSTANTS] =
+      LLVMArrayType(LLVMPointerType(LLVMFloatTypeInContext(lc), 0), LP_MAX_TGSI_CONST_BUFFERS);
+   elem_types[LP_JIT_CS_CTX_NUM_CONSTANTS] =
+      LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TGSI_CONST_BUFFERS);
+   elem_types[LP_JIT_CS_CTX_SSBOS] =
+      LLVMArrayType(LLVMPointerType(LLVMInt32TypeInContext(lc), 0), LP_MAX_TGSI_SHADER_BUFFERS);
+   elem_types[LP_JIT_CS_CTX_NUM_SSBOS] =
+      LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TGSI_SHADER_BUFFERS);
+
+   context_type = LLVMStructTypeInContext(lc, elem_types,
+                                          ARRAY_SIZE(elem_types), 0);
+
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, constants,
+                          gallivm->target, context_type,
+                          LP_JIT_CS_CTX_CONSTANTS);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, num_constants,
+                          gallivm->target, context_type,
+                          LP_JIT_CS_CTX_NUM_CONSTANTS);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, ssbos,
+                          gallivm->target, context_type,
+                          LP_JIT_CS_CTX_SSBOS);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, num_ssbos,
+                          gallivm->target, context_type,
+                          LP_JIT_CS_CTX_NUM_SSBOS);
+   LP_CHECK_STRUCT_SIZE(struct lp_jit_cs_context,
+                        gallivm->target, context_type);
+
+   lp->jit_context_ptr_type = LLVMPointerType(context_type, 0);
+}
@@ -45,6 +45,7 @@
 
 struct lp_build_format_cache;
 struct lp_fragment_shader_variant;
+struct lp_compute_shader_variant;
 struct llvmpipe_screen;
 
 
@@ -59,6 +60,8 @@ struct lp_jit_texture
    uint32_t row_stride[LP_MAX_TEXTURE_LEVELS];
    uint32_t img_stride[LP_MAX_TEXTURE_LEVELS];
    uint32_t mip_offsets[LP_MAX_TEXTURE_LEVELS];
+   uint32_t num_samples;
+   uint32_t sample_stride;
 };
 
 
@@ -88,6 +91,8 @@ enum {
    LP_JIT_TEXTURE_ROW_STRIDE,
    LP_JIT_TEXTURE_IMG_STRIDE,
    LP_JIT_TEXTURE_MIP_OFFSETS,
+   LP_JIT_TEXTURE_NUM_SAMPLES,
+   LP_JIT_TEXTURE_SAMPLE_STRIDE,
    LP_JIT_TEXTURE_NUM_FIELDS  /* number of fields above */
 };
 
@@ -233,10 +238,12 @@ enum {
  * @param dady          shader input dady
  * @param color         color buffer
  * @param depth         depth buffer
- * @param mask          mask of visible pixels in block
+ * @param mask          mask of visible pixels in block, 16 bits per sample
  * @param thread_data   task thread data
  * @param stride        color buffer row stride in bytes
  * @param depth_stride  depth buffer row stride in bytes
+ * @param sample_stride color buffer sample stride in bytes
+ * @param depth_sample_stride  depth buffer sample stride in bytes
  */
 typedef void
 (*lp_jit_frag_func)(const struct lp_jit_context *context,
@@ -248,10 +255,87 @@ typedef void
                     const void *dady,
                     uint8_t **color,
                     uint8_t *depth,
-                    uint32_t mask,
+                    uint64_t mask,
                     struct lp_jit_thread_data *thread_data,
                     unsigned *stride,
-                    unsigned depth_stride);
+                    unsigned depth_stride,
+                    unsigned *sample_stride,
+                    unsigned depth_sample_stride);
+
+
+/**
+ * This structure is passed directly to the generated compute shader.
+ *
+ * Changes here must be reflected in the lp_jit_cs_context_* macros and
+ * lp_jit_init_cs_types function. Changes to the ordering should be avoided.
+ */
+struct lp_jit_cs_context
+{
+   const float *constants[LP_MAX_TGSI_CONST_BUFFERS];
+   int num_constants[LP_MAX_TGSI_CONST_BUFFERS];
+
+   uint32_t *ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   int num_ssbos[LP_MAX_TGSI_SHADER_BUFFERS];   /**< in bytes */
+};
+
+
+/**
+ * These enum values must match the position of the fields in the
+ * lp_jit_cs_context struct above.
+ */
+enum {
+   LP_JIT_CS_CTX_CONSTANTS = 0,
+   LP_JIT_CS_CTX_NUM_CONSTANTS,
+   LP_JIT_CS_CTX_SSBOS,
+   LP_JIT_CS_CTX_NUM_SSBOS,
+   LP_JIT_CS_CTX_COUNT
+};
+
+
+#define lp_jit_cs_context_constants(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_CONSTANTS, "constants")
+
+#define lp_jit_cs_context_num_constants(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_NUM_CONSTANTS, "num_constants")
+
+#define lp_jit_cs_context_ssbos(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_SSBOS, "ssbos")
+
+#define lp_jit_cs_context_num_ssbos(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_NUM_SSBOS, "num_ssbos")
+
+
+/**
+ * typedef for compute shader function
+ *
+ * Runs one vector of invocations of a work group, starting at the
+ * first_invocation linear index within the group.
+ *
+ * @param context       jit context
+ * @param block_id_x    work group id
+ * @param grid_size_x   number of work groups
+ * @param block_size_x  work group size
+ * @param first_invocation  linear index of the first invocation
+ * @param shared        work group shared memory
+ * @param temps         storage for the temporaries if the shader has barriers
+ * @param resume_index  barrier to resume at, zero to start
+ * @return  index of the barrier the invocations stopped at, zero when done
+ */
+typedef uint32_t
+(*lp_jit_cs_func)(const struct lp_jit_cs_context *context,
+                  uint32_t block_id_x,
+                  uint32_t block_id_y,
+                  uint32_t block_id_z,
+                  uint32_t grid_size_x,
+                  uint32_t grid_size_y,
+                  uint32_t grid_size_z,
+                  uint32_t block_size_x,
+                  uint32_t block_size_y,
+                  uint32_t block_size_z,
+                  uint32_t first_invocation,
+                  uint8_t *shared,
+                  void *temps,
+                  uint32_t resume_index);
 
 
 void
@@ -266,4 +350,8 @@ void
 lp_jit_init_types(struct lp_fragment_shader_variant *lp);
 
 
+void
+lp_jit_init_cs_types(struct lp_compute_shader_variant *lp);
+
+
 #endif /* LP_JIT_H */
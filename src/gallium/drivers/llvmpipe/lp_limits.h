@@ -64,6 +64,13 @@
 #define LP_MAX_THREADS 16
 
 
+/**
+ * Max number of samples per pixel for multisampled surfaces.  Only 4x
+ * multisampling is supported.
+ */
+#define LP_MAX_SAMPLES 4
+
+
 /**
  * Max bytes per scene.  This may be replaced by a runtime parameter.
  */
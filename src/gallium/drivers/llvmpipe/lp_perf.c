@@ -50,6 +50,7 @@ lp_print_counters(void)
 
       debug_printf("llvmpipe: nr_triangles:                 %9u\n", lp_count.nr_tris);
       debug_printf("llvmpipe: nr_culled_triangles:          %9u\n", lp_count.nr_culled_tris);
+      debug_printf("llvmpipe: nr_mask_triangles:            %9u\n", lp_count.nr_mask_tris);
 
       total_64 = (lp_count.nr_empty_64 + 
                   lp_count.nr_fully_covered_64 +
@@ -98,7 +99,13 @@ lp_print_counters(void)
       debug_printf("llvmpipe:   nr_empty_4x4:               %9u (%3.0f%% of %u)\n", lp_count.nr_empty_4, p1, total_4);
       debug_printf("llvmpipe:   nr_non_empty_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_non_empty_4, p4, total_4);
 
+      debug_printf("llvmpipe: nr_hiz_culled_64x64:          %9u\n", lp_count.nr_hiz_culled_64);
+      debug_printf("llvmpipe: nr_hiz_culled_16x16:          %9u\n", lp_count.nr_hiz_culled_16);
+      debug_printf("llvmpipe: nr_hiz_culled_4x4:            %9u\n", lp_count.nr_hiz_culled_4);
+
       debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
+      debug_printf("llvmpipe: nr_color_tile_clear_deferred: %9u\n", lp_count.nr_color_tile_clear_deferred);
+      debug_printf("llvmpipe: nr_color_tile_clear_skipped:  %9u\n", lp_count.nr_color_tile_clear_skipped);
       debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
       debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
 
@@ -42,6 +42,7 @@ struct lp_counters
 {
    unsigned nr_tris;
    unsigned nr_culled_tris;
+   unsigned nr_mask_tris;      /**< tris binned as a single 4x4 mask */
    unsigned nr_empty_64;
    unsigned nr_fully_covered_64;
    unsigned nr_partially_covered_64;
@@ -56,10 +57,15 @@ struct lp_counters
    unsigned nr_fully_covered_4;
    unsigned nr_partially_covered_4;
    unsigned nr_non_empty_4;
+   unsigned nr_hiz_culled_64;
+   unsigned nr_hiz_culled_16;
+   unsigned nr_hiz_culled_4;
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
 
    unsigned nr_color_tile_clear;
+   unsigned nr_color_tile_clear_deferred;
+   unsigned nr_color_tile_clear_skipped;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
 };
@@ -68,6 +74,38 @@ struct lp_counters
 extern struct lp_counters lp_count;
 
 
+/**
+ * Counters exported as driver queries, see lp_query.c.  Unlike the
+ * above they are always collected.
+ *
+ * The setup ones are kept per context in lp_setup_context::counters,
+ * the rasterizer ones per thread in lp_rasterizer_task::counters, only
+ * written by the thread owning them.  Times are in nanoseconds.
+ */
+enum lp_counter
+{
+   /* setup */
+   LP_COUNTER_PRIMS_BINNED,
+   LP_COUNTER_PRIMS_CULLED,
+   LP_COUNTER_SCENES,
+   LP_COUNTER_SCENE_MEMORY,     /**< bytes of bin data in flushed scenes */
+   LP_COUNTER_SETUP_TIME,       /**< in vbuf draw calls, binning included */
+   LP_COUNTER_RAST_TIME,        /**< waiting for scenes to be rasterized */
+
+   /* rasterizer */
+   LP_COUNTER_BINS,
+   LP_COUNTER_BLOCKS_SHADED,
+   LP_COUNTER_BLOCKS_REJECTED,  /**< by hierarchical z, before shading */
+   LP_COUNTER_FRAGMENTS_SHADED,
+   LP_COUNTER_SHADER_TIME,      /**< only while a query of it is active */
+   LP_COUNTER_BUSY_TIME,        /**< rasterizing scenes */
+
+   LP_COUNTER_TYPES
+};
+
+#define LP_COUNTER_FIRST_RAST LP_COUNTER_BINS
+
+
 /** Increment the named counter (only for debug builds) */
 #ifdef DEBUG
 #define LP_COUNT(counter) lp_count.counter++
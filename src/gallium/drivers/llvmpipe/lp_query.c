@@ -34,6 +34,7 @@
 #include "pipe/p_defines.h"
 #include "util/u_memory.h"
 #include "util/os_time.h"
+#include "util/macros.h"
 #include "lp_context.h"
 #include "lp_flush.h"
 #include "lp_fence.h"
@@ -48,6 +49,82 @@ static struct llvmpipe_query *llvmpipe_query( struct pipe_query *p )
    return (struct llvmpipe_query *)p;
 }
 
+
+static const struct {
+   const char *name;
+   enum pipe_driver_query_type type;
+} counter_info[LP_COUNTER_TYPES] = {
+   [LP_COUNTER_PRIMS_BINNED] = { "prims-binned", PIPE_DRIVER_QUERY_TYPE_UINT64 },
+   [LP_COUNTER_PRIMS_CULLED] = { "prims-culled", PIPE_DRIVER_QUERY_TYPE_UINT64 },
+   [LP_COUNTER_SCENES] = { "scenes", PIPE_DRIVER_QUERY_TYPE_UINT64 },
+   [LP_COUNTER_SCENE_MEMORY] = { "scene-memory", PIPE_DRIVER_QUERY_TYPE_BYTES },
+   [LP_COUNTER_SETUP_TIME] = { "setup-time", PIPE_DRIVER_QUERY_TYPE_MICROSECONDS },
+   [LP_COUNTER_RAST_TIME] = { "rast-time", PIPE_DRIVER_QUERY_TYPE_MICROSECONDS },
+   [LP_COUNTER_BINS] = { "bins", PIPE_DRIVER_QUERY_TYPE_UINT64 },
+   [LP_COUNTER_BLOCKS_SHADED] = { "blocks-shaded", PIPE_DRIVER_QUERY_TYPE_UINT64 },
+   [LP_COUNTER_BLOCKS_REJECTED] = { "blocks-rejected", PIPE_DRIVER_QUERY_TYPE_UINT64 },
+   [LP_COUNTER_FRAGMENTS_SHADED] = { "fragments-shaded", PIPE_DRIVER_QUERY_TYPE_UINT64 },
+   [LP_COUNTER_SHADER_TIME] = { "shader-time", PIPE_DRIVER_QUERY_TYPE_MICROSECONDS },
+   [LP_COUNTER_BUSY_TIME] = { "busy-time", PIPE_DRIVER_QUERY_TYPE_MICROSECONDS },
+};
+
+static const char *thread_busy_names[] = {
+   "thread0-busy", "thread1-busy", "thread2-busy", "thread3-busy",
+   "thread4-busy", "thread5-busy", "thread6-busy", "thread7-busy",
+   "thread8-busy", "thread9-busy", "thread10-busy", "thread11-busy",
+   "thread12-busy", "thread13-busy", "thread14-busy", "thread15-busy",
+};
+
+
+static boolean
+is_driver_query(unsigned type)
+{
+   return type >= LP_QUERY_FIRST_COUNTER && type < LP_QUERY_END;
+}
+
+
+/**
+ * Read the current value of the counter behind a driver query.
+ */
+static uint64_t
+read_driver_query(struct llvmpipe_context *llvmpipe, unsigned type)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(llvmpipe->pipe.screen);
+   enum lp_counter counter = LP_COUNTER_BUSY_TIME;
+   int thread_index = -1;
+   uint64_t value;
+
+   if (type >= LP_QUERY_FIRST_THREAD_BUSY)
+      thread_index = type - LP_QUERY_FIRST_THREAD_BUSY;
+   else
+      counter = type - LP_QUERY_FIRST_COUNTER;
+
+   if (counter < LP_COUNTER_FIRST_RAST)
+      return lp_setup_get_counter(llvmpipe->setup, counter);
+
+   /* the threads only update their counters while holding the mutex */
+   mtx_lock(&screen->rast_mutex);
+   value = lp_rast_get_counter(screen->rast, thread_index, counter);
+   mtx_unlock(&screen->rast_mutex);
+
+   return value;
+}
+
+
+static boolean
+is_time_query(unsigned type)
+{
+   switch (type) {
+   case LP_QUERY_FIRST_COUNTER + LP_COUNTER_SETUP_TIME:
+   case LP_QUERY_FIRST_COUNTER + LP_COUNTER_RAST_TIME:
+   case LP_QUERY_FIRST_COUNTER + LP_COUNTER_SHADER_TIME:
+   case LP_QUERY_FIRST_COUNTER + LP_COUNTER_BUSY_TIME:
+      return TRUE;
+   default:
+      return type >= LP_QUERY_FIRST_THREAD_BUSY;
+   }
+}
+
 static struct pipe_query *
 llvmpipe_create_query(struct pipe_context *pipe, 
                       unsigned type,
@@ -55,7 +132,7 @@ llvmpipe_create_query(struct pipe_context *pipe,
 {
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES || is_driver_query(type));
 
    pq = CALLOC_STRUCT( llvmpipe_query );
 
@@ -118,6 +195,13 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
     */
    *result = 0;
 
+   if (is_driver_query(pq->type)) {
+      *result = pq->end[0] - pq->start[0];
+      if (is_time_query(pq->type))
+         *result /= 1000;
+      return TRUE;
+   }
+
    switch (pq->type) {
    case PIPE_QUERY_OCCLUSION_COUNTER:
       for (i = 0; i < num_threads; i++) {
@@ -192,6 +276,13 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (is_driver_query(pq->type)) {
+      if (pq->type == LP_QUERY_FIRST_COUNTER + LP_COUNTER_SHADER_TIME)
+         lp_setup_set_shader_timing(llvmpipe->setup, TRUE);
+      pq->start[0] = read_driver_query(llvmpipe, pq->type);
+      return true;
+   }
+
    /* Check if the query is already in the scene.  If so, we need to
     * flush the scene now.  Real apps shouldn't re-use a query in a
     * frame of rendering.
@@ -249,6 +340,14 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (is_driver_query(pq->type)) {
+      /* work still binned is only accounted when its scene is flushed */
+      pq->end[0] = read_driver_query(llvmpipe, pq->type);
+      if (pq->type == LP_QUERY_FIRST_COUNTER + LP_COUNTER_SHADER_TIME)
+         lp_setup_set_shader_timing(llvmpipe->setup, FALSE);
+      return true;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -291,6 +390,8 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
          llvmpipe->pipeline_statistics.c_primitives - pq->stats.c_primitives;
       pq->stats.ps_invocations =
          llvmpipe->pipeline_statistics.ps_invocations - pq->stats.ps_invocations;
+      pq->stats.cs_invocations =
+         llvmpipe->pipeline_statistics.cs_invocations - pq->stats.cs_invocations;
 
       llvmpipe->active_statistics_queries--;
       break;
@@ -328,6 +429,66 @@ llvmpipe_check_render_cond(struct llvmpipe_context *lp)
       return TRUE;
 }
 
+/**
+ * Describe the driver specific queries, for the HUD and
+ * GL_AMD_performance_monitor.
+ */
+int
+llvmpipe_get_driver_query_info(struct pipe_screen *_screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+   const unsigned num_threads = MAX2(screen->num_threads, 1);
+
+   STATIC_ASSERT(ARRAY_SIZE(thread_busy_names) == LP_MAX_THREADS);
+
+   if (!info)
+      return LP_COUNTER_TYPES + num_threads;
+
+   if (index >= LP_COUNTER_TYPES + num_threads)
+      return 0;
+
+   memset(info, 0, sizeof *info);
+   info->query_type = LP_QUERY_FIRST_COUNTER + index;
+   info->result_type = PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE;
+   info->group_id = 0;
+
+   if (index < LP_COUNTER_TYPES) {
+      info->name = counter_info[index].name;
+      info->type = counter_info[index].type;
+   }
+   else {
+      info->name = thread_busy_names[index - LP_COUNTER_TYPES];
+      info->type = PIPE_DRIVER_QUERY_TYPE_MICROSECONDS;
+   }
+
+   return 1;
+}
+
+
+int
+llvmpipe_get_driver_query_group_info(struct pipe_screen *_screen,
+                                     unsigned index,
+                                     struct pipe_driver_query_group_info *info)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+   const unsigned num_queries =
+      LP_COUNTER_TYPES + MAX2(screen->num_threads, 1);
+
+   if (!info)
+      return 1;
+
+   if (index >= 1)
+      return 0;
+
+   info->name = "llvmpipe";
+   info->max_active_queries = num_queries;
+   info->num_queries = num_queries;
+   return 1;
+}
+
+
 static void
 llvmpipe_set_active_query_state(struct pipe_context *pipe, boolean enable)
 {
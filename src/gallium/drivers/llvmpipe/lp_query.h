@@ -35,10 +35,22 @@
 
 #include <limits.h>
 #include "os/os_thread.h"
+#include "pipe/p_defines.h"
 #include "lp_limits.h"
+#include "lp_perf.h"
 
 
 struct llvmpipe_context;
+struct pipe_screen;
+
+
+/**
+ * Driver specific queries: the counters of enum lp_counter, followed by
+ * the busy time of each rasterizer thread.
+ */
+#define LP_QUERY_FIRST_COUNTER      PIPE_QUERY_DRIVER_SPECIFIC
+#define LP_QUERY_FIRST_THREAD_BUSY  (LP_QUERY_FIRST_COUNTER + LP_COUNTER_TYPES)
+#define LP_QUERY_END                (LP_QUERY_FIRST_THREAD_BUSY + LP_MAX_THREADS)
 
 
 struct llvmpipe_query {
@@ -57,4 +69,14 @@ extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
 extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *);
 
+extern int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info);
+
+extern int
+llvmpipe_get_driver_query_group_info(struct pipe_screen *screen,
+                                     unsigned index,
+                                     struct pipe_driver_query_group_info *info);
+
 #endif /* LP_QUERY_H */
@@ -33,6 +33,7 @@
 #include "util/u_pack_color.h"
 #include "util/u_string.h"
 #include "util/u_thread.h"
+#include "util/u_atomic.h"
 
 #include "util/os_time.h"
 
@@ -111,9 +112,12 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
 
    for (i = 0; i < task->scene->fb.nr_cbufs; i++) {
       if (task->scene->fb.cbufs[i]) {
+         unsigned x_bytes = scene->cbufs[i].format_bytes * task->x;
+         if (scene->cbufs[i].tiled)
+            x_bytes *= 4;
          task->color_tiles[i] = scene->cbufs[i].map +
                                 scene->cbufs[i].stride * task->y +
-                                scene->cbufs[i].format_bytes * task->x;
+                                x_bytes;
       }
    }
    if (task->scene->fb.zsbuf) {
@@ -121,6 +125,102 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
                          scene->zsbuf.stride * task->y +
                          scene->zsbuf.format_bytes * task->x;
    }
+
+   /*
+    * Nothing is known about the depth buffer contents at this point.
+    * Layered or multisampled rendering would need a set of bounds per layer
+    * or sample, don't bother.
+    */
+   task->hiz_enabled = scene->fb.zsbuf &&
+                       scene->fb_max_layer == 0 &&
+                       scene->nr_samples == 1 &&
+                       util_format_has_depth(util_format_description(scene->fb.zsbuf->format)) &&
+                       !(LP_PERF & PERF_NO_HIZ);
+   if (task->hiz_enabled) {
+      for (i = 0; i < LP_RAST_HIZ_BLOCKS; i++) {
+         task->hiz_zmax[i] = LP_RAST_HIZ_UNKNOWN;
+      }
+   }
+
+   /* pick up clears left pending by earlier scenes */
+   task->clear_pending = 0;
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->cbufs[i].clear_tiles) {
+         const struct llvmpipe_tile_clear *tc =
+            &scene->cbufs[i].clear_tiles[y * scene->tiles_x + x];
+         if (tc->pending) {
+            task->clear_pending |= 1 << i;
+            task->clear_color[i] = tc->color;
+         }
+      }
+   }
+}
+
+
+/**
+ * Fill the current tile of a color buffer with a packed color.
+ */
+static void
+lp_rast_fill_color_tile(struct lp_rasterizer_task *task,
+                        unsigned cbuf,
+                        union util_color *uc)
+{
+   const struct lp_scene *scene = task->scene;
+   enum pipe_format format = scene->fb.cbufs[cbuf]->format;
+   unsigned s;
+
+   for (s = 0; s < scene->nr_samples; s++) {
+      uint8_t *map = scene->cbufs[cbuf].map +
+                     s * scene->cbufs[cbuf].sample_stride;
+
+      if (scene->cbufs[cbuf].tiled) {
+         /*
+          * A row of tiles is contiguous, so fill the (padded) tile rows as
+          * if they were very long pixel rows.
+          */
+         util_fill_box(map,
+                       format,
+                       scene->cbufs[cbuf].stride * 4,
+                       scene->cbufs[cbuf].layer_stride,
+                       task->x * 4,
+                       task->y / 4,
+                       0,
+                       align(task->width, 4) * 4,
+                       align(task->height, 4) / 4,
+                       scene->fb_max_layer + 1,
+                       uc);
+      }
+      else {
+         util_fill_box(map,
+                       format,
+                       scene->cbufs[cbuf].stride,
+                       scene->cbufs[cbuf].layer_stride,
+                       task->x,
+                       task->y,
+                       0,
+                       task->width,
+                       task->height,
+                       scene->fb_max_layer + 1,
+                       uc);
+      }
+   }
+
+   /* this will increase for each rb which probably doesn't mean much */
+   LP_COUNT(nr_color_tile_clear);
+}
+
+
+/**
+ * Write out the deferred clears of the current tile, before anything
+ * else touches the color buffers.
+ */
+static void
+lp_rast_resolve_clears(struct lp_rasterizer_task *task)
+{
+   while (task->clear_pending) {
+      unsigned cbuf = u_bit_scan(&task->clear_pending);
+      lp_rast_fill_color_tile(task, cbuf, &task->clear_color[cbuf]);
+   }
 }
 
 
@@ -152,21 +252,70 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
    LP_DBG(DEBUG_RAST, "%s clear value (target format %d) raw 0x%x,0x%x,0x%x,0x%x\n",
           __FUNCTION__, format, uc.ui[0], uc.ui[1], uc.ui[2], uc.ui[3]);
 
+   if (scene->cbufs[cbuf].clear_tiles) {
+      /*
+       * Only remember the clear, it gets written out if the tile is drawn
+       * to, or recorded in the resource at the end of the tile.
+       */
+      task->clear_pending |= 1 << cbuf;
+      task->clear_color[cbuf] = uc;
+      LP_COUNT(nr_color_tile_clear_deferred);
+      return;
+   }
+
+   lp_rast_fill_color_tile(task, cbuf, &uc);
+}
 
-   util_fill_box(scene->cbufs[cbuf].map,
-                 format,
-                 scene->cbufs[cbuf].stride,
-                 scene->cbufs[cbuf].layer_stride,
-                 task->x,
-                 task->y,
-                 0,
-                 task->width,
-                 task->height,
-                 scene->fb_max_layer + 1,
-                 &uc);
 
-   /* this will increase for each rb which probably doesn't mean much */
-   LP_COUNT(nr_color_tile_clear);
+/**
+ * Set the hierarchical z bounds of the current tile after a depth/stencil
+ * clear.  Partial depth clears leave nothing known about the tile.
+ */
+static void
+lp_rast_hiz_clear(struct lp_rasterizer_task *task,
+                  uint64_t clear_value, uint64_t clear_mask)
+{
+   const struct util_format_description *desc =
+      util_format_description(task->scene->fb.zsbuf->format);
+   const struct util_format_channel_description *chan =
+      &desc->channel[desc->swizzle[0]];
+   uint64_t depth_mask;
+   union {
+      uint16_t ui16;
+      uint32_t ui32;
+      uint64_t ui64;
+   } packed;
+   float z;
+   unsigned i;
+
+   depth_mask = (chan->size >= 64 ? ~0ULL : ((1ULL << chan->size) - 1)) << chan->shift;
+
+   if (!(clear_mask & depth_mask)) {
+      /* stencil only clear */
+      return;
+   }
+
+   if ((clear_mask & depth_mask) == depth_mask) {
+      switch (desc->block.bits) {
+      case 16:
+         packed.ui16 = (uint16_t) clear_value;
+         break;
+      case 32:
+         packed.ui32 = (uint32_t) clear_value;
+         break;
+      default:
+         packed.ui64 = clear_value;
+         break;
+      }
+      desc->unpack_z_float(&z, 0, (const uint8_t *) &packed, 0, 1, 1);
+   }
+   else {
+      z = LP_RAST_HIZ_UNKNOWN;
+   }
+
+   for (i = 0; i < LP_RAST_HIZ_BLOCKS; i++) {
+      task->hiz_zmax[i] = z;
+   }
 }
 
 
@@ -199,14 +348,17 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
     */
 
    if (scene->fb.zsbuf) {
+      const unsigned num_layers = scene->fb_max_layer + 1;
       unsigned layer;
-      uint8_t *dst_layer = task->depth_tile;
       block_size = util_format_get_blocksize(scene->fb.zsbuf->format);
 
       clear_value &= clear_mask;
 
-      for (layer = 0; layer <= scene->fb_max_layer; layer++) {
-         dst = dst_layer;
+      /* all layers of all samples */
+      for (layer = 0; layer < num_layers * scene->nr_samples; layer++) {
+         dst = task->depth_tile +
+               (layer / num_layers) * scene->zsbuf.sample_stride +
+               (layer % num_layers) * scene->zsbuf.layer_stride;
 
          switch (block_size) {
          case 1:
@@ -279,7 +431,10 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
             assert(0);
             break;
          }
-         dst_layer += scene->zsbuf.layer_stride;
+      }
+
+      if (task->hiz_enabled) {
+         lp_rast_hiz_clear(task, arg.clear_zstencil.value, clear_mask64);
       }
    }
 }
@@ -300,6 +455,8 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    const struct lp_rast_state *state;
    struct lp_fragment_shader_variant *variant;
    const unsigned tile_x = task->x, tile_y = task->y;
+   unsigned hiz_culled = 0;
+   int64_t t0;
    unsigned x, y;
 
    if (inputs->disable) {
@@ -316,24 +473,63 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    }
    variant = state->variant;
 
+   /* the whole tile function can't leave samples out */
+   if (state->sample_mask != ~0ULL) {
+      for (y = 0; y < task->height; y += 4) {
+         for (x = 0; x < task->width; x += 4) {
+            lp_rast_shade_quads_mask_sample(task, inputs,
+                                            tile_x + x, tile_y + y, ~0ULL);
+         }
+      }
+      return;
+   }
+
+   if (lp_rast_hiz_cull(task, inputs, tile_x, tile_y, TILE_SIZE)) {
+      LP_COUNT(nr_hiz_culled_64);
+      task->counters[LP_COUNTER_BLOCKS_REJECTED] +=
+         (task->width / 4) * (task->height / 4);
+      return;
+   }
+
+   for (y = 0; y < task->height; y += LP_RAST_HIZ_BLOCK_SIZE) {
+      for (x = 0; x < task->width; x += LP_RAST_HIZ_BLOCK_SIZE) {
+         if (lp_rast_hiz_cull(task, inputs, tile_x + x, tile_y + y,
+                              LP_RAST_HIZ_BLOCK_SIZE)) {
+            LP_COUNT(nr_hiz_culled_16);
+            task->counters[LP_COUNTER_BLOCKS_REJECTED] +=
+               (LP_RAST_HIZ_BLOCK_SIZE / 4) * (LP_RAST_HIZ_BLOCK_SIZE / 4);
+            hiz_culled |= 1 << lp_rast_hiz_block(x, y);
+         }
+      }
+   }
+
    /* render the whole 64x64 tile in 4x4 chunks */
+   t0 = lp_rast_shader_time_begin(task);
    for (y = 0; y < task->height; y += 4){
       for (x = 0; x < task->width; x += 4) {
          uint8_t *color[PIPE_MAX_COLOR_BUFS];
          unsigned stride[PIPE_MAX_COLOR_BUFS];
+         unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
          uint8_t *depth = NULL;
          unsigned depth_stride = 0;
+         unsigned depth_sample_stride = 0;
          unsigned i;
 
+         if (hiz_culled & (1 << lp_rast_hiz_block(x, y))) {
+            continue;
+         }
+
          /* color buffer */
          for (i = 0; i < scene->fb.nr_cbufs; i++){
             if (scene->fb.cbufs[i]) {
-               stride[i] = scene->cbufs[i].stride;
+               stride[i] = lp_rast_get_color_block_stride(task, i);
+               sample_stride[i] = scene->cbufs[i].sample_stride;
                color[i] = lp_rast_get_color_block_pointer(task, i, tile_x + x,
                                                           tile_y + y, inputs->layer);
             }
             else {
                stride[i] = 0;
+               sample_stride[i] = 0;
                color[i] = NULL;
             }
          }
@@ -343,8 +539,12 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
             depth = lp_rast_get_depth_block_pointer(task, tile_x + x,
                                                     tile_y + y, inputs->layer);
             depth_stride = scene->zsbuf.stride;
+            depth_sample_stride = scene->zsbuf.sample_stride;
          }
 
+         task->counters[LP_COUNTER_BLOCKS_SHADED]++;
+         task->counters[LP_COUNTER_FRAGMENTS_SHADED] += 16;
+
          /* Propagate non-interpolated raster state. */
          task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
@@ -361,10 +561,20 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
                                             0xffff,
                                             &task->thread_data,
                                             stride,
-                                            depth_stride);
+                                            depth_stride,
+                                            sample_stride,
+                                            depth_sample_stride);
          END_JIT_CALL();
       }
    }
+   lp_rast_shader_time_end(task, t0);
+
+   /* the whole tile is covered, so every block's bound may be lowered */
+   for (y = 0; y < task->height; y += LP_RAST_HIZ_BLOCK_SIZE) {
+      for (x = 0; x < task->width; x += LP_RAST_HIZ_BLOCK_SIZE) {
+         lp_rast_hiz_update(task, inputs, tile_x + x, tile_y + y);
+      }
+   }
 }
 
 
@@ -384,6 +594,22 @@ lp_rast_shade_tile_opaque(struct lp_rasterizer_task *task,
       return;
    }
 
+   /*
+    * Opaque shaders write the single color buffer everywhere (there's no
+    * depth test, hence no hiz culling), so a pending clear is just dropped.
+    */
+   if (task->clear_pending) {
+      if (!arg.shade_tile->disable &&
+          !task->state->variant->hiz_reject &&
+          task->scene->fb.nr_cbufs == 1) {
+         task->clear_pending = 0;
+         LP_COUNT(nr_color_tile_clear_skipped);
+      }
+      else {
+         lp_rast_resolve_clears(task);
+      }
+   }
+
    lp_rast_shade_tile(task, arg);
 }
 
@@ -393,20 +619,40 @@ lp_rast_shade_tile_opaque(struct lp_rasterizer_task *task,
  * This is a bin command called during bin processing.
  * \param x  X position of quad in window coords
  * \param y  Y position of quad in window coords
+ * \param mask  coverage of the pixels, the same for all their samples
  */
 void
 lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          const struct lp_rast_shader_inputs *inputs,
                          unsigned x, unsigned y,
                          unsigned mask)
+{
+   lp_rast_shade_quads_mask_sample(task, inputs, x, y,
+                                   (uint64_t)mask * 0x0001000100010001ULL);
+}
+
+
+/**
+ * Compute shading for a 4x4 block of pixels with per sample coverage.
+ * Samples left out by the sample mask are dropped from the coverage.
+ * \param mask  coverage of sample n of the pixels in bits 16n to 16n+15
+ */
+void
+lp_rast_shade_quads_mask_sample(struct lp_rasterizer_task *task,
+                                const struct lp_rast_shader_inputs *inputs,
+                                unsigned x, unsigned y,
+                                uint64_t mask)
 {
    const struct lp_rast_state *state = task->state;
    struct lp_fragment_shader_variant *variant = state->variant;
    const struct lp_scene *scene = task->scene;
    uint8_t *color[PIPE_MAX_COLOR_BUFS];
    unsigned stride[PIPE_MAX_COLOR_BUFS];
+   unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth = NULL;
    unsigned depth_stride = 0;
+   unsigned depth_sample_stride = 0;
+   int64_t t0;
    unsigned i;
 
    assert(state);
@@ -420,15 +666,27 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
    assert((x % 4) == 0);
    assert((y % 4) == 0);
 
+   mask &= state->sample_mask;
+   if (!mask)
+      return;
+
+   if (lp_rast_hiz_cull(task, inputs, x, y, 4)) {
+      LP_COUNT(nr_hiz_culled_4);
+      task->counters[LP_COUNTER_BLOCKS_REJECTED]++;
+      return;
+   }
+
    /* color buffer */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i]) {
-         stride[i] = scene->cbufs[i].stride;
+         stride[i] = lp_rast_get_color_block_stride(task, i);
+         sample_stride[i] = scene->cbufs[i].sample_stride;
          color[i] = lp_rast_get_color_block_pointer(task, i, x, y,
                                                     inputs->layer);
       }
       else {
          stride[i] = 0;
+         sample_stride[i] = 0;
          color[i] = NULL;
       }
    }
@@ -436,6 +694,7 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
    /* depth buffer */
    if (scene->zsbuf.map) {
       depth_stride = scene->zsbuf.stride;
+      depth_sample_stride = scene->zsbuf.sample_stride;
       depth = lp_rast_get_depth_block_pointer(task, x, y, inputs->layer);
    }
 
@@ -449,11 +708,16 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
       /* not very accurate would need a popcount on the mask */
       /* always count this not worth bothering? */
       task->ps_invocations += 1 * variant->ps_inv_multiplier;
+      task->counters[LP_COUNTER_BLOCKS_SHADED]++;
+      task->counters[LP_COUNTER_FRAGMENTS_SHADED] +=
+         util_bitcount((unsigned) (mask | mask >> 16 | mask >> 32 | mask >> 48) &
+                       0xffff);
 
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
       /* run shader on 4x4 block */
+      t0 = lp_rast_shader_time_begin(task);
       BEGIN_JIT_CALL(state, task);
       variant->jit_function[RAST_EDGE_TEST](&state->jit_context,
                                             x, y,
@@ -466,8 +730,11 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                                             mask,
                                             &task->thread_data,
                                             stride,
-                                            depth_stride);
+                                            depth_stride,
+                                            sample_stride,
+                                            depth_sample_stride);
       END_JIT_CALL();
+      lp_rast_shader_time_end(task, t0);
    }
 }
 
@@ -538,7 +805,16 @@ void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg)
 {
+   unsigned i;
+
    task->state = arg.state;
+
+   if (task->hiz_enabled && task->state->variant->hiz_invalidate) {
+      /* depth values may grow from here on */
+      for (i = 0; i < LP_RAST_HIZ_BLOCKS; i++) {
+         task->hiz_zmax[i] = LP_RAST_HIZ_UNKNOWN;
+      }
+   }
 }
 
 
@@ -555,6 +831,19 @@ lp_rast_tile_end(struct lp_rasterizer_task *task)
       lp_rast_end_query(task, lp_rast_arg_query(task->scene->active_queries[i]));
    }
 
+   /* record which clears are still pending for later scenes and maps */
+   for (i = 0; i < task->scene->fb.nr_cbufs; i++) {
+      if (task->scene->cbufs[i].clear_tiles) {
+         struct llvmpipe_tile_clear *tc =
+            &task->scene->cbufs[i].clear_tiles[(task->y / TILE_SIZE) *
+                                               task->scene->tiles_x +
+                                               task->x / TILE_SIZE];
+         tc->pending = (task->clear_pending >> i) & 1;
+         if (tc->pending)
+            tc->color = task->clear_color[i];
+      }
+   }
+
    /* debug */
    memset(task->color_tiles, 0, sizeof(task->color_tiles));
    task->depth_tile = NULL;
@@ -592,10 +881,33 @@ static lp_rast_cmd_func dispatch[LP_RAST_OP_MAX] =
    lp_rast_triangle_32_8,
    lp_rast_triangle_32_3_4,
    lp_rast_triangle_32_3_16,
-   lp_rast_triangle_32_4_16
+   lp_rast_triangle_32_4_16,
+   lp_rast_triangle_mask
 };
 
 
+/**
+ * Whether a bin command may access the color buffers, which then must
+ * have their deferred clears written out.  Opaque tiles are handled by
+ * lp_rast_shade_tile_opaque() itself.
+ */
+static inline boolean
+cmd_accesses_color(unsigned cmd)
+{
+   switch (cmd) {
+   case LP_RAST_OP_CLEAR_COLOR:
+   case LP_RAST_OP_CLEAR_ZSTENCIL:
+   case LP_RAST_OP_SHADE_TILE_OPAQUE:
+   case LP_RAST_OP_BEGIN_QUERY:
+   case LP_RAST_OP_END_QUERY:
+   case LP_RAST_OP_SET_STATE:
+      return FALSE;
+   default:
+      return TRUE;
+   }
+}
+
+
 static void
 do_rasterize_bin(struct lp_rasterizer_task *task,
                  const struct cmd_bin *bin,
@@ -609,6 +921,8 @@ do_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (block = bin->head; block; block = block->next) {
       for (k = 0; k < block->count; k++) {
+         if (task->clear_pending && cmd_accesses_color(block->cmd[k]))
+            lp_rast_resolve_clears(task);
          dispatch[block->cmd[k]]( task, block->arg[k] );
       }
    }
@@ -628,6 +942,7 @@ rasterize_bin(struct lp_rasterizer_task *task,
 {
    lp_rast_tile_begin( task, bin, x, y );
 
+   task->counters[LP_COUNTER_BINS]++;
    do_rasterize_bin(task, bin, x, y);
 
    lp_rast_tile_end(task);
@@ -666,7 +981,10 @@ static void
 rasterize_scene(struct lp_rasterizer_task *task,
                 struct lp_scene *scene)
 {
+   int64_t t0 = os_time_get_nano();
+
    task->scene = scene;
+   task->shader_timing = scene->shader_timing;
 
    /* Clear the cache tags. This should not always be necessary but
       simpler for now. */
@@ -708,6 +1026,8 @@ rasterize_scene(struct lp_rasterizer_task *task,
    }
 #endif
 
+   task->counters[LP_COUNTER_BUSY_TIME] += os_time_get_nano() - t0;
+
    if (scene->fence) {
       lp_fence_signal(scene->fence);
    }
@@ -777,6 +1097,82 @@ lp_rast_finish( struct lp_rasterizer *rast )
 }
 
 
+/**
+ * Grab and run jobs until there are none left.
+ */
+static void
+run_jobs(struct lp_rasterizer *rast)
+{
+   unsigned job;
+
+   while ((job = p_atomic_inc_return(&rast->jobs.next) - 1) < rast->jobs.count)
+      rast->jobs.func(rast->jobs.data, job);
+}
+
+
+/**
+ * Run nr_jobs independent jobs on the rasterizer threads, and wait for
+ * their completion.  Used for work which doesn't go through a scene,
+ * like blits.
+ * The caller must hold the screen's rast_mutex.
+ */
+void
+lp_rast_run_jobs( struct lp_rasterizer *rast,
+                  lp_rast_job_func func,
+                  void *data,
+                  unsigned nr_jobs )
+{
+   unsigned i;
+
+   if (rast->num_threads == 0 || nr_jobs <= 1) {
+      for (i = 0; i < nr_jobs; i++)
+         func(data, i);
+      return;
+   }
+
+   rast->jobs.func = func;
+   rast->jobs.data = data;
+   rast->jobs.count = nr_jobs;
+   rast->jobs.next = 0;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      pipe_semaphore_signal(&rast->tasks[i].work_ready);
+   }
+
+   lp_rast_finish(rast);
+
+   rast->jobs.func = NULL;
+}
+
+
+/**
+ * Read a rasterizer counter of one thread, or the sum over all threads
+ * if thread_index is negative.
+ * Only meaningful while no scene is being rasterized.
+ */
+uint64_t
+lp_rast_get_counter( const struct lp_rasterizer *rast,
+                     int thread_index,
+                     enum lp_counter counter )
+{
+   const unsigned num_tasks = MAX2(rast->num_threads, 1);
+   uint64_t value = 0;
+   unsigned i;
+
+   assert(counter >= LP_COUNTER_FIRST_RAST && counter < LP_COUNTER_TYPES);
+
+   if (thread_index >= 0) {
+      assert(thread_index < num_tasks);
+      return rast->tasks[thread_index].counters[counter];
+   }
+
+   for (i = 0; i < num_tasks; i++)
+      value += rast->tasks[i].counters[counter];
+
+   return value;
+}
+
+
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
@@ -811,6 +1207,12 @@ thread_function(void *init_data)
       if (rast->exit_flag)
          break;
 
+      if (rast->jobs.func) {
+         run_jobs(rast);
+         pipe_semaphore_signal(&task->work_done);
+         continue;
+      }
+
       if (task->thread_index == 0) {
          /* thread[0]:
           *  - get next scene to rasterize
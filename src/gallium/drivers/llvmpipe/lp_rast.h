@@ -40,6 +40,7 @@
 #include "pipe/p_compiler.h"
 #include "util/u_pack_color.h"
 #include "lp_jit.h"
+#include "lp_perf.h"
 
 
 struct lp_rasterizer;
@@ -70,6 +71,42 @@ struct cmd_bin;
 
 #define IMUL64(a, b) (((int64_t)(a)) * ((int64_t)(b)))
 
+/**
+ * Standard 4x multisample positions, in 1/8 pixel units relative to the
+ * pixel center.  The pattern is point symmetric around the center.
+ */
+static const int8_t lp_sample_pos_4x[LP_MAX_SAMPLES][2] = {
+   { -1, -3 }, {  3, -1 }, { -3,  1 }, {  1,  3 }
+};
+
+/**
+ * Difference of an edge function between sample 's' and the pixel center.
+ * dcdx and dcdy are multiples of FIXED_ONE, so this is exact.
+ */
+static inline int32_t
+lp_rast_plane_sample_offset(int32_t dcdx, int32_t dcdy, unsigned s)
+{
+   return (dcdy / 8) * lp_sample_pos_4x[s][1] -
+          (dcdx / 8) * lp_sample_pos_4x[s][0];
+}
+
+/**
+ * Largest sample offset of an edge function.  Multisampled triangles have
+ * their planes' c biased by this amount, so that the pixel level tests
+ * find all pixels with at least one covered sample.  Since the sample
+ * pattern is symmetric, the smallest offset is just the negation.
+ */
+static inline int32_t
+lp_rast_plane_sample_max_offset(int32_t dcdx, int32_t dcdy)
+{
+   int32_t m = 0;
+   unsigned s;
+
+   for (s = 0; s < LP_MAX_SAMPLES; s++)
+      m = MAX2(m, lp_rast_plane_sample_offset(dcdx, dcdy, s));
+   return m;
+}
+
 struct lp_rasterizer_task;
 
 
@@ -88,6 +125,11 @@ struct lp_rast_state {
     * the tile color/z/stencil data somehow
      */
    struct lp_fragment_shader_variant *variant;
+
+   /* Samples enabled by the sample mask, expanded to the rasterizer's
+    * 16 bits of coverage per sample.  All ones when none are masked off.
+    */
+   uint64_t sample_mask;
 };
 
 
@@ -100,7 +142,8 @@ struct lp_rast_shader_inputs {
    unsigned frontfacing:1;      /** True for front-facing */
    unsigned disable:1;          /** Partially binned, disable this command */
    unsigned opaque:1;           /** Is opaque */
-   unsigned pad0:29;            /* wasted space */
+   unsigned multisample:1;      /** Planes are set up for per sample coverage */
+   unsigned pad0:28;            /* wasted space */
    unsigned stride;             /* how much to advance data between a0, dadx, dady */
    unsigned layer;              /* the layer to render to (from gs, already clamped) */
    unsigned viewport_index;     /* the active viewport index (from gs, already clamped) */
@@ -170,6 +213,23 @@ void
 lp_rast_finish( struct lp_rasterizer *rast );
 
 
+/**
+ * Function run by lp_rast_run_jobs() for each job index.
+ */
+typedef void (*lp_rast_job_func)( void *data, unsigned job );
+
+void
+lp_rast_run_jobs( struct lp_rasterizer *rast,
+                  lp_rast_job_func func,
+                  void *data,
+                  unsigned nr_jobs );
+
+uint64_t
+lp_rast_get_counter( const struct lp_rasterizer *rast,
+                     int thread_index,
+                     enum lp_counter counter );
+
+
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
    struct {
@@ -224,6 +284,22 @@ lp_rast_arg_triangle_contained( const struct lp_rast_triangle *triangle,
    return arg;
 }
 
+/**
+ * Build argument for a triangle whose coverage within a single 4x4
+ * stamp was already computed at setup time.  x, y are the tile-relative
+ * coordinates of the stamp, mask the 16-bit pixel coverage.
+ */
+static inline union lp_rast_cmd_arg
+lp_rast_arg_triangle_mask( const struct lp_rast_triangle *triangle,
+                           unsigned x, unsigned y, unsigned mask)
+{
+   union lp_rast_cmd_arg arg;
+   assert(mask <= 0xffff);
+   arg.triangle.tri = triangle;
+   arg.triangle.plane_mask = x | (y << 8) | (mask << 16);
+   return arg;
+}
+
 static inline union lp_rast_cmd_arg
 lp_rast_arg_state( const struct lp_rast_state *state )
 {
@@ -302,8 +378,9 @@ lp_rast_arg_null( void )
 #define LP_RAST_OP_TRIANGLE_32_3_4   0x1a
 #define LP_RAST_OP_TRIANGLE_32_3_16  0x1b
 #define LP_RAST_OP_TRIANGLE_32_4_16  0x1c
+#define LP_RAST_OP_TRIANGLE_MASK     0x1d
 
-#define LP_RAST_OP_MAX               0x1d
+#define LP_RAST_OP_MAX               0x1e
 #define LP_RAST_OP_MASK              0xff
 
 void
@@ -54,6 +54,7 @@ static const char *cmd_names[LP_RAST_OP_MAX] =
    "triangle_32_3_4",
    "triangle_32_3_16",
    "triangle_32_4_16",
+   "triangle_mask",
 };
 
 static const char *cmd_name(unsigned cmd)
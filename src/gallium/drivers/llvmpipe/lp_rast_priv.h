@@ -28,10 +28,14 @@
 #ifndef LP_RAST_PRIV_H
 #define LP_RAST_PRIV_H
 
+#include <float.h>
 #include "util/u_format.h"
+#include "util/u_math.h"
 #include "util/u_thread.h"
 #include "gallivm/lp_bld_debug.h"
 #include "lp_memory.h"
+#include "lp_perf.h"
+#include "util/os_time.h"
 #include "lp_rast.h"
 #include "lp_scene.h"
 #include "lp_state.h"
@@ -42,6 +46,21 @@
 #define TILE_VECTOR_HEIGHT 4
 #define TILE_VECTOR_WIDTH 4
 
+/*
+ * Hierarchical z: each task keeps a conservative upper bound of the depth
+ * values stored in every 16x16 block of its current tile.  Primitives
+ * whose nearest depth lies beyond that bound cannot pass a "less" depth
+ * test anywhere in the block, so the block is skipped without running
+ * the fragment shader.
+ */
+#define LP_RAST_HIZ_BLOCK_SIZE 16
+#define LP_RAST_HIZ_BLOCKS_PER_ROW (TILE_SIZE / LP_RAST_HIZ_BLOCK_SIZE)
+#define LP_RAST_HIZ_BLOCKS (LP_RAST_HIZ_BLOCKS_PER_ROW * LP_RAST_HIZ_BLOCKS_PER_ROW)
+#define LP_RAST_HIZ_UNKNOWN FLT_MAX
+
+/* Covers depth buffer quantization down to 16 bit unorm. */
+#define LP_RAST_HIZ_EPSILON (1.0f / 32768.0f)
+
 /* If we crash in a jitted function, we can examine jit_line and jit_state
  * to get some info.  This is not thread-safe, however.
  */
@@ -102,6 +121,18 @@ struct lp_rasterizer_task
    uint64_t ps_invocations;
    uint8_t ps_inv_multiplier;
 
+   /** Rasterizer counters, see enum lp_counter */
+   uint64_t counters[LP_COUNTER_TYPES];
+   boolean shader_timing;   /**< of the current scene */
+
+   /** Hierarchical z state for the current tile */
+   boolean hiz_enabled;
+   float hiz_zmax[LP_RAST_HIZ_BLOCKS];
+
+   /** Deferred color clears of the current tile, see lp_rast_clear_color() */
+   unsigned clear_pending;   /**< bitmask of color buffers */
+   union util_color clear_color[PIPE_MAX_COLOR_BUFS];
+
    pipe_semaphore work_ready;
    pipe_semaphore work_done;
 };
@@ -131,6 +162,16 @@ struct lp_rasterizer
 
    /** For synchronizing the rasterization threads */
    util_barrier barrier;
+
+   /** Generic jobs run by the threads instead of a scene, see
+    * lp_rast_run_jobs().
+    */
+   struct {
+      lp_rast_job_func func;
+      void *data;
+      unsigned count;
+      int32_t next;
+   } jobs;
 };
 
 
@@ -140,6 +181,12 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          unsigned x, unsigned y,
                          unsigned mask);
 
+void
+lp_rast_shade_quads_mask_sample(struct lp_rasterizer_task *task,
+                                const struct lp_rast_shader_inputs *inputs,
+                                unsigned x, unsigned y,
+                                uint64_t mask);
+
 
 /**
  * Get the pointer to a 4x4 color block (within a 64x64 tile).
@@ -169,8 +216,15 @@ lp_rast_get_color_block_pointer(struct lp_rasterizer_task *task,
    px = x % TILE_SIZE;
    py = y % TILE_SIZE;
 
-   pixel_offset = px * task->scene->cbufs[buf].format_bytes +
-                  py * task->scene->cbufs[buf].stride;
+   if (task->scene->cbufs[buf].tiled) {
+      /* the 4x4 block is exactly one tile */
+      pixel_offset = px * 4 * task->scene->cbufs[buf].format_bytes +
+                     py * task->scene->cbufs[buf].stride;
+   }
+   else {
+      pixel_offset = px * task->scene->cbufs[buf].format_bytes +
+                     py * task->scene->cbufs[buf].stride;
+   }
    color = task->color_tiles[buf] + pixel_offset;
 
    if (layer) {
@@ -182,6 +236,20 @@ lp_rast_get_color_block_pointer(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Get the row stride the fragment shader uses within 4x4 color blocks.
+ */
+static inline unsigned
+lp_rast_get_color_block_stride(const struct lp_rasterizer_task *task,
+                               unsigned buf)
+{
+   if (task->scene->cbufs[buf].tiled)
+      return 4 * task->scene->cbufs[buf].format_bytes;
+   else
+      return task->scene->cbufs[buf].stride;
+}
+
+
 /**
  * Get the pointer to a 4x4 depth block (within a 64x64 tile).
  * \param x, y location of 4x4 block in window coords
@@ -217,6 +285,121 @@ lp_rast_get_depth_block_pointer(struct lp_rasterizer_task *task,
 
 
 
+/**
+ * Index of the hierarchical z block containing window position x, y.
+ */
+static inline unsigned
+lp_rast_hiz_block(unsigned x, unsigned y)
+{
+   return ((y % TILE_SIZE) / LP_RAST_HIZ_BLOCK_SIZE) * LP_RAST_HIZ_BLOCKS_PER_ROW +
+          (x % TILE_SIZE) / LP_RAST_HIZ_BLOCK_SIZE;
+}
+
+
+/**
+ * Conservative range of the primitive's z plane over the size x size
+ * pixels starting at window position x, y.  The slack term accounts for
+ * the jit code evaluating the plane in a different order.
+ */
+static inline void
+lp_rast_hiz_tri_range(const struct lp_rast_shader_inputs *inputs,
+                      unsigned x, unsigned y, unsigned size,
+                      float *zmin, float *zmax)
+{
+   const float a0 = GET_A0(inputs)[0][2];
+   const float dzdx = GET_DADX(inputs)[0][2];
+   const float dzdy = GET_DADY(inputs)[0][2];
+   const float x0 = dzdx * (float) x;
+   const float x1 = dzdx * (float) (x + size - 1);
+   const float y0 = dzdy * (float) y;
+   const float y1 = dzdy * (float) (y + size - 1);
+   const float slack = (fabsf(a0) +
+                        MAX2(fabsf(x0), fabsf(x1)) +
+                        MAX2(fabsf(y0), fabsf(y1))) * (1.0f / (1 << 20));
+
+   *zmin = a0 + MIN2(x0, x1) + MIN2(y0, y1) - slack;
+   *zmax = a0 + MAX2(x0, x1) + MAX2(y0, y1) + slack;
+}
+
+
+/**
+ * Whether no fragment of the current primitive can pass the depth test
+ * within the size x size pixels at window position x, y.  The area is
+ * either the whole tile or lies within a single hierarchical z block.
+ */
+static inline boolean
+lp_rast_hiz_cull(const struct lp_rasterizer_task *task,
+                 const struct lp_rast_shader_inputs *inputs,
+                 unsigned x, unsigned y, unsigned size)
+{
+   float zmin, zmax, hiz_zmax = -FLT_MAX;
+   unsigned bx, by;
+
+   if (!task->hiz_enabled || !task->state->variant->hiz_reject)
+      return FALSE;
+
+   for (by = y; by < y + size; by += LP_RAST_HIZ_BLOCK_SIZE) {
+      for (bx = x; bx < x + size; bx += LP_RAST_HIZ_BLOCK_SIZE) {
+         hiz_zmax = MAX2(hiz_zmax, task->hiz_zmax[lp_rast_hiz_block(bx, by)]);
+      }
+   }
+
+   if (hiz_zmax == LP_RAST_HIZ_UNKNOWN)
+      return FALSE;
+
+   lp_rast_hiz_tri_range(inputs, x, y, size, &zmin, &zmax);
+
+   /* Fragment depth is clamped to [0,1] when converted to the buffer. */
+   return MIN2(zmin, 1.0f) > hiz_zmax + LP_RAST_HIZ_EPSILON;
+}
+
+
+/**
+ * Lower the depth bound of a 16x16 block which the current primitive
+ * fully covers.  Only called for variants which cannot discard fragments
+ * and only write depth values which are less than the stored ones.
+ */
+static inline void
+lp_rast_hiz_update(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   unsigned x, unsigned y)
+{
+   float zmin, zmax;
+   float *hiz_zmax;
+
+   if (!task->hiz_enabled || !task->state->variant->hiz_update)
+      return;
+
+   lp_rast_hiz_tri_range(inputs, x, y, LP_RAST_HIZ_BLOCK_SIZE, &zmin, &zmax);
+
+   /* written the other way around a NaN would turn into 0 */
+   if (zmax < 0.0f)
+      zmax = 0.0f;
+
+   hiz_zmax = &task->hiz_zmax[lp_rast_hiz_block(x, y)];
+   if (zmax < *hiz_zmax)
+      *hiz_zmax = zmax;
+}
+
+
+/**
+ * Start timing fragment shader calls, if asked for by the scene.
+ */
+static inline int64_t
+lp_rast_shader_time_begin(const struct lp_rasterizer_task *task)
+{
+   return task->shader_timing ? os_time_get_nano() : 0;
+}
+
+
+static inline void
+lp_rast_shader_time_end(struct lp_rasterizer_task *task, int64_t t0)
+{
+   if (task->shader_timing)
+      task->counters[LP_COUNTER_SHADER_TIME] += os_time_get_nano() - t0;
+}
+
+
 /**
  * Shade all pixels in a 4x4 block.  The fragment code omits the
  * triangle in/out tests.
@@ -232,19 +415,36 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
    struct lp_fragment_shader_variant *variant = state->variant;
    uint8_t *color[PIPE_MAX_COLOR_BUFS];
    unsigned stride[PIPE_MAX_COLOR_BUFS];
+   unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth = NULL;
    unsigned depth_stride = 0;
+   unsigned depth_sample_stride = 0;
+   int64_t t0;
    unsigned i;
 
+   /* the whole block function can't leave samples out */
+   if (state->sample_mask != ~0ULL) {
+      lp_rast_shade_quads_mask_sample(task, inputs, x, y, ~0ULL);
+      return;
+   }
+
+   if (lp_rast_hiz_cull(task, inputs, x, y, 4)) {
+      LP_COUNT(nr_hiz_culled_4);
+      task->counters[LP_COUNTER_BLOCKS_REJECTED]++;
+      return;
+   }
+
    /* color buffer */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i]) {
-         stride[i] = scene->cbufs[i].stride;
+         stride[i] = lp_rast_get_color_block_stride(task, i);
+         sample_stride[i] = scene->cbufs[i].sample_stride;
          color[i] = lp_rast_get_color_block_pointer(task, i, x, y,
                                                     inputs->layer);
       }
       else {
          stride[i] = 0;
+         sample_stride[i] = 0;
          color[i] = NULL;
       }
    }
@@ -252,6 +452,7 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
    if (scene->zsbuf.map) {
       depth = lp_rast_get_depth_block_pointer(task, x, y, inputs->layer);
       depth_stride = scene->zsbuf.stride;
+      depth_sample_stride = scene->zsbuf.sample_stride;
    }
 
    /*
@@ -262,11 +463,14 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
       /* not very accurate would need a popcount on the mask */
       /* always count this not worth bothering? */
       task->ps_invocations += 1 * variant->ps_inv_multiplier;
+      task->counters[LP_COUNTER_BLOCKS_SHADED]++;
+      task->counters[LP_COUNTER_FRAGMENTS_SHADED] += 16;
 
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
       /* run shader on 4x4 block */
+      t0 = lp_rast_shader_time_begin(task);
       BEGIN_JIT_CALL(state, task);
       variant->jit_function[RAST_WHOLE]( &state->jit_context,
                                          x, y,
@@ -279,8 +483,11 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
                                          0xffff,
                                          &task->thread_data,
                                          stride,
-                                         depth_stride);
+                                         depth_stride,
+                                         sample_stride,
+                                         depth_sample_stride);
       END_JIT_CALL();
+      lp_rast_shader_time_end(task, t0);
    }
 }
 
@@ -337,6 +544,9 @@ void lp_rast_triangle_32_3_16( struct lp_rasterizer_task *,
 void lp_rast_triangle_32_4_16( struct lp_rasterizer_task *, 
                             const union lp_rast_cmd_arg );
 
+void lp_rast_triangle_mask( struct lp_rasterizer_task *,
+                            const union lp_rast_cmd_arg );
+
 void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg);
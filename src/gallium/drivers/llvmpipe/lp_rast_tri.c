@@ -58,9 +58,18 @@ block_full_16(struct lp_rasterizer_task *task,
    unsigned ix, iy;
    assert(x % 16 == 0);
    assert(y % 16 == 0);
+
+   if (lp_rast_hiz_cull(task, &tri->inputs, x, y, 16)) {
+      LP_COUNT(nr_hiz_culled_16);
+      task->counters[LP_COUNTER_BLOCKS_REJECTED] += 16;
+      return;
+   }
+
    for (iy = 0; iy < 16; iy += 4)
       for (ix = 0; ix < 16; ix += 4)
 	 block_full_4(task, tri, x + ix, y + iy);
+
+   lp_rast_hiz_update(task, &tri->inputs, x, y);
 }
 
 static inline unsigned
@@ -133,6 +142,22 @@ lp_rast_triangle_4_16(struct lp_rasterizer_task *task,
    lp_rast_triangle_4(task, arg2);
 }
 
+/**
+ * Small triangle contained in a single 4x4 stamp, with coverage already
+ * computed during setup.  No planes are stored or evaluated.
+ */
+void
+lp_rast_triangle_mask(struct lp_rasterizer_task *task,
+                      const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   unsigned x = (arg.triangle.plane_mask & 0xff) + task->x;
+   unsigned y = ((arg.triangle.plane_mask >> 8) & 0xff) + task->y;
+   unsigned mask = arg.triangle.plane_mask >> 16;
+
+   lp_rast_shade_quads_mask(task, &tri->inputs, x, y, mask);
+}
+
 #if defined(PIPE_ARCH_SSE)
 
 #include <emmintrin.h>
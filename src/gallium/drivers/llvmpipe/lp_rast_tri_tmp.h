@@ -39,6 +39,51 @@
  * XXX: Need ways of dropping planes as we descend.
  * XXX: SIMD
  */
+/**
+ * Multisampled version of do_block_4: evaluate the planes at every sample
+ * position, the shader gets one coverage mask per sample.
+ */
+static void
+TAG(do_block_4_ms)(struct lp_rasterizer_task *task,
+                   const struct lp_rast_triangle *tri,
+                   const struct lp_rast_plane *plane,
+                   int x, int y,
+                   const int64_t *c)
+{
+   int64_t cs[NR_PLANES];
+   uint64_t mask = 0;
+   unsigned s;
+   int j;
+
+   /* undo the bias applied in setup */
+   for (j = 0; j < NR_PLANES; j++)
+      cs[j] = c[j] - lp_rast_plane_sample_max_offset(plane[j].dcdx,
+                                                     plane[j].dcdy);
+
+   for (s = 0; s < LP_MAX_SAMPLES; s++) {
+      unsigned smask = 0xffff;
+
+      for (j = 0; j < NR_PLANES; j++) {
+         int64_t cj = cs[j] + lp_rast_plane_sample_offset(plane[j].dcdx,
+                                                          plane[j].dcdy, s);
+#ifdef RASTER_64
+         smask &= ~BUILD_MASK_LINEAR(((cj - 1) >> (int64_t)FIXED_ORDER),
+                                     -plane[j].dcdx >> FIXED_ORDER,
+                                     plane[j].dcdy >> FIXED_ORDER);
+#else
+         smask &= ~BUILD_MASK_LINEAR((cj - 1),
+                                     -plane[j].dcdx,
+                                     plane[j].dcdy);
+#endif
+      }
+      mask |= (uint64_t)smask << (16 * s);
+   }
+
+   if (mask)
+      lp_rast_shade_quads_mask_sample(task, &tri->inputs, x, y, mask);
+}
+
+
 static void
 TAG(do_block_4)(struct lp_rasterizer_task *task,
                 const struct lp_rast_triangle *tri,
@@ -49,6 +94,11 @@ TAG(do_block_4)(struct lp_rasterizer_task *task,
    unsigned mask = 0xffff;
    int j;
 
+   if (tri->inputs.multisample) {
+      TAG(do_block_4_ms)(task, tri, plane, x, y, c);
+      return;
+   }
+
    for (j = 0; j < NR_PLANES; j++) {
 #ifdef RASTER_64
       mask &= ~BUILD_MASK_LINEAR(((c[j] - 1) >> (int64_t)FIXED_ORDER),
@@ -81,6 +131,11 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
    unsigned outmask, inmask, partmask, partial_mask;
    unsigned j;
 
+   if (lp_rast_hiz_cull(task, &tri->inputs, x, y, 16)) {
+      LP_COUNT(nr_hiz_culled_16);
+      return;
+   }
+
    outmask = 0;                 /* outside one or more trivial reject planes */
    partmask = 0;                /* outside one or more trivial accept planes */
 
@@ -191,6 +246,11 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       return;
    }
 
+   if (lp_rast_hiz_cull(task, &tri->inputs, x, y, TILE_SIZE)) {
+      LP_COUNT(nr_hiz_culled_64);
+      return;
+   }
+
    outmask = 0;                 /* outside one or more trivial reject planes */
    partmask = 0;                /* outside one or more trivial accept planes */
 
@@ -27,6 +27,7 @@
 
 #include "util/u_framebuffer.h"
 #include "util/u_math.h"
+#include "pipe/p_config.h"
 #include "util/u_memory.h"
 #include "util/u_inlines.h"
 #include "util/simple_list.h"
@@ -34,6 +35,11 @@
 #include "lp_scene.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
+#include "lp_screen.h"
+
+#if defined(PIPE_OS_LINUX)
+#include <sys/mman.h>
+#endif
 
 
 #define RESOURCE_REF_SZ 32
@@ -46,6 +52,190 @@ struct resource_ref {
 };
 
 
+/**
+ * Scene data blocks are recycled through a pool shared by all the scenes
+ * of a screen, instead of being malloc'ed and freed for every scene.
+ *
+ * Blocks are carved out of LP_SCENE_SLAB_SIZE slabs, aligned so that the
+ * kernel can back them with a transparent huge page, which saves page
+ * faults and TLB misses while binning.  The pool grows as needed and
+ * keeps about as many blocks as the biggest recent scenes used; slabs
+ * beyond that are released once all their blocks are back.
+ */
+struct lp_scene_slab {
+   struct lp_scene_slab *next;
+   struct data_block *free_blocks;
+   unsigned num_free;
+};
+
+struct lp_scene_pool {
+   mtx_t mutex;
+   struct lp_scene_slab *slabs;
+   unsigned num_free;     /**< free blocks, over all slabs */
+   unsigned target;       /**< free blocks to keep around */
+   boolean huge_pages;
+};
+
+/* The slab header lives at the start of the slab, followed by the blocks,
+ * all cache line aligned.
+ */
+#define SLAB_BLOCK_OFFSET \
+   align(sizeof(struct lp_scene_slab), 64)
+
+#define SLAB_BLOCK_STRIDE \
+   align(sizeof(struct data_block), 64)
+
+#define BLOCKS_PER_SLAB \
+   ((LP_SCENE_SLAB_SIZE - SLAB_BLOCK_OFFSET) / SLAB_BLOCK_STRIDE)
+
+
+struct lp_scene_pool *
+lp_scene_pool_create(void)
+{
+   struct lp_scene_pool *pool = CALLOC_STRUCT(lp_scene_pool);
+   if (!pool)
+      return NULL;
+
+   (void) mtx_init(&pool->mutex, mtx_plain);
+   pool->huge_pages = debug_get_bool_option("LP_HUGE_PAGES", TRUE);
+
+   return pool;
+}
+
+
+void
+lp_scene_pool_destroy(struct lp_scene_pool *pool)
+{
+   struct lp_scene_slab *slab, *next;
+
+   for (slab = pool->slabs; slab; slab = next) {
+      next = slab->next;
+      assert(slab->num_free == BLOCKS_PER_SLAB);
+      align_free(slab);
+   }
+
+   mtx_destroy(&pool->mutex);
+   FREE(pool);
+}
+
+
+static struct lp_scene_slab *
+pool_new_slab(struct lp_scene_pool *pool)
+{
+   struct lp_scene_slab *slab, **prev;
+   ubyte *blocks;
+   unsigned i;
+
+   slab = align_malloc(LP_SCENE_SLAB_SIZE, LP_SCENE_SLAB_SIZE);
+   if (!slab)
+      return NULL;
+
+#if defined(PIPE_OS_LINUX) && defined(MADV_HUGEPAGE)
+   if (pool->huge_pages)
+      (void) madvise(slab, LP_SCENE_SLAB_SIZE, MADV_HUGEPAGE);
+#endif
+
+   slab->free_blocks = NULL;
+   slab->num_free = BLOCKS_PER_SLAB;
+
+   blocks = (ubyte *) slab + SLAB_BLOCK_OFFSET;
+   for (i = 0; i < BLOCKS_PER_SLAB; i++) {
+      struct data_block *block =
+         (struct data_block *) (blocks + i * SLAB_BLOCK_STRIDE);
+      block->slab = slab;
+      block->next = slab->free_blocks;
+      slab->free_blocks = block;
+   }
+
+   /* keep the list oldest first */
+   for (prev = &pool->slabs; *prev; prev = &(*prev)->next)
+      ;
+   slab->next = NULL;
+   *prev = slab;
+   pool->num_free += BLOCKS_PER_SLAB;
+
+   return slab;
+}
+
+
+static struct data_block *
+pool_get_block(struct lp_scene_pool *pool)
+{
+   struct lp_scene_slab *slab;
+   struct data_block *block = NULL;
+
+   mtx_lock(&pool->mutex);
+
+   /* Filling the oldest slabs first lets the newer ones drain */
+   for (slab = pool->slabs; slab; slab = slab->next) {
+      if (slab->num_free)
+         break;
+   }
+
+   if (!slab)
+      slab = pool_new_slab(pool);
+
+   if (slab) {
+      block = slab->free_blocks;
+      slab->free_blocks = block->next;
+      slab->num_free--;
+      pool->num_free--;
+   }
+
+   mtx_unlock(&pool->mutex);
+
+   return block;
+}
+
+
+/**
+ * Give back a list of blocks, used by a scene which needed num_used
+ * blocks.  The pool target decays slowly towards the current needs.
+ */
+static void
+pool_put_blocks(struct lp_scene_pool *pool,
+                struct data_block *blocks,
+                unsigned num_used)
+{
+   struct lp_scene_slab *slab, **prev;
+   struct data_block *block, *next;
+
+   mtx_lock(&pool->mutex);
+
+   for (block = blocks; block; block = next) {
+      next = block->next;
+      slab = block->slab;
+      block->next = slab->free_blocks;
+      slab->free_blocks = block;
+      slab->num_free++;
+      pool->num_free++;
+   }
+
+   pool->target = MAX2(num_used, pool->target - pool->target / 8);
+
+   /* Release the empty slabs we don't need, newest first */
+   while (pool->num_free >= pool->target + BLOCKS_PER_SLAB) {
+      struct lp_scene_slab *empty = NULL, **empty_prev = NULL;
+
+      for (prev = &pool->slabs; *prev; prev = &(*prev)->next) {
+         if ((*prev)->num_free == BLOCKS_PER_SLAB) {
+            empty = *prev;
+            empty_prev = prev;
+         }
+      }
+
+      if (!empty)
+         break;
+
+      *empty_prev = empty->next;
+      pool->num_free -= BLOCKS_PER_SLAB;
+      align_free(empty);
+   }
+
+   mtx_unlock(&pool->mutex);
+}
+
+
 /**
  * Create a new scene object.
  * \param queue  the queue to put newly rendered/emptied scenes into
@@ -58,6 +248,7 @@ lp_scene_create( struct pipe_context *pipe )
       return NULL;
 
    scene->pipe = pipe;
+   scene->pool = llvmpipe_screen(pipe->screen)->scene_pool;
 
    scene->data.head =
       CALLOC_STRUCT(data_block);
@@ -175,6 +366,9 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
                                                      cbuf->u.tex.first_layer,
                                                      LP_TEX_USAGE_READ_WRITE);
          scene->cbufs[i].format_bytes = util_format_get_blocksize(cbuf->format);
+         scene->cbufs[i].tiled = llvmpipe_resource_is_tiled(cbuf->texture);
+         scene->cbufs[i].sample_stride =
+            llvmpipe_resource(cbuf->texture)->sample_stride;
       }
       else {
          struct llvmpipe_resource *lpr = llvmpipe_resource(cbuf->texture);
@@ -184,6 +378,8 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
          scene->cbufs[i].map = lpr->data;
          scene->cbufs[i].map += cbuf->u.buf.first_element * pixstride;
          scene->cbufs[i].format_bytes = util_format_get_blocksize(cbuf->format);
+         scene->cbufs[i].tiled = FALSE;
+         scene->cbufs[i].sample_stride = 0;
       }
    }
 
@@ -197,6 +393,8 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
                                                zsbuf->u.tex.first_layer,
                                                LP_TEX_USAGE_READ_WRITE);
       scene->zsbuf.format_bytes = util_format_get_blocksize(zsbuf->format);
+      scene->zsbuf.sample_stride =
+         llvmpipe_resource(zsbuf->texture)->sample_stride;
    }
 }
 
@@ -220,6 +418,9 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                                     cbuf->u.tex.level,
                                     cbuf->u.tex.first_layer);
          }
+         if (scene->cbufs[i].clear_tiles) {
+            llvmpipe_resource_update_clear_pending(cbuf->texture);
+         }
          scene->cbufs[i].map = NULL;
       }
    }
@@ -274,19 +475,31 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                       j, scene->resource_reference_size);
    }
 
-   /* Free all scene data blocks:
+   /* Give the scene data blocks back to the pool, but for our own one:
     */
    {
       struct data_block_list *list = &scene->data;
-      struct data_block *block, *tmp;
-
-      for (block = list->head->next; block; block = tmp) {
-         tmp = block->next;
-	 FREE(block);
+      struct data_block *block, *next, *own = NULL, *pooled = NULL;
+      unsigned num_pooled = 0;
+
+      for (block = list->head; block; block = next) {
+         next = block->next;
+         if (block->slab) {
+            block->next = pooled;
+            pooled = block;
+            num_pooled++;
+         }
+         else {
+            own = block;
+         }
       }
 
-      list->head->next = NULL;
-      list->head->used = 0;
+      pool_put_blocks(scene->pool, pooled, num_pooled);
+
+      assert(own);
+      own->next = NULL;
+      own->used = 0;
+      list->head = own;
    }
 
    lp_fence_reference(&scene->fence, NULL);
@@ -336,10 +549,10 @@ lp_scene_new_data_block( struct lp_scene *scene )
       return NULL;
    }
    else {
-      struct data_block *block = MALLOC_STRUCT(data_block);
+      struct data_block *block = pool_get_block(scene->pool);
       if (!block)
          return NULL;
-      
+
       scene->scene_size += sizeof *block;
 
       block->used = 0;
@@ -546,6 +759,30 @@ void lp_scene_begin_binning( struct lp_scene *scene,
       max_layer = MIN2(max_layer, zsbuf->u.tex.last_layer - zsbuf->u.tex.first_layer);
    }
    scene->fb_max_layer = max_layer;
+   scene->nr_samples = MAX2(util_framebuffer_get_num_samples(fb), 1);
+
+   /*
+    * Color clears can be deferred per tile if the tiles of the scene match
+    * those of the whole resource.  Otherwise clears still pending from
+    * earlier scenes must be written out before rendering.
+    */
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      struct pipe_surface *cbuf = scene->fb.cbufs[i];
+
+      scene->cbufs[i].clear_tiles = NULL;
+      if (!cbuf || !llvmpipe_resource_is_texture(cbuf->texture))
+         continue;
+
+      if (cbuf->u.tex.level == 0 &&
+          fb->width == cbuf->texture->width0 &&
+          fb->height == cbuf->texture->height0) {
+         scene->cbufs[i].clear_tiles =
+            llvmpipe_resource_clear_tiles(cbuf->texture);
+      }
+      if (!scene->cbufs[i].clear_tiles) {
+         llvmpipe_resource_resolve_clears(cbuf->texture, FALSE);
+      }
+   }
 }
 
 
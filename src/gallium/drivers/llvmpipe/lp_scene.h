@@ -40,7 +40,10 @@
 #include "lp_debug.h"
 
 struct lp_scene_queue;
+struct lp_scene_pool;
+struct lp_scene_slab;
 struct lp_rast_state;
+struct llvmpipe_tile_clear;
 
 /* We're limited to 2K by 2K for 32bit fixed point rasterization.
  * Will need a 64-bit version for larger framebuffers.
@@ -58,6 +61,10 @@ struct lp_rast_state;
  */
 #define DATA_BLOCK_SIZE (64 * 1024)
 
+/* Data blocks are carved out of slabs of this size, see lp_scene_pool:
+ */
+#define LP_SCENE_SLAB_SIZE (2 * 1024 * 1024)
+
 /* Scene temporary storage is clamped to this size:
  */
 #define LP_SCENE_MAX_SIZE (9*1024*1024)
@@ -86,6 +93,7 @@ struct data_block {
    ubyte data[DATA_BLOCK_SIZE];
    unsigned used;
    struct data_block *next;
+   struct lp_scene_slab *slab;   /**< NULL if not from the pool */
 };
 
 
@@ -127,6 +135,7 @@ struct resource_ref;
  */
 struct lp_scene {
    struct pipe_context *pipe;
+   struct lp_scene_pool *pool;
    struct lp_fence *fence;
 
    /* The queries still active at end of scene */
@@ -134,6 +143,8 @@ struct lp_scene {
    unsigned num_active_queries;
    /* If queries were either active or there were begin/end query commands */
    boolean had_queries;
+   /* Whether to time the fragment shader calls */
+   boolean shader_timing;
 
    /* Framebuffer mappings - valid only between begin_rasterization()
     * and end_rasterization().
@@ -143,11 +154,18 @@ struct lp_scene {
       unsigned stride;
       unsigned layer_stride;
       unsigned format_bytes;
+      boolean tiled;   /**< 4x4 pixel tiles, see llvmpipe_resource::tiled */
+      unsigned sample_stride;   /**< bytes between samples, if multisampled */
+      /** Per tile deferred clears, NULL when clears are done immediately */
+      struct llvmpipe_tile_clear *clear_tiles;
    } zsbuf, cbufs[PIPE_MAX_COLOR_BUFS];
 
    /* The amount of layers in the fb (minimum of all attachments) */
    unsigned fb_max_layer;
 
+   /* Samples per pixel of the fb, 1 if not multisampled */
+   unsigned nr_samples;
+
    /** the framebuffer to render the scene into */
    struct pipe_framebuffer_state fb;
 
@@ -182,6 +200,10 @@ struct lp_scene {
 
 
 
+struct lp_scene_pool *lp_scene_pool_create(void);
+
+void lp_scene_pool_destroy(struct lp_scene_pool *pool);
+
 struct lp_scene *lp_scene_create(struct pipe_context *pipe);
 
 void lp_scene_destroy(struct lp_scene *scene);
@@ -48,6 +48,8 @@
 #include "lp_public.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
+#include "lp_scene.h"
+#include "lp_query.h"
 
 #include "state_tracker/sw_winsys.h"
 
@@ -81,6 +83,9 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_blend",       PERF_NO_BLEND, NULL },
    { "no_depth",       PERF_NO_DEPTH, NULL },
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
+   { "no_hiz",         PERF_NO_HIZ, NULL },
+   { "no_blit",        PERF_NO_BLIT, NULL },
+   { "no_fastclear",   PERF_NO_FASTCLEAR, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -212,7 +217,12 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_QUADS_FOLLOW_PROVOKING_VERTEX_CONVENTION:
       return 0;
    case PIPE_CAP_COMPUTE:
-      return 0;
+      /* atomics need cmpxchg.  Only for gallium frontends for now: without
+       * images, compute samplers and atomic counters (SSBOs are hidden by a
+       * zero PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT) st won't enable
+       * ARB_compute_shader.
+       */
+      return HAVE_LLVM >= 0x0309;
    case PIPE_CAP_USER_VERTEX_BUFFERS:
       return 1;
    case PIPE_CAP_USER_CONSTANT_BUFFERS:
@@ -230,7 +240,7 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_CONSTANT_BUFFER_OFFSET_ALIGNMENT:
       return 16;
    case PIPE_CAP_TEXTURE_MULTISAMPLE:
-      return 0;
+      return 1;
    case PIPE_CAP_MIN_MAP_BUFFER_ALIGNMENT:
       return 64;
    case PIPE_CAP_TEXTURE_BUFFER_OBJECTS:
@@ -404,11 +414,75 @@ llvmpipe_get_shader_param(struct pipe_screen *screen,
       default:
          return draw_get_shader_param(shader, param);
       }
+   case PIPE_SHADER_COMPUTE:
+      switch (param) {
+      case PIPE_SHADER_CAP_MAX_TEXTURE_SAMPLERS:
+      case PIPE_SHADER_CAP_MAX_SAMPLER_VIEWS:
+         /* no texturing in compute shaders yet */
+         return 0;
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         return LP_MAX_TGSI_SHADER_BUFFERS;
+      default:
+         return gallivm_get_shader_param(param);
+      }
    default:
       return 0;
    }
 }
 
+static int
+llvmpipe_get_compute_param(struct pipe_screen *_screen,
+                           enum pipe_shader_ir ir_type,
+                           enum pipe_compute_cap param,
+                           void *ret)
+{
+   switch (param) {
+   case PIPE_COMPUTE_CAP_IR_TARGET:
+      return 0;
+   case PIPE_COMPUTE_CAP_MAX_GRID_SIZE:
+      if (ret) {
+         uint64_t *grid_size = ret;
+         grid_size[0] = 65535;
+         grid_size[1] = 65535;
+         grid_size[2] = 65535;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_BLOCK_SIZE:
+      if (ret) {
+         uint64_t *block_size = ret;
+         block_size[0] = 1024;
+         block_size[1] = 1024;
+         block_size[2] = 1024;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_THREADS_PER_BLOCK:
+      if (ret) {
+         uint64_t *max_threads_per_block = ret;
+         *max_threads_per_block = 1024;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_LOCAL_SIZE:
+      if (ret) {
+         uint64_t *max_local_size = ret;
+         *max_local_size = 32768;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_GRID_DIMENSION:
+   case PIPE_COMPUTE_CAP_MAX_GLOBAL_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_PRIVATE_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_INPUT_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_MEM_ALLOC_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_CLOCK_FREQUENCY:
+   case PIPE_COMPUTE_CAP_MAX_COMPUTE_UNITS:
+   case PIPE_COMPUTE_CAP_IMAGES_SUPPORTED:
+   case PIPE_COMPUTE_CAP_SUBGROUP_SIZE:
+   case PIPE_COMPUTE_CAP_ADDRESS_BITS:
+   case PIPE_COMPUTE_CAP_MAX_VARIABLE_THREADS_PER_BLOCK:
+      break;
+   }
+   return 0;
+}
+
 static float
 llvmpipe_get_paramf(struct pipe_screen *screen, enum pipe_capf param)
 {
@@ -467,8 +541,23 @@ llvmpipe_is_format_supported( struct pipe_screen *_screen,
           target == PIPE_TEXTURE_CUBE ||
           target == PIPE_TEXTURE_CUBE_ARRAY);
 
-   if (sample_count > 1)
-      return FALSE;
+   /*
+    * Multisampling is limited to 4x 2D render targets and depth buffers,
+    * which can be fetched from (texelFetch) but not used as images or
+    * scanned out.
+    */
+   if (sample_count > 1) {
+      if (sample_count != LP_MAX_SAMPLES ||
+          (target != PIPE_TEXTURE_2D &&
+           target != PIPE_TEXTURE_2D_ARRAY &&
+           target != PIPE_TEXTURE_RECT) ||
+          (bind & (PIPE_BIND_DISPLAY_TARGET |
+                   PIPE_BIND_SCANOUT |
+                   PIPE_BIND_SHARED |
+                   PIPE_BIND_SHADER_IMAGE)) ||
+          !(bind & (PIPE_BIND_RENDER_TARGET | PIPE_BIND_DEPTH_STENCIL)))
+         return FALSE;
+   }
 
    if (bind & PIPE_BIND_RENDER_TARGET) {
       if (format_desc->colorspace == UTIL_FORMAT_COLORSPACE_SRGB) {
@@ -560,6 +649,7 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
 
    assert(texture->dt);
+   llvmpipe_resource_resolve_clears(resource, FALSE);
    if (texture->dt)
       winsys->displaytarget_display(winsys, texture->dt, context_private, sub_box);
 }
@@ -573,6 +663,9 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
+   if (screen->scene_pool)
+      lp_scene_pool_destroy(screen->scene_pool);
+
    lp_jit_screen_cleanup(screen);
 
    if(winsys->destroy)
@@ -661,6 +754,9 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.get_param = llvmpipe_get_param;
    screen->base.get_shader_param = llvmpipe_get_shader_param;
    screen->base.get_paramf = llvmpipe_get_paramf;
+   screen->base.get_compute_param = llvmpipe_get_compute_param;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
+   screen->base.get_driver_query_group_info = llvmpipe_get_driver_query_group_info;
    screen->base.is_format_supported = llvmpipe_is_format_supported;
 
    screen->base.context_create = llvmpipe_create_context;
@@ -679,8 +775,18 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
 
+   screen->tiled_textures = debug_get_bool_option("LP_TILED_TEXTURES", FALSE);
+
+   screen->scene_pool = lp_scene_pool_create();
+   if (!screen->scene_pool) {
+      lp_jit_screen_cleanup(screen);
+      FREE(screen);
+      return NULL;
+   }
+
    screen->rast = lp_rast_create(screen->num_threads);
    if (!screen->rast) {
+      lp_scene_pool_destroy(screen->scene_pool);
       lp_jit_screen_cleanup(screen);
       FREE(screen);
       return NULL;
@@ -41,6 +41,7 @@
 
 
 struct sw_winsys;
+struct lp_scene_pool;
 
 
 struct llvmpipe_screen
@@ -51,12 +52,18 @@ struct llvmpipe_screen
 
    unsigned num_threads;
 
+   /** Store eligible textures in 4x4 pixel tiles (LP_TILED_TEXTURES) */
+   boolean tiled_textures;
+
    /* Increments whenever textures are modified.  Contexts can track this.
     */
    unsigned timestamp;
 
    struct lp_rasterizer *rast;
    mtx_t rast_mutex;
+
+   /** Scene data blocks, recycled across the scenes of all contexts */
+   struct lp_scene_pool *scene_pool;
 };
 
 
@@ -153,10 +153,12 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
 {
    struct lp_scene *scene = setup->scene;
    struct llvmpipe_screen *screen = llvmpipe_screen(scene->pipe->screen);
+   int64_t t0;
 
    scene->num_active_queries = setup->active_binned_queries;
    memcpy(scene->active_queries, setup->active_queries,
           scene->num_active_queries * sizeof(scene->active_queries[0]));
+   scene->shader_timing = setup->shader_timing_queries != 0;
 
    lp_scene_end_binning(scene);
 
@@ -165,6 +167,9 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
+   setup->counters[LP_COUNTER_SCENES]++;
+   setup->counters[LP_COUNTER_SCENE_MEMORY] += scene->scene_size;
+
    mtx_lock(&screen->rast_mutex);
 
    /* FIXME: We enqueue the scene then wait on the rasterizer to finish.
@@ -177,8 +182,10 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
     * Certainly, lp_scene_end_rasterization() would need to be deferred too
     * and there's probably other bits why this doesn't actually work.
     */
+   t0 = os_time_get_nano();
    lp_rast_queue_scene(screen->rast, scene);
    lp_rast_finish(screen->rast);
+   setup->counters[LP_COUNTER_RAST_TIME] += os_time_get_nano() - t0;
    mtx_unlock(&screen->rast_mutex);
 
    lp_scene_end_rasterization(setup->scene);
@@ -384,6 +391,8 @@ lp_setup_bind_framebuffer( struct lp_setup_context *setup,
     * scene.
     */
    util_copy_framebuffer_state(&setup->fb, fb);
+   setup->multisample = setup->rast_multisample &&
+                        util_framebuffer_get_num_samples(fb) > 1;
    setup->framebuffer.x0 = 0;
    setup->framebuffer.y0 = 0;
    setup->framebuffer.x1 = fb->width-1;
@@ -740,6 +749,41 @@ lp_setup_set_rasterizer_discard( struct lp_setup_context *setup,
    }
 }
 
+void
+lp_setup_set_multisample( struct lp_setup_context *setup,
+                          boolean multisample )
+{
+   setup->rast_multisample = multisample;
+   setup->multisample = multisample &&
+                        util_framebuffer_get_num_samples(&setup->fb) > 1;
+}
+
+/**
+ * Set the samples to render to.  Only meaningful for multisample
+ * framebuffers, so must be called again when the framebuffer changes.
+ */
+void
+lp_setup_set_sample_mask( struct lp_setup_context *setup,
+                          uint32_t sample_mask )
+{
+   uint64_t mask = ~0ULL;
+   unsigned s;
+
+   if (util_framebuffer_get_num_samples(&setup->fb) > 1) {
+      assert(util_framebuffer_get_num_samples(&setup->fb) == LP_MAX_SAMPLES);
+      mask = 0;
+      for (s = 0; s < LP_MAX_SAMPLES; s++) {
+         if (sample_mask & (1 << s))
+            mask |= 0xffffULL << (16 * s);
+      }
+   }
+
+   if (setup->fs.current.sample_mask != mask) {
+      setup->fs.current.sample_mask = mask;
+      setup->dirty |= LP_SETUP_NEW_FS;
+   }
+}
+
 void 
 lp_setup_set_vertex_info( struct lp_setup_context *setup,
                           struct vertex_info *vertex_info )
@@ -815,6 +859,9 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
           */
          pipe_resource_reference(&setup->fs.current_tex[i], res);
 
+         jit_tex->num_samples = MAX2(res->nr_samples, 1);
+         jit_tex->sample_stride = lp_tex->sample_stride;
+
          if (!lp_tex->dt) {
             /* regular texture - setup array of mipmap level offsets */
             int j;
@@ -843,6 +890,7 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
                jit_tex->mip_offsets[0] = 0;
                jit_tex->row_stride[0] = 0;
                jit_tex->img_stride[0] = 0;
+               jit_tex->sample_stride = 0;
             }
             else {
                jit_tex->width = res->width0;
@@ -1345,6 +1393,7 @@ lp_setup_create( struct pipe_context *pipe,
    setup->line     = first_line;
    setup->point    = first_point;
    
+   setup->fs.current.sample_mask = ~0ULL;
    setup->dirty = ~0;
 
    /* Initialize empty default fb correctly, so the rect is empty */
@@ -1487,6 +1536,36 @@ fail:
 }
 
 
+/**
+ * Read one of the setup counters.
+ */
+uint64_t
+lp_setup_get_counter(const struct lp_setup_context *setup,
+                     enum lp_counter counter)
+{
+   assert(counter < LP_COUNTER_FIRST_RAST);
+   return setup->counters[counter];
+}
+
+
+/**
+ * Enable or disable the timing of fragment shader calls, from the next
+ * flushed scene on.  Calls nest.
+ */
+void
+lp_setup_set_shader_timing(struct lp_setup_context *setup,
+                           boolean enable)
+{
+   if (enable) {
+      setup->shader_timing_queries++;
+   }
+   else {
+      assert(setup->shader_timing_queries);
+      setup->shader_timing_queries--;
+   }
+}
+
+
 boolean
 lp_setup_flush_and_restart(struct lp_setup_context *setup)
 {
@@ -29,6 +29,7 @@
 
 #include "pipe/p_compiler.h"
 #include "lp_jit.h"
+#include "lp_perf.h"
 
 struct draw_context;
 struct vertex_info;
@@ -147,6 +148,14 @@ void
 lp_setup_set_rasterizer_discard( struct lp_setup_context *setup, 
                                  boolean rasterizer_discard );
 
+void
+lp_setup_set_multisample( struct lp_setup_context *setup,
+                          boolean multisample );
+
+void
+lp_setup_set_sample_mask( struct lp_setup_context *setup,
+                          uint32_t sample_mask );
+
 void
 lp_setup_set_vertex_info( struct lp_setup_context *setup, 
                           struct vertex_info *info );
@@ -159,6 +168,14 @@ void
 lp_setup_end_query(struct lp_setup_context *setup,
                    struct llvmpipe_query *pq);
 
+uint64_t
+lp_setup_get_counter(const struct lp_setup_context *setup,
+                     enum lp_counter counter);
+
+void
+lp_setup_set_shader_timing(struct lp_setup_context *setup,
+                           boolean enable);
+
 static inline unsigned
 lp_clamp_viewport_idx(int idx)
 {
@@ -95,11 +95,17 @@ struct lp_setup_context
    struct llvmpipe_query *active_queries[LP_MAX_ACTIVE_BINNED_QUERIES];
    unsigned active_binned_queries;
 
+   /** Setup counters, see enum lp_counter */
+   uint64_t counters[LP_COUNTER_TYPES];
+   unsigned shader_timing_queries;
+
    boolean flatshade_first;
    boolean ccw_is_frontface;
    boolean scissor_test;
    boolean point_size_per_vertex;
    boolean rasterizer_discard;
+   boolean rast_multisample;  /**< multisample rasterizer state */
+   boolean multisample;       /**< ...and the fb is multisampled */
    unsigned cullmode;
    unsigned bottom_edge_rule;
    float pixel_offset;
@@ -184,6 +190,9 @@ scissor_planes_needed(boolean scis_planes[4], const struct u_rect *bbox,
 
 
 void lp_setup_choose_triangle( struct lp_setup_context *setup );
+void lp_setup_triangle_batch( struct lp_setup_context *setup,
+                              const float (*const *v)[4],
+                              unsigned nr );
 void lp_setup_choose_line( struct lp_setup_context *setup );
 void lp_setup_choose_point( struct lp_setup_context *setup );
 
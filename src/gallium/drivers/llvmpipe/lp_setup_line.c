@@ -343,6 +343,7 @@ try_setup_line( struct lp_setup_context *setup,
    area = (dx * dx  + dy * dy);
    if (area == 0) {
       LP_COUNT(nr_culled_tris);
+      setup->counters[LP_COUNTER_PRIMS_CULLED]++;
       return TRUE;
    }
 
@@ -572,12 +573,14 @@ try_setup_line( struct lp_setup_context *setup,
        bbox.y1 < bbox.y0) {
       if (0) debug_printf("empty bounding box\n");
       LP_COUNT(nr_culled_tris);
+      setup->counters[LP_COUNTER_PRIMS_CULLED]++;
       return TRUE;
    }
 
    if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
       if (0) debug_printf("offscreen\n");
       LP_COUNT(nr_culled_tris);
+      setup->counters[LP_COUNTER_PRIMS_CULLED]++;
       return TRUE;
    }
 
@@ -615,6 +618,7 @@ try_setup_line( struct lp_setup_context *setup,
 #endif
 
    LP_COUNT(nr_tris);
+   setup->counters[LP_COUNTER_PRIMS_BINNED]++;
 
    if (lp_context->active_statistics_queries &&
        !llvmpipe_rasterization_disabled(lp_context)) {
@@ -650,6 +654,7 @@ try_setup_line( struct lp_setup_context *setup,
 
    line->inputs.disable = FALSE;
    line->inputs.opaque = FALSE;
+   line->inputs.multisample = FALSE;
    line->inputs.layer = layer;
    line->inputs.viewport_index = viewport_index;
 
@@ -256,6 +256,75 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Compute the coverage of a triangle within the 4x4 stamp at (x, y),
+ * using the same edge functions and fill conventions as the plane setup
+ * in do_triangle_ccw(), and restricted to the given draw region.
+ * Bit (iy * 4 + ix) of the result is set if pixel (x + ix, y + iy) is
+ * covered.
+ */
+static unsigned
+triangle_stamp_mask(const struct lp_setup_context *setup,
+                    const struct fixed_position *position,
+                    int x, int y,
+                    const struct u_rect *region)
+{
+   int32_t dcdx[3], dcdy[3];
+   unsigned mask = 0xffff;
+   int i, ix, iy;
+
+   dcdy[0] = position->dx01;
+   dcdy[1] = position->x[1] - position->x[2];
+   dcdy[2] = position->dx20;
+   dcdx[0] = position->dy01;
+   dcdx[1] = position->y[1] - position->y[2];
+   dcdx[2] = position->dy20;
+
+   for (i = 0; i < 3; i++) {
+      int64_t xstep = -IMUL64(dcdx[i], FIXED_ONE);
+      int64_t ystep = IMUL64(dcdy[i], FIXED_ONE);
+      unsigned plane_mask = 0;
+      int64_t c;
+
+      c = IMUL64(dcdx[i], position->x[i]) -
+          IMUL64(dcdy[i], position->y[i]);
+
+      if (dcdx[i] < 0 ||
+          (dcdx[i] == 0 && (setup->bottom_edge_rule == 0 ?
+                            dcdy[i] > 0 : dcdy[i] < 0))) {
+         c++;
+      }
+
+      /* Move to the stamp origin:
+       */
+      c += xstep * x + ystep * y;
+
+      for (iy = 0; iy < 4; iy++) {
+         int64_t cx = c;
+         for (ix = 0; ix < 4; ix++) {
+            if (cx > 0)
+               plane_mask |= 1 << (iy * 4 + ix);
+            cx += xstep;
+         }
+         c += ystep;
+      }
+
+      mask &= plane_mask;
+      if (!mask)
+         return 0;
+   }
+
+   for (i = 0; i < 4; i++) {
+      if (x + i < region->x0 || x + i > region->x1)
+         mask &= ~(0x1111 << i);
+      if (y + i < region->y0 || y + i > region->y1)
+         mask &= ~(0xf << (i * 4));
+   }
+
+   return mask;
+}
+
+
 /**
  * Do basic setup for triangle rasterization and determine which
  * framebuffer tiles are touched.  Put the triangle in the scene's
@@ -280,6 +349,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
    int nr_planes = 3;
    unsigned viewport_index = 0;
    unsigned layer = 0;
+   unsigned stamp_mask = 0;
    const float (*pv)[4];
 
    /* Area should always be positive here */
@@ -319,18 +389,28 @@ do_triangle_ccw(struct lp_setup_context *setup,
       /* Inclusive / exclusive depending upon adj (bottom-left or top-right) */
       bbox.y0 = (MIN3(position->y[0], position->y[1], position->y[2]) + adj) >> FIXED_ORDER;
       bbox.y1 = (MAX3(position->y[0], position->y[1], position->y[2]) - 1 + adj) >> FIXED_ORDER;
+
+      /* Samples may be covered in pixels whose center is outside. */
+      if (setup->multisample) {
+         bbox.x0--;
+         bbox.y0--;
+         bbox.x1++;
+         bbox.y1++;
+      }
    }
 
    if (bbox.x1 < bbox.x0 ||
        bbox.y1 < bbox.y0) {
       if (0) debug_printf("empty bounding box\n");
       LP_COUNT(nr_culled_tris);
+      setup->counters[LP_COUNTER_PRIMS_CULLED]++;
       return TRUE;
    }
 
    if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
       if (0) debug_printf("offscreen\n");
       LP_COUNT(nr_culled_tris);
+      setup->counters[LP_COUNTER_PRIMS_CULLED]++;
       return TRUE;
    }
 
@@ -343,12 +423,38 @@ do_triangle_ccw(struct lp_setup_context *setup,
    bboxpos.x0 = MAX2(bboxpos.x0, 0);
    bboxpos.y0 = MAX2(bboxpos.y0, 0);
 
+   /*
+    * Triangles contained in a single 4x4 stamp are very common on dense
+    * meshes.  Compute their coverage right away: those not covering any
+    * pixel center are dropped before running the setup function, and
+    * the others are binned together with their coverage mask, so no
+    * planes need to be stored or evaluated during rasterization.
+    */
+   if (!setup->multisample &&
+       bbox.x0 >= 0 && bbox.y0 >= 0 &&
+       (bbox.x0 & ~3) == (bbox.x1 & ~3) &&
+       (bbox.y0 & ~3) == (bbox.y1 & ~3)) {
+      stamp_mask = triangle_stamp_mask(setup, position,
+                                       bbox.x0 & ~3, bbox.y0 & ~3,
+                                       &setup->draw_regions[viewport_index]);
+      if (!stamp_mask) {
+         if (0) debug_printf("no pixel coverage\n");
+         LP_COUNT(nr_culled_tris);
+         setup->counters[LP_COUNTER_PRIMS_CULLED]++;
+         return TRUE;
+      }
+   }
+
    nr_planes = 3;
    /*
     * Determine how many scissor planes we need, that is drop scissor
     * edges if the bounding box of the tri is fully inside that edge.
     */
-   if (setup->scissor_test) {
+   if (stamp_mask) {
+      /* coverage is known, scissor already applied */
+      nr_planes = 0;
+   }
+   else if (setup->scissor_test) {
       /* why not just use draw_regions */
       scissor = &setup->scissors[viewport_index];
       scissor_planes_needed(s_planes, &bboxpos, scissor);
@@ -372,6 +478,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
 #endif
 
    LP_COUNT(nr_tris);
+   setup->counters[LP_COUNTER_PRIMS_BINNED]++;
 
    /* Setup parameter interpolants:
     */
@@ -383,7 +490,10 @@ do_triangle_ccw(struct lp_setup_context *setup,
 
    tri->inputs.frontfacing = frontfacing;
    tri->inputs.disable = FALSE;
-   tri->inputs.opaque = setup->fs.current.variant->opaque;
+   /* samples masked off keep their contents, even under opaque shaders */
+   tri->inputs.opaque = setup->fs.current.variant->opaque &&
+                        setup->fs.current.sample_mask == ~0ULL;
+   tri->inputs.multisample = setup->multisample;
    tri->inputs.layer = layer;
    tri->inputs.viewport_index = viewport_index;
 
@@ -393,6 +503,19 @@ do_triangle_ccw(struct lp_setup_context *setup,
                          (const float (*)[4])GET_DADX(&tri->inputs),
                          (const float (*)[4])GET_DADY(&tri->inputs));
 
+   if (stamp_mask) {
+      LP_COUNT(nr_mask_tris);
+      return lp_scene_bin_cmd_with_state(scene,
+                                         bbox.x0 / TILE_SIZE,
+                                         bbox.y0 / TILE_SIZE,
+                                         setup->fs.stored,
+                                         LP_RAST_OP_TRIANGLE_MASK,
+                                         lp_rast_arg_triangle_mask(tri,
+                                                                   (bbox.x0 & ~3) % TILE_SIZE,
+                                                                   (bbox.y0 & ~3) % TILE_SIZE,
+                                                                   stamp_mask));
+   }
+
    plane = GET_PLANES(tri);
 
 #if defined(PIPE_ARCH_SSE)
@@ -717,6 +840,27 @@ do_triangle_ccw(struct lp_setup_context *setup,
       assert(plane_s == &plane[nr_planes]);
    }
 
+   /*
+    * For multisampling bias the planes so that they cover every pixel with
+    * at least one covered sample, and widen the trivial reject offsets so
+    * that trivial accept still means all samples are covered.  The
+    * rasterizer evaluates the individual samples of partial 4x4 blocks.
+    * Scissor edges are moved to the middle of the pixels, where no sample
+    * can cross them.
+    */
+   if (setup->multisample) {
+      int i;
+
+      for (i = 0; i < nr_planes; i++) {
+         int32_t m = lp_rast_plane_sample_max_offset(plane[i].dcdx,
+                                                     plane[i].dcdy);
+         if (i >= 3)
+            plane[i].c -= FIXED_ONE / 2;
+         plane[i].c += m;
+         plane[i].eo += align(2 * m, FIXED_ONE);
+      }
+   }
+
    return lp_setup_bin_triangle(setup, tri, &bbox, &bboxpos, nr_planes, viewport_index);
 }
 
@@ -792,6 +936,8 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
     */
    if (dx < TILE_SIZE)
    {
+      /* The specialized small triangle paths don't do multisampling. */
+      boolean ms = tri->inputs.multisample;
       int ix0 = bbox->x0 / TILE_SIZE;
       int iy0 = bbox->y0 / TILE_SIZE;
       unsigned px = bbox->x0 & 63 & ~3;
@@ -800,7 +946,7 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
       assert(iy0 == bbox->y1 / TILE_SIZE &&
 	     ix0 == bbox->x1 / TILE_SIZE);
 
-      if (nr_planes == 3) {
+      if (nr_planes == 3 && !ms) {
          if (sz < 4)
          {
             /* Triangle is contained in a single 4x4 stamp:
@@ -839,7 +985,7 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                                                 lp_rast_arg_triangle_contained(tri, px, py) );
          }
       }
-      else if (nr_planes == 4 && sz < 16) 
+      else if (nr_planes == 4 && sz < 16 && !ms) 
       {
          px = MIN2(px, TILE_SIZE - 16);
          py = MIN2(py, TILE_SIZE - 16);
@@ -1204,6 +1350,187 @@ static void triangle_nop( struct lp_setup_context *setup,
 }
 
 
+/**
+ * Set up a batch of up to four triangles, given as 3 * nr vertex pointers.
+ *
+ * Fixed point positions, edge deltas and areas of all the triangles are
+ * computed at once, and zero area, back/front facing and triangles whose
+ * bounding box contains no pixel center are culled before doing any
+ * per-triangle work.  The remaining ones take the same path as in
+ * triangle_cw/ccw/both.
+ */
+void
+lp_setup_triangle_batch(struct lp_setup_context *setup,
+                        const float (*const *v)[4],
+                        unsigned nr)
+{
+   PIPE_ALIGN_VAR(16) struct fixed_position position;
+   PIPE_ALIGN_VAR(16) int32_t xy[4][8];   /* x[4], y[4] per triangle */
+   PIPE_ALIGN_VAR(16) int32_t dxdy[4][4]; /* dx01, dy01, dx20, dy20 */
+   PIPE_ALIGN_VAR(16) int64_t area[4];
+   boolean keep_ccw, keep_cw;
+   unsigned empty = 0;
+   unsigned i;
+
+   assert(nr > 0 && nr <= 4);
+
+   if (setup->multisample ||
+       (setup->triangle != triangle_both &&
+        setup->triangle != triangle_ccw &&
+        setup->triangle != triangle_cw)) {
+      /* Everything culled, or triangle function not chosen yet.  The
+       * empty bounding box test below doesn't hold for multisampling.
+       */
+      for (i = 0; i < nr; i++)
+         setup->triangle(setup, v[i * 3 + 0], v[i * 3 + 1], v[i * 3 + 2]);
+      return;
+   }
+
+   keep_ccw = setup->triangle != triangle_cw;
+   keep_cw = setup->triangle != triangle_ccw;
+
+   if (setup->triangle == triangle_both) {
+      struct llvmpipe_context *lp_context = (struct llvmpipe_context *)setup->pipe;
+
+      if (lp_context->active_statistics_queries &&
+          !llvmpipe_rasterization_disabled(lp_context)) {
+         lp_context->pipeline_statistics.c_primitives += nr;
+      }
+   }
+
+#if defined(PIPE_ARCH_SSE)
+   {
+      __m128 pix_offset = _mm_set1_ps(setup->pixel_offset);
+      __m128 fixed_one = _mm_set1_ps((float)FIXED_ONE);
+      __m128i one = _mm_set1_epi32(1);
+      __m128i adj = _mm_set1_epi32((setup->bottom_edge_rule != 0) ? 1 : 0);
+      __m128i zero = _mm_setzero_si128();
+      __m128i x[3], y[3];
+      __m128i dx01, dy01, dx20, dy20;
+      __m128i area02, area13, tmp02, tmp13;
+      __m128i xmin, xmax, ymin, ymax, empty_x, empty_y;
+      __m128i t0, t1, t2, t3;
+      unsigned j;
+
+      for (j = 0; j < 3; j++) {
+         /* Partial batches just repeat the last triangle.
+          */
+         const float (*v0)[4] = v[0 * 3 + j];
+         const float (*v1)[4] = v[MIN2(1, nr - 1) * 3 + j];
+         const float (*v2)[4] = v[MIN2(2, nr - 1) * 3 + j];
+         const float (*v3)[4] = v[MIN2(3, nr - 1) * 3 + j];
+         __m128 fx = _mm_setr_ps(v0[0][0], v1[0][0], v2[0][0], v3[0][0]);
+         __m128 fy = _mm_setr_ps(v0[0][1], v1[0][1], v2[0][1], v3[0][1]);
+
+         x[j] = _mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(fx, pix_offset),
+                                           fixed_one));
+         y[j] = _mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(fy, pix_offset),
+                                           fixed_one));
+      }
+
+      dx01 = _mm_sub_epi32(x[0], x[1]);
+      dy01 = _mm_sub_epi32(y[0], y[1]);
+      dx20 = _mm_sub_epi32(x[2], x[0]);
+      dy20 = _mm_sub_epi32(y[2], y[0]);
+
+      /* area = dx01 * dy20 - dx20 * dy01, with 64 bit results.
+       */
+      area02 = mm_mullohi_epi32(dx01, dy20, &area13);
+      tmp02 = mm_mullohi_epi32(dx20, dy01, &tmp13);
+      area02 = _mm_sub_epi64(area02, tmp02);
+      area13 = _mm_sub_epi64(area13, tmp13);
+      _mm_store_si128((__m128i *)&area[0], _mm_unpacklo_epi64(area02, area13));
+      _mm_store_si128((__m128i *)&area[2], _mm_unpackhi_epi64(area02, area13));
+
+      /* Same empty bounding box test as in do_triangle_ccw().
+       */
+      xmin = mm_min_epi32(mm_min_epi32(x[0], x[1]), x[2]);
+      xmax = mm_max_epi32(mm_max_epi32(x[0], x[1]), x[2]);
+      ymin = mm_min_epi32(mm_min_epi32(y[0], y[1]), y[2]);
+      ymax = mm_max_epi32(mm_max_epi32(y[0], y[1]), y[2]);
+      empty_x = _mm_cmplt_epi32(_mm_srai_epi32(_mm_sub_epi32(xmax, one), FIXED_ORDER),
+                                _mm_srai_epi32(xmin, FIXED_ORDER));
+      empty_y = _mm_cmplt_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_sub_epi32(ymax, one), adj),
+                                               FIXED_ORDER),
+                                _mm_srai_epi32(_mm_add_epi32(ymin, adj), FIXED_ORDER));
+      empty = _mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(empty_x, empty_y)));
+
+      /* Back to one triangle per vector.
+       */
+      transpose4_epi32(&x[0], &x[1], &x[2], &zero, &t0, &t1, &t2, &t3);
+      _mm_store_si128((__m128i *)&xy[0][0], t0);
+      _mm_store_si128((__m128i *)&xy[1][0], t1);
+      _mm_store_si128((__m128i *)&xy[2][0], t2);
+      _mm_store_si128((__m128i *)&xy[3][0], t3);
+      transpose4_epi32(&y[0], &y[1], &y[2], &zero, &t0, &t1, &t2, &t3);
+      _mm_store_si128((__m128i *)&xy[0][4], t0);
+      _mm_store_si128((__m128i *)&xy[1][4], t1);
+      _mm_store_si128((__m128i *)&xy[2][4], t2);
+      _mm_store_si128((__m128i *)&xy[3][4], t3);
+      transpose4_epi32(&dx01, &dy01, &dx20, &dy20, &t0, &t1, &t2, &t3);
+      _mm_store_si128((__m128i *)&dxdy[0][0], t0);
+      _mm_store_si128((__m128i *)&dxdy[1][0], t1);
+      _mm_store_si128((__m128i *)&dxdy[2][0], t2);
+      _mm_store_si128((__m128i *)&dxdy[3][0], t3);
+   }
+#else
+   for (i = 0; i < nr; i++) {
+      int adj = (setup->bottom_edge_rule != 0) ? 1 : 0;
+
+      calc_fixed_position(setup, &position,
+                          v[i * 3 + 0], v[i * 3 + 1], v[i * 3 + 2]);
+
+      memcpy(&xy[i][0], position.x, sizeof position.x);
+      memcpy(&xy[i][4], position.y, sizeof position.y);
+      dxdy[i][0] = position.dx01;
+      dxdy[i][1] = position.dy01;
+      dxdy[i][2] = position.dx20;
+      dxdy[i][3] = position.dy20;
+      area[i] = position.area;
+
+      if (((MAX3(position.x[0], position.x[1], position.x[2]) - 1) >> FIXED_ORDER) <
+          (MIN3(position.x[0], position.x[1], position.x[2]) >> FIXED_ORDER) ||
+          ((MAX3(position.y[0], position.y[1], position.y[2]) - 1 + adj) >> FIXED_ORDER) <
+          ((MIN3(position.y[0], position.y[1], position.y[2]) + adj) >> FIXED_ORDER))
+         empty |= 1 << i;
+   }
+#endif
+
+   for (i = 0; i < nr; i++) {
+      const float (*v0)[4] = v[i * 3 + 0];
+      const float (*v1)[4] = v[i * 3 + 1];
+      const float (*v2)[4] = v[i * 3 + 2];
+
+      if (area[i] > 0 ? !keep_ccw : (area[i] == 0 || !keep_cw))
+         continue;
+
+      if (empty & (1 << i)) {
+         LP_COUNT(nr_culled_tris);
+         setup->counters[LP_COUNTER_PRIMS_CULLED]++;
+         continue;
+      }
+
+      memcpy(position.x, &xy[i][0], sizeof position.x);
+      memcpy(position.y, &xy[i][4], sizeof position.y);
+      position.dx01 = dxdy[i][0];
+      position.dy01 = dxdy[i][1];
+      position.dx20 = dxdy[i][2];
+      position.dy20 = dxdy[i][3];
+      position.area = area[i];
+
+      if (position.area > 0)
+         retry_triangle_ccw(setup, &position, v0, v1, v2, setup->ccw_is_frontface);
+      else if (setup->flatshade_first) {
+         rotate_fixed_position_12(&position);
+         retry_triangle_ccw(setup, &position, v0, v2, v1, !setup->ccw_is_frontface);
+      } else {
+         rotate_fixed_position_01(&position);
+         retry_triangle_ccw(setup, &position, v1, v0, v2, !setup->ccw_is_frontface);
+      }
+   }
+}
+
+
 void 
 lp_setup_choose_triangle( struct lp_setup_context *setup )
 {
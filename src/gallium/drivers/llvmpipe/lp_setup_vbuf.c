@@ -41,6 +41,7 @@
 #include "draw/draw_vbuf.h"
 #include "draw/draw_vertex.h"
 #include "util/u_memory.h"
+#include "util/os_time.h"
 
 
 #define LP_MAX_VBUF_INDEXES 1024
@@ -139,6 +140,8 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    const unsigned stride = setup->vertex_info->size * sizeof(float);
    const void *vertex_buffer = setup->vertex_buffer;
    const boolean flatshade_first = setup->flatshade_first;
+   const int64_t t0 = os_time_get_nano();
+   const uint64_t rast_time = setup->counters[LP_COUNTER_RAST_TIME];
    unsigned i;
 
    assert(setup->setup.variant);
@@ -184,11 +187,22 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
       break;
 
    case PIPE_PRIM_TRIANGLES:
-      for (i = 2; i < nr; i += 3) {
-         setup->triangle( setup,
-                          get_vert(vertex_buffer, indices[i-2], stride),
-                          get_vert(vertex_buffer, indices[i-1], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride) );
+      {
+         /* set up and cull four triangles at a time */
+         const_float4_ptr tris[12];
+         unsigned n = 0;
+
+         for (i = 2; i < nr; i += 3) {
+            tris[n++] = get_vert(vertex_buffer, indices[i-2], stride);
+            tris[n++] = get_vert(vertex_buffer, indices[i-1], stride);
+            tris[n++] = get_vert(vertex_buffer, indices[i-0], stride);
+            if (n == ARRAY_SIZE(tris)) {
+               lp_setup_triangle_batch( setup, tris, n / 3 );
+               n = 0;
+            }
+         }
+         if (n)
+            lp_setup_triangle_batch( setup, tris, n / 3 );
       }
       break;
 
@@ -324,6 +338,10 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    default:
       assert(0);
    }
+
+   /* scenes flushed meanwhile are accounted as rasterization */
+   setup->counters[LP_COUNTER_SETUP_TIME] += os_time_get_nano() - t0 -
+      (setup->counters[LP_COUNTER_RAST_TIME] - rast_time);
 }
 
 
@@ -339,6 +357,8 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    const void *vertex_buffer =
       (void *) get_vert(setup->vertex_buffer, start, stride);
    const boolean flatshade_first = setup->flatshade_first;
+   const int64_t t0 = os_time_get_nano();
+   const uint64_t rast_time = setup->counters[LP_COUNTER_RAST_TIME];
    unsigned i;
 
    if (!lp_setup_update_state(setup, TRUE))
@@ -382,11 +402,22 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       break;
 
    case PIPE_PRIM_TRIANGLES:
-      for (i = 2; i < nr; i += 3) {
-         setup->triangle( setup,
-                          get_vert(vertex_buffer, i-2, stride),
-                          get_vert(vertex_buffer, i-1, stride),
-                          get_vert(vertex_buffer, i-0, stride) );
+      {
+         /* set up and cull four triangles at a time */
+         const_float4_ptr tris[12];
+         unsigned n = 0;
+
+         for (i = 2; i < nr; i += 3) {
+            tris[n++] = get_vert(vertex_buffer, i-2, stride);
+            tris[n++] = get_vert(vertex_buffer, i-1, stride);
+            tris[n++] = get_vert(vertex_buffer, i-0, stride);
+            if (n == ARRAY_SIZE(tris)) {
+               lp_setup_triangle_batch( setup, tris, n / 3 );
+               n = 0;
+            }
+         }
+         if (n)
+            lp_setup_triangle_batch( setup, tris, n / 3 );
       }
       break;
 
@@ -519,6 +550,10 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    default:
       assert(0);
    }
+
+   /* scenes flushed meanwhile are accounted as rasterization */
+   setup->counters[LP_COUNTER_SETUP_TIME] += os_time_get_nano() - t0 -
+      (setup->counters[LP_COUNTER_RAST_TIME] - rast_time);
 }
 
 
@@ -0,0 +1,675 @@
+/**************************************************************************
+ *
+ * Copyright 2017 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Compute shaders.
+ *
+ * The shader is compiled into a function running one vector of
+ * invocations of a work group.  The work groups of a grid are spread over
+ * the rasterizer threads, each thread running whole work groups with their
+ * own shared memory.  Barriers make the function return, and the work
+ * group's vectors are run again from the barrier once they all got there.
+ */
+
+#include "pipe/p_defines.h"
+#include "util/u_atomic.h"
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+#include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
+#include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_intr.h"
+#include "gallivm/lp_bld_logic.h"
+#include "gallivm/lp_bld_tgsi.h"
+#include "gallivm/lp_bld_type.h"
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_flush.h"
+#include "lp_query.h"
+#include "lp_rast.h"
+#include "lp_screen.h"
+#include "lp_state.h"
+#include "lp_state_cs.h"
+#include "lp_texture.h"
+
+
+/** Number of work group ranges per rasterizer thread, for balance */
+#define LP_CS_CHUNKS_PER_THREAD 4
+
+/** Resume index of a vector of invocations which ran to completion */
+#define LP_CS_DONE ~0u
+
+
+static unsigned cs_no = 0;
+
+static const float fake_const_buf[4];
+
+/*
+ * Unbound shader buffers point here, so that the shader can always read
+ * index zero of a buffer, see build_gather().
+ */
+static uint32_t fake_ssbo_buf[4];
+
+
+/**
+ * Vector width of compute shaders, in bits.  This stays at most 256 on
+ * AVX-512 CPUs, as only fragment shaders are 16 wide.
+ */
+static inline unsigned
+cs_vector_width(void)
+{
+   return MIN2(lp_native_vector_width, 256);
+}
+
+
+/**
+ * \return FALSE if the shader has barriers in control flow which can't
+ * be resumed.
+ */
+static boolean
+generate_compute(struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef int8_ptr_type =
+      LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+   LLVMTypeRef arg_types[14];
+   LLVMTypeRef func_type;
+   LLVMValueRef function;
+   LLVMValueRef context_ptr;
+   LLVMValueRef first_invocation;
+   LLVMValueRef temps_ptr;
+   LLVMValueRef resume_index;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   LLVMValueRef invocation, num_invocations, rest;
+   LLVMValueRef lane[LP_MAX_VECTOR_LENGTH];
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   struct lp_type cs_type;
+   struct lp_build_context uint_bld;
+   struct lp_build_mask_context mask;
+   struct lp_bld_tgsi_system_values system_values;
+   struct lp_build_tgsi_cs_iface cs_iface;
+   boolean unsupported_barrier = FALSE;
+   char func_name[64];
+   unsigned i;
+
+   memset(&cs_type, 0, sizeof cs_type);
+   cs_type.floating = TRUE;      /* floating point values */
+   cs_type.sign = TRUE;          /* values are signed */
+   cs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
+   cs_type.width = 32;           /* 32-bit float */
+   cs_type.length = cs_vector_width() / 32;
+
+   util_snprintf(func_name, sizeof(func_name), "cs%u", shader->no);
+
+   /*
+    * Generate the function prototype. Any change here must be reflected in
+    * lp_jit.h's lp_jit_cs_func function pointer type, and vice-versa.
+    */
+   arg_types[0] = variant->jit_context_ptr_type;       /* context */
+   arg_types[1] = int32_type;                          /* block_id_x */
+   arg_types[2] = int32_type;                          /* block_id_y */
+   arg_types[3] = int32_type;                          /* block_id_z */
+   arg_types[4] = int32_type;                          /* grid_size_x */
+   arg_types[5] = int32_type;                          /* grid_size_y */
+   arg_types[6] = int32_type;                          /* grid_size_z */
+   arg_types[7] = int32_type;                          /* block_size_x */
+   arg_types[8] = int32_type;                          /* block_size_y */
+   arg_types[9] = int32_type;                          /* block_size_z */
+   arg_types[10] = int32_type;                         /* first_invocation */
+   arg_types[11] = int8_ptr_type;                      /* shared */
+   arg_types[12] = int8_ptr_type;                      /* temps */
+   arg_types[13] = int32_type;                         /* resume_index */
+
+   func_type = LLVMFunctionType(int32_type, arg_types,
+                                ARRAY_SIZE(arg_types), 0);
+
+   function = LLVMAddFunction(gallivm->module, func_name, func_type);
+   LLVMSetFunctionCallConv(function, LLVMCCallConv);
+
+   variant->function = function;
+
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(function, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   memset(&system_values, 0, sizeof system_values);
+   memset(&cs_iface, 0, sizeof cs_iface);
+
+   context_ptr = LLVMGetParam(function, 0);
+   for (i = 0; i < 3; i++) {
+      system_values.block_id[i] = LLVMGetParam(function, 1 + i);
+      system_values.grid_size[i] = LLVMGetParam(function, 4 + i);
+      system_values.block_size[i] = LLVMGetParam(function, 7 + i);
+   }
+   first_invocation = LLVMGetParam(function, 10);
+   cs_iface.shared_ptr = LLVMGetParam(function, 11);
+   temps_ptr = LLVMGetParam(function, 12);
+   resume_index = LLVMGetParam(function, 13);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(system_values.block_id[0], "block_id_x");
+   lp_build_name(system_values.block_id[1], "block_id_y");
+   lp_build_name(system_values.block_id[2], "block_id_z");
+   lp_build_name(system_values.grid_size[0], "grid_size_x");
+   lp_build_name(system_values.grid_size[1], "grid_size_y");
+   lp_build_name(system_values.grid_size[2], "grid_size_z");
+   lp_build_name(system_values.block_size[0], "block_size_x");
+   lp_build_name(system_values.block_size[1], "block_size_y");
+   lp_build_name(system_values.block_size[2], "block_size_z");
+   lp_build_name(first_invocation, "first_invocation");
+   lp_build_name(cs_iface.shared_ptr, "shared");
+   lp_build_name(temps_ptr, "temps");
+   lp_build_name(resume_index, "resume_index");
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, function, "entry");
+   builder = gallivm->builder;
+   assert(builder);
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   lp_build_context_init(&uint_bld, gallivm, lp_uint_type(cs_type));
+
+   /* linear index of the invocation in each lane */
+   for (i = 0; i < cs_type.length; i++)
+      lane[i] = lp_build_const_int32(gallivm, i);
+   invocation = LLVMBuildAdd(builder,
+                             lp_build_broadcast_scalar(&uint_bld, first_invocation),
+                             LLVMConstVector(lane, cs_type.length),
+                             "invocation");
+
+   rest = LLVMBuildUDiv(builder, invocation,
+                        lp_build_broadcast_scalar(&uint_bld,
+                                                  system_values.block_size[0]),
+                        "");
+   system_values.thread_id[0] =
+      LLVMBuildSub(builder, invocation,
+                   LLVMBuildMul(builder, rest,
+                                lp_build_broadcast_scalar(&uint_bld,
+                                                          system_values.block_size[0]),
+                                ""),
+                   "thread_id_x");
+   system_values.thread_id[2] =
+      LLVMBuildUDiv(builder, rest,
+                    lp_build_broadcast_scalar(&uint_bld,
+                                              system_values.block_size[1]),
+                    "thread_id_z");
+   system_values.thread_id[1] =
+      LLVMBuildSub(builder, rest,
+                   LLVMBuildMul(builder, system_values.thread_id[2],
+                                lp_build_broadcast_scalar(&uint_bld,
+                                                          system_values.block_size[1]),
+                                ""),
+                   "thread_id_y");
+
+   /* the last vector of a work group may be partially filled */
+   num_invocations = LLVMBuildMul(builder,
+                                  LLVMBuildMul(builder,
+                                               system_values.block_size[0],
+                                               system_values.block_size[1], ""),
+                                  system_values.block_size[2], "");
+   lp_build_mask_begin(&mask, gallivm, cs_type,
+                       lp_build_cmp(&uint_bld, PIPE_FUNC_LESS, invocation,
+                                    lp_build_broadcast_scalar(&uint_bld,
+                                                              num_invocations)));
+
+   consts_ptr = lp_jit_cs_context_constants(gallivm, context_ptr);
+   num_consts_ptr = lp_jit_cs_context_num_constants(gallivm, context_ptr);
+
+   cs_iface.ssbo_ptr = lp_jit_cs_context_ssbos(gallivm, context_ptr);
+   cs_iface.ssbo_sizes_ptr = lp_jit_cs_context_num_ssbos(gallivm, context_ptr);
+   cs_iface.shared_size = lp_build_const_int32(gallivm, shader->req_local_mem);
+   if (shader->has_barriers) {
+      cs_iface.temps_ptr = temps_ptr;
+      cs_iface.resume_index = resume_index;
+      cs_iface.unsupported_barrier = &unsupported_barrier;
+   }
+
+   lp_build_tgsi_soa(gallivm, shader->tokens, cs_type, &mask,
+                     consts_ptr, num_consts_ptr, &system_values,
+                     NULL, NULL, context_ptr, NULL,
+                     NULL, &shader->info, NULL, &cs_iface);
+
+   lp_build_mask_end(&mask);
+
+   LLVMBuildRet(builder, lp_build_const_int32(gallivm, 0));
+
+   gallivm_verify_function(gallivm, function);
+
+   return !unsupported_barrier;
+}
+
+
+static void *
+llvmpipe_create_compute_state(struct pipe_context *pipe,
+                              const struct pipe_compute_state *templ)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct lp_compute_shader *shader;
+   struct lp_compute_shader_variant *variant;
+   char module_name[64];
+
+   if (templ->ir_type != PIPE_SHADER_IR_TGSI) {
+      assert(0);
+      return NULL;
+   }
+
+   shader = CALLOC_STRUCT(lp_compute_shader);
+   if (!shader)
+      return NULL;
+
+   shader->no = cs_no++;
+   shader->tokens = tgsi_dup_tokens(templ->prog);
+   if (!shader->tokens)
+      goto fail;
+
+   tgsi_scan_shader(shader->tokens, &shader->info);
+
+   shader->req_local_mem = templ->req_local_mem;
+   shader->has_barriers =
+      shader->info.opcode_count[TGSI_OPCODE_BARRIER] != 0;
+   if (shader->has_barriers) {
+      /* see emit_prologue() */
+      shader->temps_size = (shader->info.file_max[TGSI_FILE_TEMPORARY] + 1) *
+                           TGSI_NUM_CHANNELS * (cs_vector_width() / 8);
+   }
+
+   if (LP_DEBUG & DEBUG_TGSI) {
+      debug_printf("llvmpipe: Create compute shader #%u %p:\n",
+                   shader->no, (void *) shader);
+      tgsi_dump(shader->tokens, 0);
+   }
+
+   util_snprintf(module_name, sizeof(module_name), "cs%u", shader->no);
+
+   variant = &shader->variant;
+   variant->gallivm = gallivm_create(module_name, llvmpipe->context);
+   if (!variant->gallivm)
+      goto fail;
+
+   lp_jit_init_cs_types(variant);
+
+   if (!generate_compute(shader, variant)) {
+      debug_printf("llvmpipe: compute shader #%u has a barrier in "
+                   "unsupported control flow\n", shader->no);
+      gallivm_destroy(variant->gallivm);
+      goto fail;
+   }
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->jit_function = (lp_jit_cs_func)
+      gallivm_jit_function(variant->gallivm, variant->function);
+
+   gallivm_free_ir(variant->gallivm);
+
+   return shader;
+
+fail:
+   FREE((void *) shader->tokens);
+   FREE(shader);
+   return NULL;
+}
+
+
+static void
+llvmpipe_bind_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+
+   llvmpipe->cs = (struct lp_compute_shader *) cs;
+}
+
+
+static void
+llvmpipe_delete_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct lp_compute_shader *shader = cs;
+
+   assert(cs != llvmpipe->cs);
+
+   gallivm_destroy(shader->variant.gallivm);
+   FREE((void *) shader->tokens);
+   FREE(shader);
+}
+
+
+static void
+llvmpipe_set_shader_buffers(struct pipe_context *pipe,
+                            enum pipe_shader_type shader,
+                            unsigned start_slot, unsigned count,
+                            const struct pipe_shader_buffer *buffers)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   assert(shader < PIPE_SHADER_TYPES);
+   assert(start_slot + count <= ARRAY_SIZE(llvmpipe->ssbos[shader]));
+
+   for (i = 0; i < count; i++) {
+      struct pipe_shader_buffer *dst = &llvmpipe->ssbos[shader][start_slot + i];
+
+      if (buffers) {
+         pipe_resource_reference(&dst->buffer, buffers[i].buffer);
+         dst->buffer_offset = buffers[i].buffer_offset;
+         dst->buffer_size = buffers[i].buffer_size;
+      }
+      else {
+         pipe_resource_reference(&dst->buffer, NULL);
+         dst->buffer_offset = 0;
+         dst->buffer_size = 0;
+      }
+   }
+}
+
+
+/**
+ * Fill in the jit context from the bound compute constant and shader
+ * buffers.  The shader accesses the buffers directly, so any pending
+ * rendering using them is finished first.
+ */
+static void
+update_cs_context(struct llvmpipe_context *llvmpipe,
+                  struct lp_jit_cs_context *context)
+{
+   unsigned i;
+
+   for (i = 0; i < LP_MAX_TGSI_CONST_BUFFERS; i++) {
+      const struct pipe_constant_buffer *cb =
+         &llvmpipe->constants[PIPE_SHADER_COMPUTE][i];
+      const ubyte *data = NULL;
+
+      if (cb->buffer)
+         data = (const ubyte *) llvmpipe_resource_data(cb->buffer);
+      else if (cb->user_buffer)
+         data = (const ubyte *) cb->user_buffer;
+
+      if (data) {
+         unsigned size = MIN2(cb->buffer_size, LP_MAX_TGSI_CONST_BUFFER_SIZE);
+         context->constants[i] = (const float *) (data + cb->buffer_offset);
+         context->num_constants[i] = size / (sizeof(float) * 4);
+      }
+      else {
+         context->constants[i] = fake_const_buf;
+         context->num_constants[i] = 0;
+      }
+   }
+
+   for (i = 0; i < LP_MAX_TGSI_SHADER_BUFFERS; i++) {
+      const struct pipe_shader_buffer *sb =
+         &llvmpipe->ssbos[PIPE_SHADER_COMPUTE][i];
+
+      if (sb->buffer) {
+         ubyte *data = (ubyte *) llvmpipe_resource_data(sb->buffer);
+
+         llvmpipe_flush_resource(&llvmpipe->pipe, sb->buffer, 0,
+                                 FALSE, TRUE, FALSE, "compute");
+
+         context->ssbos[i] = (uint32_t *) (data + sb->buffer_offset);
+         context->num_ssbos[i] = sb->buffer_size;
+      }
+      else {
+         context->ssbos[i] = fake_ssbo_buf;
+         context->num_ssbos[i] = 0;
+      }
+   }
+}
+
+
+struct lp_cs_job
+{
+   const struct lp_compute_shader *shader;
+   const struct lp_jit_cs_context *context;
+
+   unsigned grid_size[3];
+   unsigned block_size[3];
+   uint64_t num_groups;
+   uint64_t groups_per_chunk;
+   unsigned num_chunks;
+   unsigned next_chunk;      /**< next range of work groups to run */
+
+   unsigned vector_length;
+   unsigned num_vectors;     /**< per work group */
+   unsigned shared_size;     /**< rounded up */
+   unsigned temps_size;      /**< rounded up */
+
+   /** Shared memory and temporaries, scratch_size bytes for each job */
+   uint8_t *scratch;
+   unsigned scratch_size;
+};
+
+
+/**
+ * Run all the invocations of a work group.
+ */
+static void
+run_work_group(const struct lp_cs_job *job,
+               const unsigned block_id[3],
+               uint8_t *shared,
+               uint8_t *temps,
+               uint32_t *resume)
+{
+   const struct lp_compute_shader *shader = job->shader;
+   lp_jit_cs_func func = shader->variant.jit_function;
+   boolean running;
+   unsigned v;
+
+   if (!shader->has_barriers) {
+      for (v = 0; v < job->num_vectors; v++) {
+         func(job->context,
+              block_id[0], block_id[1], block_id[2],
+              job->grid_size[0], job->grid_size[1], job->grid_size[2],
+              job->block_size[0], job->block_size[1], job->block_size[2],
+              v * job->vector_length, shared, NULL, 0);
+      }
+      return;
+   }
+
+   /*
+    * Run each vector up to the next barrier, until they all finished.
+    * Barriers are in uniform control flow, so all the vectors stop at the
+    * same barrier on each pass.
+    */
+   for (v = 0; v < job->num_vectors; v++)
+      resume[v] = 0;
+
+   do {
+      running = FALSE;
+      for (v = 0; v < job->num_vectors; v++) {
+         if (resume[v] == LP_CS_DONE)
+            continue;
+
+         resume[v] = func(job->context,
+                          block_id[0], block_id[1], block_id[2],
+                          job->grid_size[0], job->grid_size[1], job->grid_size[2],
+                          job->block_size[0], job->block_size[1], job->block_size[2],
+                          v * job->vector_length, shared,
+                          temps + v * shader->temps_size,
+                          resume[v]);
+         if (resume[v])
+            running = TRUE;
+         else
+            resume[v] = LP_CS_DONE;
+      }
+   } while (running);
+}
+
+
+/**
+ * Run ranges of work groups until all have been taken.  Each job has its
+ * own slice of the scratch memory, so that jobs running concurrently never
+ * share it.
+ */
+static void
+cs_job(void *data, unsigned job_index)
+{
+   struct lp_cs_job *job = (struct lp_cs_job *) data;
+   const unsigned groups_per_layer = job->grid_size[0] * job->grid_size[1];
+   uint8_t *shared = job->scratch + job_index * job->scratch_size;
+   uint8_t *temps = NULL;
+   uint32_t *resume = NULL;
+   unsigned chunk;
+
+   if (job->shader->has_barriers) {
+      temps = shared + job->shared_size;
+      resume = (uint32_t *) (temps + job->temps_size);
+   }
+
+   while ((chunk = p_atomic_inc_return(&job->next_chunk) - 1) <
+          job->num_chunks) {
+      const uint64_t first = chunk * job->groups_per_chunk;
+      const uint64_t last = MIN2(first + job->groups_per_chunk,
+                                 job->num_groups);
+      uint64_t group;
+
+      for (group = first; group < last; group++) {
+         unsigned block_id[3];
+
+         block_id[2] = (unsigned) (group / groups_per_layer);
+         block_id[1] = (unsigned) (group % groups_per_layer) / job->grid_size[0];
+         block_id[0] = (unsigned) (group % groups_per_layer) % job->grid_size[0];
+
+         run_work_group(job, block_id, shared, temps, resume);
+      }
+   }
+}
+
+
+static void
+llvmpipe_launch_grid(struct pipe_context *pipe,
+                     const struct pipe_grid_info *info)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct lp_compute_shader *shader = llvmpipe->cs;
+   struct lp_jit_cs_context context;
+   struct lp_cs_job job;
+   unsigned num_threads;
+   unsigned num_invocations;
+   unsigned nr_jobs;
+
+   if (!shader || !shader->variant.jit_function)
+      return;
+
+   if (!llvmpipe_check_render_cond(llvmpipe))
+      return;
+
+   memset(&job, 0, sizeof job);
+
+   if (info->indirect) {
+      const uint32_t *params;
+
+      /* The grid size may have been written by a pending draw */
+      llvmpipe_flush_resource(pipe, info->indirect, 0,
+                              TRUE, TRUE, FALSE, "compute indirect");
+
+      params = (const uint32_t *)
+         ((const ubyte *) llvmpipe_resource_data(info->indirect) +
+          info->indirect_offset);
+
+      job.grid_size[0] = params[0];
+      job.grid_size[1] = params[1];
+      job.grid_size[2] = params[2];
+   }
+   else {
+      job.grid_size[0] = info->grid[0];
+      job.grid_size[1] = info->grid[1];
+      job.grid_size[2] = info->grid[2];
+   }
+
+   job.block_size[0] = info->block[0];
+   job.block_size[1] = info->block[1];
+   job.block_size[2] = info->block[2];
+
+   num_invocations = job.block_size[0] * job.block_size[1] * job.block_size[2];
+   job.num_groups = (uint64_t) job.grid_size[0] * job.grid_size[1] *
+                    job.grid_size[2];
+   if (!num_invocations || !job.num_groups)
+      return;
+
+   update_cs_context(llvmpipe, &context);
+
+   job.shader = shader;
+   job.context = &context;
+   job.vector_length = cs_vector_width() / 32;
+   job.num_vectors = DIV_ROUND_UP(num_invocations, job.vector_length);
+   job.shared_size = align(MAX2(shader->req_local_mem, 16), 16);
+
+   if (shader->has_barriers)
+      job.temps_size = align(shader->temps_size * job.num_vectors, 16);
+   job.scratch_size = align(job.shared_size + job.temps_size +
+                            job.num_vectors * sizeof(uint32_t), 16);
+
+   num_threads = MAX2(screen->num_threads, 1);
+   job.groups_per_chunk = DIV_ROUND_UP(job.num_groups,
+                                       num_threads * LP_CS_CHUNKS_PER_THREAD);
+   job.num_chunks = (unsigned) DIV_ROUND_UP(job.num_groups,
+                                            job.groups_per_chunk);
+   nr_jobs = MIN2(num_threads, job.num_chunks);
+
+   job.scratch = align_malloc((size_t) job.scratch_size * nr_jobs, 16);
+   if (!job.scratch) {
+      _debug_printf("llvmpipe: out of memory for compute shader scratch, "
+                    "dispatch of %u work groups dropped\n",
+                    (unsigned) job.num_groups);
+      return;
+   }
+
+   mtx_lock(&screen->rast_mutex);
+   lp_rast_run_jobs(screen->rast, cs_job, &job, nr_jobs);
+   mtx_unlock(&screen->rast_mutex);
+
+   align_free(job.scratch);
+
+   if (llvmpipe->active_statistics_queries) {
+      llvmpipe->pipeline_statistics.cs_invocations +=
+         job.num_groups * num_invocations;
+   }
+}
+
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe)
+{
+   llvmpipe->pipe.create_compute_state = llvmpipe_create_compute_state;
+   llvmpipe->pipe.bind_compute_state = llvmpipe_bind_compute_state;
+   llvmpipe->pipe.delete_compute_state = llvmpipe_delete_compute_state;
+   llvmpipe->pipe.set_shader_buffers = llvmpipe_set_shader_buffers;
+   llvmpipe->pipe.launch_grid = llvmpipe_launch_grid;
+}
@@ -0,0 +1,81 @@
+/**************************************************************************
+ *
+ * Copyright 2017 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#ifndef LP_STATE_CS_H
+#define LP_STATE_CS_H
+
+#include "pipe/p_state.h"
+#include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
+#include "gallivm/lp_bld.h"
+#include "lp_jit.h"
+
+struct gallivm_state;
+struct llvmpipe_context;
+
+
+struct lp_compute_shader_variant
+{
+   struct gallivm_state *gallivm;
+
+   LLVMTypeRef jit_context_ptr_type;
+
+   LLVMValueRef function;
+   lp_jit_cs_func jit_function;
+};
+
+
+/**
+ * Subclass of pipe_compute_state.
+ *
+ * There are no variants depending on state: the shader is compiled when
+ * created.
+ */
+struct lp_compute_shader
+{
+   const struct tgsi_token *tokens;
+   struct tgsi_shader_info info;
+
+   unsigned no;
+   unsigned req_local_mem;
+
+   /** Whether the shader has barriers and must be resumable */
+   boolean has_barriers;
+
+   /** Size in bytes of the temporaries of a vector of invocations, which
+    * are kept in memory across barriers; zero without barriers.
+    */
+   unsigned temps_size;
+
+   struct lp_compute_shader_variant variant;
+};
+
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe);
+
+
+#endif /* LP_STATE_CS_H */
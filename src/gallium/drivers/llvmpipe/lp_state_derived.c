@@ -25,6 +25,7 @@
  * 
  **************************************************************************/
 
+#include "util/u_framebuffer.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "pipe/p_shader_tokens.h"
@@ -209,12 +210,16 @@ void llvmpipe_update_derived( struct llvmpipe_context *llvmpipe )
                           LP_NEW_OCCLUSION_QUERY))
       llvmpipe_update_fs( llvmpipe );
 
-   if (llvmpipe->dirty & (LP_NEW_RASTERIZER)) {
+   if (llvmpipe->dirty & (LP_NEW_RASTERIZER |
+                          LP_NEW_FRAMEBUFFER)) {
+      unsigned nr_samples =
+         MAX2(util_framebuffer_get_num_samples(&llvmpipe->framebuffer), 1);
       boolean discard =
-         (llvmpipe->sample_mask & 1) == 0 ||
+         (llvmpipe->sample_mask & ((1 << nr_samples) - 1)) == 0 ||
          (llvmpipe->rasterizer ? llvmpipe->rasterizer->rasterizer_discard : FALSE);
 
       lp_setup_set_rasterizer_discard(llvmpipe->setup, discard);
+      lp_setup_set_sample_mask(llvmpipe->setup, llvmpipe->sample_mask);
    }
 
    if (llvmpipe->dirty & (LP_NEW_FS |
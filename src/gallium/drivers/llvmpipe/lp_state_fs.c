@@ -63,6 +63,7 @@
 #include "util/u_memory.h"
 #include "util/u_pointer.h"
 #include "util/u_format.h"
+#include "util/u_framebuffer.h"
 #include "util/u_dump.h"
 #include "util/u_string.h"
 #include "util/simple_list.h"
@@ -287,6 +288,134 @@ lp_build_depth_clamp(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Per sample part of multisampled fragment processing.  The shader ran
+ * once per pixel, now combine the pixel mask with the coverage of each
+ * sample and do the depth/stencil test and write for each sample, with z
+ * interpolated at the sample position unless the shader wrote it.
+ * The final sample masks are left in sample_mask_store for blending.
+ */
+static void
+generate_fs_samples(struct gallivm_state *gallivm,
+                    const struct lp_fragment_shader_variant_key *key,
+                    struct lp_type type,
+                    const struct util_format_description *zs_format_desc,
+                    unsigned depth_mode,
+                    struct lp_build_interp_soa_context *interp,
+                    struct lp_build_mask_context *mask,
+                    LLVMValueRef sample_mask_store,
+                    LLVMValueRef num_loop,
+                    LLVMValueRef loop_counter,
+                    LLVMValueRef z,
+                    boolean z_per_sample,
+                    LLVMValueRef stencil_refs[2],
+                    LLVMValueRef facing,
+                    LLVMValueRef context_ptr,
+                    LLVMValueRef thread_data_ptr,
+                    LLVMValueRef depth_ptr,
+                    LLVMValueRef depth_stride,
+                    LLVMValueRef depth_sample_stride)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context f32_bld;
+   LLVMValueRef dzdx = NULL, dzdy = NULL;
+   LLVMValueRef counter = NULL;
+   LLVMValueRef covered;
+   unsigned s;
+
+   lp_build_context_init(&f32_bld, gallivm, type);
+   covered = lp_build_const_int_vec(gallivm, lp_int_type(type), 0);
+
+   if ((depth_mode & LATE_DEPTH_TEST) && z_per_sample) {
+      LLVMValueRef zchan = lp_build_const_int32(gallivm, 2);
+      dzdx = lp_build_extract_broadcast(gallivm, interp->setup_bld.type, type,
+                                        interp->dadxaos[0], zchan);
+      dzdy = lp_build_extract_broadcast(gallivm, interp->setup_bld.type, type,
+                                        interp->dadyaos[0], zchan);
+   }
+
+   if (key->occlusion_count) {
+      counter = lp_jit_thread_data_counter(gallivm, thread_data_ptr);
+      lp_build_name(counter, "counter");
+   }
+
+   for (s = 0; s < LP_MAX_SAMPLES; s++) {
+      LLVMValueRef index, smask_ptr, smask;
+
+      index = LLVMBuildMul(builder, num_loop,
+                           lp_build_const_int32(gallivm, s), "");
+      index = LLVMBuildAdd(builder, index, loop_counter, "");
+      smask_ptr = LLVMBuildGEP(builder, sample_mask_store, &index, 1,
+                               "sample_mask_ptr");
+      smask = LLVMBuildAnd(builder,
+                           LLVMBuildLoad(builder, smask_ptr, ""),
+                           lp_build_mask_value(mask), "");
+
+      if (depth_mode & LATE_DEPTH_TEST) {
+         struct lp_build_mask_context smask_ctx;
+         LLVMValueRef z_s = z;
+         LLVMValueRef z_fb, s_fb, z_value, s_value;
+         LLVMValueRef offset, sample_depth_ptr;
+
+         if (dzdx) {
+            z_s = lp_build_mad(&f32_bld, dzdx,
+                               lp_build_const_vec(gallivm, type,
+                                                  lp_sample_pos_4x[s][0] / 8.0),
+                               z_s);
+            z_s = lp_build_mad(&f32_bld, dzdy,
+                               lp_build_const_vec(gallivm, type,
+                                                  lp_sample_pos_4x[s][1] / 8.0),
+                               z_s);
+         }
+         if (key->depth_clamp) {
+            z_s = lp_build_depth_clamp(gallivm, builder, type, context_ptr,
+                                       thread_data_ptr, z_s);
+         }
+
+         offset = LLVMBuildMul(builder, depth_sample_stride,
+                               lp_build_const_int32(gallivm, s), "");
+         sample_depth_ptr = LLVMBuildGEP(builder, depth_ptr, &offset, 1, "");
+
+         lp_build_mask_begin(&smask_ctx, gallivm, type, smask);
+
+         lp_build_depth_stencil_load_swizzled(gallivm, type,
+                                              zs_format_desc, key->resource_1d,
+                                              sample_depth_ptr, depth_stride,
+                                              &z_fb, &s_fb, loop_counter);
+         lp_build_depth_stencil_test(gallivm,
+                                     &key->depth,
+                                     key->stencil,
+                                     type,
+                                     zs_format_desc,
+                                     &smask_ctx,
+                                     stencil_refs,
+                                     z_s, z_fb, s_fb,
+                                     facing,
+                                     &z_value, &s_value,
+                                     FALSE);
+         if (depth_mode & LATE_DEPTH_WRITE) {
+            lp_build_depth_stencil_write_swizzled(gallivm, type,
+                                                  zs_format_desc, key->resource_1d,
+                                                  NULL, NULL, NULL, loop_counter,
+                                                  sample_depth_ptr, depth_stride,
+                                                  z_value, s_value);
+         }
+
+         smask = lp_build_mask_end(&smask_ctx);
+      }
+
+      if (counter) {
+         lp_build_occlusion_count(gallivm, type, smask, counter);
+      }
+
+      LLVMBuildStore(builder, smask, smask_ptr);
+      covered = LLVMBuildOr(builder, covered, smask, "");
+   }
+
+   lp_build_mask_update(mask, covered);
+}
+
+
 /**
  * Generate the fragment shader, depth/stencil test, and alpha tests.
  */
@@ -301,9 +430,11 @@ generate_fs_loop(struct gallivm_state *gallivm,
                  struct lp_build_interp_soa_context *interp,
                  struct lp_build_sampler_soa *sampler,
                  LLVMValueRef mask_store,
+                 LLVMValueRef sample_mask_store,
                  LLVMValueRef (*out_color)[4],
                  LLVMValueRef depth_ptr,
                  LLVMValueRef depth_stride,
+                 LLVMValueRef depth_sample_stride,
                  LLVMValueRef facing,
                  LLVMValueRef thread_data_ptr)
 {
@@ -375,6 +506,14 @@ generate_fs_loop(struct gallivm_state *gallivm,
                                         (key->stencil[1].enabled &&
                                          key->stencil[1].writemask))))
          depth_mode &= ~(LATE_DEPTH_WRITE | EARLY_DEPTH_WRITE);
+
+      /* Multisampled depth/stencil is tested per sample, after the shader */
+      if (key->multisample) {
+         if (depth_mode & (EARLY_DEPTH_WRITE | LATE_DEPTH_WRITE))
+            depth_mode = LATE_DEPTH_TEST | LATE_DEPTH_WRITE;
+         else
+            depth_mode = LATE_DEPTH_TEST;
+      }
    }
    else {
       depth_mode = 0;
@@ -479,7 +618,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
                      consts_ptr, num_consts_ptr, &system_values,
                      interp->inputs,
                      outputs, context_ptr, thread_data_ptr,
-                     sampler, &shader->info.base, NULL);
+                     sampler, &shader->info.base, NULL, NULL);
 
    /* Alpha test */
    if (key->alpha.enabled) {
@@ -545,13 +684,15 @@ generate_fs_loop(struct gallivm_state *gallivm,
       int s_out = find_output_by_semantic(&shader->info.base,
                                           TGSI_SEMANTIC_STENCIL,
                                           0);
+      boolean z_per_sample = TRUE;
       if (pos0 != -1 && outputs[pos0][2]) {
          z = LLVMBuildLoad(builder, outputs[pos0][2], "output.z");
+         z_per_sample = FALSE;
       }
       /*
        * Clamp according to ARB_depth_clamp semantics.
        */
-      if (key->depth_clamp) {
+      if (key->depth_clamp && !key->multisample) {
          z = lp_build_depth_clamp(gallivm, builder, type, context_ptr,
                                   thread_data_ptr, z);
       }
@@ -565,30 +706,49 @@ generate_fs_loop(struct gallivm_state *gallivm,
          stencil_refs[1] = stencil_refs[0];
       }
 
-      lp_build_depth_stencil_load_swizzled(gallivm, type,
-                                           zs_format_desc, key->resource_1d,
-                                           depth_ptr, depth_stride,
-                                           &z_fb, &s_fb, loop_state.counter);
-
-      lp_build_depth_stencil_test(gallivm,
-                                  &key->depth,
-                                  key->stencil,
-                                  type,
-                                  zs_format_desc,
-                                  &mask,
-                                  stencil_refs,
-                                  z, z_fb, s_fb,
-                                  facing,
-                                  &z_value, &s_value,
-                                  !simple_shader);
-      /* Late Z write */
-      if (depth_mode & LATE_DEPTH_WRITE) {
-         lp_build_depth_stencil_write_swizzled(gallivm, type,
-                                               zs_format_desc, key->resource_1d,
-                                               NULL, NULL, NULL, loop_state.counter,
-                                               depth_ptr, depth_stride,
-                                               z_value, s_value);
+      if (key->multisample) {
+         generate_fs_samples(gallivm, key, type, zs_format_desc, depth_mode,
+                             interp, &mask, sample_mask_store, num_loop,
+                             loop_state.counter, z, z_per_sample,
+                             stencil_refs, facing, context_ptr,
+                             thread_data_ptr, depth_ptr, depth_stride,
+                             depth_sample_stride);
       }
+      else {
+         lp_build_depth_stencil_load_swizzled(gallivm, type,
+                                              zs_format_desc, key->resource_1d,
+                                              depth_ptr, depth_stride,
+                                              &z_fb, &s_fb, loop_state.counter);
+
+         lp_build_depth_stencil_test(gallivm,
+                                     &key->depth,
+                                     key->stencil,
+                                     type,
+                                     zs_format_desc,
+                                     &mask,
+                                     stencil_refs,
+                                     z, z_fb, s_fb,
+                                     facing,
+                                     &z_value, &s_value,
+                                     !simple_shader);
+         /* Late Z write */
+         if (depth_mode & LATE_DEPTH_WRITE) {
+            lp_build_depth_stencil_write_swizzled(gallivm, type,
+                                                  zs_format_desc, key->resource_1d,
+                                                  NULL, NULL, NULL, loop_state.counter,
+                                                  depth_ptr, depth_stride,
+                                                  z_value, s_value);
+         }
+      }
+   }
+   else if (key->multisample) {
+      /* no depth/stencil, just the coverage */
+      generate_fs_samples(gallivm, key, type, zs_format_desc, depth_mode,
+                          interp, &mask, sample_mask_store, num_loop,
+                          loop_state.counter, z, FALSE,
+                          stencil_refs, facing, context_ptr,
+                          thread_data_ptr, depth_ptr, depth_stride,
+                          depth_sample_stride);
    }
    else if ((depth_mode & EARLY_DEPTH_TEST) &&
             (depth_mode & LATE_DEPTH_WRITE))
@@ -628,7 +788,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
       }
    }
 
-   if (key->occlusion_count) {
+   if (key->occlusion_count && !key->multisample) {
       LLVMValueRef counter = lp_jit_thread_data_counter(gallivm, thread_data_ptr);
       lp_build_name(counter, "counter");
       lp_build_occlusion_count(gallivm, type,
@@ -1819,7 +1979,9 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
    undef_src_val = lp_build_undef(gallivm, fs_type);
 
    row_type.length = fs_type.length;
-   vector_width    = dst_type.floating ? lp_native_vector_width : lp_integer_vector_width;
+   /* fs_type may be narrower than the native width (see split_fs_outputs) */
+   vector_width    = dst_type.floating ? fs_type.width * fs_type.length :
+                                         lp_integer_vector_width;
 
    /* Compute correct swizzle and count channels */
    memset(swizzle, LP_BLD_SWIZZLE_DONTCARE, TGSI_NUM_CHANNELS);
@@ -2390,6 +2552,54 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Split 16-wide fragment shader outputs into two 8-wide halves (quads 01 and
+ * 23 of the stamp), as the blending code only deals with up to 8-wide
+ * vectors.
+ */
+static void
+split_fs_outputs(struct gallivm_state *gallivm,
+                 struct lp_type fs_type,
+                 unsigned num_halves,
+                 unsigned num_cbufs,
+                 LLVMValueRef fs_mask[16 / 4],
+                 LLVMValueRef fs_out_color[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS][16 / 4])
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type half_type = fs_type;
+   LLVMTypeRef half_vec_type;
+   LLVMValueRef mask = fs_mask[0];
+   unsigned cbuf, chan, i;
+
+   assert(fs_type.length == 16);
+   half_type.length = 8;
+   half_vec_type = lp_build_vec_type(gallivm, half_type);
+
+   for (cbuf = 0; cbuf < num_cbufs; cbuf++) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
+         LLVMValueRef color = LLVMBuildLoad(builder, fs_out_color[cbuf][chan][0], "");
+         LLVMValueRef store = lp_build_array_alloca(gallivm, half_vec_type,
+                                                    lp_build_const_int32(gallivm, num_halves),
+                                                    "color_half");
+
+         for (i = 0; i < num_halves; i++) {
+            LLVMValueRef index = lp_build_const_int32(gallivm, i);
+            LLVMValueRef ptr = LLVMBuildGEP(builder, store, &index, 1, "");
+
+            LLVMBuildStore(builder,
+                           lp_build_extract_range(gallivm, color, i * 8, 8),
+                           ptr);
+            fs_out_color[cbuf][chan][i] = ptr;
+         }
+      }
+   }
+
+   for (i = 0; i < num_halves; i++) {
+      fs_mask[i] = lp_build_extract_range(gallivm, mask, i * 8, 8);
+   }
+}
+
+
 /**
  * Generate the runtime callable function for the whole fragment pipeline.
  * Note that the function which we generate operates on a block of 16
@@ -2410,9 +2620,10 @@ generate_fragment(struct llvmpipe_context *lp,
    struct lp_type blend_type;
    LLVMTypeRef fs_elem_type;
    LLVMTypeRef blend_vec_type;
-   LLVMTypeRef arg_types[13];
+   LLVMTypeRef arg_types[15];
    LLVMTypeRef func_type;
    LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef int64_type = LLVMInt64TypeInContext(gallivm->context);
    LLVMTypeRef int8_type = LLVMInt8TypeInContext(gallivm->context);
    LLVMValueRef context_ptr;
    LLVMValueRef x;
@@ -2424,6 +2635,8 @@ generate_fragment(struct llvmpipe_context *lp,
    LLVMValueRef stride_ptr;
    LLVMValueRef depth_ptr;
    LLVMValueRef depth_stride;
+   LLVMValueRef sample_stride_ptr;
+   LLVMValueRef depth_sample_stride;
    LLVMValueRef mask_input;
    LLVMValueRef thread_data_ptr;
    LLVMBasicBlockRef block;
@@ -2431,11 +2644,13 @@ generate_fragment(struct llvmpipe_context *lp,
    struct lp_build_sampler_soa *sampler;
    struct lp_build_interp_soa_context interp;
    LLVMValueRef fs_mask[16 / 4];
+   LLVMValueRef fs_sample_mask[LP_MAX_SAMPLES][16 / 4];
    LLVMValueRef fs_out_color[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS][16 / 4];
    LLVMValueRef function;
    LLVMValueRef facing;
    unsigned num_fs;
-   unsigned i;
+   unsigned num_samples = key->multisample ? LP_MAX_SAMPLES : 1;
+   unsigned i, s;
    unsigned chan;
    unsigned cbuf;
    boolean cbuf0_write_all;
@@ -2498,10 +2713,12 @@ generate_fragment(struct llvmpipe_context *lp,
    arg_types[6] = LLVMPointerType(fs_elem_type, 0);    /* dady */
    arg_types[7] = LLVMPointerType(LLVMPointerType(blend_vec_type, 0), 0);  /* color */
    arg_types[8] = LLVMPointerType(int8_type, 0);       /* depth */
-   arg_types[9] = int32_type;                          /* mask_input */
+   arg_types[9] = int64_type;                          /* mask_input */
    arg_types[10] = variant->jit_thread_data_ptr_type;  /* per thread data */
    arg_types[11] = LLVMPointerType(int32_type, 0);     /* stride */
    arg_types[12] = int32_type;                         /* depth_stride */
+   arg_types[13] = LLVMPointerType(int32_type, 0);     /* sample_stride */
+   arg_types[14] = int32_type;                         /* depth_sample_stride */
 
    func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
                                 arg_types, ARRAY_SIZE(arg_types), 0);
@@ -2531,6 +2748,8 @@ generate_fragment(struct llvmpipe_context *lp,
    thread_data_ptr  = LLVMGetParam(function, 10);
    stride_ptr   = LLVMGetParam(function, 11);
    depth_stride = LLVMGetParam(function, 12);
+   sample_stride_ptr = LLVMGetParam(function, 13);
+   depth_sample_stride = LLVMGetParam(function, 14);
 
    lp_build_name(context_ptr, "context");
    lp_build_name(x, "x");
@@ -2544,6 +2763,8 @@ generate_fragment(struct llvmpipe_context *lp,
    lp_build_name(thread_data_ptr, "thread_data");
    lp_build_name(stride_ptr, "stride_ptr");
    lp_build_name(depth_stride, "depth_stride");
+   lp_build_name(sample_stride_ptr, "sample_stride_ptr");
+   lp_build_name(depth_sample_stride, "depth_sample_stride");
 
    /*
     * Function body
@@ -2559,7 +2780,7 @@ generate_fragment(struct llvmpipe_context *lp,
 
    num_fs = 16 / fs_type.length; /* number of loops per 4x4 stamp */
    /* for 1d resources only run "upper half" of stamp */
-   if (key->resource_1d)
+   if (key->resource_1d && num_fs > 1)
       num_fs /= 2;
 
    {
@@ -2567,6 +2788,7 @@ generate_fragment(struct llvmpipe_context *lp,
       LLVMTypeRef mask_type = lp_build_int_vec_type(gallivm, fs_type);
       LLVMValueRef mask_store = lp_build_array_alloca(gallivm, mask_type,
                                                       num_loop, "mask_store");
+      LLVMValueRef sample_mask_store = NULL;
       LLVMValueRef color_store[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS];
       boolean pixel_center_integer =
          shader->info.base.properties[TGSI_PROPERTY_FS_COORD_PIXEL_CENTER];
@@ -2586,6 +2808,19 @@ generate_fragment(struct llvmpipe_context *lp,
                                a0_ptr, dadx_ptr, dady_ptr,
                                x, y);
 
+      /*
+       * The mask input has 16 bits of coverage per sample.  Multisampled
+       * variants shade the pixels with any sample covered, and keep the
+       * coverage of the samples for the depth test and blending.
+       */
+      if (key->multisample) {
+         sample_mask_store =
+            lp_build_array_alloca(gallivm, mask_type,
+                                  lp_build_const_int32(gallivm,
+                                                       num_fs * LP_MAX_SAMPLES),
+                                  "sample_mask_store");
+      }
+
       for (i = 0; i < num_fs; i++) {
          LLVMValueRef mask;
          LLVMValueRef indexi = lp_build_const_int32(gallivm, i);
@@ -2593,11 +2828,37 @@ generate_fragment(struct llvmpipe_context *lp,
                                               &indexi, 1, "mask_ptr");
 
          if (partial_mask) {
-            mask = generate_quad_mask(gallivm, fs_type,
-                                      i*fs_type.length/4, mask_input);
+            mask = NULL;
+            for (s = 0; s < num_samples; s++) {
+               LLVMValueRef smask, sample_input;
+
+               sample_input = LLVMBuildLShr(builder, mask_input,
+                                            LLVMConstInt(int64_type, 16 * s, 0),
+                                            "");
+               sample_input = LLVMBuildTrunc(builder, sample_input,
+                                             int32_type, "");
+               smask = generate_quad_mask(gallivm, fs_type,
+                                          i*fs_type.length/4, sample_input);
+               mask = mask ? LLVMBuildOr(builder, mask, smask, "") : smask;
+
+               if (sample_mask_store) {
+                  LLVMValueRef index =
+                     lp_build_const_int32(gallivm, s * num_fs + i);
+                  LLVMBuildStore(builder, smask,
+                                 LLVMBuildGEP(builder, sample_mask_store,
+                                              &index, 1, ""));
+               }
+            }
          }
          else {
             mask = lp_build_const_int_vec(gallivm, fs_type, ~0);
+            for (s = 0; sample_mask_store && s < num_samples; s++) {
+               LLVMValueRef index =
+                  lp_build_const_int32(gallivm, s * num_fs + i);
+               LLVMBuildStore(builder, mask,
+                              LLVMBuildGEP(builder, sample_mask_store,
+                                           &index, 1, ""));
+            }
          }
          LLVMBuildStore(builder, mask, mask_ptr);
       }
@@ -2611,9 +2872,11 @@ generate_fragment(struct llvmpipe_context *lp,
                        &interp,
                        sampler,
                        mask_store, /* output */
+                       sample_mask_store, /* output */
                        color_store,
                        depth_ptr,
                        depth_stride,
+                       depth_sample_stride,
                        facing,
                        thread_data_ptr);
 
@@ -2622,6 +2885,11 @@ generate_fragment(struct llvmpipe_context *lp,
          LLVMValueRef ptr = LLVMBuildGEP(builder, mask_store,
                                          &indexi, 1, "");
          fs_mask[i] = LLVMBuildLoad(builder, ptr, "mask");
+         for (s = 0; sample_mask_store && s < num_samples; s++) {
+            LLVMValueRef index = lp_build_const_int32(gallivm, s * num_fs + i);
+            ptr = LLVMBuildGEP(builder, sample_mask_store, &index, 1, "");
+            fs_sample_mask[s][i] = LLVMBuildLoad(builder, ptr, "sample_mask");
+         }
          /* This is fucked up need to reorganize things */
          for (cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
             for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
@@ -2645,6 +2913,20 @@ generate_fragment(struct llvmpipe_context *lp,
 
    sampler->destroy(sampler);
 
+   if (fs_type.length == 16) {
+      unsigned num_halves = key->resource_1d ? 1 : 2;
+
+      split_fs_outputs(gallivm, fs_type, num_halves,
+                       MAX2(key->nr_cbufs, dual_source_blend ? 2 : 0),
+                       fs_mask, fs_out_color);
+      for (s = 0; key->multisample && s < num_samples; s++) {
+         split_fs_outputs(gallivm, fs_type, num_halves, 0,
+                          fs_sample_mask[s], NULL);
+      }
+      fs_type.length = 8;
+      num_fs = num_halves;
+   }
+
    /* Loop over color outputs / color buffers to do blending.
     */
    for(cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
@@ -2669,11 +2951,43 @@ generate_fragment(struct llvmpipe_context *lp,
                                 LLVMBuildGEP(builder, stride_ptr, &index, 1, ""),
                                 "");
 
-         generate_unswizzled_blend(gallivm, cbuf, variant,
-                                   key->cbuf_format[cbuf],
-                                   num_fs, fs_type, fs_mask, fs_out_color,
-                                   context_ptr, color_ptr, stride,
-                                   partial_mask, do_branch);
+         if (key->multisample) {
+            /* blend the pixels' color into each covered sample */
+            LLVMValueRef sample_stride =
+               LLVMBuildLoad(builder,
+                             LLVMBuildGEP(builder, sample_stride_ptr,
+                                          &index, 1, ""),
+                             "");
+
+            for (s = 0; s < num_samples; s++) {
+               LLVMValueRef offset =
+                  LLVMBuildMul(builder, sample_stride,
+                               lp_build_const_int32(gallivm, s), "");
+               LLVMValueRef sample_color_ptr =
+                  LLVMBuildBitCast(builder, color_ptr,
+                                   LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0),
+                                   "");
+
+               sample_color_ptr = LLVMBuildGEP(builder, sample_color_ptr,
+                                               &offset, 1, "");
+               sample_color_ptr = LLVMBuildBitCast(builder, sample_color_ptr,
+                                                   LLVMTypeOf(color_ptr), "");
+
+               generate_unswizzled_blend(gallivm, cbuf, variant,
+                                         key->cbuf_format[cbuf],
+                                         num_fs, fs_type, fs_sample_mask[s],
+                                         fs_out_color, context_ptr,
+                                         sample_color_ptr, stride,
+                                         partial_mask, do_branch);
+            }
+         }
+         else {
+            generate_unswizzled_blend(gallivm, cbuf, variant,
+                                      key->cbuf_format[cbuf],
+                                      num_fs, fs_type, fs_mask, fs_out_color,
+                                      context_ptr, color_ptr, stride,
+                                      partial_mask, do_branch);
+         }
       }
    }
 
@@ -2693,6 +3007,9 @@ dump_fs_variant_key(const struct lp_fragment_shader_variant_key *key)
    if (key->flatshade) {
       debug_printf("flatshade = 1\n");
    }
+   if (key->multisample) {
+      debug_printf("multisample = 1\n");
+   }
    for (i = 0; i < key->nr_cbufs; ++i) {
       debug_printf("cbuf_format[%u] = %s\n", i, util_format_name(key->cbuf_format[i]));
    }
@@ -2843,6 +3160,40 @@ generate_variant(struct llvmpipe_context *lp,
          !shader->info.base.writes_samplemask
       ? TRUE : FALSE;
 
+   /*
+    * Hierarchical z only understands the "less" family of depth tests on
+    * the interpolated z value. Stencil is excluded since depth failures
+    * may still update the stencil buffer.
+    */
+   variant->hiz_reject =
+         key->depth.enabled &&
+         (key->depth.func == PIPE_FUNC_LESS ||
+          key->depth.func == PIPE_FUNC_LEQUAL ||
+          key->depth.func == PIPE_FUNC_EQUAL) &&
+         !key->stencil[0].enabled &&
+         !key->depth_clamp &&
+         !shader->info.base.writes_z
+      ? TRUE : FALSE;
+
+   variant->hiz_update =
+         variant->hiz_reject &&
+         key->depth.writemask &&
+         key->depth.func != PIPE_FUNC_EQUAL &&
+         !key->alpha.enabled &&
+         !key->blend.alpha_to_coverage &&
+         !shader->info.base.uses_kill &&
+         !shader->info.base.writes_samplemask
+      ? TRUE : FALSE;
+
+   variant->hiz_invalidate =
+         key->depth.enabled &&
+         key->depth.writemask &&
+         key->depth.func != PIPE_FUNC_NEVER &&
+         key->depth.func != PIPE_FUNC_LESS &&
+         key->depth.func != PIPE_FUNC_LEQUAL &&
+         key->depth.func != PIPE_FUNC_EQUAL
+      ? TRUE : FALSE;
+
    if ((shader->info.base.num_tokens <= 1) &&
        !key->depth.enabled && !key->stencil[0].enabled) {
       variant->ps_inv_multiplier = 0;
@@ -3116,7 +3467,7 @@ llvmpipe_set_constant_buffer(struct pipe_context *pipe,
       draw_set_mapped_constant_buffer(llvmpipe->draw, shader,
                                       index, data, size);
    }
-   else {
+   else if (shader == PIPE_SHADER_FRAGMENT) {
       llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
    }
 
@@ -3148,6 +3499,22 @@ force_dst_alpha_one(unsigned factor, boolean clamped_zero)
 }
 
 
+/**
+ * Get the static texture state, including the llvmpipe specific layout of
+ * the texture.
+ */
+static void
+make_texture_state(struct lp_static_texture_state *state,
+                   const struct pipe_sampler_view *view)
+{
+   lp_sampler_static_texture_state(state, view);
+
+   if (view && view->texture) {
+      state->tiled = llvmpipe_resource_is_tiled(view->texture);
+   }
+}
+
+
 /**
  * We need to generate several variants of the fragment pipeline to match
  * all the combinations of the contributing state atoms.
@@ -3214,6 +3581,7 @@ make_variant_key(struct llvmpipe_context *lp,
    /* alpha.ref_value is passed in jit_context */
 
    key->flatshade = lp->rasterizer->flatshade;
+   key->multisample = util_framebuffer_get_num_samples(&lp->framebuffer) > 1;
    if (lp->active_occlusion_queries) {
       key->occlusion_count = TRUE;
    }
@@ -3324,8 +3692,8 @@ make_variant_key(struct llvmpipe_context *lp,
       key->nr_sampler_views = shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
       for(i = 0; i < key->nr_sampler_views; ++i) {
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW] & (1 << i)) {
-            lp_sampler_static_texture_state(&key->state[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            make_texture_state(&key->state[i].texture_state,
+                               lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
@@ -3333,8 +3701,8 @@ make_variant_key(struct llvmpipe_context *lp,
       key->nr_sampler_views = key->nr_samplers;
       for(i = 0; i < key->nr_sampler_views; ++i) {
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
-            lp_sampler_static_texture_state(&key->state[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            make_texture_state(&key->state[i].texture_state,
+                               lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
@@ -77,6 +77,7 @@ struct lp_fragment_shader_variant_key
    unsigned occlusion_count:1;
    unsigned resource_1d:1;
    unsigned depth_clamp:1;
+   unsigned multisample:1;      /* fb is multisampled, see generate_fragment */
 
    enum pipe_format zsbuf_format;
    enum pipe_format cbuf_format[PIPE_MAX_COLOR_BUFS];
@@ -100,6 +101,16 @@ struct lp_fragment_shader_variant
    boolean opaque;
    uint8_t ps_inv_multiplier;
 
+   /*
+    * Hierarchical z (see lp_rast_priv.h): whether blocks known to be
+    * occluded may be skipped, whether fully covered blocks lower the
+    * per-block depth bound, and whether the bounds must be discarded
+    * because depth values may grow.
+    */
+   boolean hiz_reject;
+   boolean hiz_update;
+   boolean hiz_invalidate;
+
    struct gallivm_state *gallivm;
 
    LLVMTypeRef jit_context_ptr_type;
@@ -140,6 +140,12 @@ llvmpipe_set_sampler_views(struct pipe_context *pipe,
       }
       pipe_sampler_view_reference(&llvmpipe->sampler_views[shader][start + i],
                                   views[i]);
+
+      /* the draw module only samples linear textures */
+      if (views[i] && views[i]->texture &&
+          (shader == PIPE_SHADER_VERTEX || shader == PIPE_SHADER_GEOMETRY)) {
+         llvmpipe_resource_untile(pipe, views[i]->texture);
+      }
    }
 
    /* find highest non-null sampler_views[] entry */
@@ -332,6 +338,8 @@ prepare_shader_sampling(
                                  i,
                                  width0, tex->height0, num_layers,
                                  first_level, last_level,
+                                 MAX2(tex->nr_samples, 1),
+                                 lp_tex->sample_stride,
                                  addr,
                                  row_stride, img_stride, mip_offsets);
       }
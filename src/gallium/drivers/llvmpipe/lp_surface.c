@@ -27,6 +27,7 @@
 
 #include "util/u_rect.h"
 #include "util/u_surface.h"
+#include "lp_blit.h"
 #include "lp_context.h"
 #include "lp_flush.h"
 #include "lp_limits.h"
@@ -42,6 +43,11 @@ lp_resource_copy(struct pipe_context *pipe,
                  struct pipe_resource *src, unsigned src_level,
                  const struct pipe_box *src_box)
 {
+   if (llvmpipe_direct_copy_region(llvmpipe_context(pipe),
+                                   dst, dst_level, dstx, dsty, dstz,
+                                   src, src_level, src_box))
+      return;
+
    llvmpipe_flush_resource(pipe,
                            dst, dst_level,
                            FALSE, /* read_only */
@@ -70,15 +76,20 @@ static void lp_blit(struct pipe_context *pipe,
    if (blit_info->render_condition_enable && !llvmpipe_check_render_cond(lp))
       return;
 
-   if (info.src.resource->nr_samples > 1 &&
-       info.dst.resource->nr_samples <= 1 &&
-       !util_format_is_depth_or_stencil(info.src.resource->format) &&
-       !util_format_is_pure_integer(info.src.resource->format)) {
-      debug_printf("llvmpipe: color resolve unimplemented\n");
-      return;
+   if (util_try_blit_via_copy_region(pipe, &info)) {
+      return; /* done */
    }
 
-   if (util_try_blit_via_copy_region(pipe, &info)) {
+   /*
+    * Scissored, scaled or flipped multisample blits are left to
+    * util_blitter, which fetches the samples with TXF.
+    */
+   if (info.src.resource->nr_samples > 1) {
+      if (llvmpipe_direct_resolve(lp, &info)) {
+         return; /* done */
+      }
+   }
+   else if (llvmpipe_direct_blit(lp, &info)) {
       return; /* done */
    }
 
@@ -104,7 +115,7 @@ static void lp_blit(struct pipe_context *pipe,
    util_blitter_save_blend(lp->blitter, (void*)lp->blend);
    util_blitter_save_depth_stencil_alpha(lp->blitter, (void*)lp->depth_stencil);
    util_blitter_save_stencil_ref(lp->blitter, &lp->stencil_ref);
-   /*util_blitter_save_sample_mask(sp->blitter, lp->sample_mask);*/
+   util_blitter_save_sample_mask(lp->blitter, lp->sample_mask);
    util_blitter_save_framebuffer(lp->blitter, &lp->framebuffer);
    util_blitter_save_fragment_sampler_states(lp->blitter,
                      lp->num_samplers[PIPE_SHADER_FRAGMENT],
@@ -198,6 +209,10 @@ llvmpipe_clear_render_target(struct pipe_context *pipe,
    if (render_condition_enabled && !llvmpipe_check_render_cond(llvmpipe))
       return;
 
+   if (llvmpipe_direct_clear_color(llvmpipe, dst, color,
+                                   dstx, dsty, width, height))
+      return;
+
    util_clear_render_target(pipe, dst, color,
                             dstx, dsty, width, height);
 }
@@ -218,6 +233,11 @@ llvmpipe_clear_depth_stencil(struct pipe_context *pipe,
    if (render_condition_enabled && !llvmpipe_check_render_cond(llvmpipe))
       return;
 
+   if (llvmpipe_direct_clear_depth_stencil(llvmpipe, dst, clear_flags,
+                                           depth, stencil,
+                                           dstx, dsty, width, height))
+      return;
+
    util_clear_depth_stencil(pipe, dst, clear_flags,
                             depth, stencil,
                             dstx, dsty, width, height);
@@ -0,0 +1,294 @@
+/**************************************************************************
+ *
+ * Copyright 2017 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/**
+ * @file
+ * Unit tests for compute shaders: work group and invocation ids, shader
+ * buffers, shared memory and barriers.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "state_tracker/sw_winsys.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_inlines.h"
+
+#include "lp_public.h"
+#include "lp_test.h"
+
+
+#define TEST_BLOCK_SIZE 64
+#define TEST_GRID_SIZE 3
+#define TEST_INVOCATIONS (TEST_BLOCK_SIZE * TEST_GRID_SIZE)
+
+
+/*
+ * Each invocation puts its id in shared memory and, after a barrier,
+ * writes its neighbour's id plus the work group's first invocation
+ * index to the buffer.  Work groups span several vectors, so this only
+ * passes if the barrier waits for all of them.
+ */
+static const char barrier_text[] =
+   "COMP\n"
+   "DCL SV[0], THREAD_ID[0]\n"
+   "DCL SV[1], BLOCK_ID[0]\n"
+   "DCL BUFFER[0]\n"
+   "DCL MEMORY[0], SHARED\n"
+   "DCL TEMP[0..2]\n"
+   "IMM[0] UINT32 { 4, 63, 64, 1 }\n"
+   "  0: UMUL TEMP[0].x, SV[0].xxxx, IMM[0].xxxx\n"
+   "  1: STORE MEMORY[0].x, TEMP[0].xxxx, SV[0].xxxx\n"
+   "  2: BARRIER\n"
+   "  3: UADD TEMP[1].x, SV[0].xxxx, IMM[0].wwww\n"
+   "  4: AND TEMP[1].x, TEMP[1].xxxx, IMM[0].yyyy\n"
+   "  5: UMUL TEMP[1].x, TEMP[1].xxxx, IMM[0].xxxx\n"
+   "  6: LOAD TEMP[2].x, MEMORY[0], TEMP[1].xxxx\n"
+   "  7: UMAD TEMP[2].x, SV[1].xxxx, IMM[0].zzzz, TEMP[2].xxxx\n"
+   "  8: UMAD TEMP[0].x, SV[1].xxxx, IMM[0].zzzz, SV[0].xxxx\n"
+   "  9: UMUL TEMP[0].x, TEMP[0].xxxx, IMM[0].xxxx\n"
+   " 10: STORE BUFFER[0].x, TEMP[0].xxxx, TEMP[2].xxxx\n"
+   " 11: END\n";
+
+/* A barrier the invocations may take different paths to */
+static const char switch_barrier_text[] =
+   "COMP\n"
+   "DCL SV[0], THREAD_ID[0]\n"
+   "DCL MEMORY[0], SHARED\n"
+   "IMM[0] UINT32 { 0, 0, 0, 0 }\n"
+   "  0: SWITCH SV[0].xxxx\n"
+   "  1: CASE IMM[0].xxxx\n"
+   "  2: BARRIER\n"
+   "  3: BRK\n"
+   "  4: ENDSWITCH\n"
+   "  5: END\n";
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "test\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp, const char *test, boolean success)
+{
+   fprintf(fp, "%s\t%s\n", success ? "pass" : "fail", test);
+   fflush(fp);
+}
+
+
+static void
+test_winsys_destroy(struct sw_winsys *ws)
+{
+}
+
+
+static boolean
+test_winsys_is_displaytarget_format_supported(struct sw_winsys *ws,
+                                              unsigned tex_usage,
+                                              enum pipe_format format)
+{
+   return FALSE;
+}
+
+
+static void *
+create_cs(struct pipe_context *pipe, const char *text)
+{
+   struct pipe_compute_state state;
+   struct tgsi_token tokens[256];
+
+   if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens)))
+      return NULL;
+
+   memset(&state, 0, sizeof state);
+   state.ir_type = PIPE_SHADER_IR_TGSI;
+   state.prog = tokens;
+   state.req_local_mem = TEST_BLOCK_SIZE * 4;
+
+   return pipe->create_compute_state(pipe, &state);
+}
+
+
+static boolean
+test_barrier(unsigned verbose, struct pipe_context *pipe)
+{
+   struct pipe_resource *buf;
+   struct pipe_shader_buffer sb;
+   struct pipe_grid_info info;
+   uint32_t data[TEST_INVOCATIONS];
+   boolean success = TRUE;
+   void *cs;
+   unsigned i;
+
+   cs = create_cs(pipe, barrier_text);
+   if (!cs)
+      return FALSE;
+
+   buf = pipe_buffer_create(pipe->screen, PIPE_BIND_SHADER_BUFFER,
+                            PIPE_USAGE_DEFAULT, sizeof data);
+   if (!buf) {
+      pipe->delete_compute_state(pipe, cs);
+      return FALSE;
+   }
+
+   memset(&sb, 0, sizeof sb);
+   sb.buffer = buf;
+   sb.buffer_size = sizeof data;
+   pipe->set_shader_buffers(pipe, PIPE_SHADER_COMPUTE, 0, 1, &sb);
+   pipe->bind_compute_state(pipe, cs);
+
+   memset(&info, 0, sizeof info);
+   info.work_dim = 1;
+   info.block[0] = TEST_BLOCK_SIZE;
+   info.block[1] = 1;
+   info.block[2] = 1;
+   info.grid[0] = TEST_GRID_SIZE;
+   info.grid[1] = 1;
+   info.grid[2] = 1;
+   pipe->launch_grid(pipe, &info);
+
+   pipe_buffer_read(pipe, buf, 0, sizeof data, data);
+
+   for (i = 0; i < TEST_INVOCATIONS; i++) {
+      unsigned block = i / TEST_BLOCK_SIZE;
+      unsigned thread = i % TEST_BLOCK_SIZE;
+      uint32_t ref = block * TEST_BLOCK_SIZE +
+                     (thread + 1) % TEST_BLOCK_SIZE;
+
+      if (data[i] != ref) {
+         if (verbose)
+            printf("block %u thread %u: %u, expected %u\n",
+                   block, thread, data[i], ref);
+         success = FALSE;
+      }
+   }
+
+   pipe->bind_compute_state(pipe, NULL);
+   pipe->delete_compute_state(pipe, cs);
+   pipe->set_shader_buffers(pipe, PIPE_SHADER_COMPUTE, 0, 1, NULL);
+   pipe_resource_reference(&buf, NULL);
+
+   return success;
+}
+
+
+/**
+ * Barriers which can't be resumed must fail the shader instead of being
+ * skipped.
+ */
+static boolean
+test_switch_barrier(unsigned verbose, struct pipe_context *pipe)
+{
+   void *cs = create_cs(pipe, switch_barrier_text);
+
+   if (cs) {
+      if (verbose)
+         printf("barrier in a switch accepted\n");
+      pipe->delete_compute_state(pipe, cs);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   struct sw_winsys winsys;
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   boolean success = TRUE, test_success;
+
+   memset(&winsys, 0, sizeof winsys);
+   winsys.destroy = test_winsys_destroy;
+   winsys.is_displaytarget_format_supported =
+      test_winsys_is_displaytarget_format_supported;
+
+   screen = llvmpipe_create_screen(&winsys);
+   if (!screen)
+      return FALSE;
+
+   /* not available with this LLVM version */
+   if (!screen->get_param(screen, PIPE_CAP_COMPUTE)) {
+      screen->destroy(screen);
+      return TRUE;
+   }
+
+   pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe) {
+      screen->destroy(screen);
+      return FALSE;
+   }
+
+   test_success = test_barrier(verbose, pipe);
+   if (fp)
+      write_tsv_row(fp, "barrier", test_success);
+   if (!test_success)
+      success = FALSE;
+
+   test_success = test_switch_barrier(verbose, pipe);
+   if (fp)
+      write_tsv_row(fp, "switch_barrier", test_success);
+   if (!test_success)
+      success = FALSE;
+
+   pipe->destroy(pipe);
+   screen->destroy(screen);
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   printf("no test_single()");
+   return TRUE;
+}
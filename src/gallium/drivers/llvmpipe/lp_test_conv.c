@@ -344,6 +344,11 @@ const struct lp_type conv_types[] = {
    {   TRUE, FALSE, FALSE,  TRUE,    32,   8 },
    {   TRUE, FALSE, FALSE, FALSE,    32,   8 },
 
+   {   TRUE, FALSE,  TRUE,  TRUE,    32,  16 },
+   {   TRUE, FALSE,  TRUE, FALSE,    32,  16 },
+   {   TRUE, FALSE, FALSE,  TRUE,    32,  16 },
+   {   TRUE, FALSE, FALSE, FALSE,    32,  16 },
+
    /* Fixed */
    {  FALSE,  TRUE,  TRUE,  TRUE,    32,   4 },
    {  FALSE,  TRUE,  TRUE, FALSE,    32,   4 },
@@ -366,6 +371,11 @@ const struct lp_type conv_types[] = {
    {  FALSE, FALSE, FALSE,  TRUE,    32,   8 },
    {  FALSE, FALSE, FALSE, FALSE,    32,   8 },
 
+   {  FALSE, FALSE,  TRUE,  TRUE,    32,  16 },
+   {  FALSE, FALSE,  TRUE, FALSE,    32,  16 },
+   {  FALSE, FALSE, FALSE,  TRUE,    32,  16 },
+   {  FALSE, FALSE, FALSE, FALSE,    32,  16 },
+
    {  FALSE, FALSE,  TRUE,  TRUE,    16,   8 },
    {  FALSE, FALSE,  TRUE, FALSE,    16,   8 },
    {  FALSE, FALSE, FALSE,  TRUE,    16,   8 },
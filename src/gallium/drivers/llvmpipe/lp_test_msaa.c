@@ -0,0 +1,567 @@
+/**************************************************************************
+ *
+ * Copyright 2017 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/**
+ * @file
+ * Unit tests for the multisample edge function offsets, the resolve
+ * of 8-bit unorm samples, and the rasterization of triangles at 4x.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "state_tracker/sw_winsys.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_inlines.h"
+#include "util/u_simple_shaders.h"
+
+#include "lp_blit.h"
+#include "lp_public.h"
+#include "lp_rast.h"
+#include "lp_test.h"
+
+
+#define TEST_RESOLVE_BYTES 67
+
+#define TEST_RAST_SIZE 32
+
+/** Each sample a triangle covers is incremented by this, saturating */
+#define TEST_RAST_COLOR 128
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "test\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp, const char *test, boolean success)
+{
+   fprintf(fp, "%s\t%s\n", success ? "pass" : "fail", test);
+   fflush(fp);
+}
+
+
+/**
+ * Compare the sample offsets of a plane against evaluating the edge
+ * function at the sample positions.
+ */
+static boolean
+test_plane(unsigned verbose, int32_t dcdx, int32_t dcdy)
+{
+   int32_t m = lp_rast_plane_sample_max_offset(dcdx, dcdy);
+   boolean success = TRUE;
+   unsigned s;
+
+   for (s = 0; s < LP_MAX_SAMPLES; s++) {
+      double x = lp_sample_pos_4x[s][0] / 8.0;
+      double y = lp_sample_pos_4x[s][1] / 8.0;
+      double ref = dcdy * y - dcdx * x;
+      int32_t off = lp_rast_plane_sample_offset(dcdx, dcdy, s);
+
+      if (off != ref || off > m || off < -m) {
+         if (verbose)
+            printf("dcdx %d dcdy %d sample %u: offset %d, expected %f, max %d\n",
+                   dcdx, dcdy, s, off, ref, m);
+         success = FALSE;
+      }
+   }
+
+   return success;
+}
+
+
+static boolean
+test_planes(unsigned verbose, FILE *fp, unsigned long n)
+{
+   boolean success = TRUE;
+   unsigned long i;
+
+   for (i = 0; i < n; i++) {
+      int32_t dcdx = ((rand() % 2049) - 1024) * FIXED_ONE;
+      int32_t dcdy = ((rand() % 2049) - 1024) * FIXED_ONE;
+
+      if (!test_plane(verbose, dcdx, dcdy))
+         success = FALSE;
+   }
+
+   if (fp)
+      write_tsv_row(fp, "plane_offsets", success);
+
+   return success;
+}
+
+
+static boolean
+test_resolve(unsigned verbose, FILE *fp, unsigned long n)
+{
+   uint8_t src[LP_MAX_SAMPLES][TEST_RESOLVE_BYTES];
+   uint8_t dst[TEST_RESOLVE_BYTES];
+   boolean success = TRUE;
+   unsigned long i;
+   unsigned bytes, j, s;
+
+   for (i = 0; i < n; i++) {
+      bytes = 1 + i % TEST_RESOLVE_BYTES;
+
+      for (s = 0; s < LP_MAX_SAMPLES; s++)
+         for (j = 0; j < bytes; j++)
+            src[s][j] = rand() & 0xff;
+
+      llvmpipe_resolve_row_unorm8(dst, src[0], TEST_RESOLVE_BYTES, bytes);
+
+      for (j = 0; j < bytes; j++) {
+         double sum = 0.0;
+         unsigned ref;
+
+         for (s = 0; s < LP_MAX_SAMPLES; s++)
+            sum += src[s][j];
+         ref = (unsigned)floor(sum / LP_MAX_SAMPLES + 0.5);
+
+         if (dst[j] != ref) {
+            if (verbose)
+               printf("resolve %u %u %u %u: %u, expected %u\n",
+                      src[0][j], src[1][j], src[2][j], src[3][j],
+                      dst[j], ref);
+            success = FALSE;
+         }
+      }
+   }
+
+   if (fp)
+      write_tsv_row(fp, "resolve_unorm8", success);
+
+   return success;
+}
+
+
+struct test_rast_case
+{
+   const char *name;
+   unsigned sample_mask;
+   unsigned num_tris;
+   float tris[2][3][2];
+};
+
+
+/*
+ * Window coordinates, so the pixel centers are at .5.  The shared edge
+ * of the split quad goes through sample 0 of the pixels on the diagonal
+ * (but not through a sample at its ends), to check that those samples
+ * are covered exactly once.
+ */
+static const struct test_rast_case test_rast_cases[] = {
+   { "rast_sliver", 0xf, 1,
+     { { { 2.1f, 1.3f }, { 29.7f, 3.9f }, { 2.3f, 2.2f } } } },
+   { "rast_edge_on", 0xf, 1,
+     { { { 1.2f, 30.7f }, { 30.6f, 1.1f }, { 30.9f, 1.4f } } } },
+   { "rast_partial", 0xf, 1,
+     { { { 3.3f, 5.1f }, { 27.9f, 11.4f }, { 9.6f, 30.2f } } } },
+   { "rast_shared_edge", 0xf, 2,
+     { { { 4.125f, 3.875f }, { 28.9f, 3.3f }, { 28.625f, 28.375f } },
+       { { 4.125f, 3.875f }, { 28.625f, 28.375f }, { 3.7f, 27.6f } } } },
+   { "rast_sample_mask", 0x5, 1,
+     { { { 3.3f, 5.1f }, { 27.9f, 11.4f }, { 9.6f, 30.2f } } } },
+};
+
+
+/**
+ * Where a sample lies relative to a triangle: 1 inside, 0 on an edge,
+ * -1 outside.  Computed in the rasterizer's fixed point, where the pixel
+ * centers are at integer coordinates.
+ */
+static int
+test_rast_classify(const float tri[3][2], unsigned x, unsigned y, unsigned s)
+{
+   int64_t v[3][2], area;
+   int64_t px = x * FIXED_ONE + lp_sample_pos_4x[s][0] * (FIXED_ONE / 8);
+   int64_t py = y * FIXED_ONE + lp_sample_pos_4x[s][1] * (FIXED_ONE / 8);
+   boolean on_edge = FALSE;
+   unsigned i;
+
+   for (i = 0; i < 3; i++) {
+      v[i][0] = lrintf((tri[i][0] - 0.5f) * FIXED_ONE);
+      v[i][1] = lrintf((tri[i][1] - 0.5f) * FIXED_ONE);
+   }
+
+   area = (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) -
+          (v[1][1] - v[0][1]) * (v[2][0] - v[0][0]);
+
+   for (i = 0; i < 3; i++) {
+      const int64_t *a = v[i], *b = v[(i + 1) % 3];
+      int64_t e = (b[0] - a[0]) * (py - a[1]) - (b[1] - a[1]) * (px - a[0]);
+
+      if (area < 0)
+         e = -e;
+      if (e < 0)
+         return -1;
+      if (e == 0)
+         on_edge = TRUE;
+   }
+
+   return on_edge ? 0 : 1;
+}
+
+
+/**
+ * Expected resolved value of a pixel, or -1 if a sample lies on an outer
+ * edge, where the fill convention decides.
+ */
+static int
+test_rast_reference(const struct test_rast_case *tc, unsigned x, unsigned y)
+{
+   unsigned sum = 0;
+   unsigned s, t;
+
+   for (s = 0; s < LP_MAX_SAMPLES; s++) {
+      unsigned inside = 0, on_edge = 0, count;
+
+      for (t = 0; t < tc->num_tris; t++) {
+         int c = test_rast_classify(tc->tris[t], x, y, s);
+         inside += c > 0;
+         on_edge += c == 0;
+      }
+
+      if (on_edge == 0)
+         count = inside;
+      else if (on_edge == 2 && inside == 0)
+         count = 1; /* on the shared edge, which exactly one triangle owns */
+      else
+         return -1;
+
+      if (!(tc->sample_mask & (1 << s)))
+         count = 0;
+
+      sum += MIN2(count * TEST_RAST_COLOR, 255);
+   }
+
+   return (sum + LP_MAX_SAMPLES / 2) / LP_MAX_SAMPLES;
+}
+
+
+static void
+test_winsys_destroy(struct sw_winsys *ws)
+{
+}
+
+
+static boolean
+test_winsys_is_displaytarget_format_supported(struct sw_winsys *ws,
+                                              unsigned tex_usage,
+                                              enum pipe_format format)
+{
+   return FALSE;
+}
+
+
+static struct pipe_resource *
+test_rast_create_target(struct pipe_screen *screen, unsigned nr_samples)
+{
+   struct pipe_resource templ;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_R8G8B8A8_UNORM;
+   templ.width0 = TEST_RAST_SIZE;
+   templ.height0 = TEST_RAST_SIZE;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.nr_samples = nr_samples;
+   templ.bind = PIPE_BIND_RENDER_TARGET | PIPE_BIND_SAMPLER_VIEW;
+
+   return screen->resource_create(screen, &templ);
+}
+
+
+/**
+ * Draw the triangles of a case into a 4x target with additive blending,
+ * resolve it, and compare each pixel against the sample coverage
+ * computed on the CPU.
+ */
+static boolean
+test_rast_draw(unsigned verbose, struct pipe_context *pipe,
+               const struct test_rast_case *tc,
+               struct pipe_resource *ms, struct pipe_resource *ss)
+{
+   static const union pipe_color_union black;
+   struct pipe_surface surf_templ, *surf;
+   struct pipe_framebuffer_state fb;
+   struct pipe_vertex_buffer vbuf;
+   struct pipe_draw_info info;
+   struct pipe_blit_info blit;
+   struct pipe_transfer *transfer;
+   float verts[6][4];
+   const uint8_t *map;
+   boolean success = TRUE;
+   unsigned i, j, x, y;
+
+   for (i = 0; i < tc->num_tris; i++) {
+      for (j = 0; j < 3; j++) {
+         verts[i * 3 + j][0] = tc->tris[i][j][0];
+         verts[i * 3 + j][1] = tc->tris[i][j][1];
+         verts[i * 3 + j][2] = 0.0f;
+         verts[i * 3 + j][3] = 1.0f;
+      }
+   }
+
+   memset(&surf_templ, 0, sizeof surf_templ);
+   surf_templ.format = ms->format;
+   surf = pipe->create_surface(pipe, ms, &surf_templ);
+   if (!surf)
+      return FALSE;
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = TEST_RAST_SIZE;
+   fb.height = TEST_RAST_SIZE;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = surf;
+   pipe->set_framebuffer_state(pipe, &fb);
+   pipe->set_sample_mask(pipe, tc->sample_mask);
+   pipe->clear(pipe, PIPE_CLEAR_COLOR0, &black, 0.0, 0);
+
+   memset(&vbuf, 0, sizeof vbuf);
+   vbuf.stride = sizeof verts[0];
+   vbuf.is_user_buffer = true;
+   vbuf.buffer.user = verts;
+   pipe->set_vertex_buffers(pipe, 0, 1, &vbuf);
+
+   memset(&info, 0, sizeof info);
+   info.mode = PIPE_PRIM_TRIANGLES;
+   info.count = tc->num_tris * 3;
+   info.instance_count = 1;
+   info.max_index = info.count - 1;
+   pipe->draw_vbo(pipe, &info);
+
+   memset(&blit, 0, sizeof blit);
+   blit.src.resource = ms;
+   blit.src.format = ms->format;
+   blit.src.box.width = TEST_RAST_SIZE;
+   blit.src.box.height = TEST_RAST_SIZE;
+   blit.src.box.depth = 1;
+   blit.dst.resource = ss;
+   blit.dst.format = ss->format;
+   blit.dst.box = blit.src.box;
+   blit.mask = PIPE_MASK_RGBA;
+   blit.filter = PIPE_TEX_FILTER_NEAREST;
+   pipe->blit(pipe, &blit);
+
+   map = pipe_transfer_map(pipe, ss, 0, 0, PIPE_TRANSFER_READ,
+                           0, 0, TEST_RAST_SIZE, TEST_RAST_SIZE, &transfer);
+   if (!map) {
+      pipe_surface_reference(&surf, NULL);
+      return FALSE;
+   }
+
+   for (y = 0; y < TEST_RAST_SIZE; y++) {
+      for (x = 0; x < TEST_RAST_SIZE; x++) {
+         int ref = test_rast_reference(tc, x, y);
+         int val = map[y * transfer->stride + x * 4];
+
+         /* the shader's 0.5 may round either way */
+         if (ref >= 0 && abs(val - ref) > 1) {
+            if (verbose)
+               printf("%s: pixel %u,%u is %d, expected %d\n",
+                      tc->name, x, y, val, ref);
+            success = FALSE;
+         }
+      }
+   }
+
+   pipe->transfer_unmap(pipe, transfer);
+   pipe_surface_reference(&surf, NULL);
+
+   return success;
+}
+
+
+/**
+ * Rasterize thin, edge-on, partially covering and edge sharing triangles
+ * at 4x through the pipe interface, and check the resolved coverage.
+ */
+static boolean
+test_rast(unsigned verbose, FILE *fp)
+{
+   static const char fs_text[] =
+      "FRAG\n"
+      "DCL OUT[0], COLOR\n"
+      "IMM[0] FLT32 { 0.5020, 0.5020, 0.5020, 0.5020 }\n"
+      "  0: MOV OUT[0], IMM[0]\n"
+      "  1: END\n";
+   const uint semantic_names[] = { TGSI_SEMANTIC_POSITION };
+   const uint semantic_indexes[] = { 0 };
+   struct sw_winsys winsys;
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   struct pipe_resource *ms, *ss;
+   struct pipe_blend_state blend;
+   struct pipe_depth_stencil_alpha_state dsa;
+   struct pipe_rasterizer_state rast;
+   struct pipe_vertex_element velem;
+   struct pipe_shader_state fs_state;
+   struct tgsi_token tokens[64];
+   void *blend_cso, *dsa_cso, *rast_cso, *velem_cso, *vs, *fs;
+   boolean success = TRUE;
+   unsigned i;
+
+   memset(&winsys, 0, sizeof winsys);
+   winsys.destroy = test_winsys_destroy;
+   winsys.is_displaytarget_format_supported =
+      test_winsys_is_displaytarget_format_supported;
+
+   screen = llvmpipe_create_screen(&winsys);
+   if (!screen)
+      return FALSE;
+   pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe) {
+      screen->destroy(screen);
+      return FALSE;
+   }
+
+   ms = test_rast_create_target(screen, LP_MAX_SAMPLES);
+   ss = test_rast_create_target(screen, 0);
+   if (!ms || !ss ||
+       !tgsi_text_translate(fs_text, tokens, ARRAY_SIZE(tokens))) {
+      success = FALSE;
+      goto out;
+   }
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].blend_enable = 1;
+   blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+   blend.rt[0].rgb_src_factor = PIPE_BLENDFACTOR_ONE;
+   blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_ONE;
+   blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+   blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+   blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_ONE;
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   blend_cso = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, blend_cso);
+
+   memset(&dsa, 0, sizeof dsa);
+   dsa_cso = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   pipe->bind_depth_stencil_alpha_state(pipe, dsa_cso);
+
+   memset(&rast, 0, sizeof rast);
+   rast.cull_face = PIPE_FACE_NONE;
+   rast.half_pixel_center = 1;
+   rast.multisample = 1;
+   rast.depth_clip = 1;
+   rast_cso = pipe->create_rasterizer_state(pipe, &rast);
+   pipe->bind_rasterizer_state(pipe, rast_cso);
+
+   memset(&velem, 0, sizeof velem);
+   velem.src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   velem_cso = pipe->create_vertex_elements_state(pipe, 1, &velem);
+   pipe->bind_vertex_elements_state(pipe, velem_cso);
+
+   /* window space positions, so there's no viewport transform */
+   vs = util_make_vertex_passthrough_shader(pipe, 1, semantic_names,
+                                            semantic_indexes, TRUE);
+   pipe->bind_vs_state(pipe, vs);
+
+   memset(&fs_state, 0, sizeof fs_state);
+   fs_state.tokens = tokens;
+   fs = pipe->create_fs_state(pipe, &fs_state);
+   pipe->bind_fs_state(pipe, fs);
+
+   for (i = 0; i < ARRAY_SIZE(test_rast_cases); i++) {
+      boolean case_success =
+         test_rast_draw(verbose, pipe, &test_rast_cases[i], ms, ss);
+
+      if (fp)
+         write_tsv_row(fp, test_rast_cases[i].name, case_success);
+      if (!case_success)
+         success = FALSE;
+   }
+
+   pipe->bind_fs_state(pipe, NULL);
+   pipe->delete_fs_state(pipe, fs);
+   pipe->bind_vs_state(pipe, NULL);
+   pipe->delete_vs_state(pipe, vs);
+   pipe->bind_vertex_elements_state(pipe, NULL);
+   pipe->delete_vertex_elements_state(pipe, velem_cso);
+   pipe->bind_rasterizer_state(pipe, NULL);
+   pipe->delete_rasterizer_state(pipe, rast_cso);
+   pipe->bind_depth_stencil_alpha_state(pipe, NULL);
+   pipe->delete_depth_stencil_alpha_state(pipe, dsa_cso);
+   pipe->bind_blend_state(pipe, NULL);
+   pipe->delete_blend_state(pipe, blend_cso);
+
+out:
+   pipe_resource_reference(&ms, NULL);
+   pipe_resource_reference(&ss, NULL);
+   pipe->destroy(pipe);
+   screen->destroy(screen);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_some(verbose, fp, 1000);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   boolean success = TRUE;
+
+   if (!test_planes(verbose, fp, n))
+      success = FALSE;
+   if (!test_resolve(verbose, fp, n))
+      success = FALSE;
+   if (!test_rast(verbose, fp))
+      success = FALSE;
+
+   return success;
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   printf("no test_single()");
+   return TRUE;
+}
@@ -0,0 +1,442 @@
+/**************************************************************************
+ *
+ * Copyright 2018 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Benchmark of bilinear and trilinear sampling from textures stored in the
+ * linear and in the 4x4 tiled layout (see LP_TILED_TEXTURES).
+ *
+ * Both layouts hold the same texels, so the results of the two are also
+ * compared against each other.  Note tiled textures never take the AoS
+ * filtering path, which linear rgba8 textures may use.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "util/u_memory.h"
+
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_sample.h"
+#include "lp_jit.h"
+#include "lp_state_fs.h"
+#include "lp_tex_sample.h"
+#include "lp_test.h"
+
+
+#define TEST_TEX_SIZE 256
+#define TEST_TEX_LEVELS 9
+
+/** Pixels per side of the screen area which gets textured */
+#define TEST_GRID_SIZE 64
+
+#define TEST_NUM_PIXELS (TEST_GRID_SIZE * TEST_GRID_SIZE)
+
+
+typedef void (*sample_test_ptr_t)(struct lp_jit_context *context,
+                                  const void *s, const void *t, void *texel);
+
+
+struct sample_test_filter
+{
+   const char *name;
+   unsigned min_mip_filter;
+   /** texels per pixel, which picks the mip level */
+   float scale;
+};
+
+
+static const struct sample_test_filter filters[] = {
+   { "bilinear",  PIPE_TEX_MIPFILTER_NONE,   0.8f },
+   { "trilinear", PIPE_TEX_MIPFILTER_LINEAR, 2.75f },
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cycles_per_pixel\t"
+           "filter\t"
+           "layout\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp, const char *filter, const char *layout,
+              double cycles, boolean success)
+{
+   fprintf(fp, "%s\t%.2f\t%s\t%s\n", success ? "pass" : "fail",
+           cycles, filter, layout);
+   fflush(fp);
+}
+
+
+/**
+ * A mipmapped rgba8 texture, with each level padded to whole 4x4 tiles so
+ * the same layout description fits both the linear and the tiled texels.
+ */
+struct sample_test_texture
+{
+   struct lp_jit_texture jit;
+   uint8_t *linear;
+   uint8_t *tiled;
+};
+
+
+static void
+init_texture(struct sample_test_texture *tex)
+{
+   const unsigned cpp = 4;
+   unsigned level, size = 0;
+   unsigned i, x, y;
+
+   memset(tex, 0, sizeof *tex);
+
+   tex->jit.width = TEST_TEX_SIZE;
+   tex->jit.height = TEST_TEX_SIZE;
+   tex->jit.depth = 1;
+   tex->jit.first_level = 0;
+   tex->jit.last_level = TEST_TEX_LEVELS - 1;
+
+   for (level = 0; level < TEST_TEX_LEVELS; level++) {
+      const unsigned width = u_minify(TEST_TEX_SIZE, level);
+      const unsigned height = u_minify(TEST_TEX_SIZE, level);
+
+      tex->jit.row_stride[level] = align(width, 4) * cpp;
+      tex->jit.img_stride[level] = tex->jit.row_stride[level] * align(height, 4);
+      tex->jit.mip_offsets[level] = size;
+      size += tex->jit.img_stride[level];
+   }
+
+   tex->linear = align_malloc(size, 64);
+   tex->tiled = align_malloc(size, 64);
+
+   for (i = 0; i < size; i++)
+      tex->linear[i] = rand();
+   memset(tex->tiled, 0, size);
+
+   for (level = 0; level < TEST_TEX_LEVELS; level++) {
+      const unsigned width = u_minify(TEST_TEX_SIZE, level);
+      const unsigned height = u_minify(TEST_TEX_SIZE, level);
+      const unsigned stride = tex->jit.row_stride[level];
+      const uint8_t *src = tex->linear + tex->jit.mip_offsets[level];
+      uint8_t *dst = tex->tiled + tex->jit.mip_offsets[level];
+
+      for (y = 0; y < height; y++) {
+         for (x = 0; x < width; x++) {
+            memcpy(dst + (y & ~3) * stride +
+                   ((x & ~3) * 4 + (y & 3) * 4 + (x & 3)) * cpp,
+                   src + y * stride + x * cpp, cpp);
+         }
+      }
+   }
+}
+
+
+/**
+ * Texture coordinates of a rotated and scaled screen area, in the order the
+ * fragment shader sees them: each vector holds a row of 2x2 pixel quads.
+ */
+static void
+init_coords(struct lp_type type, float scale, float *s, float *t)
+{
+   const float angle = 0.5f;
+   const float ds = cosf(angle) * scale / TEST_TEX_SIZE;
+   const float dt = sinf(angle) * scale / TEST_TEX_SIZE;
+   unsigned x, y, i, n = 0;
+
+   for (y = 0; y < TEST_GRID_SIZE; y += 2) {
+      for (x = 0; x < TEST_GRID_SIZE; x += type.length / 2) {
+         for (i = 0; i < type.length; i++) {
+            const float px = x + (i / 4) * 2 + (i & 1) + 0.5f;
+            const float py = y + ((i >> 1) & 1) + 0.5f;
+
+            s[n] = px * ds - py * dt + 0.1f;
+            t[n] = px * dt + py * ds + 0.3f;
+            n++;
+         }
+      }
+   }
+
+   assert(n == TEST_NUM_PIXELS);
+}
+
+
+static LLVMValueRef
+add_sample_test(struct gallivm_state *gallivm,
+                LLVMTypeRef context_ptr_type,
+                struct lp_build_sampler_soa *sampler,
+                struct lp_type type)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMModuleRef module = gallivm->module;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef vec_type = lp_build_vec_type(gallivm, type);
+   LLVMTypeRef args[4];
+   LLVMValueRef func;
+   LLVMValueRef texel_ptr;
+   LLVMBasicBlockRef block;
+   LLVMValueRef coords[5];
+   LLVMValueRef offsets[3] = { NULL };
+   LLVMValueRef texel[4];
+   struct lp_sampler_params params;
+   unsigned i;
+
+   args[0] = context_ptr_type;
+   args[1] = args[2] = args[3] = LLVMPointerType(vec_type, 0);
+
+   func = LLVMAddFunction(module, "sample",
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, ARRAY_SIZE(args), 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+   texel_ptr = LLVMGetParam(func, 3);
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   coords[0] = LLVMBuildLoad(builder, LLVMGetParam(func, 1), "s");
+   coords[1] = LLVMBuildLoad(builder, LLVMGetParam(func, 2), "t");
+   coords[2] = coords[3] = coords[4] = lp_build_undef(gallivm, type);
+
+   memset(&params, 0, sizeof params);
+   params.type = type;
+   params.sample_key = LP_SAMPLER_LOD_SCALAR << LP_SAMPLER_LOD_PROPERTY_SHIFT;
+   params.texture_index = 0;
+   params.sampler_index = 0;
+   params.context_ptr = LLVMGetParam(func, 0);
+   params.coords = coords;
+   params.offsets = offsets;
+   params.texel = texel;
+
+   sampler->emit_tex_sample(sampler, gallivm, &params);
+
+   for (i = 0; i < 4; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      LLVMBuildStore(builder, texel[i],
+                     LLVMBuildGEP(builder, texel_ptr, &index, 1, ""));
+   }
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+/**
+ * Sample the whole screen area from one texture layout.
+ * Returns the best time of LP_TEST_NUM_SAMPLES runs, in cycles per pixel.
+ */
+PIPE_ALIGN_STACK
+static double
+run_sample_test(const struct sample_test_filter *filter,
+                const struct sample_test_texture *tex,
+                boolean tiled,
+                struct lp_type type,
+                const float *s, const float *t, float *texels)
+{
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+   struct lp_fragment_shader_variant *variant;
+   struct lp_sampler_static_state static_state;
+   struct lp_build_sampler_soa *sampler;
+   struct lp_jit_context jit_context;
+   LLVMValueRef func;
+   sample_test_ptr_t sample_test_ptr;
+   const unsigned num_vecs = TEST_NUM_PIXELS / type.length;
+   int64_t best = 0;
+   unsigned i, j;
+
+   memset(&static_state, 0, sizeof static_state);
+   static_state.texture_state.format = PIPE_FORMAT_R8G8B8A8_UNORM;
+   static_state.texture_state.swizzle_r = PIPE_SWIZZLE_X;
+   static_state.texture_state.swizzle_g = PIPE_SWIZZLE_Y;
+   static_state.texture_state.swizzle_b = PIPE_SWIZZLE_Z;
+   static_state.texture_state.swizzle_a = PIPE_SWIZZLE_W;
+   static_state.texture_state.target = PIPE_TEXTURE_2D;
+   static_state.texture_state.pot_width = 1;
+   static_state.texture_state.pot_height = 1;
+   static_state.texture_state.pot_depth = 1;
+   static_state.texture_state.tiled = tiled;
+   static_state.sampler_state.wrap_s = PIPE_TEX_WRAP_REPEAT;
+   static_state.sampler_state.wrap_t = PIPE_TEX_WRAP_REPEAT;
+   static_state.sampler_state.wrap_r = PIPE_TEX_WRAP_REPEAT;
+   static_state.sampler_state.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+   static_state.sampler_state.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+   static_state.sampler_state.min_mip_filter = filter->min_mip_filter;
+   static_state.sampler_state.normalized_coords = 1;
+   static_state.sampler_state.max_lod_pos = 1;
+
+   memset(&jit_context, 0, sizeof jit_context);
+   jit_context.textures[0] = tex->jit;
+   jit_context.textures[0].base = tiled ? tex->tiled : tex->linear;
+   jit_context.samplers[0].max_lod = TEST_TEX_LEVELS - 1;
+
+   context = LLVMContextCreate();
+   gallivm = gallivm_create("test_module", context);
+
+   variant = CALLOC_STRUCT(lp_fragment_shader_variant);
+   variant->gallivm = gallivm;
+   lp_jit_init_types(variant);
+
+   sampler = lp_llvm_sampler_soa_create(&static_state);
+
+   func = add_sample_test(gallivm, variant->jit_context_ptr_type,
+                          sampler, type);
+
+   gallivm_compile_module(gallivm);
+
+   sample_test_ptr = (sample_test_ptr_t) gallivm_jit_function(gallivm, func);
+
+   gallivm_free_ir(gallivm);
+
+   sampler->destroy(sampler);
+   FREE(variant);
+
+   for (i = 0; i < LP_TEST_NUM_SAMPLES; i++) {
+      int64_t start_counter, end_counter;
+
+      start_counter = rdtsc();
+      for (j = 0; j < num_vecs; j++) {
+         sample_test_ptr(&jit_context,
+                         s + j * type.length,
+                         t + j * type.length,
+                         texels + j * 4 * type.length);
+      }
+      end_counter = rdtsc();
+
+      if (i == 0 || end_counter - start_counter < best)
+         best = end_counter - start_counter;
+   }
+
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+
+   return (double)best / TEST_NUM_PIXELS;
+}
+
+
+static boolean
+test_sample(unsigned verbose, FILE *fp,
+            const struct sample_test_filter *filter)
+{
+   struct lp_type type = lp_type_float_vec(32, lp_native_vector_width);
+   struct sample_test_texture tex;
+   const unsigned num_floats = 4 * TEST_NUM_PIXELS;
+   float *s, *t, *texels_linear, *texels_tiled;
+   double cycles_linear, cycles_tiled;
+   boolean success = TRUE;
+   unsigned i;
+
+   /* the AoS path filters with 8 bit weights */
+   const double eps = 4.0 / 255.0;
+
+   init_texture(&tex);
+
+   s = align_malloc(TEST_NUM_PIXELS * sizeof *s, 64);
+   t = align_malloc(TEST_NUM_PIXELS * sizeof *t, 64);
+   texels_linear = align_malloc(num_floats * sizeof *texels_linear, 64);
+   texels_tiled = align_malloc(num_floats * sizeof *texels_tiled, 64);
+
+   init_coords(type, filter->scale, s, t);
+
+   cycles_linear = run_sample_test(filter, &tex, FALSE, type,
+                                   s, t, texels_linear);
+   cycles_tiled = run_sample_test(filter, &tex, TRUE, type,
+                                  s, t, texels_tiled);
+
+   for (i = 0; i < num_floats; i++) {
+      if (fabs(texels_linear[i] - texels_tiled[i]) > eps) {
+         printf("%s: tiled result %f differs from linear result %f "
+                "at pixel %u channel %u\n", filter->name,
+                texels_tiled[i], texels_linear[i],
+                (i / (4 * type.length)) * type.length + i % type.length,
+                (i / type.length) % 4);
+         success = FALSE;
+         break;
+      }
+   }
+
+   printf("%s: linear %.2f, tiled %.2f cycles/pixel\n",
+          filter->name, cycles_linear, cycles_tiled);
+   fflush(stdout);
+
+   if (fp) {
+      write_tsv_row(fp, filter->name, "linear", cycles_linear, success);
+      write_tsv_row(fp, filter->name, "tiled", cycles_tiled, success);
+   }
+
+   align_free(s);
+   align_free(t);
+   align_free(texels_linear);
+   align_free(texels_tiled);
+   align_free(tex.linear);
+   align_free(tex.tiled);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   boolean success = TRUE;
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(filters); i++) {
+      if (!test_sample(verbose, fp, &filters[i]))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_sample(verbose, fp, &filters[0]);
+}
@@ -41,15 +41,18 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/simple_list.h"
+#include "util/u_surface.h"
 #include "util/u_transfer.h"
 
 #include "lp_context.h"
+#include "lp_debug.h"
 #include "lp_flush.h"
 #include "lp_screen.h"
 #include "lp_texture.h"
 #include "lp_setup.h"
 #include "lp_state.h"
 #include "lp_rast.h"
+#include "lp_perf.h"
 
 #include "state_tracker/sw_winsys.h"
 
@@ -60,6 +63,82 @@ static struct llvmpipe_resource resource_list;
 static unsigned id_counter = 0;
 
 
+/**
+ * Whether a texture may be stored in 4x4 pixel tiles.  The layout is
+ * only used for memory nobody outside llvmpipe looks at directly, and
+ * only for formats with 1x1 pixel blocks which we can render to with
+ * the 4x4 block granularity of the rasterizer.
+ */
+static boolean
+llvmpipe_texture_can_tile(const struct llvmpipe_screen *screen,
+                          const struct pipe_resource *pt)
+{
+   const struct util_format_description *desc =
+      util_format_description(pt->format);
+
+   if (!screen->tiled_textures)
+      return FALSE;
+
+   if (llvmpipe_resource_is_1d(pt) ||
+       pt->nr_samples > 1 ||
+       pt->usage == PIPE_USAGE_STAGING)
+      return FALSE;
+
+   if (pt->bind & (PIPE_BIND_DISPLAY_TARGET |
+                   PIPE_BIND_SCANOUT |
+                   PIPE_BIND_SHARED |
+                   PIPE_BIND_LINEAR |
+                   PIPE_BIND_DEPTH_STENCIL |
+                   PIPE_BIND_SHADER_IMAGE))
+      return FALSE;
+
+   if (!desc ||
+       desc->block.width != 1 ||
+       desc->block.height != 1 ||
+       util_format_has_depth(desc) ||
+       util_format_has_stencil(desc))
+      return FALSE;
+
+   return TRUE;
+}
+
+
+/**
+ * Copy a box of pixels between an image stored in 4x4 pixel tiles and a
+ * linear one.
+ */
+static void
+llvmpipe_copy_tiled(uint8_t *tiled, unsigned tiled_stride,
+                    uint8_t *linear, unsigned linear_stride,
+                    unsigned cpp,
+                    unsigned x, unsigned y,
+                    unsigned width, unsigned height,
+                    boolean to_linear)
+{
+   unsigned i, j;
+
+   for (j = 0; j < height; j++) {
+      const unsigned ty = y + j;
+      uint8_t *tiled_row = tiled + (ty & ~3) * tiled_stride +
+                           (ty & 3) * 4 * cpp;
+      uint8_t *linear_row = linear + j * linear_stride;
+
+      for (i = 0; i < width; ) {
+         const unsigned tx = x + i;
+         /* pixels up to the end of the tile are contiguous */
+         const unsigned n = MIN2(4 - (tx & 3), width - i);
+         uint8_t *tiled_ptr = tiled_row + ((tx & ~3) * 4 + (tx & 3)) * cpp;
+
+         if (to_linear)
+            memcpy(linear_row + i * cpp, tiled_ptr, n * cpp);
+         else
+            memcpy(tiled_ptr, linear_row + i * cpp, n * cpp);
+         i += n;
+      }
+   }
+}
+
+
 /**
  * Conventional allocation path for non-display textures:
  * Compute strides and allocate data (unless asked not to).
@@ -166,6 +245,14 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
       depth = u_minify(depth, 1);
    }
 
+   if (pt->nr_samples > 1) {
+      lpr->sample_stride = total_size;
+      total_size *= pt->nr_samples;
+      if (total_size > LP_MAX_TEXTURE_SIZE) {
+         goto fail;
+      }
+   }
+
    if (allocate) {
       lpr->tex_data = align_malloc(total_size, mip_align);
       if (!lpr->tex_data) {
@@ -262,6 +349,7 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
       }
       else {
          /* texture map */
+         lpr->tiled = llvmpipe_texture_can_tile(screen, &lpr->base);
          if (!llvmpipe_texture_layout(screen, lpr, true))
             goto fail;
       }
@@ -337,6 +425,8 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
       align_free(lpr->data);
    }
 
+   FREE(lpr->clear_tiles);
+
 #ifdef DEBUG
    if (lpr->next)
       remove_from_list(lpr);
@@ -423,6 +513,117 @@ llvmpipe_resource_unmap(struct pipe_resource *resource,
 }
 
 
+/**
+ * Return the deferred clear state of a render target, allocating it on
+ * first use, or NULL if clears to the resource can't be deferred.
+ * Only single level, single layer textures qualify, so that a tile always
+ * refers to the same memory.
+ */
+struct llvmpipe_tile_clear *
+llvmpipe_resource_clear_tiles(struct pipe_resource *resource)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   unsigned tiles_x, tiles_y;
+
+   if (lpr->clear_tiles)
+      return lpr->clear_tiles;
+
+   if ((LP_PERF & PERF_NO_FASTCLEAR) ||
+       (resource->target != PIPE_TEXTURE_2D &&
+        resource->target != PIPE_TEXTURE_RECT) ||
+       resource->last_level != 0 ||
+       resource->array_size != 1 ||
+       resource->nr_samples > 1 ||
+       !(resource->bind & PIPE_BIND_RENDER_TARGET) ||
+       (resource->bind & PIPE_BIND_SHARED) ||
+       lpr->tiled)
+      return NULL;
+
+   tiles_x = align(resource->width0, TILE_SIZE) / TILE_SIZE;
+   tiles_y = align(resource->height0, TILE_SIZE) / TILE_SIZE;
+   lpr->clear_tiles = CALLOC(tiles_x * tiles_y, sizeof *lpr->clear_tiles);
+
+   return lpr->clear_tiles;
+}
+
+
+/**
+ * Recompute llvmpipe_resource::clear_pending once the rasterizer is done
+ * with the resource.
+ */
+void
+llvmpipe_resource_update_clear_pending(struct pipe_resource *resource)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   unsigned num_tiles, i;
+
+   lpr->clear_pending = FALSE;
+
+   if (!lpr->clear_tiles)
+      return;
+
+   num_tiles = (align(resource->width0, TILE_SIZE) / TILE_SIZE) *
+               (align(resource->height0, TILE_SIZE) / TILE_SIZE);
+
+   for (i = 0; i < num_tiles; i++) {
+      if (lpr->clear_tiles[i].pending) {
+         lpr->clear_pending = TRUE;
+         break;
+      }
+   }
+}
+
+
+/**
+ * Write out all deferred clears of a resource, or just forget about them
+ * if the contents are about to be discarded.
+ */
+void
+llvmpipe_resource_resolve_clears(struct pipe_resource *resource,
+                                 boolean discard)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   unsigned tiles_x, tiles_y, x, y;
+   uint8_t *map = NULL;
+
+   if (!lpr->clear_pending)
+      return;
+
+   tiles_x = align(resource->width0, TILE_SIZE) / TILE_SIZE;
+   tiles_y = align(resource->height0, TILE_SIZE) / TILE_SIZE;
+
+   if (!discard) {
+      map = llvmpipe_resource_map(resource, 0, 0, LP_TEX_USAGE_READ_WRITE);
+      if (!map)
+         return;
+   }
+
+   for (y = 0; y < tiles_y; y++) {
+      for (x = 0; x < tiles_x; x++) {
+         struct llvmpipe_tile_clear *tc = &lpr->clear_tiles[y * tiles_x + x];
+
+         if (!tc->pending)
+            continue;
+
+         if (map) {
+            util_fill_rect(map, resource->format, lpr->row_stride[0],
+                           x * TILE_SIZE, y * TILE_SIZE,
+                           MIN2(TILE_SIZE, resource->width0 - x * TILE_SIZE),
+                           MIN2(TILE_SIZE, resource->height0 - y * TILE_SIZE),
+                           &tc->color);
+            LP_COUNT(nr_color_tile_clear);
+         }
+         tc->pending = FALSE;
+      }
+   }
+
+   if (map)
+      llvmpipe_resource_unmap(resource, 0, 0);
+
+   lpr->clear_pending = FALSE;
+}
+
+
 void *
 llvmpipe_resource_data(struct pipe_resource *resource)
 {
@@ -500,6 +701,8 @@ llvmpipe_resource_get_handle(struct pipe_screen *screen,
    if (!lpr->dt)
       return FALSE;
 
+   llvmpipe_resource_resolve_clears(pt, FALSE);
+
    return winsys->displaytarget_get_handle(winsys, lpr->dt, whandle);
 }
 
@@ -559,6 +762,15 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       }
    }
 
+   if (lpr->tiled && (usage & PIPE_TRANSFER_MAP_DIRECTLY)) {
+      /* the caller would see the tiled layout */
+      return NULL;
+   }
+
+   /* Materialize clears the rasterizer has deferred */
+   llvmpipe_resource_resolve_clears(resource,
+                                    !!(usage & PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE));
+
    lpt = CALLOC_STRUCT(llvmpipe_transfer);
    if (!lpt)
       return NULL;
@@ -611,6 +823,42 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       screen->timestamp++;
    }
 
+   if (lpr->tiled) {
+      /*
+       * Hand out a linear copy of the box, it gets tiled again when
+       * unmapping.
+       */
+      const unsigned cpp = util_format_get_blocksize(format);
+      unsigned z;
+
+      pt->stride = align(box->width * cpp, 16);
+      pt->layer_stride = pt->stride * box->height;
+
+      lpt->staging = align_malloc(pt->layer_stride * box->depth, 16);
+      if (!lpt->staging) {
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         *transfer = NULL;
+         return NULL;
+      }
+
+      if (!(usage & (PIPE_TRANSFER_DISCARD_RANGE |
+                     PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE)) ||
+          (usage & PIPE_TRANSFER_READ)) {
+         for (z = 0; z < box->depth; z++) {
+            llvmpipe_copy_tiled(llvmpipe_get_texture_image_address(lpr, box->z + z,
+                                                                   level),
+                                lpr->row_stride[level],
+                                lpt->staging + z * pt->layer_stride,
+                                pt->stride, cpp,
+                                box->x, box->y, box->width, box->height,
+                                TRUE);
+         }
+      }
+
+      return lpt->staging;
+   }
+
    map +=
       box->y / util_format_get_blockheight(format) * pt->stride +
       box->x / util_format_get_blockwidth(format) * util_format_get_blocksize(format);
@@ -623,8 +871,30 @@ static void
 llvmpipe_transfer_unmap(struct pipe_context *pipe,
                         struct pipe_transfer *transfer)
 {
+   struct llvmpipe_transfer *lpt = llvmpipe_transfer(transfer);
+
    assert(transfer->resource);
 
+   if (lpt->staging) {
+      struct llvmpipe_resource *lpr = llvmpipe_resource(transfer->resource);
+      const struct pipe_box *box = &transfer->box;
+      const unsigned cpp = util_format_get_blocksize(lpr->base.format);
+      unsigned z;
+
+      if (transfer->usage & PIPE_TRANSFER_WRITE) {
+         for (z = 0; z < box->depth; z++) {
+            llvmpipe_copy_tiled(llvmpipe_get_texture_image_address(lpr, box->z + z,
+                                                                   transfer->level),
+                                lpr->row_stride[transfer->level],
+                                lpt->staging + z * transfer->layer_stride,
+                                transfer->stride, cpp,
+                                box->x, box->y, box->width, box->height,
+                                FALSE);
+         }
+      }
+      align_free(lpt->staging);
+   }
+
    llvmpipe_resource_unmap(transfer->resource,
                            transfer->level,
                            transfer->box.z);
@@ -715,6 +985,58 @@ llvmpipe_user_buffer_create(struct pipe_screen *screen,
 }
 
 
+/**
+ * Convert a tiled texture to the linear layout, for users which can't
+ * deal with tiles such as vertex texturing in the draw module.
+ */
+void
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct pipe_resource *resource)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   const unsigned cpp = util_format_get_blocksize(resource->format);
+   unsigned level, layer, num_layers;
+   uint8_t *tmp;
+
+   if (!lpr->tiled)
+      return;
+
+   llvmpipe_flush_resource(pipe, resource, 0,
+                           FALSE, /* read_only */
+                           TRUE, /* cpu_access */
+                           FALSE, /* do_not_block */
+                           __FUNCTION__);
+
+   tmp = align_malloc(lpr->img_stride[0], 16);
+   if (!tmp)
+      return;
+
+   for (level = 0; level <= resource->last_level; level++) {
+      const unsigned width = u_minify(resource->width0, level);
+      const unsigned height = u_minify(resource->height0, level);
+
+      if (resource->target == PIPE_TEXTURE_3D)
+         num_layers = u_minify(resource->depth0, level);
+      else
+         num_layers = resource->array_size;
+
+      for (layer = 0; layer < num_layers; layer++) {
+         uint8_t *image = llvmpipe_get_texture_image_address(lpr, layer, level);
+
+         llvmpipe_copy_tiled(image, lpr->row_stride[level],
+                             tmp, lpr->row_stride[level], cpp,
+                             0, 0, width, height, TRUE);
+         memcpy(image, tmp, lpr->row_stride[level] * height);
+      }
+   }
+
+   align_free(tmp);
+
+   lpr->tiled = FALSE;
+   llvmpipe_context(pipe)->dirty |= LP_NEW_SAMPLER_VIEW;
+}
+
+
 /**
  * Compute size (in bytes) need to store a texture image / mipmap level,
  * for just one cube face, one array layer or one 3D texture slice
@@ -31,6 +31,7 @@
 
 #include "pipe/p_state.h"
 #include "util/u_debug.h"
+#include "util/u_pack_color.h"
 #include "lp_limits.h"
 
 
@@ -49,6 +50,18 @@ struct llvmpipe_context;
 struct sw_displaytarget;
 
 
+/**
+ * Deferred clear state of one TILE_SIZE x TILE_SIZE region of a render
+ * target.  While pending, the region logically holds the clear color but
+ * the memory has not been written yet.
+ */
+struct llvmpipe_tile_clear
+{
+   union util_color color;
+   boolean pending;
+};
+
+
 /**
  * llvmpipe subclass of pipe_resource.  A texture, drawing surface,
  * vertex buffer, const buffer, etc.
@@ -68,6 +81,28 @@ struct llvmpipe_resource
    unsigned mip_offsets[LP_MAX_TEXTURE_LEVELS];
    /** allocated total size (for non-display target texture resources only) */
    unsigned total_alloc_size;
+   /**
+    * Multisampled resources store each sample as a complete image, sample
+    * n starting sample_stride * n bytes after sample 0.
+    */
+   unsigned sample_stride;
+
+   /**
+    * Images are stored in 4x4 pixel tiles rather than linearly, with the
+    * tiles of a row of tiles stored consecutively.  Row and image strides
+    * keep their meaning, a row of tiles hence spans 4 * row_stride bytes.
+    */
+   boolean tiled;
+
+   /**
+    * Per tile deferred color clears, allocated on first use as a render
+    * target, see llvmpipe_resource_clear_tiles().  Whoever accesses the
+    * memory other than the rasterizer must call
+    * llvmpipe_resource_resolve_clears() first.
+    */
+   struct llvmpipe_tile_clear *clear_tiles;
+   /** Whether any tile in clear_tiles is pending */
+   boolean clear_pending;
 
    /**
     * Display target, for textures with the PIPE_BIND_DISPLAY_TARGET
@@ -102,6 +137,9 @@ struct llvmpipe_transfer
    struct pipe_transfer base;
 
    unsigned long offset;
+
+   /** Linear copy of the mapped box of tiled resources */
+   uint8_t *staging;
 };
 
 
@@ -175,6 +213,13 @@ llvmpipe_resource_is_1d(const struct pipe_resource *resource)
 }
 
 
+static inline boolean
+llvmpipe_resource_is_tiled(const struct pipe_resource *resource)
+{
+   return llvmpipe_resource_const(resource)->tiled;
+}
+
+
 static inline unsigned
 llvmpipe_layer_stride(struct pipe_resource *resource,
                       unsigned level)
@@ -195,6 +240,22 @@ llvmpipe_resource_stride(struct pipe_resource *resource,
 }
 
 
+void
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct pipe_resource *resource);
+
+
+struct llvmpipe_tile_clear *
+llvmpipe_resource_clear_tiles(struct pipe_resource *resource);
+
+void
+llvmpipe_resource_update_clear_pending(struct pipe_resource *resource);
+
+void
+llvmpipe_resource_resolve_clears(struct pipe_resource *resource,
+                                 boolean discard);
+
+
 void *
 llvmpipe_resource_map(struct pipe_resource *resource,
                       unsigned level,
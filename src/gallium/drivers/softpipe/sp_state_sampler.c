@@ -264,6 +264,7 @@ prepare_shader_sampling(
                                  i,
                                  width0, tex->height0, num_layers,
                                  first_level, last_level,
+                                 1, 0,
                                  addr,
                                  row_stride, img_stride, mip_offsets);
       }
@@ -654,7 +654,8 @@ BuilderSWR::CompileGS(struct swr_context *ctx, swr_jit_gs_key &key)
                      NULL, // thread data
                      sampler,
                      &gs->info.base,
-                     &gs_iface.base);
+                     &gs_iface.base,
+                     NULL); // compute shader interface
 
    lp_build_mask_end(&mask);
 
@@ -791,7 +792,8 @@ BuilderSWR::CompileVS(struct swr_context *ctx, swr_jit_vs_key &key)
                      NULL, // thread data
                      sampler, // sampler
                      &swr_vs->info.base,
-                     NULL); // geometry shader face
+                     NULL, // geometry shader face
+                     NULL); // compute shader interface
 
    sampler->destroy(sampler);
 
@@ -1271,7 +1273,8 @@ BuilderSWR::CompileFS(struct swr_context *ctx, swr_jit_fs_key &key)
                      NULL, // thread data
                      sampler, // sampler
                      &swr_fs->info.base,
-                     NULL); // geometry shader face
+                     NULL, // geometry shader face
+                     NULL); // compute shader interface
 
    sampler->destroy(sampler);
 
@@ -77,6 +77,10 @@ int main(int argc, char** argv)
       create_fn = translate_generic_create;
    else if (!strcmp(argv[1], "x86"))
       create_fn = translate_sse2_create;
+#if HAVE_LLVM
+   else if (!strcmp(argv[1], "llvm"))
+      create_fn = translate_llvm_create;
+#endif
    else if (!strcmp(argv[1], "nosse"))
    {
       util_cpu_caps.has_sse = 0;
@@ -130,7 +134,7 @@ int main(int argc, char** argv)
 
    if (!create_fn)
    {
-      printf("Usage: ./translate_test [default|generic|x86|nosse|sse|sse2|sse3|sse4.1]\n");
+      printf("Usage: ./translate_test [default|generic|x86|nosse|sse|sse2|sse3|sse4.1|llvm]\n");
       return 2;
    }
 
@@ -85,9 +85,26 @@ class PrintCode(gl_XML.gl_print_base):
         else:
             out('return {0};'.format(call))
 
+    def print_sync_call_after(self, func):
+        """Like print_sync_call(), followed by the marshal_call_after code,
+        which is what keeps the state tracked on the main thread up to
+        date."""
+        call = 'CALL_{0}(ctx->CurrentServerDispatch, ({1}))'.format(
+            func.name, func.get_called_parameter_string())
+        if func.return_type == 'void':
+            out('{0};'.format(call))
+            out(func.marshal_call_after)
+        else:
+            out('{0} result = {1};'.format(func.return_type, call))
+            out(func.marshal_call_after)
+            out('return result;')
+
     def print_sync_dispatch(self, func):
         out('debug_print_sync_fallback("{0}");'.format(func.name))
-        self.print_sync_call(func)
+        if func.marshal_call_after:
+            self.print_sync_call_after(func)
+        else:
+            self.print_sync_call(func)
 
     def print_sync_body(self, func):
         out('/* {0}: marshalled synchronously */'.format(func.name))
@@ -98,7 +115,10 @@ class PrintCode(gl_XML.gl_print_base):
             out('GET_CURRENT_CONTEXT(ctx);')
             out('_mesa_glthread_finish(ctx);')
             out('debug_print_sync("{0}");'.format(func.name))
-            self.print_sync_call(func)
+            if func.marshal_call_after:
+                self.print_sync_call_after(func)
+            else:
+                self.print_sync_call(func)
         out('}')
         out('')
         out('')
@@ -130,8 +150,17 @@ class PrintCode(gl_XML.gl_print_base):
                     out('variable_data += {0};'.format(
                         p.size_string(False)))
 
+        if func.marshal == 'draw' and func.draw_kind():
+            out('cmd->user_array_mask = upload.mask;')
+            out('memcpy(cmd + 1, upload.ptrs, '
+                'upload.num_arrays * sizeof(upload.ptrs[0]));')
+
         if not func.fixed_params and not func.variable_params:
             out('(void) cmd;\n')
+        elif func.marshal_coalesce():
+            out('_mesa_glthread_coalesce_command(ctx, &cmd->cmd_base);')
+        if func.marshal_call_after:
+            out(func.marshal_call_after)
         out('_mesa_post_marshal_hook(ctx);')
 
     def print_async_struct(self, func):
@@ -151,6 +180,10 @@ class PrintCode(gl_XML.gl_print_base):
                     out('bool {0}_null; /* If set, no data follows '
                         'for "{0}" */'.format(p.name))
 
+            if func.marshal == 'draw' and func.draw_kind():
+                out('GLbitfield user_array_mask; /* Followed by one '
+                    'const GLubyte * per bit */')
+
             for p in func.variable_params:
                 if p.count_scale != 1:
                     out(('/* Next {0} bytes are '
@@ -204,7 +237,25 @@ class PrintCode(gl_XML.gl_print_base):
                     else:
                         out('variable_data += {0};'.format(p.size_string(False)))
 
-            self.print_sync_call(func)
+            if func.marshal == 'draw' and func.draw_kind():
+                # Point the arrays the main thread copied at the copies for
+                # the duration of the draw.
+                out('const GLubyte *old_ptrs[VERT_ATTRIB_MAX];')
+                out('if (cmd->user_array_mask) {')
+                with indent():
+                    out('_mesa_glthread_bind_user_arrays(ctx, '
+                        'cmd->user_array_mask,')
+                    out('                                cmd + 1, old_ptrs);')
+                out('}')
+                self.print_sync_call(func)
+                out('if (cmd->user_array_mask) {')
+                with indent():
+                    out('_mesa_glthread_bind_user_arrays(ctx, '
+                        'cmd->user_array_mask,')
+                    out('                                old_ptrs, NULL);')
+                out('}')
+            else:
+                self.print_sync_call(func)
         out('}')
 
     def validate_count_or_fallback(self, func):
@@ -238,11 +289,17 @@ class PrintCode(gl_XML.gl_print_base):
                 size_terms.append(size)
             out('size_t cmd_size = {0};'.format(' + '.join(size_terms)))
             out('{0} *cmd;'.format(struct))
+            if func.marshal == 'draw' and func.draw_kind():
+                out('struct glthread_upload upload;')
 
             out('debug_print_marshal("{0}");'.format(func.name))
 
             need_fallback_sync = self.validate_count_or_fallback(func)
 
+            if func.marshal == 'draw':
+                self.print_draw_upload(func)
+                need_fallback_sync = True
+
             if func.marshal_fail:
                 out('if ({0}) {{'.format(func.marshal_fail))
                 with indent():
@@ -267,6 +324,54 @@ class PrintCode(gl_XML.gl_print_base):
 
         out('}')
 
+    def print_draw_upload(self, func):
+        # Draws reading vertex arrays or indices from client memory copy
+        # them into the upload area of the batch, or have to be executed
+        # synchronously if that's not possible.
+        names = set(p.name for p in func.parameters)
+        kind = func.draw_kind()
+        instances = 'primcount' if 'primcount' in names else '1'
+        base_instance = 'baseinstance' if 'baseinstance' in names else '0'
+
+        if kind == 'arrays':
+            out('upload.mask = 0;')
+            out('upload.num_arrays = 0;')
+            out('if (_mesa_glthread_has_user_arrays(ctx) &&')
+            out('    !_mesa_glthread_upload_arrays(ctx, cmd_size, first, '
+                'count, {0}, {1},'.format(instances, base_instance))
+            out('                                  &upload)) {')
+            with indent():
+                out('goto fallback_to_sync;')
+            out('}')
+        elif kind == 'elements':
+            if 'start' in names:
+                range_args = 'true, start, end'
+            else:
+                range_args = 'false, 0, 0'
+            base_vertex = 'basevertex' if 'basevertex' in names else '0'
+            out('upload.mask = 0;')
+            out('upload.num_arrays = 0;')
+            out('if (_mesa_glthread_has_user_elements(ctx) &&')
+            out('    !_mesa_glthread_upload_elements(ctx, cmd_size, count, '
+                'type, &indices,')
+            out('                                    {0}, {1}, {2}, {3},'.format(
+                range_args, base_vertex, instances, base_instance))
+            out('                                    &upload)) {')
+            with indent():
+                out('goto fallback_to_sync;')
+            out('}')
+        else:
+            if 'indices' in names:
+                out('if (_mesa_glthread_has_user_elements(ctx)) {')
+            else:
+                out('if (_mesa_glthread_has_user_arrays(ctx)) {')
+            with indent():
+                out('goto fallback_to_sync;')
+            out('}')
+            return
+
+        out('cmd_size += upload.num_arrays * sizeof(upload.ptrs[0]);')
+
     def print_async_body(self, func):
         out('/* {0}: marshalled asynchronously */'.format(func.name))
         self.print_async_struct(func)
@@ -26,6 +26,19 @@
 import gl_XML
 
 
+# State setting functions that are often called repeatedly with the same
+# arguments, and for which doing so back-to-back is redundant.
+coalesce_prefixes = ('Uniform', 'ProgramUniform')
+coalesce_functions = frozenset([
+    'ActiveTexture', 'BindFramebuffer', 'BindRenderbuffer', 'BindSampler',
+    'BindTexture', 'BlendEquation', 'BlendEquationSeparate', 'BlendFunc',
+    'BlendFuncSeparate', 'ColorMask', 'CullFace', 'DepthFunc', 'DepthMask',
+    'DepthRange', 'Disable', 'FrontFace', 'PixelStorei', 'PolygonOffset',
+    'Scissor', 'StencilFunc', 'StencilMask', 'StencilOp', 'UseProgram',
+    'Viewport',
+])
+
+
 class marshal_item_factory(gl_XML.gl_item_factory):
     """Factory to create objects derived from gl_item containing
     information necessary to generate thread marshalling code."""
@@ -58,6 +71,7 @@ class marshal_function(gl_XML.gl_function):
         # Store the "marshal" attribute, if present.
         self.marshal = element.get('marshal')
         self.marshal_fail = element.get('marshal_fail')
+        self.marshal_call_after = element.get('marshal_call_after')
 
     def marshal_flavor(self):
         """Find out how this function should be marshalled between
@@ -84,3 +98,26 @@ class marshal_function(gl_XML.gl_function):
                 # written logic to handle this yet.  TODO: fix.
                 return 'sync'
         return 'async'
+
+    def marshal_coalesce(self):
+        """Whether a queued call can be dropped when it's identical to
+        the call queued right before it."""
+        return (self.name in coalesce_functions or
+                self.name.startswith(coalesce_prefixes))
+
+    def draw_kind(self):
+        """Find out what client memory a marshal="draw" function may read,
+        other than what's in the command.
+
+        'arrays' draws read a range of vertices starting at first, and
+        'elements' draws the vertices referenced by indices.  Other draws
+        have to be executed synchronously when client memory is involved.
+        """
+        names = dict((p.name, p) for p in self.parameters)
+        if 'count' not in names or names['count'].is_pointer():
+            return None
+        if 'first' in names:
+            return 'arrays'
+        if 'indices' in names and 'type' in names:
+            return 'elements'
+        return None
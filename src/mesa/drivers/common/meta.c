@@ -139,6 +139,7 @@ meta_compile_shader_with_debug(struct gl_context *ctx, gl_shader_stage stage,
    sh->Source = strdup(source);
    sh->CompileStatus = compile_failure;
    _mesa_compile_shader(ctx, sh);
+   _mesa_wait_shader_compile(sh);
 
    if (!sh->CompileStatus) {
       if (sh->InfoLog) {
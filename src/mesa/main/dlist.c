@@ -3205,14 +3205,24 @@ save_MatrixMode(GLenum mode)
 {
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
-   ASSERT_OUTSIDE_SAVE_BEGIN_END_AND_FLUSH(ctx);
+   ASSERT_OUTSIDE_SAVE_BEGIN_END(ctx);
+
+   if (ctx->ExecuteFlag) {
+      CALL_MatrixMode(ctx->Exec, (mode));
+   }
+
+   /* Don't compile this call if it's a no-op, like save_ShadeModel. */
+   if (ctx->ListState.Current.MatrixMode == mode)
+      return;
+
+   SAVE_FLUSH_VERTICES(ctx);
+
+   ctx->ListState.Current.MatrixMode = mode;
+
    n = alloc_instruction(ctx, OPCODE_MATRIX_MODE, 1);
    if (n) {
       n[1].e = mode;
    }
-   if (ctx->ExecuteFlag) {
-      CALL_MatrixMode(ctx->Exec, (mode));
-   }
 }
 
 
@@ -3526,6 +3536,10 @@ save_PopAttrib(void)
    GET_CURRENT_CONTEXT(ctx);
    ASSERT_OUTSIDE_SAVE_BEGIN_END_AND_FLUSH(ctx);
    (void) alloc_instruction(ctx, OPCODE_POP_ATTRIB, 0);
+
+   /* The restored state isn't known at compile time. */
+   invalidate_saved_current_state( ctx );
+
    if (ctx->ExecuteFlag) {
       CALL_PopAttrib(ctx->Exec, ());
    }
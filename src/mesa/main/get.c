@@ -1360,11 +1360,64 @@ check_extra(struct gl_context *ctx, const char *func, const struct value_desc *d
 static const struct value_desc error_value =
    { 0, 0, TYPE_INVALID, NO_OFFSET, NO_EXTRA };
 
+/**
+ * Return the index in values[] of the entry for 'pname' in the hash table
+ * of the context's API, or 0 if 'pname' isn't a valid glGet enum for it.
+ */
+static inline unsigned
+lookup_value_index(const struct gl_context *ctx, GLenum pname)
+{
+   unsigned bucket, slot, idx;
+   int api;
+
+   api = ctx->API;
+   /* We index into the table_set[] list of per-API hash tables using the API's
+    * value in the gl_api enum. Since GLES 3 doesn't have an API_OPENGL* enum
+    * value since it's compatible with GLES2 its entry in table_set[] is at the
+    * end.
+    */
+   STATIC_ASSERT(ARRAY_SIZE(table_set) == API_OPENGL_LAST + 4);
+   if (ctx->API == API_OPENGLES2) {
+      if (ctx->Version >= 32)
+         api = API_OPENGL_LAST + 3;
+      else if (ctx->Version >= 31)
+         api = API_OPENGL_LAST + 2;
+      else if (ctx->Version >= 30)
+         api = API_OPENGL_LAST + 1;
+   }
+   bucket = (pname * prime_factor) & (ARRAY_SIZE(disp(api)) - 1);
+   slot = ((pname ^ disp(api)[bucket]) * hash_multiplier) >>
+          (32 - hash_table_bits);
+   idx = table(api)[slot];
+
+   /* The tables are perfect hashes, so an enum is either in its slot or
+    * not valid for the API.  Empty slots hold index 0, pointing to the
+    * first entry of values[] which doesn't hold any valid enum.
+    */
+   if (idx == 0 || values[idx].pname != pname)
+      return 0;
+
+   return idx;
+}
+
+
+/**
+ * Non-inlined lookup_value_index(), for the glGet lookup benchmark in
+ * main/tests.
+ */
+unsigned
+_mesa_get_value_index(const struct gl_context *ctx, GLenum pname)
+{
+   return lookup_value_index(ctx, pname);
+}
+
+
 /**
  * Find the struct value_desc corresponding to the enum 'pname'.
  *
  * We hash the enum value to get an index into the 'table' array,
  * which holds the index in the 'values' array of struct value_desc.
+ * The hash is perfect, see get_hash_generator.py.
  * Once we've found the entry, we do the extra checks, if any, then
  * look up the value and return a pointer to it.
  *
@@ -1387,45 +1440,16 @@ find_value(const char *func, GLenum pname, void **p, union value *v)
 {
    GET_CURRENT_CONTEXT(ctx);
    struct gl_texture_unit *unit;
-   int mask, hash;
    const struct value_desc *d;
-   int api;
+   unsigned idx;
 
-   api = ctx->API;
-   /* We index into the table_set[] list of per-API hash tables using the API's
-    * value in the gl_api enum. Since GLES 3 doesn't have an API_OPENGL* enum
-    * value since it's compatible with GLES2 its entry in table_set[] is at the
-    * end.
-    */
-   STATIC_ASSERT(ARRAY_SIZE(table_set) == API_OPENGL_LAST + 4);
-   if (ctx->API == API_OPENGLES2) {
-      if (ctx->Version >= 32)
-         api = API_OPENGL_LAST + 3;
-      else if (ctx->Version >= 31)
-         api = API_OPENGL_LAST + 2;
-      else if (ctx->Version >= 30)
-         api = API_OPENGL_LAST + 1;
-   }
-   mask = ARRAY_SIZE(table(api)) - 1;
-   hash = (pname * prime_factor);
-   while (1) {
-      int idx = table(api)[hash & mask];
-
-      /* If the enum isn't valid, the hash walk ends with index 0,
-       * pointing to the first entry of values[] which doesn't hold
-       * any valid enum. */
-      if (unlikely(idx == 0)) {
-         _mesa_error(ctx, GL_INVALID_ENUM, "%s(pname=%s)", func,
-               _mesa_enum_to_string(pname));
-         return &error_value;
-      }
-
-      d = &values[idx];
-      if (likely(d->pname == pname))
-         break;
-
-      hash += prime_step;
+   idx = lookup_value_index(ctx, pname);
+   if (unlikely(idx == 0)) {
+      _mesa_error(ctx, GL_INVALID_ENUM, "%s(pname=%s)", func,
+            _mesa_enum_to_string(pname));
+      return &error_value;
    }
+   d = &values[idx];
 
    if (unlikely(d->extra && !check_extra(ctx, func, d)))
       return &error_value;
@@ -34,6 +34,10 @@
 
 #include "glheader.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 extern void GLAPIENTRY
 _mesa_GetBooleanv( GLenum pname, GLboolean *params );
@@ -90,4 +94,13 @@ _mesa_GetError( void );
 extern GLenum GLAPIENTRY
 _mesa_GetGraphicsResetStatusARB( void );
 
+struct gl_context;
+
+extern unsigned
+_mesa_get_value_index(const struct gl_context *ctx, GLenum pname);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
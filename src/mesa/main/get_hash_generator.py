@@ -39,16 +39,25 @@ GLAPI = "%s/../../mapi/glapi/gen" % cur_dir
 sys.path.append(GLAPI)
 import gl_XML
 
+# The tables are perfect hashes: an enum is first hashed to one of
+# hash_bucket_count buckets, and the displacement found for its bucket at
+# build time then sends it to a table slot that no other enum of the API
+# uses.  Looking up an enum thus takes a single probe.
 prime_factor = 89
-prime_step = 281
-hash_table_size = 1024
+hash_multiplier = 0x9e3779b1
+hash_table_bits = 10
+hash_table_size = 1 << hash_table_bits
+hash_bucket_count = 256
+max_displacement = 0xffff
 
 gl_apis=set(["GL", "GL_CORE", "GLES", "GLES2", "GLES3", "GLES31", "GLES32"])
 
 def print_header():
-   print "typedef const unsigned short table_t[%d];\n" % (hash_table_size)
-   print "static const int prime_factor = %d, prime_step = %d;\n" % \
-          (prime_factor, prime_step)
+   print "typedef const unsigned short table_t[%d];" % (hash_table_size)
+   print "typedef const unsigned short disp_t[%d];\n" % (hash_bucket_count)
+   print "static const unsigned prime_factor = %d, hash_multiplier = 0x%x;" % \
+          (prime_factor, hash_multiplier)
+   print "static const unsigned hash_table_bits = %d;\n" % (hash_table_bits)
 
 def print_params(params):
    print "static const struct value_desc values[] = {"
@@ -77,60 +86,96 @@ def api_index(api):
 def table_name(api):
    return "table_" + api_name(api)
 
-def print_table(api, table):
-   print "static table_t %s = {" % (table_name(api))
-
-   # convert sparse (index, value) table into a dense table
-   dense_table = [0] * hash_table_size
-   for i, v in table:
-      dense_table[i] = v
+def disp_name(api):
+   return "disp_" + api_name(api)
 
+def print_rows(values):
    row_size = 4
-   for i in range(0, hash_table_size, row_size):
-      row = dense_table[i : i + row_size]
-      idx_val = ["%4d" % v for v in row]
+   for i in range(0, len(values), row_size):
+      row = values[i : i + row_size]
+      idx_val = ["%5d" % v for v in row]
       print " " * 4 + ", ".join(idx_val) + ","
 
+def print_table(api, table):
+   print "static table_t %s = {" % (table_name(api))
+   print_rows(table["slots"])
+   print "};\n"
+
+   print "static disp_t %s = {" % (disp_name(api))
+   print_rows(table["disp"])
    print "};\n"
 
 def print_tables(tables):
    for table in tables:
-      print_table(table["apis"][0], table["indices"])
+      print_table(table["apis"][0], table)
 
    dense_tables = ['NULL'] * len(api_enum)
+   dense_disps = ['NULL'] * len(api_enum)
    for table in tables:
-      tname = table_name(table["apis"][0])
       for api in table["apis"]:
          i = api_index(api)
-         dense_tables[i] = "&%s" % (tname)
+         dense_tables[i] = "&%s" % (table_name(table["apis"][0]))
+         dense_disps[i] = "&%s" % (disp_name(table["apis"][0]))
 
    print "static table_t *table_set[] = {"
    for expr in dense_tables:
       print "   %s," % expr
    print "};\n"
 
+   print "static disp_t *disp_set[] = {"
+   for expr in dense_disps:
+      print "   %s," % expr
+   print "};\n"
+
    print "#define table(api) (*table_set[api])"
+   print "#define disp(api) (*disp_set[api])"
 
 # Merge tables with matching parameter lists (i.e. GL and GL_CORE)
 def merge_tables(tables):
    merged_tables = []
-   for api, indices in sorted(tables.items()):
-      matching_table = filter(lambda mt:mt["indices"] == indices,
+   for api, table in sorted(tables.items()):
+      matching_table = filter(lambda mt:mt["slots"] == table["slots"] and
+                                        mt["disp"] == table["disp"],
                               merged_tables)
       if matching_table:
          matching_table[0]["apis"].append(api)
       else:
-         merged_tables.append({"apis": [api], "indices": indices})
+         table["apis"] = [api]
+         merged_tables.append(table)
 
    return merged_tables
 
-def add_to_hash_table(table, hash_val, value):
-   while True:
-      index = hash_val & (hash_table_size - 1)
-      if index not in table:
-         table[index] = value
-         break
-      hash_val += prime_step
+# These must match find_value() in get.c.
+def hash_bucket(enum_val):
+   return (enum_val * prime_factor) & (hash_bucket_count - 1)
+
+def hash_slot(enum_val, displacement):
+   return (((enum_val ^ displacement) * hash_multiplier) & 0xffffffff) >> \
+          (32 - hash_table_bits)
+
+def build_perfect_hash(api, entries):
+   buckets = defaultdict(list)
+   for enum_val, index in entries:
+      buckets[hash_bucket(enum_val)].append((enum_val, index))
+
+   slots = [0] * hash_table_size
+   disp = [0] * hash_bucket_count
+
+   # Place the most crowded buckets first, while the table is still empty.
+   for bucket, keys in sorted(buckets.items(), key=lambda b: (-len(b[1]), b[0])):
+      for d in range(max_displacement + 1):
+         used = [hash_slot(enum_val, d) for enum_val, index in keys]
+         if len(set(used)) == len(used) and \
+            all(slots[i] == 0 for i in used):
+            break
+      else:
+         die("no perfect hash for %s, increase hash_table_bits" % api)
+
+      disp[bucket] = d
+      for i, (enum_val, index) in zip(used, keys):
+         slots[i] = index
+
+   return {"slots": slots, "disp": disp}
 
 def die(msg):
    sys.stderr.write("%s: %s\n" % (program, msg))
@@ -139,12 +184,17 @@ def die(msg):
 program = os.path.basename(sys.argv[0])
 
 def generate_hash_tables(enum_list, enabled_apis, param_descriptors):
-   tables = defaultdict(lambda:{})
+   entries = defaultdict(lambda:[])
 
    # the first entry should be invalid, so that get.c:find_value can use
    # its index for the 'enum not found' condition.
    params = [[0, ""]]
 
+   def add_entry(api, enum_val, index):
+      # The first descriptor of an enum wins, as it did with probing.
+      if all(e[0] != enum_val for e in entries[api]):
+         entries[api].append((enum_val, index))
+
    for param_block in param_descriptors:
       if set(["apis", "params"]) != set(param_block):
          die("missing fields (%s) in param descriptor file (%s)" %
@@ -164,29 +214,28 @@ def generate_hash_tables(enum_list, enabled_apis, param_descriptors):
       for param in param_block["params"]:
          enum_name = param[0]
          enum_val = enum_list[enum_name].value
-         hash_val = enum_val * prime_factor
 
          for api in valid_apis:
-            add_to_hash_table(tables[api], hash_val, len(params))
+            add_entry(api, enum_val, len(params))
             # Also add GLES2 items to the GLES3+ hash tables
             if api == "GLES2":
-               add_to_hash_table(tables["GLES3"], hash_val, len(params))
-               add_to_hash_table(tables["GLES31"], hash_val, len(params))
-               add_to_hash_table(tables["GLES32"], hash_val, len(params))
+               add_entry("GLES3", enum_val, len(params))
+               add_entry("GLES31", enum_val, len(params))
+               add_entry("GLES32", enum_val, len(params))
             # Also add GLES3 items to the GLES31+ hash tables
             if api == "GLES3":
-               add_to_hash_table(tables["GLES31"], hash_val, len(params))
-               add_to_hash_table(tables["GLES32"], hash_val, len(params))
+               add_entry("GLES31", enum_val, len(params))
+               add_entry("GLES32", enum_val, len(params))
             # Also add GLES31 items to the GLES32+ hash tables
             if api == "GLES31":
-               add_to_hash_table(tables["GLES32"], hash_val, len(params))
+               add_entry("GLES32", enum_val, len(params))
          params.append(["GL_" + enum_name, param[1]])
 
-   sorted_tables={}
-   for api, indices in tables.items():
-      sorted_tables[api] = sorted(indices.items())
+   tables = {}
+   for api, api_entries in entries.items():
+      tables[api] = build_perfect_hash(api, api_entries)
 
-   return params, merge_tables(sorted_tables)
+   return params, merge_tables(tables)
 
 
 def show_usage():
@@ -36,14 +36,14 @@
 #include "main/glthread.h"
 #include "main/marshal.h"
 #include "main/marshal_generated.h"
+#include "util/os_time.h"
 #include "util/u_atomic.h"
 #include "util/u_thread.h"
 
 
 static void
-glthread_unmarshal_batch(void *job, int thread_index)
+glthread_unmarshal_batch(struct glthread_batch *batch)
 {
-   struct glthread_batch *batch = (struct glthread_batch*)job;
    struct gl_context *ctx = batch->ctx;
    size_t pos = 0;
 
@@ -54,15 +54,84 @@ glthread_unmarshal_batch(void *job, int thread_index)
 
    assert(pos == batch->used);
    batch->used = 0;
+   batch->upload_used = 0;
 }
 
+/**
+ * Wakes up the worker thread if it's sleeping.  Called after "submitted" or
+ * "shutdown" have been set.
+ */
 static void
-glthread_thread_initialization(void *job, int thread_index)
+glthread_wake_worker(struct glthread_state *glthread)
+{
+   if (p_atomic_read(&glthread->worker_sleeping) &&
+       p_atomic_cmpxchg(&glthread->worker_sleeping, 1, 0) == 1)
+      util_queue_fence_signal(&glthread->wakeup);
+}
+
+static bool
+glthread_has_work(struct glthread_state *glthread)
+{
+   return p_atomic_read(&glthread->submitted) != glthread->executed ||
+          p_atomic_read(&glthread->shutdown);
+}
+
+/**
+ * Waits until a batch has been submitted or the thread has to exit,
+ * spinning for a while before going to sleep.
+ */
+static void
+glthread_wait_for_work(struct glthread_state *glthread)
+{
+   const int64_t spin_end = os_time_get_nano() + GLTHREAD_SPIN_TIME_NS;
+
+   do {
+      if (glthread_has_work(glthread))
+         return;
+   } while (os_time_get_nano() < spin_end);
+
+   /* The main thread checks worker_sleeping after submitting, and we check
+    * for work after setting it, so at least one of us sees the other.  The
+    * fence is signalled by whoever clears worker_sleeping.
+    */
+   util_queue_fence_reset(&glthread->wakeup);
+   p_atomic_xchg(&glthread->worker_sleeping, 1);
+
+   if (glthread_has_work(glthread) &&
+       p_atomic_cmpxchg(&glthread->worker_sleeping, 1, 0) == 1)
+      util_queue_fence_signal(&glthread->wakeup);
+
+   util_queue_fence_wait(&glthread->wakeup);
+}
+
+static int
+glthread_worker(void *data)
 {
-   struct gl_context *ctx = (struct gl_context*)job;
+   struct gl_context *ctx = (struct gl_context*)data;
+   struct glthread_state *glthread = ctx->GLThread;
 
-   ctx->Driver.SetBackgroundContext(ctx, &ctx->GLThread->stats);
+   u_thread_setname("glthread");
+   ctx->Driver.SetBackgroundContext(ctx, &glthread->stats);
    _glapi_set_context(ctx);
+   util_queue_fence_signal(&glthread->ready);
+
+   for (;;) {
+      if (glthread->executed == p_atomic_read(&glthread->submitted)) {
+         if (p_atomic_read(&glthread->shutdown))
+            break;
+
+         glthread_wait_for_work(glthread);
+         continue;
+      }
+
+      struct glthread_batch *batch =
+         &glthread->batches[glthread->executed % MARSHAL_MAX_BATCHES];
+
+      glthread_unmarshal_batch(batch);
+      p_atomic_inc(&glthread->executed);
+      util_queue_fence_signal(&batch->fence);
+   }
+   return 0;
 }
 
 void
@@ -73,15 +142,14 @@ _mesa_glthread_init(struct gl_context *ctx)
    if (!glthread)
       return;
 
-   if (!util_queue_init(&glthread->queue, "glthread", MARSHAL_MAX_BATCHES - 2,
-                        1, 0)) {
+   if (!_mesa_glthread_init_arrays(glthread)) {
       free(glthread);
       return;
    }
 
    ctx->MarshalExec = _mesa_create_marshal_table(ctx);
    if (!ctx->MarshalExec) {
-      util_queue_destroy(&glthread->queue);
+      _mesa_glthread_destroy_arrays(glthread);
       free(glthread);
       return;
    }
@@ -90,18 +158,32 @@ _mesa_glthread_init(struct gl_context *ctx)
       glthread->batches[i].ctx = ctx;
       util_queue_fence_init(&glthread->batches[i].fence);
    }
+   util_queue_fence_init(&glthread->wakeup);
+   util_queue_fence_init(&glthread->ready);
+   util_queue_fence_reset(&glthread->ready);
 
-   glthread->stats.queue = &glthread->queue;
-   ctx->CurrentClientDispatch = ctx->MarshalExec;
+   glthread->batch_size = MARSHAL_MIN_BATCH_SIZE;
+   glthread->stats.thread = &glthread->thread;
    ctx->GLThread = glthread;
 
-   /* Execute the thread initialization function in the thread. */
-   struct util_queue_fence fence;
-   util_queue_fence_init(&fence);
-   util_queue_add_job(&glthread->queue, ctx, &fence,
-                      glthread_thread_initialization, NULL);
-   util_queue_fence_wait(&fence);
-   util_queue_fence_destroy(&fence);
+   glthread->thread = u_thread_create(glthread_worker, ctx);
+   if (!glthread->thread) {
+      ctx->GLThread = NULL;
+      for (unsigned i = 0; i < MARSHAL_MAX_BATCHES; i++)
+         util_queue_fence_destroy(&glthread->batches[i].fence);
+      util_queue_fence_destroy(&glthread->wakeup);
+      util_queue_fence_signal(&glthread->ready);
+      util_queue_fence_destroy(&glthread->ready);
+      _mesa_glthread_destroy_arrays(glthread);
+      free(ctx->MarshalExec);
+      ctx->MarshalExec = NULL;
+      free(glthread);
+      return;
+   }
+
+   /* Wait for the thread initialization. */
+   util_queue_fence_wait(&glthread->ready);
+   ctx->CurrentClientDispatch = ctx->MarshalExec;
 }
 
 void
@@ -113,11 +195,19 @@ _mesa_glthread_destroy(struct gl_context *ctx)
       return;
 
    _mesa_glthread_finish(ctx);
-   util_queue_destroy(&glthread->queue);
 
-   for (unsigned i = 0; i < MARSHAL_MAX_BATCHES; i++)
+   p_atomic_set(&glthread->shutdown, true);
+   glthread_wake_worker(glthread);
+   thrd_join(glthread->thread, NULL);
+
+   for (unsigned i = 0; i < MARSHAL_MAX_BATCHES; i++) {
       util_queue_fence_destroy(&glthread->batches[i].fence);
+      free(glthread->batches[i].upload);
+   }
+   util_queue_fence_destroy(&glthread->wakeup);
+   util_queue_fence_destroy(&glthread->ready);
 
+   _mesa_glthread_destroy_arrays(glthread);
    free(glthread);
    ctx->GLThread = NULL;
 
@@ -156,24 +246,96 @@ _mesa_glthread_flush_batch(struct gl_context *ctx)
     * need to restore it when it returns.
     */
    if (false) {
-      glthread_unmarshal_batch(next, 0);
+      glthread_unmarshal_batch(next);
+      glthread->last_coalescable = NULL;
       _glapi_set_dispatch(ctx->CurrentClientDispatch);
       return;
    }
 
    p_atomic_add(&glthread->stats.num_offloaded_items, next->used);
 
-   util_queue_add_job(&glthread->queue, next, &next->fence,
-                      glthread_unmarshal_batch, NULL);
+   /* Flush smaller batches while the worker thread keeps up, and larger
+    * ones when it has fallen behind.
+    */
+   const unsigned pending = glthread->submitted -
+                            p_atomic_read(&glthread->executed);
+   if (pending == 0)
+      glthread->batch_size = MAX2(glthread->batch_size / 2,
+                                  MARSHAL_MIN_BATCH_SIZE);
+   else if (pending >= 2)
+      glthread->batch_size = MIN2(glthread->batch_size * 2,
+                                  MARSHAL_MAX_CMD_SIZE);
+
+   util_queue_fence_reset(&next->fence);
+   p_atomic_inc(&glthread->submitted);
+   glthread_wake_worker(glthread);
+
    glthread->last = glthread->next;
    glthread->next = (glthread->next + 1) % MARSHAL_MAX_BATCHES;
+   glthread->last_coalescable = NULL;
+
+   /* The commands and the upload area of the batch are about to be reused,
+    * make sure it's been executed.
+    */
+   util_queue_fence_wait(&glthread->batches[glthread->next].fence);
+}
+
+/**
+ * Allocates size bytes in the upload area of the batch being filled, for
+ * the command of cmd_size bytes about to be allocated.  The command is made
+ * sure to end up in the same batch, as the upload area is recycled with it.
+ *
+ * Returns NULL if size is too large, and the caller then has to copy the
+ * data elsewhere or synchronize.
+ */
+void *
+_mesa_glthread_upload_alloc(struct gl_context *ctx, size_t cmd_size,
+                            size_t size)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *next = &glthread->batches[glthread->next];
+
+   if (size > GLTHREAD_UPLOAD_SIZE)
+      return NULL;
+
+   if (next->used + cmd_size > glthread->batch_size ||
+       next->upload_used + size > GLTHREAD_UPLOAD_SIZE) {
+      _mesa_glthread_flush_batch(ctx);
+      next = &glthread->batches[glthread->next];
+   }
+
+   if (!next->upload) {
+      next->upload = malloc(GLTHREAD_UPLOAD_SIZE);
+      if (!next->upload)
+         return NULL;
+   }
+
+   void *ptr = next->upload + next->upload_used;
+   next->upload_used += ALIGN(size, 8);
+   return ptr;
+}
+
+/**
+ * Copies client memory into the upload area.
+ * \sa _mesa_glthread_upload_alloc
+ */
+void *
+_mesa_glthread_upload(struct gl_context *ctx, size_t cmd_size,
+                      const void *data, size_t size)
+{
+   void *ptr = _mesa_glthread_upload_alloc(ctx, cmd_size, size);
+
+   if (ptr)
+      memcpy(ptr, data, size);
+   return ptr;
 }
 
 /**
  * Waits for all pending batches have been unmarshaled.
  *
  * This can be used by the main thread to synchronize access to the context,
- * since the worker thread will be idle after this.
+ * since the worker thread will be idle after this.  It's also where state
+ * the main thread lost track of is read back from the context.
  */
 void
 _mesa_glthread_finish(struct gl_context *ctx)
@@ -187,13 +349,15 @@ _mesa_glthread_finish(struct gl_context *ctx)
     * dri interface entrypoints), in which case we don't need to actually
     * synchronize against ourself.
     */
-   if (u_thread_is_self(glthread->queue.threads[0]))
+   if (u_thread_is_self(glthread->thread))
       return;
 
    struct glthread_batch *last = &glthread->batches[glthread->last];
    struct glthread_batch *next = &glthread->batches[glthread->next];
    bool synced = false;
 
+   p_atomic_inc(&glthread->stats.num_sync_calls);
+
    if (!util_queue_fence_is_signalled(&last->fence)) {
       util_queue_fence_wait(&last->fence);
       synced = true;
@@ -206,7 +370,8 @@ _mesa_glthread_finish(struct gl_context *ctx)
        * restore it after it's done.
        */
       struct _glapi_table *dispatch = _glapi_get_dispatch();
-      glthread_unmarshal_batch(next, 0);
+      glthread_unmarshal_batch(next);
+      glthread->last_coalescable = NULL;
       _glapi_set_dispatch(dispatch);
 
       /* It's not a sync because we don't enqueue partial batches, but
@@ -217,4 +382,7 @@ _mesa_glthread_finish(struct gl_context *ctx)
 
    if (synced)
       p_atomic_inc(&glthread->stats.num_syncs);
+
+   if (!glthread->CurrentVAO->Valid || !glthread->RestartValid)
+      _mesa_glthread_refresh_arrays(ctx);
 }
@@ -26,16 +26,32 @@
 
 #include "main/mtypes.h"
 
-/* The size of one batch and the maximum size of one call.
+/* The maximum size of one batch and of one call.
  *
- * This should be as low as possible, so that:
+ * Batches are flushed well before that most of the time, see
+ * MARSHAL_MIN_BATCH_SIZE.  Calls that don't fit in 32 KB are executed
+ * synchronously, and cmd_size in marshal_cmd_base limits this to 64 KB - 8.
+ */
+#define MARSHAL_MAX_CMD_SIZE (32 * 1024)
+
+/* The size at which batches are flushed adapts to how busy the worker
+ * thread is, between this and MARSHAL_MAX_CMD_SIZE.
+ *
+ * Small batches are preferable when the worker thread keeps up, so that:
  * - multiple synchronizations within a frame don't slow us down much
  * - a smaller number of calls per frame can still get decent parallelism
  * - the memory footprint of the queue is low, and with that comes a lower
  *   chance of experiencing CPU cache thrashing
- * but it should be high enough so that u_queue overhead remains negligible.
+ * When batches pile up, larger ones amortize the handoff to the worker
+ * thread, which is what draw-call-heavy workloads are bound by.
+ */
+#define MARSHAL_MIN_BATCH_SIZE (4 * 1024)
+
+/* How long the worker thread busy-waits for the next batch before going to
+ * sleep, in nanoseconds.  Waking a sleeping thread costs a system call on
+ * both sides, which for small batches is more than executing them.
  */
-#define MARSHAL_MAX_CMD_SIZE (8 * 1024)
+#define GLTHREAD_SPIN_TIME_NS 50000
 
 /* The number of batch slots in memory.
  *
@@ -45,9 +61,20 @@
  */
 #define MARSHAL_MAX_BATCHES 8
 
+/* The size of the upload area of one batch.
+ *
+ * User vertex arrays and index buffers referenced by queued draws are copied
+ * there, so that the application can't change them before the draw is
+ * executed.  The area is recycled together with the batch and allocated on
+ * first use.  Draws needing more than this are executed synchronously.
+ */
+#define GLTHREAD_UPLOAD_SIZE (1024 * 1024)
+
 #include <inttypes.h>
 #include <stdbool.h>
 #include "util/u_queue.h"
+#include "compiler/shader_enums.h"
+#include "main/glheader.h"
 
 enum marshal_dispatch_cmd_id;
 
@@ -63,14 +90,82 @@ struct glthread_batch
    /** Amount of data used by batch commands, in bytes. */
    size_t used;
 
+   /** User vertex and index data referenced by the batch commands. */
+   uint8_t *upload;
+
+   /** Amount of the upload area used by the batch, in bytes. */
+   size_t upload_used;
+
    /** Data contained in the command buffer. */
    uint8_t buffer[MARSHAL_MAX_CMD_SIZE];
 };
 
+/** A vertex array as seen by the main thread. */
+struct glthread_attrib
+{
+   const GLubyte *Pointer;  /**< client memory pointer or offset into Buffer */
+   GLuint Buffer;           /**< name of the array buffer, or 0 */
+   GLuint ElementSize;      /**< size of one element in bytes */
+   GLsizei Stride;          /**< stride in bytes, never 0 */
+   GLuint Divisor;          /**< instance divisor */
+};
+
+/**
+ * The state of a vertex array object needed to tell on the main thread what
+ * a draw reads from client memory.
+ */
+struct glthread_vao
+{
+   GLuint Name;
+   GLuint IndexBuffer;          /**< element array buffer name, or 0 */
+   GLbitfield Enabled;          /**< VERT_BIT_* of the enabled arrays */
+   GLbitfield UserPointerMask;  /**< VERT_BIT_* of arrays in client memory */
+
+   /**
+    * Cleared when the state above may be out of date, e.g. after
+    * glPopClientAttrib.  Draws needing it synchronize until it's read back
+    * from the context by _mesa_glthread_finish().
+    */
+   bool Valid;
+
+   struct glthread_attrib Attrib[VERT_ATTRIB_MAX];
+};
+
+/** Client memory copied into the upload area for one draw. */
+struct glthread_upload
+{
+   GLbitfield mask;       /**< VERT_BIT_* of the copied vertex arrays */
+   unsigned num_arrays;
+
+   /** Where the draw should read the arrays in mask from, in bit order. */
+   const GLubyte *ptrs[VERT_ATTRIB_MAX];
+};
+
 struct glthread_state
 {
-   /** Multithreaded queue. */
-   struct util_queue queue;
+   /** The worker thread executing the batches. */
+   thrd_t thread;
+
+   /**
+    * Batches are handed over to the worker thread in ring order without
+    * locking: the main thread increments "submitted" once a batch is filled
+    * and the worker thread executes batches until "executed" catches up.
+    */
+   unsigned submitted;
+   unsigned executed;
+
+   /**
+    * Set by the worker thread when it's about to sleep on "wakeup", cleared
+    * by whichever thread then signals it.
+    */
+   unsigned worker_sleeping;
+   struct util_queue_fence wakeup;
+
+   /** Set to make the worker thread exit. */
+   bool shutdown;
+
+   /** Signalled once the worker thread is initialized. */
+   struct util_queue_fence ready;
 
    /** This is sent to the driver for framebuffer overlay / HUD. */
    struct util_queue_monitoring stats;
@@ -84,17 +179,35 @@ struct glthread_state
    /** Index of the batch being filled and about to be submitted. */
    unsigned next;
 
+   /** The size at which the batch being filled is flushed, in bytes. */
+   size_t batch_size;
+
    /**
-    * Tracks on the main thread side whether the current vertex array binding
-    * is in a VBO.
+    * The last command of the batch being filled that may be merged with an
+    * identical command following it, or NULL.
     */
-   bool vertex_array_is_vbo;
+   const void *last_coalescable;
+
+   /** Vertex array objects tracked on the main thread side, by name. */
+   struct _mesa_HashTable *VAOs;
+   struct glthread_vao DefaultVAO;
+   struct glthread_vao *CurrentVAO;
+
+   /** The GL_ARRAY_BUFFER binding on the main thread side. */
+   GLuint ArrayBuffer;
+
+   /** The client active texture unit, for glTexCoordPointer. */
+   GLuint ClientActiveTexture;
 
    /**
-    * Tracks on the main thread side whether the current element array (index
-    * buffer) binding is in a VBO.
+    * Primitive restart state, needed to scan user index buffers for the
+    * range of vertices to upload.  RestartValid is cleared by calls we don't
+    * track precisely, like glPopAttrib.
     */
-   bool element_array_is_vbo;
+   bool PrimitiveRestart;
+   bool PrimitiveRestartFixedIndex;
+   bool RestartValid;
+   GLuint RestartIndex;
 };
 
 void _mesa_glthread_init(struct gl_context *ctx);
@@ -103,5 +216,62 @@ void _mesa_glthread_destroy(struct gl_context *ctx);
 void _mesa_glthread_restore_dispatch(struct gl_context *ctx);
 void _mesa_glthread_flush_batch(struct gl_context *ctx);
 void _mesa_glthread_finish(struct gl_context *ctx);
+void *_mesa_glthread_upload_alloc(struct gl_context *ctx, size_t cmd_size,
+                                  size_t size);
+void *_mesa_glthread_upload(struct gl_context *ctx, size_t cmd_size,
+                            const void *data, size_t size);
+
+/* glthread_varray.c */
+bool _mesa_glthread_init_arrays(struct glthread_state *glthread);
+void _mesa_glthread_destroy_arrays(struct glthread_state *glthread);
+void _mesa_glthread_refresh_arrays(struct gl_context *ctx);
+void _mesa_glthread_invalidate_arrays(struct gl_context *ctx);
+void _mesa_glthread_invalidate_vao(struct gl_context *ctx, GLuint vaobj);
+
+void _mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                               GLuint buffer);
+void _mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *buffers);
+void _mesa_glthread_GenVertexArrays(struct gl_context *ctx, GLsizei n,
+                                    const GLuint *arrays);
+void _mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                       const GLuint *arrays);
+void _mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint id);
+void _mesa_glthread_AttribPointer(struct gl_context *ctx,
+                                  gl_vert_attrib attrib, GLint size,
+                                  GLenum type, GLsizei stride,
+                                  const void *pointer);
+void _mesa_glthread_VertexAttribPointer(struct gl_context *ctx, GLuint index,
+                                        GLint size, GLenum type,
+                                        GLsizei stride, const void *pointer);
+void _mesa_glthread_TexCoordPointer(struct gl_context *ctx, GLint size,
+                                    GLenum type, GLsizei stride,
+                                    const void *pointer);
+void _mesa_glthread_VertexAttribDivisor(struct gl_context *ctx, GLuint index,
+                                        GLuint divisor);
+void _mesa_glthread_ClientState(struct gl_context *ctx, GLenum array,
+                                bool enable);
+void _mesa_glthread_VertexAttribArray(struct gl_context *ctx, GLuint index,
+                                      bool enable);
+void _mesa_glthread_ClientActiveTexture(struct gl_context *ctx,
+                                        GLenum texture);
+void _mesa_glthread_Enable(struct gl_context *ctx, GLenum cap, bool enable);
+void _mesa_glthread_PrimitiveRestartIndex(struct gl_context *ctx,
+                                          GLuint index);
+
+bool _mesa_glthread_upload_arrays(struct gl_context *ctx, size_t cmd_size,
+                                  GLint first, GLsizei count,
+                                  GLsizei num_instances, GLuint base_instance,
+                                  struct glthread_upload *upload);
+bool _mesa_glthread_upload_elements(struct gl_context *ctx, size_t cmd_size,
+                                    GLsizei count, GLenum type,
+                                    const GLvoid **indices, bool has_range,
+                                    GLuint start, GLuint end,
+                                    GLint basevertex, GLsizei num_instances,
+                                    GLuint base_instance,
+                                    struct glthread_upload *upload);
+void _mesa_glthread_bind_user_arrays(struct gl_context *ctx, GLbitfield mask,
+                                     const void *ptrs,
+                                     const GLubyte **old_ptrs);
 
 #endif /* _GLTHREAD_H*/
@@ -0,0 +1,729 @@
+/*
+ * Copyright © 2018 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file glthread_varray.c
+ *
+ * Vertex array state tracking for glthread.
+ *
+ * Compatibility and GLES contexts may source vertex arrays and indices from
+ * client memory, which the application is free to change as soon as the
+ * draw call returns.  To queue such draws, the main thread tracks which
+ * arrays of the bound vertex array object live in client memory, and copies
+ * the range a draw reads into the upload area of the batch.  The worker
+ * thread points the arrays at the copy for the duration of the draw.
+ *
+ * Calls changing the state in ways that aren't tracked just mark it invalid;
+ * it's read back from the context at the next synchronization.
+ */
+
+#include "main/bufferobj.h"
+#include "main/context.h"
+#include "main/glformats.h"
+#include "main/glthread.h"
+#include "main/hash.h"
+#include "main/macros.h"
+#include "main/mtypes.h"
+#include "util/bitscan.h"
+
+
+static void
+init_vao(struct glthread_vao *vao, GLuint name)
+{
+   memset(vao, 0, sizeof(*vao));
+   vao->Name = name;
+   vao->Valid = true;
+
+   /* All arrays start out in client memory, with a NULL pointer. */
+   vao->UserPointerMask = VERT_BIT_ALL;
+   for (unsigned i = 0; i < VERT_ATTRIB_MAX; i++) {
+      vao->Attrib[i].ElementSize = 4 * sizeof(GLfloat);
+      vao->Attrib[i].Stride = 4 * sizeof(GLfloat);
+   }
+}
+
+static struct glthread_vao *
+lookup_vao(struct glthread_state *glthread, GLuint id)
+{
+   if (id == 0)
+      return &glthread->DefaultVAO;
+
+   return _mesa_HashLookup(glthread->VAOs, id);
+}
+
+static struct glthread_vao *
+create_vao(struct glthread_state *glthread, GLuint id)
+{
+   struct glthread_vao *vao = malloc(sizeof(*vao));
+
+   if (vao) {
+      init_vao(vao, id);
+      _mesa_HashInsert(glthread->VAOs, id, vao);
+   }
+   return vao;
+}
+
+bool
+_mesa_glthread_init_arrays(struct glthread_state *glthread)
+{
+   glthread->VAOs = _mesa_NewHashTable();
+   if (!glthread->VAOs)
+      return false;
+
+   init_vao(&glthread->DefaultVAO, 0);
+   glthread->CurrentVAO = &glthread->DefaultVAO;
+   glthread->RestartValid = true;
+   return true;
+}
+
+static void
+free_vao(GLuint key, void *data, void *userData)
+{
+   free(data);
+}
+
+void
+_mesa_glthread_destroy_arrays(struct glthread_state *glthread)
+{
+   _mesa_HashDeleteAll(glthread->VAOs, free_vao, NULL);
+   _mesa_DeleteHashTable(glthread->VAOs);
+}
+
+/**
+ * Reads the vertex array state back from the context.
+ *
+ * The worker thread must be idle, i.e. this is only called from
+ * _mesa_glthread_finish().
+ */
+void
+_mesa_glthread_refresh_arrays(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   const struct gl_vertex_array_object *ctx_vao = ctx->Array.VAO;
+   struct glthread_vao *vao = lookup_vao(glthread, ctx_vao->Name);
+
+   if (!vao) {
+      vao = create_vao(glthread, ctx_vao->Name);
+      if (!vao)
+         return;
+   }
+
+   vao->IndexBuffer = ctx_vao->IndexBufferObj->Name;
+   vao->Enabled = ctx_vao->_Enabled;
+   vao->UserPointerMask = 0;
+   vao->Valid = true;
+
+   for (unsigned i = 0; i < VERT_ATTRIB_MAX; i++) {
+      const struct gl_array_attributes *array = &ctx_vao->VertexAttrib[i];
+      const struct gl_vertex_buffer_binding *binding =
+         &ctx_vao->BufferBinding[array->BufferBindingIndex];
+      struct glthread_attrib *attrib = &vao->Attrib[i];
+
+      attrib->Pointer = array->Ptr;
+      attrib->Buffer = binding->BufferObj->Name;
+      attrib->ElementSize = array->_ElementSize;
+      attrib->Stride = binding->Stride;
+      attrib->Divisor = binding->InstanceDivisor;
+
+      if (!_mesa_is_bufferobj(binding->BufferObj)) {
+         vao->UserPointerMask |= VERT_BIT(i);
+
+         /* Only arrays set up by gl*Pointer() can be pointed at a copy. */
+         if (array->BufferBindingIndex != i && (vao->Enabled & VERT_BIT(i)))
+            vao->Valid = false;
+      }
+   }
+
+   glthread->CurrentVAO = vao;
+   glthread->ArrayBuffer = ctx->Array.ArrayBufferObj->Name;
+   glthread->ClientActiveTexture = ctx->Array.ActiveTexture;
+   glthread->PrimitiveRestart = ctx->Array.PrimitiveRestart;
+   glthread->PrimitiveRestartFixedIndex =
+      ctx->Array.PrimitiveRestartFixedIndex;
+   glthread->RestartIndex = ctx->Array.RestartIndex;
+   glthread->RestartValid = true;
+}
+
+/**
+ * Called after glPopClientAttrib(), glInterleavedArrays() and the like,
+ * which change the vertex array state in ways not tracked here.
+ */
+void
+_mesa_glthread_invalidate_arrays(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   glthread->CurrentVAO->Valid = false;
+   glthread->RestartValid = false;
+}
+
+/**
+ * Called after the direct state access functions changing vertex array
+ * objects, which are rare enough not to be tracked.
+ */
+void
+_mesa_glthread_invalidate_vao(struct gl_context *ctx, GLuint vaobj)
+{
+   struct glthread_vao *vao = lookup_vao(ctx->GLThread, vaobj);
+
+   if (vao)
+      vao->Valid = false;
+}
+
+/**
+ * Tracks the current bindings for the vertex array and index array buffers.
+ *
+ * Note that GL core makes it so that a buffer binding with an invalid handle
+ * in the "buffer" parameter will throw an error, and then a
+ * glVertexAttribPointer() that follows might not end up pointing at a VBO.
+ * However, in GL core the draw call would throw an error as well, so we don't
+ * really care if our tracking is wrong for this case -- we never need to
+ * marshal user data for draw calls, and the unmarshal will just generate an
+ * error or not as appropriate.
+ *
+ * For compatibility GL, we do need to accurately know whether the draw call
+ * on the unmarshal side will dereference a user pointer or load data from a
+ * VBO per vertex.  That would make it seem like we need to track whether a
+ * "buffer" is valid, so that we can know when an error will be generated
+ * instead of updating the binding.  However, compat GL has the ridiculous
+ * feature that if you pass a bad name, it just gens a buffer object for you,
+ * so we escape without having to know if things are valid or not.
+ */
+void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   switch (target) {
+   case GL_ARRAY_BUFFER:
+      glthread->ArrayBuffer = buffer;
+      break;
+   case GL_ELEMENT_ARRAY_BUFFER:
+      /* The element array buffer binding is part of the vertex array
+       * object.
+       */
+      glthread->CurrentVAO->IndexBuffer = buffer;
+      break;
+   }
+}
+
+/**
+ * Deleting a buffer unbinds it from the context and from the arrays of the
+ * current vertex array object, which then read from client memory.
+ */
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_vao *vao = glthread->CurrentVAO;
+
+   if (n < 0 || !buffers)
+      return;
+
+   for (GLsizei i = 0; i < n; i++) {
+      const GLuint id = buffers[i];
+
+      if (!id)
+         continue;
+
+      if (glthread->ArrayBuffer == id)
+         glthread->ArrayBuffer = 0;
+      if (vao->IndexBuffer == id)
+         vao->IndexBuffer = 0;
+
+      for (unsigned j = 0; j < VERT_ATTRIB_MAX; j++) {
+         if (vao->Attrib[j].Buffer == id) {
+            vao->Attrib[j].Buffer = 0;
+            vao->UserPointerMask |= VERT_BIT(j);
+         }
+      }
+   }
+}
+
+void
+_mesa_glthread_GenVertexArrays(struct gl_context *ctx, GLsizei n,
+                               const GLuint *arrays)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (n < 0 || !arrays)
+      return;
+
+   for (GLsizei i = 0; i < n; i++) {
+      if (arrays[i] && !lookup_vao(glthread, arrays[i]))
+         create_vao(glthread, arrays[i]);
+   }
+}
+
+void
+_mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *arrays)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (n < 0 || !arrays)
+      return;
+
+   for (GLsizei i = 0; i < n; i++) {
+      struct glthread_vao *vao;
+
+      if (!arrays[i])
+         continue;
+
+      vao = lookup_vao(glthread, arrays[i]);
+      if (!vao)
+         continue;
+
+      /* Deleting the bound object binds the default one. */
+      if (glthread->CurrentVAO == vao)
+         glthread->CurrentVAO = &glthread->DefaultVAO;
+
+      _mesa_HashRemove(glthread->VAOs, arrays[i]);
+      free(vao);
+   }
+}
+
+void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint id)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_vao *vao = lookup_vao(glthread, id);
+
+   /* Not a name from glGenVertexArrays(), so the bind probably fails.  Let
+    * the next synchronization sort it out.
+    */
+   if (!vao) {
+      vao = create_vao(glthread, id);
+      if (!vao) {
+         glthread->CurrentVAO->Valid = false;
+         return;
+      }
+      vao->Valid = false;
+   }
+
+   glthread->CurrentVAO = vao;
+}
+
+void
+_mesa_glthread_AttribPointer(struct gl_context *ctx, gl_vert_attrib attrib,
+                             GLint size, GLenum type, GLsizei stride,
+                             const void *pointer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_vao *vao = glthread->CurrentVAO;
+   struct glthread_attrib *a = &vao->Attrib[attrib];
+   const int element_size =
+      _mesa_bytes_per_vertex_attrib(size == GL_BGRA ? 4 : size, type);
+
+   /* The call will be ignored with an error. */
+   if (element_size <= 0 || stride < 0)
+      return;
+
+   a->Pointer = pointer;
+   a->Buffer = glthread->ArrayBuffer;
+   a->ElementSize = element_size;
+   a->Stride = stride ? stride : element_size;
+
+   if (a->Buffer)
+      vao->UserPointerMask &= ~VERT_BIT(attrib);
+   else
+      vao->UserPointerMask |= VERT_BIT(attrib);
+}
+
+void
+_mesa_glthread_VertexAttribPointer(struct gl_context *ctx, GLuint index,
+                                   GLint size, GLenum type, GLsizei stride,
+                                   const void *pointer)
+{
+   if (index >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   _mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_GENERIC(index), size, type,
+                                stride, pointer);
+}
+
+void
+_mesa_glthread_TexCoordPointer(struct gl_context *ctx, GLint size,
+                               GLenum type, GLsizei stride,
+                               const void *pointer)
+{
+   const GLuint unit = ctx->GLThread->ClientActiveTexture;
+
+   _mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_TEX(unit), size, type,
+                                stride, pointer);
+}
+
+void
+_mesa_glthread_VertexAttribDivisor(struct gl_context *ctx, GLuint index,
+                                   GLuint divisor)
+{
+   if (index >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   ctx->GLThread->CurrentVAO->Attrib[VERT_ATTRIB_GENERIC(index)].Divisor =
+      divisor;
+}
+
+static void
+enable_array(struct gl_context *ctx, gl_vert_attrib attrib, bool enable)
+{
+   struct glthread_vao *vao = ctx->GLThread->CurrentVAO;
+
+   if (enable)
+      vao->Enabled |= VERT_BIT(attrib);
+   else
+      vao->Enabled &= ~VERT_BIT(attrib);
+}
+
+void
+_mesa_glthread_ClientState(struct gl_context *ctx, GLenum array, bool enable)
+{
+   switch (array) {
+   case GL_VERTEX_ARRAY:
+      enable_array(ctx, VERT_ATTRIB_POS, enable);
+      break;
+   case GL_NORMAL_ARRAY:
+      enable_array(ctx, VERT_ATTRIB_NORMAL, enable);
+      break;
+   case GL_COLOR_ARRAY:
+      enable_array(ctx, VERT_ATTRIB_COLOR0, enable);
+      break;
+   case GL_SECONDARY_COLOR_ARRAY:
+      enable_array(ctx, VERT_ATTRIB_COLOR1, enable);
+      break;
+   case GL_FOG_COORD_ARRAY:
+      enable_array(ctx, VERT_ATTRIB_FOG, enable);
+      break;
+   case GL_INDEX_ARRAY:
+      enable_array(ctx, VERT_ATTRIB_COLOR_INDEX, enable);
+      break;
+   case GL_TEXTURE_COORD_ARRAY:
+      enable_array(ctx, VERT_ATTRIB_TEX(ctx->GLThread->ClientActiveTexture),
+                   enable);
+      break;
+   case GL_EDGE_FLAG_ARRAY:
+      enable_array(ctx, VERT_ATTRIB_EDGEFLAG, enable);
+      break;
+   case GL_POINT_SIZE_ARRAY_OES:
+      enable_array(ctx, VERT_ATTRIB_POINT_SIZE, enable);
+      break;
+   case GL_PRIMITIVE_RESTART_NV:
+      ctx->GLThread->PrimitiveRestart = enable;
+      break;
+   }
+}
+
+void
+_mesa_glthread_VertexAttribArray(struct gl_context *ctx, GLuint index,
+                                 bool enable)
+{
+   if (index >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   enable_array(ctx, VERT_ATTRIB_GENERIC(index), enable);
+}
+
+void
+_mesa_glthread_ClientActiveTexture(struct gl_context *ctx, GLenum texture)
+{
+   const GLuint unit = texture - GL_TEXTURE0;
+
+   if (unit < VERT_ATTRIB_TEX_MAX)
+      ctx->GLThread->ClientActiveTexture = unit;
+}
+
+/** Tracks glEnable()/glDisable() of the caps affecting index scanning. */
+void
+_mesa_glthread_Enable(struct gl_context *ctx, GLenum cap, bool enable)
+{
+   switch (cap) {
+   case GL_PRIMITIVE_RESTART:
+      ctx->GLThread->PrimitiveRestart = enable;
+      break;
+   case GL_PRIMITIVE_RESTART_FIXED_INDEX:
+      ctx->GLThread->PrimitiveRestartFixedIndex = enable;
+      break;
+   }
+}
+
+void
+_mesa_glthread_PrimitiveRestartIndex(struct gl_context *ctx, GLuint index)
+{
+   ctx->GLThread->RestartIndex = index;
+}
+
+
+#define SCAN_INDICES(type)                                    \
+   do {                                                       \
+      const type *elts = indices;                             \
+      for (GLsizei i = 0; i < count; i++) {                   \
+         const GLuint elt = elts[i];                          \
+         if (restart && elt == restart_index)                 \
+            continue;                                         \
+         min = MIN2(min, elt);                                \
+         max = MAX2(max, elt);                                \
+      }                                                       \
+   } while (0)
+
+/**
+ * Scans indices in client memory for the range of vertices they reference,
+ * skipping restart indices.  Returns false if there are none.
+ */
+static bool
+get_index_range(const struct glthread_state *glthread, GLsizei count,
+                unsigned index_size, const void *indices,
+                GLuint *min_index, GLuint *max_index)
+{
+   const bool restart = glthread->PrimitiveRestart ||
+                        glthread->PrimitiveRestartFixedIndex;
+   const GLuint restart_index = glthread->PrimitiveRestartFixedIndex ?
+      0xffffffffu >> (32 - 8 * index_size) : glthread->RestartIndex;
+   GLuint min = ~0u, max = 0;
+
+   switch (index_size) {
+   case 1:
+      SCAN_INDICES(GLubyte);
+      break;
+   case 2:
+      SCAN_INDICES(GLushort);
+      break;
+   default:
+      SCAN_INDICES(GLuint);
+      break;
+   }
+
+   *min_index = min;
+   *max_index = max;
+   return min <= max;
+}
+
+/**
+ * Copies what a draw reads from the enabled arrays of the current vertex
+ * array object living in client memory, along with index_size bytes of
+ * indices if that's not 0.
+ */
+static bool
+upload_arrays(struct gl_context *ctx, size_t cmd_size,
+              GLuint min_vertex, GLuint num_vertices,
+              GLuint num_instances, GLuint base_instance,
+              const GLvoid **indices, size_t index_size,
+              struct glthread_upload *upload)
+{
+   const struct glthread_vao *vao = ctx->GLThread->CurrentVAO;
+   GLbitfield mask = num_vertices ? vao->Enabled & vao->UserPointerMask : 0;
+   size_t offsets[VERT_ATTRIB_MAX], sizes[VERT_ATTRIB_MAX];
+   size_t total = ALIGN(index_size, 8);
+   GLbitfield scan = mask;
+
+   while (scan) {
+      const unsigned i = u_bit_scan(&scan);
+      const struct glthread_attrib *a = &vao->Attrib[i];
+      uint64_t start, n;
+
+      /* Leave arrays nobody set up to the draw to complain about. */
+      if (!a->Pointer) {
+         mask &= ~VERT_BIT(i);
+         continue;
+      }
+
+      if (a->Divisor) {
+         start = base_instance;
+         n = (num_instances - 1) / a->Divisor + 1;
+      } else {
+         start = min_vertex;
+         n = num_vertices;
+      }
+
+      offsets[i] = start * a->Stride;
+      sizes[i] = (n - 1) * a->Stride + a->ElementSize;
+      total += ALIGN(sizes[i], 8);
+      if (total > GLTHREAD_UPLOAD_SIZE)
+         return false;
+   }
+
+   if (!total)
+      return true;
+
+   const unsigned num_arrays = _mesa_bitcount(mask);
+   uint8_t *dst = _mesa_glthread_upload_alloc(ctx, cmd_size +
+                                              num_arrays *
+                                              sizeof(upload->ptrs[0]),
+                                              total);
+   if (!dst)
+      return false;
+
+   if (index_size) {
+      memcpy(dst, *indices, index_size);
+      *indices = dst;
+      dst += ALIGN(index_size, 8);
+   }
+
+   upload->mask = mask;
+   upload->num_arrays = num_arrays;
+
+   for (unsigned k = 0; mask; k++) {
+      const unsigned i = u_bit_scan(&mask);
+
+      memcpy(dst, vao->Attrib[i].Pointer + offsets[i], sizes[i]);
+
+      /* The draw indexes the copy like it would the client array. */
+      upload->ptrs[k] = (const GLubyte *) ((uintptr_t) dst - offsets[i]);
+      dst += ALIGN(sizes[i], 8);
+   }
+   return true;
+}
+
+/**
+ * Copies the client memory arrays a glDrawArrays*() reads, for a command of
+ * cmd_size bytes plus upload->num_arrays pointers.
+ *
+ * Returns false if the draw has to be executed synchronously instead.
+ */
+bool
+_mesa_glthread_upload_arrays(struct gl_context *ctx, size_t cmd_size,
+                             GLint first, GLsizei count,
+                             GLsizei num_instances, GLuint base_instance,
+                             struct glthread_upload *upload)
+{
+   upload->mask = 0;
+   upload->num_arrays = 0;
+
+   if (!ctx->GLThread->CurrentVAO->Valid)
+      return false;
+
+   /* Errors are left to the unmarshal to report. */
+   if (first < 0 || count <= 0 || num_instances <= 0)
+      return true;
+
+   return upload_arrays(ctx, cmd_size, first, count, num_instances,
+                        base_instance, NULL, 0, upload);
+}
+
+/**
+ * Like _mesa_glthread_upload_arrays() for glDrawElements*(), which also
+ * copies indices in client memory and updates *indices to point at them.
+ */
+bool
+_mesa_glthread_upload_elements(struct gl_context *ctx, size_t cmd_size,
+                               GLsizei count, GLenum type,
+                               const GLvoid **indices, bool has_range,
+                               GLuint start, GLuint end,
+                               GLint basevertex, GLsizei num_instances,
+                               GLuint base_instance,
+                               struct glthread_upload *upload)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   const struct glthread_vao *vao = glthread->CurrentVAO;
+   const bool user_indices = !vao->IndexBuffer;
+   GLuint min_index = 0, num_vertices = 0;
+   unsigned index_size;
+
+   upload->mask = 0;
+   upload->num_arrays = 0;
+
+   if (!vao->Valid)
+      return false;
+
+   switch (type) {
+   case GL_UNSIGNED_BYTE:
+      index_size = 1;
+      break;
+   case GL_UNSIGNED_SHORT:
+      index_size = 2;
+      break;
+   case GL_UNSIGNED_INT:
+      index_size = 4;
+      break;
+   default:
+      return true;
+   }
+
+   if (count <= 0 || num_instances <= 0)
+      return true;
+
+   if (user_indices && !*indices)
+      return false;
+
+   if (vao->Enabled & vao->UserPointerMask) {
+      if (!has_range) {
+         /* Indices in a buffer object can't be read from here. */
+         if (!user_indices || !glthread->RestartValid)
+            return false;
+
+         if (!get_index_range(glthread, count, index_size, *indices,
+                              &start, &end))
+            end = start - 1;
+      }
+
+      if (end >= start) {
+         if ((int64_t) start + basevertex < 0)
+            return false;
+
+         min_index = start + basevertex;
+         num_vertices = end - start + 1;
+      }
+   }
+
+   return upload_arrays(ctx, cmd_size, min_index, num_vertices,
+                        num_instances, base_instance, indices,
+                        user_indices ? (size_t) count * index_size : 0,
+                        upload);
+}
+
+/**
+ * Points the client memory arrays in mask of the bound vertex array object
+ * at ptrs for a draw, on the worker thread.  The previous pointers are
+ * saved to old_ptrs if not NULL, to be restored the same way afterwards.
+ *
+ * ptrs follows the command in the batch and may not be aligned.
+ */
+void
+_mesa_glthread_bind_user_arrays(struct gl_context *ctx, GLbitfield mask,
+                                const void *ptrs, const GLubyte **old_ptrs)
+{
+   struct gl_vertex_array_object *vao = ctx->Array.VAO;
+
+   FLUSH_VERTICES(ctx, _NEW_ARRAY);
+
+   for (unsigned k = 0; mask; k++) {
+      const unsigned i = u_bit_scan(&mask);
+      struct gl_array_attributes *array = &vao->VertexAttrib[i];
+      struct gl_vertex_buffer_binding *binding = &vao->BufferBinding[i];
+      const GLubyte *ptr;
+
+      memcpy(&ptr, (const char *) ptrs + k * sizeof(ptr), sizeof(ptr));
+
+      if (old_ptrs)
+         old_ptrs[k] = array->Ptr;
+
+      /* Leave alone whatever the main thread was wrong about. */
+      if (array->BufferBindingIndex != i ||
+          _mesa_is_bufferobj(binding->BufferObj))
+         continue;
+
+      array->Ptr = ptr;
+      binding->Offset = (GLintptr) ptr;
+      vao->NewArrays |= VERT_BIT(i);
+   }
+}
@@ -39,6 +39,34 @@
 #include "util/hash_table.h"
 
 
+/**
+ * Dense entries are published to lock-less readers with release stores and
+ * read with acquire loads.  Without those atomics, lookups take the mutex.
+ */
+#if defined(USE_GCC_ATOMIC_BUILTINS)
+#define HASH_DENSE_LOCKLESS 1
+#define dense_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define dense_store(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#else
+#define HASH_DENSE_LOCKLESS 0
+#define dense_load(ptr) (*(ptr))
+#define dense_store(ptr, val) (*(ptr) = (val))
+#endif
+
+/**
+ * Stored in the dense array for entries inserted with NULL data, so they
+ * still count as entries, like in the struct hash_table.
+ */
+static char dense_null_data;
+#define DENSE_NULL_DATA ((void *) &dense_null_data)
+
+static inline void *
+dense_data(void *stored)
+{
+   return stored == DENSE_NULL_DATA ? NULL : stored;
+}
+
+
 /**
  * Create a new hash table.
  * 
@@ -85,14 +113,20 @@ _mesa_NewHashTable(void)
 void
 _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 {
+   GLuint i;
+
    assert(table);
 
-   if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
+   if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL ||
+       table->NumDense) {
       _mesa_problem(NULL, "In _mesa_DeleteHashTable, found non-freed data");
    }
 
    _mesa_hash_table_destroy(table->ht, NULL);
 
+   for (i = 0; i < HASH_DENSE_CHUNKS; i++)
+      free(table->Dense[i]);
+
    mtx_destroy(&table->Mutex);
    free(table);
 }
@@ -101,6 +135,8 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 
 /**
  * Lookup an entry in the hash table, without locking.
+ * With HASH_DENSE_LOCKLESS, dense entries may be read while another thread
+ * holds the mutex.
  * \sa _mesa_HashLookup
  */
 static inline void *
@@ -111,8 +147,12 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
    assert(table);
    assert(key);
 
-   if (key == DELETED_KEY_VALUE)
-      return table->deleted_key_data;
+   if (key < HASH_DENSE_MAX_KEY) {
+      void **chunk = dense_load(&table->Dense[key >> HASH_DENSE_CHUNK_BITS]);
+      if (!chunk)
+         return NULL;
+      return dense_data(dense_load(&chunk[key & (HASH_DENSE_CHUNK_SIZE - 1)]));
+   }
 
    entry = _mesa_hash_table_search_pre_hashed(table->ht,
                                               uint_hash(key),
@@ -131,11 +171,17 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
  * \param key the key.
  * 
  * \return pointer to user's data or NULL if key not in table
+ *
+ * Only keys beyond the dense array need the mutex, if HASH_DENSE_LOCKLESS.
  */
 void *
 _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
    void *res;
+
+   if (HASH_DENSE_LOCKLESS && key < HASH_DENSE_MAX_KEY)
+      return _mesa_HashLookup_unlocked(table, key);
+
    _mesa_HashLockMutex(table);
    res = _mesa_HashLookup_unlocked(table, key);
    _mesa_HashUnlockMutex(table);
@@ -173,8 +219,24 @@ _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = data;
+   if (key < HASH_DENSE_MAX_KEY) {
+      const GLuint c = key >> HASH_DENSE_CHUNK_BITS;
+      void **chunk = table->Dense[c];
+
+      if (!chunk) {
+         chunk = calloc(HASH_DENSE_CHUNK_SIZE, sizeof(void *));
+         if (!chunk) {
+            _mesa_error_no_memory(__func__);
+            return;
+         }
+         /* publish the zeroed chunk to the lock-less readers */
+         dense_store(&table->Dense[c], chunk);
+      }
+
+      chunk += key & (HASH_DENSE_CHUNK_SIZE - 1);
+      if (*chunk == NULL)
+         table->NumDense++;
+      dense_store(chunk, data ? data : DENSE_NULL_DATA);
    } else {
       entry = _mesa_hash_table_search_pre_hashed(table->ht, hash, uint_key(key));
       if (entry) {
@@ -243,8 +305,16 @@ _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
     */
    assert(!table->InDeleteAll);
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = NULL;
+   if (key < HASH_DENSE_MAX_KEY) {
+      void **chunk = table->Dense[key >> HASH_DENSE_CHUNK_BITS];
+
+      if (chunk) {
+         chunk += key & (HASH_DENSE_CHUNK_SIZE - 1);
+         if (*chunk) {
+            table->NumDense--;
+            dense_store(chunk, NULL);
+         }
+      }
    } else {
       entry = _mesa_hash_table_search_pre_hashed(table->ht,
                                                  uint_hash(key),
@@ -283,18 +353,28 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
                     void *userData)
 {
    struct hash_entry *entry;
+   GLuint c, i;
 
    assert(callback);
    _mesa_HashLockMutex(table);
    table->InDeleteAll = GL_TRUE;
+   for (c = 0; c < HASH_DENSE_CHUNKS; c++) {
+      void **chunk = table->Dense[c];
+      if (!chunk)
+         continue;
+      for (i = 0; i < HASH_DENSE_CHUNK_SIZE; i++) {
+         if (chunk[i]) {
+            callback((c << HASH_DENSE_CHUNK_BITS) | i, dense_data(chunk[i]),
+                     userData);
+            dense_store(&chunk[i], NULL);
+         }
+      }
+   }
+   table->NumDense = 0;
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
       _mesa_hash_table_remove(table->ht, entry);
    }
-   if (table->deleted_key_data) {
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
-      table->deleted_key_data = NULL;
-   }
    table->InDeleteAll = GL_FALSE;
    _mesa_HashUnlockMutex(table);
 }
@@ -315,12 +395,22 @@ hash_walk_unlocked(const struct _mesa_HashTable *table,
    assert(table);
    assert(callback);
 
+   /* The callback may remove entries, which is fine for the dense array */
+   for (GLuint c = 0; c < HASH_DENSE_CHUNKS; c++) {
+      void **chunk = table->Dense[c];
+      if (!chunk)
+         continue;
+      for (GLuint i = 0; i < HASH_DENSE_CHUNK_SIZE; i++) {
+         if (chunk[i])
+            callback((c << HASH_DENSE_CHUNK_BITS) | i, dense_data(chunk[i]),
+                     userData);
+      }
+   }
+
    struct hash_entry *entry;
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
    }
-   if (table->deleted_key_data)
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
 }
 
 
@@ -359,8 +449,6 @@ debug_print_entry(GLuint key, void *data, void *userData)
 void
 _mesa_HashPrint(const struct _mesa_HashTable *table)
 {
-   if (table->deleted_key_data)
-      debug_print_entry(DELETED_KEY_VALUE, table->deleted_key_data, NULL);
    _mesa_HashWalk(table, debug_print_entry, NULL);
 }
 
@@ -417,10 +505,7 @@ _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
 GLuint
 _mesa_HashNumEntries(const struct _mesa_HashTable *table)
 {
-   GLuint count = 0;
-
-   if (table->deleted_key_data)
-      count++;
+   GLuint count = table->NumDense;
 
    count += _mesa_hash_table_num_entries(table->ht);
 
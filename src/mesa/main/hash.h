@@ -35,19 +35,38 @@
 #include "glheader.h"
 #include "imports.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
- * Magic GLuint object name that gets stored outside of the struct hash_table.
+ * Magic GLuint object name that never gets stored in the struct hash_table.
  *
  * The hash table needs a particular pointer to be the marker for a key that
  * was deleted from the table, along with NULL for the "never allocated in the
  * table" marker.  Legacy GL allows any GLuint to be used as a GL object name,
- * and we use a 1:1 mapping from GLuints to key pointers, so we need to be
- * able to track a GLuint that happens to match the deleted key outside of
- * struct hash_table.  We tell the hash table to use "1" as the deleted key
- * value, so that we test the deleted-key-in-the-table path as best we can.
+ * and we use a 1:1 mapping from GLuints to key pointers, so we use "1" as
+ * the deleted key value: it is below HASH_DENSE_MAX_KEY, hence always kept
+ * in the dense array.
  */
 #define DELETED_KEY_VALUE 1
 
+/** @{
+ * GL names are mostly small integers handed out in increasing order by
+ * _mesa_HashFindFreeKeyBlock(), so the names below HASH_DENSE_MAX_KEY are
+ * kept in a two-level array indexed by the name, and only larger ones in
+ * the struct hash_table.
+ *
+ * The second level chunks are allocated on first use and only freed with
+ * the table, so that the array can be read without taking the mutex where
+ * the compiler provides acquire/release atomics.
+ */
+#define HASH_DENSE_CHUNK_BITS 10
+#define HASH_DENSE_CHUNK_SIZE (1 << HASH_DENSE_CHUNK_BITS)
+#define HASH_DENSE_CHUNKS 1024
+#define HASH_DENSE_MAX_KEY (HASH_DENSE_CHUNKS * HASH_DENSE_CHUNK_SIZE)
+/** @} */
+
 /** @{
  * Mapping from our use of GLuint as both the key and the hash value to the
  * hash_table.h API
@@ -96,12 +115,12 @@ uint_key(GLuint id)
  * The hash table data structure.
  */
 struct _mesa_HashTable {
-   struct hash_table *ht;
+   struct hash_table *ht;                /**< keys >= HASH_DENSE_MAX_KEY */
+   void **Dense[HASH_DENSE_CHUNKS];      /**< keys < HASH_DENSE_MAX_KEY */
+   GLuint NumDense;                      /**< used entries in Dense */
    GLuint MaxKey;                        /**< highest key inserted so far */
    mtx_t Mutex;                          /**< mutual exclusion lock */
    GLboolean InDeleteAll;                /**< Debug check */
-   /** Value that would be in the table for DELETED_KEY_VALUE. */
-   void *deleted_key_data;
 };
 
 extern struct _mesa_HashTable *_mesa_NewHashTable(void);
@@ -174,5 +193,8 @@ _mesa_HashNumEntries(const struct _mesa_HashTable *table);
 
 extern void _mesa_test_hash_functions(void);
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif
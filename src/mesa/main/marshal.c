@@ -94,6 +94,7 @@ _mesa_marshal_Enable(GLenum cap)
       cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_Enable,
                                             sizeof(*cmd));
       cmd->cap = cap;
+      _mesa_glthread_Enable(ctx, cap, true);
       _mesa_post_marshal_hook(ctx);
       return;
    }
@@ -195,58 +196,6 @@ _mesa_marshal_ShaderSource(GLuint shader, GLsizei count,
 }
 
 
-/* BindBufferBase: marshalled asynchronously */
-struct marshal_cmd_BindBufferBase
-{
-   struct marshal_cmd_base cmd_base;
-   GLenum target;
-   GLuint index;
-   GLuint buffer;
-};
-
-/** Tracks the current bindings for the vertex array and index array buffers.
- *
- * This is part of what we need to enable glthread on compat-GL contexts that
- * happen to use VBOs, without also supporting the full tracking of VBO vs
- * user vertex array bindings per attribute on each vertex array for
- * determining what to upload at draw call time.
- *
- * Note that GL core makes it so that a buffer binding with an invalid handle
- * in the "buffer" parameter will throw an error, and then a
- * glVertexAttribPointer() that followsmight not end up pointing at a VBO.
- * However, in GL core the draw call would throw an error as well, so we don't
- * really care if our tracking is wrong for this case -- we never need to
- * marshal user data for draw calls, and the unmarshal will just generate an
- * error or not as appropriate.
- *
- * For compatibility GL, we do need to accurately know whether the draw call
- * on the unmarshal side will dereference a user pointer or load data from a
- * VBO per vertex.  That would make it seem like we need to track whether a
- * "buffer" is valid, so that we can know when an error will be generated
- * instead of updating the binding.  However, compat GL has the ridiculous
- * feature that if you pass a bad name, it just gens a buffer object for you,
- * so we escape without having to know if things are valid or not.
- */
-static void
-track_vbo_binding(struct gl_context *ctx, GLenum target, GLuint buffer)
-{
-   struct glthread_state *glthread = ctx->GLThread;
-
-   switch (target) {
-   case GL_ARRAY_BUFFER:
-      glthread->vertex_array_is_vbo = (buffer != 0);
-      break;
-   case GL_ELEMENT_ARRAY_BUFFER:
-      /* The current element array buffer binding is actually tracked in the
-       * vertex array object instead of the context, so this would need to
-       * change on vertex array object updates.
-       */
-      glthread->element_array_is_vbo = (buffer != 0);
-      break;
-   }
-}
-
-
 struct marshal_cmd_BindBuffer
 {
    struct marshal_cmd_base cmd_base;
@@ -256,7 +205,7 @@ struct marshal_cmd_BindBuffer
 
 /**
  * This is just like the code-generated glBindBuffer() support, except that we
- * call track_vbo_binding().
+ * call _mesa_glthread_BindBuffer().
  */
 void
 _mesa_unmarshal_BindBuffer(struct gl_context *ctx,
@@ -274,18 +223,39 @@ _mesa_marshal_BindBuffer(GLenum target, GLuint buffer)
    struct marshal_cmd_BindBuffer *cmd;
    debug_print_marshal("BindBuffer");
 
-   track_vbo_binding(ctx, target, buffer);
+   _mesa_glthread_BindBuffer(ctx, target, buffer);
 
-   if (cmd_size <= MARSHAL_MAX_CMD_SIZE) {
-      cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_BindBuffer,
-                                            cmd_size);
-      cmd->target = target;
-      cmd->buffer = buffer;
-      _mesa_post_marshal_hook(ctx);
-   } else {
-      _mesa_glthread_finish(ctx);
-      CALL_BindBuffer(ctx->CurrentServerDispatch, (target, buffer));
+   cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_BindBuffer,
+                                         cmd_size);
+   cmd->target = target;
+   cmd->buffer = buffer;
+   _mesa_glthread_coalesce_command(ctx, &cmd->cmd_base);
+   _mesa_post_marshal_hook(ctx);
+}
+
+/**
+ * Copies the data of a buffer upload that doesn't fit in its command, so
+ * that it can still be queued: into the upload area of the batch if
+ * possible, or else onto the heap, in which case the unmarshal frees it.
+ *
+ * Returns NULL on failure, and the caller then has to synchronize.
+ */
+static const void *
+copy_buffer_data(struct gl_context *ctx, size_t cmd_size, const void *data,
+                 GLsizeiptr size, bool *heap)
+{
+   void *copy = _mesa_glthread_upload(ctx, cmd_size, data, size);
+
+   *heap = false;
+   if (!copy) {
+      copy = malloc(size);
+      if (!copy)
+         return NULL;
+
+      memcpy(copy, data, size);
+      *heap = true;
    }
+   return copy;
 }
 
 /* BufferData: marshalled asynchronously */
@@ -296,6 +266,8 @@ struct marshal_cmd_BufferData
    GLsizeiptr size;
    GLenum usage;
    bool data_null; /* If set, no data follows for "data" */
+   bool data_heap; /* If set, data_external must be freed */
+   const GLvoid *data_external; /* If set, no data follows, it's there */
    /* Next size bytes are GLubyte data[size] */
 };
 
@@ -310,10 +282,15 @@ _mesa_unmarshal_BufferData(struct gl_context *ctx,
 
    if (cmd->data_null)
       data = NULL;
+   else if (cmd->data_external)
+      data = cmd->data_external;
    else
       data = (const void *) (cmd + 1);
 
    CALL_BufferData(ctx->CurrentServerDispatch, (target, size, data, usage));
+
+   if (cmd->data_heap)
+      free((void *) cmd->data_external);
 }
 
 void GLAPIENTRY
@@ -321,36 +298,50 @@ _mesa_marshal_BufferData(GLenum target, GLsizeiptr size, const GLvoid * data,
                          GLenum usage)
 {
    GET_CURRENT_CONTEXT(ctx);
-   size_t cmd_size =
-      sizeof(struct marshal_cmd_BufferData) + (data ? size : 0);
+   const bool external = data && size > 0 &&
+      (target == GL_EXTERNAL_VIRTUAL_MEMORY_BUFFER_AMD ||
+       sizeof(struct marshal_cmd_BufferData) + size > MARSHAL_MAX_CMD_SIZE);
+   size_t cmd_size = sizeof(struct marshal_cmd_BufferData) +
+                     (data && size > 0 && !external ? size : 0);
+   const GLvoid *data_external = NULL;
+   bool data_heap = false;
    debug_print_marshal("BufferData");
 
-   if (unlikely(size < 0)) {
-      _mesa_glthread_finish(ctx);
-      _mesa_error(ctx, GL_INVALID_VALUE, "BufferData(size < 0)");
-      return;
+   if (external) {
+      /* The client memory is the storage of GL_AMD_pinned_memory buffers,
+       * so it can be passed as is.
+       */
+      if (target == GL_EXTERNAL_VIRTUAL_MEMORY_BUFFER_AMD)
+         data_external = data;
+      else
+         data_external = copy_buffer_data(ctx, cmd_size, data, size,
+                                          &data_heap);
+
+      if (!data_external) {
+         _mesa_glthread_finish(ctx);
+         debug_print_sync_fallback("BufferData");
+         CALL_BufferData(ctx->CurrentServerDispatch,
+                         (target, size, data, usage));
+         return;
+      }
    }
 
-   if (target != GL_EXTERNAL_VIRTUAL_MEMORY_BUFFER_AMD &&
-       cmd_size <= MARSHAL_MAX_CMD_SIZE) {
-      struct marshal_cmd_BufferData *cmd =
-         _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_BufferData,
-                                         cmd_size);
-
-      cmd->target = target;
-      cmd->size = size;
-      cmd->usage = usage;
-      cmd->data_null = !data;
-      if (data) {
-         char *variable_data = (char *) (cmd + 1);
-         memcpy(variable_data, data, size);
-      }
-      _mesa_post_marshal_hook(ctx);
-   } else {
-      _mesa_glthread_finish(ctx);
-      CALL_BufferData(ctx->CurrentServerDispatch,
-                      (target, size, data, usage));
+   /* Errors like size < 0 are left to the unmarshal. */
+   struct marshal_cmd_BufferData *cmd =
+      _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_BufferData,
+                                      cmd_size);
+
+   cmd->target = target;
+   cmd->size = size;
+   cmd->usage = usage;
+   cmd->data_null = !data;
+   cmd->data_heap = data_heap;
+   cmd->data_external = data_external;
+   if (data && size > 0 && !external) {
+      char *variable_data = (char *) (cmd + 1);
+      memcpy(variable_data, data, size);
    }
+   _mesa_post_marshal_hook(ctx);
 }
 
 /* BufferSubData: marshalled asynchronously */
@@ -360,6 +351,8 @@ struct marshal_cmd_BufferSubData
    GLenum target;
    GLintptr offset;
    GLsizeiptr size;
+   bool data_heap; /* If set, data_external must be freed */
+   const GLvoid *data_external; /* If set, no data follows, it's there */
    /* Next size bytes are GLubyte data[size] */
 };
 
@@ -370,10 +363,18 @@ _mesa_unmarshal_BufferSubData(struct gl_context *ctx,
    const GLenum target = cmd->target;
    const GLintptr offset = cmd->offset;
    const GLsizeiptr size = cmd->size;
-   const void *data = (const void *) (cmd + 1);
+   const void *data;
+
+   if (cmd->data_external)
+      data = cmd->data_external;
+   else
+      data = (const void *) (cmd + 1);
 
    CALL_BufferSubData(ctx->CurrentServerDispatch,
                       (target, offset, size, data));
+
+   if (cmd->data_heap)
+      free((void *) cmd->data_external);
 }
 
 void GLAPIENTRY
@@ -381,31 +382,42 @@ _mesa_marshal_BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size,
                             const GLvoid * data)
 {
    GET_CURRENT_CONTEXT(ctx);
-   size_t cmd_size = sizeof(struct marshal_cmd_BufferSubData) + size;
-
+   const bool external = data && size > 0 &&
+      sizeof(struct marshal_cmd_BufferSubData) + size > MARSHAL_MAX_CMD_SIZE;
+   size_t cmd_size = sizeof(struct marshal_cmd_BufferSubData) +
+                     (data && size > 0 && !external ? size : 0);
+   const GLvoid *data_external = NULL;
+   bool data_heap = false;
    debug_print_marshal("BufferSubData");
-   if (unlikely(size < 0)) {
-      _mesa_glthread_finish(ctx);
-      _mesa_error(ctx, GL_INVALID_VALUE, "BufferSubData(size < 0)");
-      return;
+
+   /* Unlike for BufferData, the source of BufferSubData is never buffer
+    * storage, not even for GL_AMD_pinned_memory, so it's always copied.
+    */
+   if (external) {
+      data_external = copy_buffer_data(ctx, cmd_size, data, size, &data_heap);
+
+      if (!data_external) {
+         _mesa_glthread_finish(ctx);
+         debug_print_sync_fallback("BufferSubData");
+         CALL_BufferSubData(ctx->CurrentServerDispatch,
+                            (target, offset, size, data));
+         return;
+      }
    }
 
-   if (target != GL_EXTERNAL_VIRTUAL_MEMORY_BUFFER_AMD &&
-       cmd_size <= MARSHAL_MAX_CMD_SIZE) {
-      struct marshal_cmd_BufferSubData *cmd =
-         _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_BufferSubData,
-                                         cmd_size);
-      cmd->target = target;
-      cmd->offset = offset;
-      cmd->size = size;
+   struct marshal_cmd_BufferSubData *cmd =
+      _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_BufferSubData,
+                                      cmd_size);
+   cmd->target = target;
+   cmd->offset = offset;
+   cmd->size = size;
+   cmd->data_heap = data_heap;
+   cmd->data_external = data_external;
+   if (data && size > 0 && !external) {
       char *variable_data = (char *) (cmd + 1);
       memcpy(variable_data, data, size);
-      _mesa_post_marshal_hook(ctx);
-   } else {
-      _mesa_glthread_finish(ctx);
-      CALL_BufferSubData(ctx->CurrentServerDispatch,
-                         (target, offset, size, data));
    }
+   _mesa_post_marshal_hook(ctx);
 }
 
 /* NamedBufferData: marshalled asynchronously */
@@ -413,9 +425,11 @@ struct marshal_cmd_NamedBufferData
 {
    struct marshal_cmd_base cmd_base;
    GLuint name;
-   GLsizei size;
+   GLsizeiptr size;
    GLenum usage;
    bool data_null; /* If set, no data follows for "data" */
+   bool data_heap; /* If set, data_external must be freed */
+   const GLvoid *data_external; /* If set, no data follows, it's there */
    /* Next size bytes are GLubyte data[size] */
 };
 
@@ -424,17 +438,22 @@ _mesa_unmarshal_NamedBufferData(struct gl_context *ctx,
                                 const struct marshal_cmd_NamedBufferData *cmd)
 {
    const GLuint name = cmd->name;
-   const GLsizei size = cmd->size;
+   const GLsizeiptr size = cmd->size;
    const GLenum usage = cmd->usage;
    const void *data;
 
    if (cmd->data_null)
       data = NULL;
+   else if (cmd->data_external)
+      data = cmd->data_external;
    else
       data = (const void *) (cmd + 1);
 
    CALL_NamedBufferData(ctx->CurrentServerDispatch,
                         (name, size, data, usage));
+
+   if (cmd->data_heap)
+      free((void *) cmd->data_external);
 }
 
 void GLAPIENTRY
@@ -442,33 +461,39 @@ _mesa_marshal_NamedBufferData(GLuint buffer, GLsizeiptr size,
                               const GLvoid * data, GLenum usage)
 {
    GET_CURRENT_CONTEXT(ctx);
-   size_t cmd_size = sizeof(struct marshal_cmd_NamedBufferData) + (data ? size : 0);
-
+   const bool external = data && size > 0 &&
+      sizeof(struct marshal_cmd_NamedBufferData) + size > MARSHAL_MAX_CMD_SIZE;
+   size_t cmd_size = sizeof(struct marshal_cmd_NamedBufferData) +
+                     (data && size > 0 && !external ? size : 0);
+   const GLvoid *data_external = NULL;
+   bool data_heap = false;
    debug_print_marshal("NamedBufferData");
-   if (unlikely(size < 0)) {
-      _mesa_glthread_finish(ctx);
-      _mesa_error(ctx, GL_INVALID_VALUE, "NamedBufferData(size < 0)");
-      return;
-   }
 
-   if (buffer > 0 && cmd_size <= MARSHAL_MAX_CMD_SIZE) {
-      struct marshal_cmd_NamedBufferData *cmd =
-         _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_NamedBufferData,
-                                         cmd_size);
-      cmd->name = buffer;
-      cmd->size = size;
-      cmd->usage = usage;
-      cmd->data_null = !data;
-      if (data) {
-         char *variable_data = (char *) (cmd + 1);
-         memcpy(variable_data, data, size);
+   if (external) {
+      data_external = copy_buffer_data(ctx, cmd_size, data, size, &data_heap);
+      if (!data_external) {
+         _mesa_glthread_finish(ctx);
+         debug_print_sync_fallback("NamedBufferData");
+         CALL_NamedBufferData(ctx->CurrentServerDispatch,
+                              (buffer, size, data, usage));
+         return;
       }
-      _mesa_post_marshal_hook(ctx);
-   } else {
-      _mesa_glthread_finish(ctx);
-      CALL_NamedBufferData(ctx->CurrentServerDispatch,
-                           (buffer, size, data, usage));
    }
+
+   struct marshal_cmd_NamedBufferData *cmd =
+      _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_NamedBufferData,
+                                      cmd_size);
+   cmd->name = buffer;
+   cmd->size = size;
+   cmd->usage = usage;
+   cmd->data_null = !data;
+   cmd->data_heap = data_heap;
+   cmd->data_external = data_external;
+   if (data && size > 0 && !external) {
+      char *variable_data = (char *) (cmd + 1);
+      memcpy(variable_data, data, size);
+   }
+   _mesa_post_marshal_hook(ctx);
 }
 
 /* NamedBufferSubData: marshalled asynchronously */
@@ -477,7 +502,9 @@ struct marshal_cmd_NamedBufferSubData
    struct marshal_cmd_base cmd_base;
    GLuint name;
    GLintptr offset;
-   GLsizei size;
+   GLsizeiptr size;
+   bool data_heap; /* If set, data_external must be freed */
+   const GLvoid *data_external; /* If set, no data follows, it's there */
    /* Next size bytes are GLubyte data[size] */
 };
 
@@ -487,11 +514,19 @@ _mesa_unmarshal_NamedBufferSubData(struct gl_context *ctx,
 {
    const GLuint name = cmd->name;
    const GLintptr offset = cmd->offset;
-   const GLsizei size = cmd->size;
-   const void *data = (const void *) (cmd + 1);
+   const GLsizeiptr size = cmd->size;
+   const void *data;
+
+   if (cmd->data_external)
+      data = cmd->data_external;
+   else
+      data = (const void *) (cmd + 1);
 
    CALL_NamedBufferSubData(ctx->CurrentServerDispatch,
                            (name, offset, size, data));
+
+   if (cmd->data_heap)
+      free((void *) cmd->data_external);
 }
 
 void GLAPIENTRY
@@ -499,30 +534,39 @@ _mesa_marshal_NamedBufferSubData(GLuint buffer, GLintptr offset,
                                  GLsizeiptr size, const GLvoid * data)
 {
    GET_CURRENT_CONTEXT(ctx);
-   size_t cmd_size = sizeof(struct marshal_cmd_NamedBufferSubData) + size;
-
+   const bool external = data && size > 0 &&
+      sizeof(struct marshal_cmd_NamedBufferSubData) + size >
+      MARSHAL_MAX_CMD_SIZE;
+   size_t cmd_size = sizeof(struct marshal_cmd_NamedBufferSubData) +
+                     (data && size > 0 && !external ? size : 0);
+   const GLvoid *data_external = NULL;
+   bool data_heap = false;
    debug_print_marshal("NamedBufferSubData");
-   if (unlikely(size < 0)) {
-      _mesa_glthread_finish(ctx);
-      _mesa_error(ctx, GL_INVALID_VALUE, "NamedBufferSubData(size < 0)");
-      return;
+
+   if (external) {
+      data_external = copy_buffer_data(ctx, cmd_size, data, size, &data_heap);
+      if (!data_external) {
+         _mesa_glthread_finish(ctx);
+         debug_print_sync_fallback("NamedBufferSubData");
+         CALL_NamedBufferSubData(ctx->CurrentServerDispatch,
+                                 (buffer, offset, size, data));
+         return;
+      }
    }
 
-   if (buffer > 0 && cmd_size <= MARSHAL_MAX_CMD_SIZE) {
-      struct marshal_cmd_NamedBufferSubData *cmd =
-         _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_NamedBufferSubData,
-                                         cmd_size);
-      cmd->name = buffer;
-      cmd->offset = offset;
-      cmd->size = size;
+   struct marshal_cmd_NamedBufferSubData *cmd =
+      _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_NamedBufferSubData,
+                                      cmd_size);
+   cmd->name = buffer;
+   cmd->offset = offset;
+   cmd->size = size;
+   cmd->data_heap = data_heap;
+   cmd->data_external = data_external;
+   if (data && size > 0 && !external) {
       char *variable_data = (char *) (cmd + 1);
       memcpy(variable_data, data, size);
-      _mesa_post_marshal_hook(ctx);
-   } else {
-      _mesa_glthread_finish(ctx);
-      CALL_NamedBufferSubData(ctx->CurrentServerDispatch,
-                              (buffer, offset, size, data));
    }
+   _mesa_post_marshal_hook(ctx);
 }
 
 /* ClearBuffer* (all variants): marshalled asynchronously */
@@ -42,7 +42,7 @@ struct marshal_cmd_base
    uint16_t cmd_id;
 
    /**
-    * Size of command, in multiples of 4 bytes, including cmd_base.
+    * Size of command, in bytes, including cmd_base.
     */
    uint16_t cmd_size;
 };
@@ -57,12 +57,15 @@ _mesa_glthread_allocate_command(struct gl_context *ctx,
    struct marshal_cmd_base *cmd_base;
    const size_t aligned_size = ALIGN(size, 8);
 
-   if (unlikely(next->used + size > MARSHAL_MAX_CMD_SIZE)) {
+   if (unlikely(next->used + size > glthread->batch_size)) {
       _mesa_glthread_flush_batch(ctx);
       next = &glthread->batches[glthread->next];
    }
 
    cmd_base = (struct marshal_cmd_base *)&next->buffer[next->used];
+
+   /* Clear the alignment padding for _mesa_glthread_coalesce_command(). */
+   memset(&next->buffer[next->used + aligned_size - 8], 0, 8);
    next->used += aligned_size;
    cmd_base->cmd_id = cmd_id;
    cmd_base->cmd_size = aligned_size;
@@ -70,28 +73,58 @@ _mesa_glthread_allocate_command(struct gl_context *ctx,
 }
 
 /**
- * Instead of conditionally handling marshaling previously-bound user vertex
- * array data in draw calls (deprecated and removed in GL core), we just
- * disable threading at the point where the user sets a user vertex array.
+ * Drops cmd, the last command allocated, if it's identical to the command
+ * before it, and remembers it for the next call otherwise.
+ *
+ * This is for state setting calls that applications commonly repeat without
+ * checking, like binding the same texture or setting the same uniform value
+ * for every draw.  Executing such a call twice in a row has the same effect
+ * as executing it once, errors included.
  */
-static inline bool
-_mesa_glthread_is_non_vbo_vertex_attrib_pointer(const struct gl_context *ctx)
+static inline void
+_mesa_glthread_coalesce_command(struct gl_context *ctx,
+                                const struct marshal_cmd_base *cmd)
 {
    struct glthread_state *glthread = ctx->GLThread;
+   const struct marshal_cmd_base *last = glthread->last_coalescable;
+
+   if (last && (const uint8_t *) last + last->cmd_size ==
+               (const uint8_t *) cmd &&
+       last->cmd_id == cmd->cmd_id && last->cmd_size == cmd->cmd_size &&
+       memcmp(last, cmd, cmd->cmd_size) == 0) {
+      glthread->batches[glthread->next].used -= cmd->cmd_size;
+      return;
+   }
 
-   return ctx->API != API_OPENGL_CORE && !glthread->vertex_array_is_vbo;
+   glthread->last_coalescable = cmd;
 }
 
 /**
- * Instead of conditionally handling marshaling immediate index data in draw
- * calls (deprecated and removed in GL core), we just disable threading.
+ * Whether a draw may read vertex arrays from client memory (deprecated and
+ * removed in GL core), which then have to be copied by
+ * _mesa_glthread_upload_arrays() for the draw to be queued.
  */
 static inline bool
-_mesa_glthread_is_non_vbo_draw_elements(const struct gl_context *ctx)
+_mesa_glthread_has_user_arrays(const struct gl_context *ctx)
 {
-   struct glthread_state *glthread = ctx->GLThread;
+   const struct glthread_vao *vao = ctx->GLThread->CurrentVAO;
 
-   return ctx->API != API_OPENGL_CORE && !glthread->element_array_is_vbo;
+   return ctx->API != API_OPENGL_CORE &&
+          (!vao->Valid || (vao->Enabled & vao->UserPointerMask));
+}
+
+/**
+ * Like _mesa_glthread_has_user_arrays(), but also true for indices in client
+ * memory, for _mesa_glthread_upload_elements().
+ */
+static inline bool
+_mesa_glthread_has_user_elements(const struct gl_context *ctx)
+{
+   const struct glthread_vao *vao = ctx->GLThread->CurrentVAO;
+
+   return ctx->API != API_OPENGL_CORE &&
+          (!vao->Valid || !vao->IndexBuffer ||
+           (vao->Enabled & vao->UserPointerMask));
 }
 
 #define DEBUG_MARSHAL_PRINT_CALLS 0
@@ -151,29 +184,6 @@ _mesa_post_marshal_hook(struct gl_context *ctx)
 }
 
 
-/**
- * Checks whether we're on a compat context for code-generated
- * glBindVertexArray().
- *
- * In order to decide whether a draw call uses only VBOs for vertex and index
- * buffers, we track the current vertex and index buffer bindings by
- * glBindBuffer().  However, the index buffer binding is stored in the vertex
- * array as opposed to the context.  If we were to accurately track whether
- * the index buffer was a user pointer ot not, we'd have to track it per
- * vertex array, which would mean synchronizing with the client thread and
- * looking into the hash table to find the actual vertex array object.  That's
- * more tracking than we'd like to do in the main thread, if possible.
- *
- * Instead, just punt for now and disable threading on apps using vertex
- * arrays and compat contexts.  Apps using vertex arrays can probably use a
- * core context.
- */
-static inline bool
-_mesa_glthread_is_compat_bind_vertex_array(const struct gl_context *ctx)
-{
-   return ctx->API != API_OPENGL_CORE;
-}
-
 struct marshal_cmd_Enable;
 struct marshal_cmd_ShaderSource;
 struct marshal_cmd_Flush;
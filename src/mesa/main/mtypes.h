@@ -99,7 +99,9 @@ struct gl_uniform_storage;
 struct prog_instruction;
 struct gl_program_parameter_list;
 struct gl_shader_spirv_data;
+struct gl_shader_compile_job;
 struct set;
+struct util_queue;
 struct vbo_context;
 /*@}*/
 
@@ -2597,6 +2599,12 @@ struct gl_shader
 
    enum gl_compile_status CompileStatus;
 
+   /**
+    * The last glCompileShader call, which may still be running on
+    * gl_context::ShaderCompileQueue.  See _mesa_wait_shader_compile().
+    */
+   struct gl_shader_compile_job *CompileJob;
+
 #ifdef DEBUG
    unsigned SourceChecksum;       /**< for debug/logging purposes */
 #endif
@@ -4430,6 +4438,7 @@ struct gl_dlist_state
        * list.  Used to eliminate some redundant state changes.
        */
       GLenum ShadeModel;
+      GLenum MatrixMode;
    } Current;
 };
 
@@ -4889,6 +4898,23 @@ struct gl_context
     */
    struct gl_pipeline_object *_Shader;
 
+   /**
+    * Threads running glCompileShader asynchronously, created on first use.
+    * ShaderCompileThreads is their number, from MESA_GLSL_COMPILE_THREADS,
+    * and 0 if shaders are compiled synchronously.
+    */
+   struct util_queue *ShaderCompileQueue;
+   unsigned ShaderCompileThreads;
+
+   /**
+    * Threads helping _mesa_texstore() convert the rows of large texture
+    * uploads, created on first use.  TexStoreThreads is their number, from
+    * MESA_TEXSTORE_THREADS, and 0 if uploads are converted on the calling
+    * thread only.
+    */
+   struct util_queue *TexStoreQueue;
+   unsigned TexStoreThreads;
+
    struct gl_query_state Query;  /**< occlusion, timer queries */
 
    struct gl_transform_feedback_state TransformFeedback;
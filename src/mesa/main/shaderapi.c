@@ -40,6 +40,7 @@
 #include <stdbool.h>
 #include "main/glheader.h"
 #include "main/context.h"
+#include "main/debug_output.h"
 #include "main/dispatch.h"
 #include "main/enums.h"
 #include "main/glspirv.h"
@@ -62,6 +63,7 @@
 #include "util/hash_table.h"
 #include "util/mesa-sha1.h"
 #include "util/crc32.h"
+#include "util/u_queue.h"
 
 /**
  * Return mask of GLSL_x flags by examining the MESA_GLSL env var.
@@ -137,6 +139,10 @@ _mesa_init_shader_state(struct gl_context *ctx)
 
    ctx->Shader.Flags = _mesa_get_shader_flags();
 
+   const char *threads = getenv("MESA_GLSL_COMPILE_THREADS");
+   if (threads)
+      ctx->ShaderCompileThreads = strtoul(threads, NULL, 0);
+
    if (ctx->Shader.Flags != 0)
       ctx->Const.GenerateTemporaryNames = true;
 
@@ -165,6 +171,17 @@ _mesa_free_shader_state(struct gl_context *ctx)
    _mesa_reference_pipeline_object(ctx, &ctx->_Shader, NULL);
 
    assert(ctx->Shader.RefCount == 1);
+
+   /* Pending compiles use the context, so they must be done before it goes
+    * away.  Shaders outliving it in the share group find their fence
+    * signalled.
+    */
+   if (ctx->ShaderCompileQueue) {
+      util_queue_finish(ctx->ShaderCompileQueue);
+      util_queue_destroy(ctx->ShaderCompileQueue);
+      free(ctx->ShaderCompileQueue);
+      ctx->ShaderCompileQueue = NULL;
+   }
 }
 
 
@@ -957,9 +974,11 @@ get_shaderiv(struct gl_context *ctx, GLuint name, GLenum pname, GLint *params)
       *params = shader->DeletePending;
       break;
    case GL_COMPILE_STATUS:
+      _mesa_wait_shader_compile(shader);
       *params = shader->CompileStatus ? GL_TRUE : GL_FALSE;
       break;
    case GL_INFO_LOG_LENGTH:
+      _mesa_wait_shader_compile(shader);
       *params = (shader->InfoLog && shader->InfoLog[0] != '\0') ?
          strlen(shader->InfoLog) + 1 : 0;
       break;
@@ -1025,6 +1044,7 @@ get_shader_info_log(struct gl_context *ctx, GLuint shader, GLsizei bufSize,
       return;
    }
 
+   _mesa_wait_shader_compile(sh);
    _mesa_copy_string(infoLog, bufSize, length, sh->InfoLog);
 }
 
@@ -1060,6 +1080,9 @@ set_shader_source(struct gl_shader *sh, const GLchar *source)
 {
    assert(sh);
 
+   /* A pending compile is still reading the old source. */
+   _mesa_wait_shader_compile(sh);
+
    /* The GL_ARB_gl_spirv spec adds the following to the end of the description
     * of ShaderSource:
     *
@@ -1089,33 +1112,21 @@ set_shader_source(struct gl_shader *sh, const GLchar *source)
 
 
 /**
- * Compile a shader.
+ * Compile a shader, on any thread.
+ *
+ * This reads ctx->Shader.Flags rather than ctx->_Shader->Flags, which has
+ * the same value but may be unbound and freed by the application thread.
  */
-void
-_mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
+static void
+compile_shader(struct gl_context *ctx, struct gl_shader *sh)
 {
-   if (!sh)
-      return;
-
-   /* The GL_ARB_gl_spirv spec says:
-    *
-    *    "Add a new error for the CompileShader command:
-    *
-    *      An INVALID_OPERATION error is generated if the SPIR_V_BINARY_ARB
-    *      state of <shader> is TRUE."
-    */
-   if (sh->spirv_data) {
-      _mesa_error(ctx, GL_INVALID_OPERATION, "glCompileShader(SPIR-V)");
-      return;
-   }
-
    if (!sh->Source) {
       /* If the user called glCompileShader without first calling
        * glShaderSource, we should fail to compile, but not raise a GL_ERROR.
        */
       sh->CompileStatus = compile_failure;
    } else {
-      if (ctx->_Shader->Flags & GLSL_DUMP) {
+      if (ctx->Shader.Flags & GLSL_DUMP) {
          _mesa_log("GLSL source for %s shader %d:\n",
                  _mesa_shader_stage_to_string(sh->Stage), sh->Name);
          _mesa_log("%s\n", sh->Source);
@@ -1126,11 +1137,11 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
        */
       _mesa_glsl_compile_shader(ctx, sh, false, false, false);
 
-      if (ctx->_Shader->Flags & GLSL_LOG) {
+      if (ctx->Shader.Flags & GLSL_LOG) {
          _mesa_write_shader_to_file(sh);
       }
 
-      if (ctx->_Shader->Flags & GLSL_DUMP) {
+      if (ctx->Shader.Flags & GLSL_DUMP) {
          if (sh->CompileStatus) {
             if (sh->ir) {
                _mesa_log("GLSL IR for shader %d:\n", sh->Name);
@@ -1151,14 +1162,14 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
    }
 
    if (!sh->CompileStatus) {
-      if (ctx->_Shader->Flags & GLSL_DUMP_ON_ERROR) {
+      if (ctx->Shader.Flags & GLSL_DUMP_ON_ERROR) {
          _mesa_log("GLSL source for %s shader %d:\n",
                  _mesa_shader_stage_to_string(sh->Stage), sh->Name);
          _mesa_log("%s\n", sh->Source);
          _mesa_log("Info Log:\n%s\n", sh->InfoLog);
       }
 
-      if (ctx->_Shader->Flags & GLSL_REPORT_ERRORS) {
+      if (ctx->Shader.Flags & GLSL_REPORT_ERRORS) {
          _mesa_debug(ctx, "Error compiling shader %u:\n%s\n",
                      sh->Name, sh->InfoLog);
       }
@@ -1166,6 +1177,139 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
 }
 
 
+/**
+ * A glCompileShader call queued on gl_context::ShaderCompileQueue.
+ *
+ * It's allocated by the first asynchronous compile of a shader and freed
+ * with the shader, so that waiting for it never races with freeing it.
+ */
+struct gl_shader_compile_job
+{
+   struct util_queue_fence fence;
+   struct gl_context *ctx;
+   struct gl_shader *sh;
+};
+
+
+static void
+compile_shader_job(void *data, int thread_index)
+{
+   struct gl_shader_compile_job *job = (struct gl_shader_compile_job *) data;
+
+   compile_shader(job->ctx, job->sh);
+}
+
+
+/**
+ * Queue the compilation of a shader.  Returns false if it must be compiled
+ * synchronously instead.
+ */
+static bool
+queue_shader_compile(struct gl_context *ctx, struct gl_shader *sh)
+{
+   if (!ctx->ShaderCompileThreads)
+      return false;
+
+   /* Compiler errors are reported through GL_KHR_debug, and the application
+    * asked for the callback to be called on its own thread.
+    */
+   if (ctx->Debug &&
+       _mesa_get_debug_state_int(ctx, GL_DEBUG_OUTPUT_SYNCHRONOUS))
+      return false;
+
+   if (!ctx->ShaderCompileQueue) {
+      struct util_queue *queue = CALLOC_STRUCT(util_queue);
+
+      if (!queue ||
+          !util_queue_init(queue, "glsl", 64, ctx->ShaderCompileThreads,
+                           UTIL_QUEUE_INIT_RESIZE_IF_FULL)) {
+         free(queue);
+         ctx->ShaderCompileThreads = 0;
+         return false;
+      }
+      ctx->ShaderCompileQueue = queue;
+   }
+
+   if (!sh->CompileJob) {
+      sh->CompileJob = CALLOC_STRUCT(gl_shader_compile_job);
+      if (!sh->CompileJob)
+         return false;
+
+      util_queue_fence_init(&sh->CompileJob->fence);
+   }
+
+   sh->CompileJob->ctx = ctx;
+   sh->CompileJob->sh = sh;
+   util_queue_add_job(ctx->ShaderCompileQueue, sh->CompileJob,
+                      &sh->CompileJob->fence, compile_shader_job, NULL);
+   return true;
+}
+
+
+/**
+ * Wait for the last glCompileShader call on a shader to finish.  This must
+ * be called before looking at the result of the compilation or changing
+ * the shader.
+ */
+void
+_mesa_wait_shader_compile(struct gl_shader *sh)
+{
+   if (sh->CompileJob)
+      util_queue_fence_wait(&sh->CompileJob->fence);
+}
+
+
+/**
+ * Wait for the last glCompileShader call on a shader to finish and free its
+ * job, when the shader is deleted.
+ */
+void
+_mesa_free_shader_compile_job(struct gl_shader *sh)
+{
+   if (!sh->CompileJob)
+      return;
+
+   util_queue_fence_wait(&sh->CompileJob->fence);
+   util_queue_fence_destroy(&sh->CompileJob->fence);
+   free(sh->CompileJob);
+   sh->CompileJob = NULL;
+}
+
+
+/**
+ * Compile a shader.
+ *
+ * With MESA_GLSL_COMPILE_THREADS, the compilation runs on a thread pool
+ * and only the calls looking at its result wait for it, so that
+ * applications compiling many shaders at once use all cores.
+ */
+void
+_mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
+{
+   if (!sh)
+      return;
+
+   /* The GL_ARB_gl_spirv spec says:
+    *
+    *    "Add a new error for the CompileShader command:
+    *
+    *      An INVALID_OPERATION error is generated if the SPIR_V_BINARY_ARB
+    *      state of <shader> is TRUE."
+    */
+   if (sh->spirv_data) {
+      _mesa_error(ctx, GL_INVALID_OPERATION, "glCompileShader(SPIR-V)");
+      return;
+   }
+
+   _mesa_wait_shader_compile(sh);
+
+   if (sh->Source && queue_shader_compile(ctx, sh))
+      return;
+
+   compile_shader(ctx, sh);
+}
+
+
 /**
  * Link a program's shaders.
  */
@@ -1198,6 +1342,9 @@ link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
          }
    }
 
+   for (unsigned i = 0; i < shProg->NumShaders; i++)
+      _mesa_wait_shader_compile(shProg->Shaders[i]);
+
    FLUSH_VERTICES(ctx, 0);
    _mesa_glsl_link_shader(ctx, shProg);
 
@@ -61,6 +61,12 @@ _mesa_active_program(struct gl_context *ctx, struct gl_shader_program *shProg,
 extern void
 _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh);
 
+extern void
+_mesa_wait_shader_compile(struct gl_shader *sh);
+
+extern void
+_mesa_free_shader_compile_job(struct gl_shader *sh);
+
 extern void
 _mesa_link_program(struct gl_context *ctx, struct gl_shader_program *sh_prog);
 
@@ -30,9 +30,16 @@
  */
 
 #include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "main/formats.h"
 #include "main/glformats.h"
+#include "main/mtypes.h"
+#include "main/texstore.h"
+#include "util/os_time.h"
+#include "util/u_queue.h"
 
 /**
  * Debug/test: check that all uncompressed formats are handled in the
@@ -137,3 +144,70 @@ TEST(MesaFormatsTest, FormatSanity)
 
    }
 }
+
+/**
+ * Not a correctness test: prints the _mesa_texstore() throughput of a
+ * 1024x1024 GL_RGBA/GL_UNSIGNED_BYTE upload into each uncompressed,
+ * non-integer color format, on the calling thread only and with helper
+ * threads as set by MESA_TEXSTORE_THREADS.
+ * Run it with --gtest_also_run_disabled_tests.
+ */
+TEST(MesaFormatsTest, DISABLED_TexStoreThroughput)
+{
+   static const unsigned threads[] = { 0, 3 };
+   static struct gl_context ctx;
+   struct gl_pixelstore_attrib packing;
+   const int size = 1024;
+   const int rounds = 4;
+
+   memset(&ctx, 0, sizeof(ctx));
+   memset(&packing, 0, sizeof(packing));
+   packing.Alignment = 4;
+
+   GLubyte *src = (GLubyte *) malloc(size * size * 4);
+   GLubyte *dst = (GLubyte *) malloc(size * size * 16);
+   ASSERT_TRUE(src != NULL && dst != NULL);
+
+   for (int i = 0; i < size * size * 4; i++)
+      src[i] = (GLubyte) (i * 7);
+
+   for (int fi = MESA_FORMAT_NONE + 1; fi < MESA_FORMAT_COUNT; ++fi) {
+      mesa_format f = (mesa_format) fi;
+      GLenum base = _mesa_get_format_base_format(f);
+
+      if (_mesa_is_format_compressed(f) ||
+          _mesa_is_format_integer(f) ||
+          _mesa_get_format_bytes(f) > 16 ||
+          _mesa_is_depth_or_stencil_format(base) ||
+          base == GL_YCBCR_MESA)
+         continue;
+
+      GLint dstRowStride = size * _mesa_get_format_bytes(f);
+      double mpix[ARRAY_SIZE(threads)];
+
+      for (unsigned t = 0; t < ARRAY_SIZE(threads); t++) {
+         ctx.TexStoreThreads = threads[t];
+
+         int64_t start = os_time_get_nano();
+         for (int r = 0; r < rounds; r++) {
+            EXPECT_TRUE(_mesa_texstore(&ctx, 2, base, f, dstRowStride, &dst,
+                                       size, size, 1,
+                                       GL_RGBA, GL_UNSIGNED_BYTE, src,
+                                       &packing));
+         }
+         int64_t end = os_time_get_nano();
+
+         mpix[t] = (double) rounds * size * size * 1e3 / MAX2(end - start, 1);
+      }
+
+      printf("%-40s %8.1f Mpix/s, %u threads: %8.1f Mpix/s\n",
+             _mesa_get_format_name(f), mpix[0], threads[1], mpix[1]);
+   }
+
+   if (ctx.TexStoreQueue) {
+      util_queue_destroy(ctx.TexStoreQueue);
+      free(ctx.TexStoreQueue);
+   }
+   free(src);
+   free(dst);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright © 2018 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "main/mtypes.h"
+#include "main/get.h"
+#include "util/os_time.h"
+
+/**
+ * All the glGet enums in get_hash_params.py are below this, the largest
+ * being GL_RASTER_POSITION_UNCLIPPED_IBM.
+ */
+#define GET_ENUM_SWEEP 0x20000
+
+static const struct {
+   const char *name;
+   gl_api api;
+   GLuint version;
+} get_apis[] = {
+   { "GL compat", API_OPENGL_COMPAT, 30 },
+   { "GL core",   API_OPENGL_CORE,   45 },
+   { "GLES 1",    API_OPENGLES,      11 },
+   { "GLES 2",    API_OPENGLES2,     20 },
+   { "GLES 3.0",  API_OPENGLES2,     30 },
+   { "GLES 3.1",  API_OPENGLES2,     31 },
+   { "GLES 3.2",  API_OPENGLES2,     32 },
+};
+
+class MesaGetTest : public ::testing::Test {
+public:
+   virtual void SetUp();
+
+   void SetAPI(unsigned i);
+
+   struct gl_context *ctx;
+};
+
+void
+MesaGetTest::SetUp()
+{
+   static struct gl_context context;
+
+   memset(&context, 0, sizeof(context));
+   ctx = &context;
+}
+
+void
+MesaGetTest::SetAPI(unsigned i)
+{
+   ctx->API = get_apis[i].api;
+   ctx->Version = get_apis[i].version;
+}
+
+TEST_F(MesaGetTest, ValueIndex)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(get_apis); i++) {
+      SetAPI(i);
+      EXPECT_NE(0u, _mesa_get_value_index(ctx, GL_VIEWPORT)) << get_apis[i].name;
+      EXPECT_EQ(0u, _mesa_get_value_index(ctx, 0)) << get_apis[i].name;
+      EXPECT_EQ(0u, _mesa_get_value_index(ctx, GL_INVALID_ENUM)) << get_apis[i].name;
+   }
+
+   SetAPI(0);
+   EXPECT_NE(0u, _mesa_get_value_index(ctx, GL_RASTER_POSITION_UNCLIPPED_IBM));
+   EXPECT_EQ(0u, _mesa_get_value_index(ctx, GL_RASTER_POSITION_UNCLIPPED_IBM + 1));
+}
+
+/**
+ * Not a correctness test: prints the glGet enum lookup throughput for each
+ * API, over every enum below GET_ENUM_SWEEP.  That covers all the enums in
+ * get_hash_params.py, plus the invalid ones in between.
+ * Run it with --gtest_also_run_disabled_tests.
+ */
+TEST_F(MesaGetTest, DISABLED_LookupThroughput)
+{
+   const unsigned rounds = 64;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(get_apis); i++) {
+      unsigned num_valid = 0;
+      uint64_t sum = 0;
+
+      SetAPI(i);
+
+      for (GLenum pname = 0; pname < GET_ENUM_SWEEP; pname++)
+         num_valid += _mesa_get_value_index(ctx, pname) != 0;
+
+      int64_t start = os_time_get_nano();
+      for (unsigned r = 0; r < rounds; r++) {
+         for (GLenum pname = 0; pname < GET_ENUM_SWEEP; pname++)
+            sum += _mesa_get_value_index(ctx, pname);
+      }
+      int64_t end = os_time_get_nano();
+
+      EXPECT_NE(0u, sum);
+      printf("%-9s %4u enums: %.2f ns/lookup\n", get_apis[i].name, num_valid,
+             (double) (end - start) / ((uint64_t) rounds * GET_ENUM_SWEEP));
+   }
+}
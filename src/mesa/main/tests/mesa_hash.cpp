@@ -0,0 +1,222 @@
+/*
+ * Copyright © 2018 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file mesa_hash.cpp
+ * Tests for the GL object name table in main/hash.c.
+ */
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "main/hash.h"
+#include "util/os_time.h"
+
+static void *
+name_data(GLuint key)
+{
+   return (void *) (uintptr_t) (key * 2 + 2);
+}
+
+class MesaHashTest : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   struct _mesa_HashTable *table;
+};
+
+void
+MesaHashTest::SetUp()
+{
+   table = _mesa_NewHashTable();
+   ASSERT_TRUE(table != NULL);
+}
+
+static void
+remove_cb(GLuint key, void *data, void *userData)
+{
+   struct _mesa_HashTable *table = (struct _mesa_HashTable *) userData;
+   _mesa_HashRemoveLocked(table, key);
+}
+
+void
+MesaHashTest::TearDown()
+{
+   _mesa_HashWalk(table, remove_cb, table);
+   _mesa_DeleteHashTable(table);
+}
+
+static const GLuint test_keys[] = {
+   1, 2, 3, HASH_DENSE_CHUNK_SIZE - 1, HASH_DENSE_CHUNK_SIZE,
+   HASH_DENSE_MAX_KEY - 1, HASH_DENSE_MAX_KEY, HASH_DENSE_MAX_KEY + 1,
+   0x7fffffff, 0xfffffffe,
+};
+
+TEST_F(MesaHashTest, InsertLookup)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(test_keys); i++) {
+      EXPECT_EQ(NULL, _mesa_HashLookup(table, test_keys[i]));
+      _mesa_HashInsert(table, test_keys[i], name_data(test_keys[i]));
+   }
+
+   for (unsigned i = 0; i < ARRAY_SIZE(test_keys); i++)
+      EXPECT_EQ(name_data(test_keys[i]), _mesa_HashLookup(table, test_keys[i]));
+
+   EXPECT_EQ(ARRAY_SIZE(test_keys), _mesa_HashNumEntries(table));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 4));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, HASH_DENSE_MAX_KEY + 2));
+}
+
+TEST_F(MesaHashTest, Remove)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(test_keys); i++)
+      _mesa_HashInsert(table, test_keys[i], name_data(test_keys[i]));
+
+   for (unsigned i = 0; i < ARRAY_SIZE(test_keys); i += 2)
+      _mesa_HashRemove(table, test_keys[i]);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(test_keys); i++) {
+      EXPECT_EQ(i % 2 ? name_data(test_keys[i]) : NULL,
+                _mesa_HashLookup(table, test_keys[i]));
+   }
+
+   EXPECT_EQ(ARRAY_SIZE(test_keys) / 2, _mesa_HashNumEntries(table));
+}
+
+TEST_F(MesaHashTest, ReplaceAndNull)
+{
+   _mesa_HashInsert(table, 5, name_data(5));
+   _mesa_HashInsert(table, 5, name_data(6));
+   EXPECT_EQ(name_data(6), _mesa_HashLookup(table, 5));
+   EXPECT_EQ(1u, _mesa_HashNumEntries(table));
+
+   /* glGen* reserves names by inserting NULL, which still counts as an entry */
+   _mesa_HashInsert(table, 5, NULL);
+   _mesa_HashInsert(table, HASH_DENSE_MAX_KEY + 5, NULL);
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 5));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, HASH_DENSE_MAX_KEY + 5));
+   EXPECT_EQ(2u, _mesa_HashNumEntries(table));
+
+   _mesa_HashRemove(table, 5);
+   EXPECT_EQ(1u, _mesa_HashNumEntries(table));
+}
+
+static void
+count_null_cb(GLuint key, void *data, void *userData)
+{
+   EXPECT_EQ(NULL, data);
+   (*(unsigned *) userData)++;
+}
+
+TEST_F(MesaHashTest, WalkNull)
+{
+   unsigned count = 0;
+
+   _mesa_HashInsert(table, 5, NULL);
+   _mesa_HashInsert(table, HASH_DENSE_MAX_KEY + 5, NULL);
+   _mesa_HashWalk(table, count_null_cb, &count);
+   EXPECT_EQ(2u, count);
+}
+
+struct walk_state {
+   unsigned count;
+   uint64_t key_sum;
+};
+
+static void
+walk_cb(GLuint key, void *data, void *userData)
+{
+   struct walk_state *state = (struct walk_state *) userData;
+
+   EXPECT_EQ(name_data(key), data);
+   state->count++;
+   state->key_sum += key;
+}
+
+TEST_F(MesaHashTest, Walk)
+{
+   uint64_t key_sum = 0;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(test_keys); i++) {
+      _mesa_HashInsert(table, test_keys[i], name_data(test_keys[i]));
+      key_sum += test_keys[i];
+   }
+
+   struct walk_state state = { 0, 0 };
+   _mesa_HashWalk(table, walk_cb, &state);
+   EXPECT_EQ(ARRAY_SIZE(test_keys), state.count);
+   EXPECT_EQ(key_sum, state.key_sum);
+}
+
+TEST_F(MesaHashTest, DeleteAll)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(test_keys); i++)
+      _mesa_HashInsert(table, test_keys[i], name_data(test_keys[i]));
+
+   struct walk_state state = { 0, 0 };
+   _mesa_HashDeleteAll(table, walk_cb, &state);
+   EXPECT_EQ(ARRAY_SIZE(test_keys), state.count);
+   EXPECT_EQ(0u, _mesa_HashNumEntries(table));
+
+   for (unsigned i = 0; i < ARRAY_SIZE(test_keys); i++)
+      EXPECT_EQ(NULL, _mesa_HashLookup(table, test_keys[i]));
+}
+
+TEST_F(MesaHashTest, FindFreeKeyBlock)
+{
+   EXPECT_EQ(1u, _mesa_HashFindFreeKeyBlock(table, 4));
+
+   _mesa_HashInsert(table, 10, name_data(10));
+   EXPECT_EQ(11u, _mesa_HashFindFreeKeyBlock(table, 4));
+
+   /* Exhaust the fast path, forcing a search of the whole key range */
+   _mesa_HashInsert(table, 0xfffffffe, name_data(0xfffffffe));
+   EXPECT_EQ(1u, _mesa_HashFindFreeKeyBlock(table, 4));
+   EXPECT_EQ(11u, _mesa_HashFindFreeKeyBlock(table, 10));
+}
+
+/**
+ * Not a correctness test: prints the name lookup throughput of a typical
+ * bind-heavy workload, i.e. a few thousand objects bound round robin.
+ * Run it with --gtest_also_run_disabled_tests.
+ */
+TEST_F(MesaHashTest, DISABLED_BindThroughput)
+{
+   const GLuint num_names = 4096;
+   const unsigned num_lookups = 1 << 24;
+   uintptr_t sum = 0;
+
+   for (GLuint key = 1; key <= num_names; key++)
+      _mesa_HashInsert(table, key, name_data(key));
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < num_lookups; i++)
+      sum += (uintptr_t) _mesa_HashLookup(table, (i % num_names) + 1);
+   int64_t end = os_time_get_nano();
+
+   EXPECT_NE(0u, sum);
+   printf("%.1f M lookups/s\n",
+          num_lookups * 1e3 / MAX2(end - start, 1));
+}
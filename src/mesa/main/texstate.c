@@ -41,6 +41,7 @@
 #include "state.h"
 #include "util/bitscan.h"
 #include "util/bitset.h"
+#include "util/u_queue.h"
 
 
 /**
@@ -1043,6 +1044,10 @@ _mesa_init_texture(struct gl_context *ctx)
     */
    ctx->Texture.CubeMapSeamless = ctx->API == API_OPENGLES2;
 
+   const char *threads = getenv("MESA_TEXSTORE_THREADS");
+   if (threads)
+      ctx->TexStoreThreads = strtoul(threads, NULL, 0);
+
    for (u = 0; u < ARRAY_SIZE(ctx->Texture.Unit); u++)
       init_texture_unit(ctx, u);
 
@@ -1095,6 +1100,12 @@ _mesa_free_texture_data(struct gl_context *ctx)
    for (u = 0; u < ARRAY_SIZE(ctx->Texture.Unit); u++) {
       _mesa_reference_sampler_object(ctx, &ctx->Texture.Unit[u].Sampler, NULL);
    }
+
+   if (ctx->TexStoreQueue) {
+      util_queue_destroy(ctx->TexStoreQueue);
+      free(ctx->TexStoreQueue);
+      ctx->TexStoreQueue = NULL;
+   }
 }
 
 
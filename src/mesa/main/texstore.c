@@ -75,6 +75,7 @@
 #include "pixeltransfer.h"
 #include "util/format_rgb9e5.h"
 #include "util/format_r11g11b10f.h"
+#include "util/u_queue.h"
 
 
 enum {
@@ -669,6 +670,115 @@ texstore_compressed(TEXSTORE_PARAMS)
                            srcFormat, srcType, srcAddr, srcPacking);
 }
 
+/* Images with fewer pixels than this are converted on the calling thread,
+ * as handing them to the TexStoreQueue threads costs more than it saves.
+ */
+#define TEXSTORE_MIN_PARALLEL_PIXELS (256 * 256)
+#define TEXSTORE_MAX_BANDS 16
+
+/**
+ * A band of rows of an image converted by convert_image().
+ */
+struct texstore_band
+{
+   struct util_queue_fence fence;
+   GLubyte *dst;
+   mesa_format dstFormat;
+   GLint dstRowStride;
+   GLubyte *src;
+   uint32_t srcFormat;
+   int srcRowStride;
+   int width, height;
+   uint8_t *rebaseSwizzle;
+};
+
+static void
+convert_band(void *data, int thread_index)
+{
+   struct texstore_band *band = (struct texstore_band *) data;
+
+   _mesa_format_convert(band->dst, band->dstFormat, band->dstRowStride,
+                        band->src, band->srcFormat, band->srcRowStride,
+                        band->width, band->height, band->rebaseSwizzle);
+}
+
+static struct util_queue *
+get_texstore_queue(struct gl_context *ctx)
+{
+   if (!ctx->TexStoreQueue) {
+      struct util_queue *queue = CALLOC_STRUCT(util_queue);
+
+      if (!queue ||
+          !util_queue_init(queue, "texstore", TEXSTORE_MAX_BANDS,
+                           ctx->TexStoreThreads, 0)) {
+         free(queue);
+         ctx->TexStoreThreads = 0;
+         return NULL;
+      }
+      ctx->TexStoreQueue = queue;
+   }
+
+   return ctx->TexStoreQueue;
+}
+
+/**
+ * _mesa_format_convert() one image.  Large images are split into bands of
+ * rows, which are converted on the TexStoreQueue threads and this one.
+ */
+static void
+convert_image(struct gl_context *ctx,
+              GLubyte *dst, mesa_format dstFormat, GLint dstRowStride,
+              GLubyte *src, uint32_t srcFormat, int srcRowStride,
+              int width, int height, uint8_t *rebaseSwizzle)
+{
+   struct texstore_band bands[TEXSTORE_MAX_BANDS];
+   struct util_queue *queue;
+   unsigned num_bands, rows_per_band, i;
+
+   num_bands = MIN2(ctx->TexStoreThreads + 1, TEXSTORE_MAX_BANDS);
+   num_bands = MIN2(num_bands, (unsigned) height);
+
+   if (num_bands < 2 ||
+       (size_t) width * height < TEXSTORE_MIN_PARALLEL_PIXELS ||
+       !(queue = get_texstore_queue(ctx))) {
+      _mesa_format_convert(dst, dstFormat, dstRowStride,
+                           src, srcFormat, srcRowStride,
+                           width, height, rebaseSwizzle);
+      return;
+   }
+
+   rows_per_band = DIV_ROUND_UP(height, num_bands);
+   num_bands = DIV_ROUND_UP(height, rows_per_band);
+
+   for (i = 0; i < num_bands; i++) {
+      const int y = i * rows_per_band;
+
+      bands[i].dst = dst + (ptrdiff_t) y * dstRowStride;
+      bands[i].dstFormat = dstFormat;
+      bands[i].dstRowStride = dstRowStride;
+      bands[i].src = src + (ptrdiff_t) y * srcRowStride;
+      bands[i].srcFormat = srcFormat;
+      bands[i].srcRowStride = srcRowStride;
+      bands[i].width = width;
+      bands[i].height = MIN2(rows_per_band, height - y);
+      bands[i].rebaseSwizzle = rebaseSwizzle;
+
+      /* The first band is converted below, while the others are queued. */
+      if (i > 0) {
+         util_queue_fence_init(&bands[i].fence);
+         util_queue_add_job(queue, &bands[i], &bands[i].fence,
+                            convert_band, NULL);
+      }
+   }
+
+   convert_band(&bands[0], 0);
+
+   for (i = 1; i < num_bands; i++) {
+      util_queue_fence_wait(&bands[i].fence);
+      util_queue_fence_destroy(&bands[i].fence);
+   }
+}
+
 static GLboolean
 texstore_rgba(TEXSTORE_PARAMS)
 {
@@ -806,10 +916,10 @@ texstore_rgba(TEXSTORE_PARAMS)
    }
 
    for (img = 0; img < srcDepth; img++) {
-      _mesa_format_convert(dstSlices[img], dstFormat, dstRowStride,
-                           src, srcMesaFormat, srcRowStride,
-                           srcWidth, srcHeight,
-                           needRebase ? rebaseSwizzle : NULL);
+      convert_image(ctx, dstSlices[img], dstFormat, dstRowStride,
+                    src, srcMesaFormat, srcRowStride,
+                    srcWidth, srcHeight,
+                    needRebase ? rebaseSwizzle : NULL);
       src += srcHeight * srcRowStride;
    }
 
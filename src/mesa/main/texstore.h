@@ -39,6 +39,10 @@
 #include "mtypes.h"
 #include "formats.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 /**
  * This macro defines the (many) parameters to the texstore functions.
@@ -149,4 +153,8 @@ _mesa_compute_compressed_pixelstore(GLuint dims, mesa_format texFormat,
                                     struct compressed_pixelstore *store);
 
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
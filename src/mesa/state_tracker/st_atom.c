@@ -35,6 +35,8 @@
 #include "st_atom.h"
 #include "st_program.h"
 #include "st_manager.h"
+#include "st_debug.h"
+#include "util/os_time.h"
 
 typedef void (*update_func_t)(struct st_context *st);
 
@@ -47,15 +49,49 @@ static const update_func_t update_functions[] =
 };
 
 
+/* The names of the atoms, for ST_DEBUG=atoms. */
+static const char *atom_names[] =
+{
+#define ST_STATE(FLAG, st_update) #st_update,
+#include "st_atom_list.h"
+#undef ST_STATE
+};
+
+
 void st_init_atoms( struct st_context *st )
 {
    STATIC_ASSERT(ARRAY_SIZE(update_functions) <= 64);
+
+   if (ST_DEBUG & DEBUG_ATOMS)
+      st->atom_stats = calloc(ARRAY_SIZE(update_functions),
+                              sizeof(*st->atom_stats));
 }
 
 
 void st_destroy_atoms( struct st_context *st )
 {
-   /* no-op */
+   if (!st->atom_stats)
+      return;
+
+   uint64_t total_ns = 0;
+   for (unsigned i = 0; i < ARRAY_SIZE(update_functions); i++)
+      total_ns += st->atom_stats[i].time_ns;
+
+   debug_printf("st: state atom updates (%.3f ms total):\n",
+                total_ns / 1000000.0);
+   for (unsigned i = 0; i < ARRAY_SIZE(update_functions); i++) {
+      const struct st_atom_stats *stats = &st->atom_stats[i];
+
+      if (!stats->count)
+         continue;
+
+      debug_printf("  %-32s %10"PRIu64" calls %10.3f ms %8.0f ns/call\n",
+                   atom_names[i], stats->count, stats->time_ns / 1000000.0,
+                   (double)stats->time_ns / stats->count);
+   }
+
+   free(st->atom_stats);
+   st->atom_stats = NULL;
 }
 
 
@@ -243,6 +279,19 @@ void st_validate_state( struct st_context *st, enum st_pipeline pipeline )
    dirty_lo = dirty;
    dirty_hi = dirty >> 32;
 
+   if (unlikely(st->atom_stats)) {
+      while (dirty) {
+         const unsigned i = u_bit_scan64(&dirty);
+         const int64_t start = os_time_get_nano();
+
+         update_functions[i](st);
+         st->atom_stats[i].time_ns += os_time_get_nano() - start;
+         st->atom_stats[i].count++;
+      }
+      st->dirty &= ~pipeline_mask;
+      return;
+   }
+
    /* Update states.
     *
     * Don't use u_bit_scan64, it may be slower on 32-bit.
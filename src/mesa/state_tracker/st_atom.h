@@ -48,6 +48,11 @@ enum st_pipeline {
    ST_PIPELINE_COMPUTE,
 };
 
+struct st_atom_stats {
+   uint64_t count;   /**< number of times the atom was updated */
+   uint64_t time_ns; /**< total time spent updating it */
+};
+
 void st_init_atoms( struct st_context *st );
 void st_destroy_atoms( struct st_context *st );
 void st_validate_state( struct st_context *st, enum st_pipeline pipeline );
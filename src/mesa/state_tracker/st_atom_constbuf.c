@@ -232,6 +232,15 @@ static void st_bind_ubos(struct st_context *st, struct gl_program *prog,
          cb.buffer_size = 0;
       }
 
+      /* Most draws rebind the same buffers. */
+      struct pipe_constant_buffer *bound = &st->state.ubos[shader_type][1 + i];
+      if (bound->buffer == cb.buffer &&
+          bound->buffer_offset == cb.buffer_offset &&
+          bound->buffer_size == cb.buffer_size &&
+          !bound->user_buffer)
+         continue;
+
+      util_copy_constant_buffer(bound, &cb);
       cso_set_constant_buffer(st->cso_context, shader_type, 1 + i, &cb);
    }
 }
@@ -110,6 +110,7 @@ update_textures(struct st_context *st,
    GLbitfield free_slots = ~prog->SamplersUsed;
    GLbitfield external_samplers_used = prog->ExternalSamplersUsed;
    GLuint unit;
+   bool any_change = false;
 
    if (samplers_used == 0x0 && old_max == 0)
       return;
@@ -159,6 +160,7 @@ update_textures(struct st_context *st,
          num_textures = unit + 1;
       }
 
+      any_change |= sampler_views[unit] != sampler_view;
       pipe_sampler_view_reference(&(sampler_views[unit]), sampler_view);
    }
 
@@ -207,13 +209,24 @@ update_textures(struct st_context *st,
       }
 
       num_textures = MAX2(num_textures, extra + 1);
+
+      /* The extra views are new every time. */
+      any_change = true;
    }
 
-   cso_set_sampler_views(st->cso_context,
-                         shader_stage,
-                         num_textures,
-                         sampler_views);
    *out_num_textures = num_textures;
+
+   /* The fragment views are also changed by meta operations behind our
+    * back, cso_context keeps track of what the driver has.  The views of
+    * the other stages only need to be sent to the driver if any of them
+    * changed, which is most often none.
+    */
+   if (shader_stage == PIPE_SHADER_FRAGMENT || any_change) {
+      cso_set_sampler_views(st->cso_context,
+                            shader_stage,
+                            num_textures,
+                            sampler_views);
+   }
 }
 
 
@@ -84,6 +84,7 @@
 
 
 DEBUG_GET_ONCE_BOOL_OPTION(mesa_mvp_dp4, "MESA_MVP_DP4", FALSE)
+DEBUG_GET_ONCE_BOOL_OPTION(prewarm_variants, "ST_PREWARM_VARIANTS", FALSE)
 
 
 /**
@@ -272,6 +273,11 @@ st_destroy_context_priv(struct st_context *st, bool destroy_pipe)
       }
    }
 
+   for (shader = 0; shader < ARRAY_SIZE(st->state.ubos); shader++) {
+      for (i = 0; i < ARRAY_SIZE(st->state.ubos[0]); i++)
+         pipe_resource_reference(&st->state.ubos[shader][i].buffer, NULL);
+   }
+
    /* free glDrawPixels cache data */
    free(st->drawpix_cache.image);
    pipe_resource_reference(&st->drawpix_cache.texture, NULL);
@@ -534,6 +540,8 @@ st_create_context_priv(struct gl_context *ctx, struct pipe_context *pipe,
    st->shader_has_one_variant[MESA_SHADER_GEOMETRY] = st->has_shareable_shaders;
    st->shader_has_one_variant[MESA_SHADER_COMPUTE] = st->has_shareable_shaders;
 
+   st->prewarm_variants = ctx->Cache && debug_get_option_prewarm_variants();
+
    st->bitmap.cache.empty = true;
 
    _mesa_override_extensions(ctx);
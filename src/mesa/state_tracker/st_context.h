@@ -120,6 +120,13 @@ struct st_context
     */
    boolean shader_has_one_variant[MESA_SHADER_STAGES];
 
+   /**
+    * Whether the keys of the variants created at draw time are recorded in
+    * the disk cache, so that they are compiled when the program is loaded
+    * from the cache next time (ST_PREWARM_VARIANTS).
+    */
+   boolean prewarm_variants;
+
    boolean needs_texcoord_semantic;
    boolean apply_texture_swizzle_to_border_color;
 
@@ -147,6 +154,8 @@ struct st_context
          void *ptr;
          unsigned size;
       } constants[PIPE_SHADER_TYPES];
+      /** Bound uniform buffers, to skip rebinding unchanged ones. */
+      struct pipe_constant_buffer ubos[PIPE_SHADER_TYPES][PIPE_MAX_CONSTANT_BUFFERS];
       unsigned fb_width;
       unsigned fb_height;
       unsigned fb_num_samples;
@@ -167,6 +176,9 @@ struct st_context
 
    uint64_t dirty; /**< dirty states */
 
+   /** Per-atom invocation counts and time, with ST_DEBUG=atoms. */
+   struct st_atom_stats *atom_stats;
+
    /** This masks out unused shader resources. Only valid in draw calls. */
    uint64_t active_states;
 
@@ -60,6 +60,7 @@ static const struct debug_named_value st_debug_flags[] = {
    { "precompile",  DEBUG_PRECOMPILE, NULL },
    { "gremedy",  DEBUG_GREMEDY, "Enable GREMEDY debug extensions" },
    { "noreadpixcache", DEBUG_NOREADPIXCACHE, NULL },
+   { "atoms",    DEBUG_ATOMS, "Report the time spent in each state atom" },
    DEBUG_NAMED_VALUE_END
 };
 
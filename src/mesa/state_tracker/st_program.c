@@ -632,6 +632,8 @@ st_get_vp_variant(struct st_context *st,
          /* insert into list */
          vpv->next = stvp->variants;
          stvp->variants = vpv;
+
+         st_store_variant_keys_in_disk_cache(st, &stvp->Base);
       }
    }
 
@@ -1268,6 +1270,8 @@ st_get_fp_variant(struct st_context *st,
             fpv->next = stfp->variants;
             stfp->variants = fpv;
          }
+
+         st_store_variant_keys_in_disk_cache(st, &stfp->Base);
       }
    }
 
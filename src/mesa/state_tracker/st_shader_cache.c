@@ -115,6 +115,157 @@ st_store_tgsi_in_disk_cache(struct st_context *st, struct gl_program *prog,
    blob_finish(&blob);
 }
 
+/**
+ * Compute the disk cache key of the variant keys recorded for a program.
+ * Returns false if the program doesn't come from the disk cache.
+ */
+static bool
+compute_variant_keys_sha1(struct st_context *st, struct gl_program *prog,
+                          cache_key key)
+{
+   static const char zero[sizeof(prog->sh.data->sha1)] = {0};
+   char sha1buf[41];
+   char buf[64];
+
+   if (!prog->sh.data ||
+       memcmp(prog->sh.data->sha1, zero, sizeof(prog->sh.data->sha1)) == 0)
+      return false;
+
+   _mesa_sha1_format(sha1buf, prog->sh.data->sha1);
+   snprintf(buf, sizeof(buf), "st variants %s: %s",
+            _mesa_shader_stage_to_abbrev(prog->info.stage), sha1buf);
+   disk_cache_compute_key(st->ctx->Cache, buf, strlen(buf), key);
+   return true;
+}
+
+/**
+ * Store the keys of all the vertex or fragment program variants created so
+ * far, for prewarm_shader_variants().  Called whenever a variant is added.
+ */
+void
+st_store_variant_keys_in_disk_cache(struct st_context *st,
+                                    struct gl_program *prog)
+{
+   cache_key key;
+
+   if (!st->prewarm_variants ||
+       st->shader_has_one_variant[prog->info.stage] ||
+       !compute_variant_keys_sha1(st, prog, key))
+      return;
+
+   struct blob blob;
+   blob_init(&blob);
+
+   intptr_t count_offset = blob_reserve_uint32(&blob);
+   uint32_t count = 0;
+
+   switch (prog->info.stage) {
+   case MESA_SHADER_VERTEX: {
+      struct st_vertex_program *stvp = (struct st_vertex_program *) prog;
+
+      for (struct st_vp_variant *vpv = stvp->variants; vpv; vpv = vpv->next) {
+         struct st_vp_variant_key vp_key = vpv->key;
+
+         vp_key.st = NULL;
+         blob_write_bytes(&blob, &vp_key, sizeof(vp_key));
+         count++;
+      }
+      break;
+   }
+   case MESA_SHADER_FRAGMENT: {
+      struct st_fragment_program *stfp = (struct st_fragment_program *) prog;
+
+      for (struct st_fp_variant *fpv = stfp->variants; fpv; fpv = fpv->next) {
+         struct st_fp_variant_key fp_key = fpv->key;
+
+         fp_key.st = NULL;
+         blob_write_bytes(&blob, &fp_key, sizeof(fp_key));
+         count++;
+      }
+      break;
+   }
+   default:
+      /* The other stages have no variant keys. */
+      blob_finish(&blob);
+      return;
+   }
+
+   blob_overwrite_uint32(&blob, count_offset, count);
+
+   if (!blob.out_of_memory) {
+      disk_cache_put(st->ctx->Cache, key, blob.data, blob.size, NULL);
+
+      if (st->ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+         fprintf(stderr, "putting %u %s variant keys in cache\n", count,
+                 _mesa_shader_stage_to_string(prog->info.stage));
+      }
+   }
+
+   blob_finish(&blob);
+}
+
+/**
+ * Create the vertex or fragment program variants that were used last time
+ * the program was loaded, so that the draw calls don't have to.
+ *
+ * Ideally this would happen on a separate thread, but pipe_context isn't
+ * thread-safe.  Doing it at link time still takes the compilation out of
+ * the first frames using the program, and drivers compiling asynchronously
+ * get all variants queued at once.
+ */
+static void
+prewarm_shader_variants(struct st_context *st, struct gl_program *prog)
+{
+   cache_key key;
+   size_t size;
+
+   if (!st->prewarm_variants || !compute_variant_keys_sha1(st, prog, key))
+      return;
+
+   uint8_t *buffer = (uint8_t *) disk_cache_get(st->ctx->Cache, key, &size);
+   if (!buffer)
+      return;
+
+   struct blob_reader blob_reader;
+   blob_reader_init(&blob_reader, buffer, size);
+   uint32_t count = blob_read_uint32(&blob_reader);
+   struct st_context *key_st = st->has_shareable_shaders ? NULL : st;
+
+   /* Don't store the keys again for every variant created here. */
+   st->prewarm_variants = false;
+
+   for (unsigned i = 0; i < count; i++) {
+      if (prog->info.stage == MESA_SHADER_VERTEX) {
+         struct st_vp_variant_key vp_key;
+
+         blob_copy_bytes(&blob_reader, (uint8_t *) &vp_key, sizeof(vp_key));
+         if (blob_reader.overrun)
+            break;
+
+         vp_key.st = key_st;
+         st_get_vp_variant(st, (struct st_vertex_program *) prog, &vp_key);
+      } else if (prog->info.stage == MESA_SHADER_FRAGMENT) {
+         struct st_fp_variant_key fp_key;
+
+         blob_copy_bytes(&blob_reader, (uint8_t *) &fp_key, sizeof(fp_key));
+         if (blob_reader.overrun)
+            break;
+
+         fp_key.st = key_st;
+         st_get_fp_variant(st, (struct st_fragment_program *) prog, &fp_key);
+      }
+   }
+
+   st->prewarm_variants = true;
+
+   if (st->ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+      fprintf(stderr, "%s variants prewarmed from %u cached keys\n",
+              _mesa_shader_stage_to_string(prog->info.stage), count);
+   }
+
+   free(buffer);
+}
+
 static void
 read_stream_out_from_cache(struct blob_reader *blob_reader,
                            struct pipe_shader_state *tgsi)
@@ -281,6 +432,8 @@ st_load_tgsi_from_disk_cache(struct gl_context *ctx,
       if (ST_DEBUG & DEBUG_PRECOMPILE ||
           st->shader_has_one_variant[glprog->info.stage])
          st_precompile_shader_variant(st, glprog);
+      else
+         prewarm_shader_variants(st, glprog);
 
       /* We don't need the cached blob anymore so free it */
       ralloc_free(glprog->driver_cache_blob);
@@ -41,6 +41,10 @@ st_store_tgsi_in_disk_cache(struct st_context *st, struct gl_program *prog,
                             struct pipe_shader_state *out_state,
                             unsigned num_tokens);
 
+void
+st_store_variant_keys_in_disk_cache(struct st_context *st,
+                                    struct gl_program *prog);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,96 @@
+/*
+ * Copyright © 2018 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks the GL versions the state tracker computes for llvmpipe, so that
+ * changing a cap (like the sample counts) can't silently lose extensions
+ * which the versions depend on.
+ */
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include "pipe/p_screen.h"
+#include "state_tracker/st_api.h"
+#include "llvmpipe/lp_public.h"
+
+extern "C" {
+#include "state_tracker/st_gl_api.h"
+#include "sw/null/null_sw_winsys.h"
+}
+
+class LlvmpipeVersionTest : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   struct pipe_screen *screen;
+   int core, compat, es1, es2;
+};
+
+void
+LlvmpipeVersionTest::SetUp()
+{
+   struct st_api *stapi = st_gl_api_create();
+   struct st_manager smapi;
+   struct st_config_options options;
+
+   screen = llvmpipe_create_screen(null_sw_create());
+   ASSERT_TRUE(screen != NULL);
+
+   memset(&smapi, 0, sizeof(smapi));
+   memset(&options, 0, sizeof(options));
+   smapi.screen = screen;
+
+   stapi->query_versions(stapi, &smapi, &options,
+                         &core, &compat, &es1, &es2);
+}
+
+void
+LlvmpipeVersionTest::TearDown()
+{
+   if (screen)
+      screen->destroy(screen);
+}
+
+TEST_F(LlvmpipeVersionTest, Core)
+{
+   /* 3.2 needs ARB_texture_multisample */
+   EXPECT_GE(core, 33);
+}
+
+TEST_F(LlvmpipeVersionTest, Multisample)
+{
+   EXPECT_EQ(1, screen->get_param(screen, PIPE_CAP_TEXTURE_MULTISAMPLE));
+   EXPECT_TRUE(screen->is_format_supported(screen,
+                                           PIPE_FORMAT_R8G8B8A8_UNORM,
+                                           PIPE_TEXTURE_2D, 4,
+                                           PIPE_BIND_SAMPLER_VIEW |
+                                           PIPE_BIND_RENDER_TARGET));
+}
+
+TEST_F(LlvmpipeVersionTest, ES)
+{
+   EXPECT_EQ(11, es1);
+   EXPECT_GE(es2, 30);
+}
@@ -232,7 +232,7 @@ vbo_get_default_vals_as_union(GLenum format)
 static inline unsigned
 vbo_compute_max_verts(const struct vbo_exec_context *exec)
 {
-   unsigned n = (VBO_VERT_BUFFER_SIZE - exec->vtx.buffer_used) /
+   unsigned n = (exec->vtx.buffer_end - exec->vtx.buffer_used) /
       (exec->vtx.vertex_size * sizeof(GLfloat));
    if (n == 0)
       return 0;
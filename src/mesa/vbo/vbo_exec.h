@@ -42,8 +42,9 @@ USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 /**
  * Max number of primitives (number of glBegin/End pairs) per VBO.
+ * They are all drawn with one draw_prims() call.
  */
-#define VBO_MAX_PRIM 64
+#define VBO_MAX_PRIM 256
 
 
 /**
@@ -52,6 +53,16 @@ USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define VBO_VERT_BUFFER_SIZE (1024*64)	/* bytes */
 
 
+/**
+ * Size of the persistently mapped VBO used instead when the driver supports
+ * ARB_buffer_storage, and the number of segments it's divided in.  Vertices
+ * are written to one segment at a time, and a segment is only reused once
+ * the fence placed when it was left has signalled.
+ */
+#define VBO_VERT_RING_SIZE (1024*1024)	/* bytes */
+#define VBO_VERT_RING_SEGMENTS 4
+
+
 /** Current vertex program mode */
 enum vp_mode {
    VP_NONE,   /**< fixed function */
@@ -95,6 +106,12 @@ struct vbo_exec_context
       fi_type *buffer_map;
       fi_type *buffer_ptr;              /* cursor, points into buffer */
       GLuint   buffer_used;             /* in bytes */
+      GLuint   buffer_end;              /* end of the usable range, in bytes */
+
+      /** The VBO is a persistently mapped ring, see VBO_VERT_RING_SIZE */
+      GLboolean persistent;
+      fi_type *ring_map;
+      struct gl_sync_object *ring_fences[VBO_VERT_RING_SEGMENTS];
       fi_type vertex[VBO_ATTRIB_MAX*4]; /* current vertex */
 
       GLuint vert_count;   /**< Number of vertices currently in buffer */
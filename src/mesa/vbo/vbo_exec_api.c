@@ -1115,9 +1115,6 @@ vbo_use_buffer_objects(struct gl_context *ctx)
     * go into the bufferobj hashtable.
     */
    GLuint bufName = IMM_BUFFER_NAME;
-   GLenum target = GL_ARRAY_BUFFER_ARB;
-   GLenum usage = GL_STREAM_DRAW_ARB;
-   GLsizei size = VBO_VERT_BUFFER_SIZE;
 
    /* Make sure this func is only used once */
    assert(exec->vtx.bufferobj == ctx->Shared->NullBufferObj);
@@ -1126,16 +1123,14 @@ vbo_use_buffer_objects(struct gl_context *ctx)
    exec->vtx.buffer_map = NULL;
    exec->vtx.buffer_ptr = NULL;
 
-   /* Allocate a real buffer object now */
+   /* Allocate a real buffer object now.  Its storage is allocated by
+    * vbo_exec_vtx_map() on first use, once the driver's extensions are
+    * known.
+    */
    _mesa_reference_buffer_object(ctx, &exec->vtx.bufferobj, NULL);
    exec->vtx.bufferobj = ctx->Driver.NewBufferObject(ctx, bufName);
-   if (!ctx->Driver.BufferData(ctx, target, size, NULL, usage,
-                               GL_MAP_WRITE_BIT |
-                               GL_DYNAMIC_STORAGE_BIT |
-                               GL_CLIENT_STORAGE_BIT,
-                               exec->vtx.bufferobj)) {
-      _mesa_error(ctx, GL_OUT_OF_MEMORY, "VBO allocation");
-   }
+   exec->vtx.buffer_used = 0;
+   exec->vtx.buffer_end = 0;
 }
 
 
@@ -1171,6 +1166,7 @@ vbo_exec_vtx_init(struct vbo_exec_context *exec)
    assert(!exec->vtx.buffer_map);
    exec->vtx.buffer_map = _mesa_align_malloc(VBO_VERT_BUFFER_SIZE, 64);
    exec->vtx.buffer_ptr = exec->vtx.buffer_map;
+   exec->vtx.buffer_end = VBO_VERT_BUFFER_SIZE;
 
    vbo_exec_vtxfmt_init( exec );
    _mesa_noop_vtxfmt_init(&exec->vtxfmt_noop);
@@ -1250,6 +1246,11 @@ vbo_exec_vtx_destroy(struct vbo_exec_context *exec)
                                     NULL);
    }
 
+   for (i = 0; i < VBO_VERT_RING_SEGMENTS; i++) {
+      if (exec->vtx.ring_fences[i])
+         ctx->Driver.DeleteSyncObject(ctx, exec->vtx.ring_fences[i]);
+   }
+
    /* Free the vertex buffer.  Unmap first if needed.
     */
    if (_mesa_bufferobj_mapped(exec->vtx.bufferobj, MAP_INTERNAL)) {
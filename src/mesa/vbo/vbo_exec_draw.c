@@ -244,7 +244,7 @@ vbo_exec_bind_arrays( struct gl_context *ctx )
             assert(exec->vtx.bufferobj->Mappings[MAP_INTERNAL].Pointer);
             assert(offset >= 0);
             arrays[attr].Ptr = (GLubyte *)
-               exec->vtx.bufferobj->Mappings[MAP_INTERNAL].Offset + offset;
+               (uintptr_t) exec->vtx.buffer_used + offset;
          }
          else {
             /* Ptr into ordinary app memory */
@@ -304,10 +304,12 @@ vbo_exec_vtx_unmap( struct vbo_exec_context *exec )
       exec->vtx.buffer_used += (exec->vtx.buffer_ptr -
                                 exec->vtx.buffer_map) * sizeof(float);
 
-      assert(exec->vtx.buffer_used <= VBO_VERT_BUFFER_SIZE);
+      assert(exec->vtx.buffer_used <= exec->vtx.buffer_end);
       assert(exec->vtx.buffer_ptr != NULL);
 
-      ctx->Driver.UnmapBuffer(ctx, exec->vtx.bufferobj, MAP_INTERNAL);
+      /* The ring stays mapped, it's drawn from while mapped. */
+      if (!exec->vtx.persistent)
+         ctx->Driver.UnmapBuffer(ctx, exec->vtx.bufferobj, MAP_INTERNAL);
       exec->vtx.buffer_map = NULL;
       exec->vtx.buffer_ptr = NULL;
       exec->vtx.max_vert = 0;
@@ -315,6 +317,92 @@ vbo_exec_vtx_unmap( struct vbo_exec_context *exec )
 }
 
 
+/**
+ * Allocate the persistently mapped ring.  Returns false if the driver can't
+ * map it, in which case a regular VBO is used.
+ */
+static bool
+vbo_exec_ring_alloc(struct vbo_exec_context *exec)
+{
+   struct gl_context *ctx = exec->ctx;
+   const GLbitfield storage = GL_MAP_WRITE_BIT |
+                              GL_MAP_PERSISTENT_BIT |
+                              GL_CLIENT_STORAGE_BIT;
+   const GLbitfield access = GL_MAP_WRITE_BIT |
+                             GL_MAP_PERSISTENT_BIT |
+                             GL_MAP_UNSYNCHRONIZED_BIT |
+                             GL_MAP_FLUSH_EXPLICIT_BIT;
+
+   if (!ctx->Extensions.ARB_buffer_storage || !ctx->Driver.FenceSync)
+      return false;
+
+   if (!ctx->Driver.BufferData(ctx, GL_ARRAY_BUFFER_ARB, VBO_VERT_RING_SIZE,
+                               NULL, GL_STREAM_DRAW_ARB, storage,
+                               exec->vtx.bufferobj))
+      return false;
+
+   exec->vtx.ring_map =
+      (fi_type *)ctx->Driver.MapBufferRange(ctx, 0, VBO_VERT_RING_SIZE,
+                                            access, exec->vtx.bufferobj,
+                                            MAP_INTERNAL);
+   if (!exec->vtx.ring_map)
+      return false;
+
+   exec->vtx.persistent = GL_TRUE;
+   exec->vtx.buffer_used = 0;
+   exec->vtx.buffer_end = VBO_VERT_RING_SIZE / VBO_VERT_RING_SEGMENTS;
+   return true;
+}
+
+
+/**
+ * Continue writing vertices in the ring, moving on to its next segment if
+ * the current one is full.
+ */
+static void
+vbo_exec_ring_map(struct vbo_exec_context *exec)
+{
+   struct gl_context *ctx = exec->ctx;
+   const GLuint segment_size = VBO_VERT_RING_SIZE / VBO_VERT_RING_SEGMENTS;
+
+   if (exec->vtx.buffer_used + 1024 > exec->vtx.buffer_end) {
+      const unsigned cur = exec->vtx.buffer_end / segment_size - 1;
+      const unsigned next = (cur + 1) % VBO_VERT_RING_SEGMENTS;
+      struct gl_sync_object *fence;
+
+      /* Everything read from the current segment has been drawn by now. */
+      assert(!exec->vtx.ring_fences[cur]);
+      fence = ctx->Driver.NewSyncObject(ctx);
+      if (fence) {
+         fence->RefCount = 1;
+         fence->SyncCondition = GL_SYNC_GPU_COMMANDS_COMPLETE;
+         ctx->Driver.FenceSync(ctx, fence, GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+         exec->vtx.ring_fences[cur] = fence;
+      } else {
+         /* Without a fence, wait until the GPU is idle. */
+         ctx->Driver.Finish(ctx);
+      }
+
+      fence = exec->vtx.ring_fences[next];
+      if (fence) {
+         ctx->Driver.CheckSync(ctx, fence);
+         if (!fence->StatusFlag)
+            ctx->Driver.ClientWaitSync(ctx, fence,
+                                       GL_SYNC_FLUSH_COMMANDS_BIT,
+                                       GL_TIMEOUT_IGNORED);
+         ctx->Driver.DeleteSyncObject(ctx, fence);
+         exec->vtx.ring_fences[next] = NULL;
+      }
+
+      exec->vtx.buffer_used = next * segment_size;
+      exec->vtx.buffer_end = exec->vtx.buffer_used + segment_size;
+   }
+
+   exec->vtx.buffer_map =
+      exec->vtx.ring_map + exec->vtx.buffer_used / sizeof(fi_type);
+}
+
+
 /**
  * Map the vertex buffer to begin storing glVertex, glColor, etc data.
  */
@@ -335,13 +423,16 @@ vbo_exec_vtx_map( struct vbo_exec_context *exec )
    assert(!exec->vtx.buffer_map);
    assert(!exec->vtx.buffer_ptr);
 
-   if (VBO_VERT_BUFFER_SIZE > exec->vtx.buffer_used + 1024) {
+   if (exec->vtx.persistent) {
+      vbo_exec_ring_map(exec);
+   }
+   else if (exec->vtx.buffer_end > exec->vtx.buffer_used + 1024) {
       /* The VBO exists and there's room for more */
       if (exec->vtx.bufferobj->Size > 0) {
          exec->vtx.buffer_map =
             (fi_type *)ctx->Driver.MapBufferRange(ctx,
                                                   exec->vtx.buffer_used,
-                                                  (VBO_VERT_BUFFER_SIZE - 
+                                                  (exec->vtx.buffer_end -
                                                    exec->vtx.buffer_used),
                                                   accessRange,
                                                   exec->vtx.bufferobj,
@@ -353,9 +444,13 @@ vbo_exec_vtx_map( struct vbo_exec_context *exec )
       }
    }
 
-   if (!exec->vtx.buffer_map) {
+   if (!exec->vtx.buffer_map && vbo_exec_ring_alloc(exec)) {
+      exec->vtx.buffer_map = exec->vtx.ring_map;
+   }
+   else if (!exec->vtx.buffer_map) {
       /* Need to allocate a new VBO */
       exec->vtx.buffer_used = 0;
+      exec->vtx.buffer_end = VBO_VERT_BUFFER_SIZE;
 
       if (ctx->Driver.BufferData(ctx, GL_ARRAY_BUFFER_ARB,
                                  VBO_VERT_BUFFER_SIZE,
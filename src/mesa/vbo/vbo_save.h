@@ -82,6 +82,16 @@ struct vbo_save_vertex_list {
    struct _mesa_prim *prim;
    GLuint prim_count;
 
+   /* The same primitives drawn through an index buffer that references
+    * each distinct vertex only once, so that repeated vertices hit the
+    * post-transform vertex cache.  NULL if the list doesn't repeat enough
+    * vertices for this to pay off.  prim[] is still used for loopback.
+    */
+   struct _mesa_prim *indexed_prim;
+   struct gl_buffer_object *index_bufferobj;
+   GLuint index_count;
+   GLuint index_size;            /**< 2 or 4 bytes */
+
    struct vbo_save_vertex_store *vertex_store;
    struct vbo_save_primitive_store *prim_store;
 };
@@ -98,6 +108,11 @@ struct vbo_save_vertex_list {
  */
 #define VBO_SAVE_BUFFER_SIZE (256*1024) /* dwords */
 #define VBO_SAVE_PRIM_SIZE   128
+
+/* Vertex lists with fewer vertices than this, or which would shrink by
+ * less than a quarter by deduplicating vertices, aren't indexed.
+ */
+#define VBO_SAVE_INDEX_MIN_VERTS 32
 #define VBO_SAVE_PRIM_MODE_MASK         0x3f
 #define VBO_SAVE_PRIM_WEAK              0x40
 #define VBO_SAVE_PRIM_NO_CURRENT_UPDATE 0x80
@@ -80,6 +80,7 @@ USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "main/dispatch.h"
 #include "main/state.h"
 #include "util/bitscan.h"
+#include "util/hash_table.h"
 
 #include "vbo_context.h"
 #include "vbo_noop.h"
@@ -407,6 +408,112 @@ convert_line_loop_to_strip(struct vbo_save_context *save,
 }
 
 
+/**
+ * Build vbo_save_vertex_list::indexed_prim and the index buffer it draws
+ * from.  Each index refers to the first vertex of the list that is
+ * bitwise identical to the one drawn there, which is what applications
+ * emitting shared mesh vertices once per triangle or strip produce.
+ */
+static void
+build_index_buffer(struct gl_context *ctx,
+                   struct vbo_save_vertex_list *node,
+                   const fi_type *vertices)
+{
+   const GLuint vertex_bytes = node->vertex_size * sizeof(fi_type);
+   const GLuint index_size = node->count <= 65536 ? 2 : 4;
+   GLuint *table = NULL, *remap = NULL;
+   void *indices = NULL;
+   struct _mesa_prim *prims = NULL;
+   struct gl_buffer_object *obj;
+   GLuint table_mask, num_unique = 0, num_indices = 0;
+   GLuint i, j;
+
+   node->indexed_prim = NULL;
+   node->index_bufferobj = NULL;
+   node->index_count = 0;
+   node->index_size = 0;
+
+   if (node->count < VBO_SAVE_INDEX_MIN_VERTS)
+      return;
+
+   /* Open addressing hash table of vertex numbers plus one. */
+   table_mask = (1u << util_last_bit(node->count * 2)) - 1;
+   table = calloc(table_mask + 1, sizeof(GLuint));
+   remap = malloc(node->count * sizeof(GLuint));
+   if (!table || !remap)
+      goto out;
+
+   for (i = 0; i < node->count; i++) {
+      const fi_type *v = vertices + i * node->vertex_size;
+      GLuint h = _mesa_hash_data(v, vertex_bytes) & table_mask;
+
+      while (table[h] &&
+             memcmp(v, vertices + (table[h] - 1) * node->vertex_size,
+                    vertex_bytes) != 0)
+         h = (h + 1) & table_mask;
+
+      if (!table[h]) {
+         table[h] = i + 1;
+         num_unique++;
+      }
+      remap[i] = table[h] - 1;
+   }
+
+   if (num_unique * 4 > node->count * 3)
+      goto out;
+
+   for (i = 0; i < node->prim_count; i++)
+      num_indices += node->prim[i].count;
+
+   indices = malloc(num_indices * index_size);
+   prims = malloc(node->prim_count * sizeof(*prims));
+   if (!indices || !prims)
+      goto out;
+
+   num_indices = 0;
+   for (i = 0; i < node->prim_count; i++) {
+      const struct _mesa_prim *prim = &node->prim[i];
+
+      for (j = 0; j < prim->count; j++) {
+         if (index_size == 2)
+            ((GLushort *) indices)[num_indices + j] = remap[prim->start + j];
+         else
+            ((GLuint *) indices)[num_indices + j] = remap[prim->start + j];
+      }
+
+      prims[i] = *prim;
+      prims[i].indexed = 1;
+      prims[i].start = num_indices;
+      prims[i].basevertex = 0;
+      num_indices += prim->count;
+   }
+
+   obj = ctx->Driver.NewBufferObject(ctx, VBO_BUF_ID + 1);
+   if (!obj)
+      goto out;
+
+   /* Failing this only costs us the optimization. */
+   if (!ctx->Driver.BufferData(ctx, GL_ELEMENT_ARRAY_BUFFER_ARB,
+                               num_indices * index_size, indices,
+                               GL_STATIC_DRAW_ARB, 0, obj)) {
+      _mesa_reference_buffer_object(ctx, &obj, NULL);
+      goto out;
+   }
+
+   node->indexed_prim = prims;
+   node->index_bufferobj = obj;
+   node->index_count = num_indices;
+   node->index_size = index_size;
+   prims = NULL;
+
+out:
+   free(prims);
+   free(indices);
+   free(remap);
+   free(table);
+}
+
+
 /**
  * Insert the active immediate struct onto the display list currently
  * being built.
@@ -512,6 +619,11 @@ _save_compile_vertex_list(struct gl_context *ctx)
       _glapi_set_dispatch(dispatch);
    }
 
+   build_index_buffer(ctx, node,
+                      (const fi_type *) ((const char *) save->
+                                         vertex_store->buffer +
+                                         node->buffer_offset));
+
    /* Decide whether the storage structs are full, or can be used for
     * the next vertex lists as well.
     */
@@ -1650,6 +1762,10 @@ vbo_destroy_vertex_list(struct gl_context *ctx, void *data)
 
    free(node->current_data);
    node->current_data = NULL;
+
+   free(node->indexed_prim);
+   node->indexed_prim = NULL;
+   _mesa_reference_buffer_object(ctx, &node->index_bufferobj, NULL);
 }
 
 
@@ -1667,6 +1783,9 @@ vbo_print_vertex_list(struct gl_context *ctx, void *data, FILE *f)
            node->count, node->prim_count, node->vertex_size,
            buffer);
 
+   if (node->indexed_prim)
+      fprintf(f, "   drawn with %u indices\n", node->index_count);
+
    for (i = 0; i < node->prim_count; i++) {
       struct _mesa_prim *prim = &node->prim[i];
       fprintf(f, "   prim %d: %s%s %d..%d %s %s\n",
@@ -311,7 +311,28 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data)
       if (ctx->NewState)
 	 _mesa_update_state( ctx );
 
-      if (node->count > 0) {
+      /* Use the indexed primitives unless the restart index could collide
+       * with one of ours.
+       */
+      if (node->count > 0 && node->indexed_prim &&
+          !ctx->Array._PrimitiveRestart) {
+         struct _mesa_index_buffer ib;
+
+         ib.count = node->index_count;
+         ib.index_size = node->index_size;
+         ib.obj = node->index_bufferobj;
+         ib.ptr = NULL;
+
+         vbo_context(ctx)->draw_prims(ctx,
+                                      node->indexed_prim,
+                                      node->prim_count,
+                                      &ib,
+                                      GL_TRUE,
+                                      0,
+                                      node->count - 1,
+                                      NULL, 0, NULL);
+      }
+      else if (node->count > 0) {
          vbo_context(ctx)->draw_prims(ctx, 
                                       node->prim,
                                       node->prim_count,
@@ -249,13 +249,17 @@ util_queue_is_initialized(struct util_queue *queue)
  */
 struct util_queue_monitoring
 {
-   /* For querying the thread busyness. */
-   struct util_queue *queue;
+   /* For querying the thread busyness, NULL if there's no thread. */
+   thrd_t *thread;
 
    /* Counters updated by the user of the queue. */
    unsigned num_offloaded_items;
    unsigned num_direct_items;
    unsigned num_syncs;
+   /* Calls that had to synchronize with the queue, whether it was busy or
+    * not.  Useful for finding the remaining sync points of a workload.
+    */
+   unsigned num_sync_calls;
 };
 
 #ifdef __cplusplus